@@ -72,11 +72,12 @@ bool sdHotServerList::IsServerValid( const sdNetSession& session, sdNetManager&
 		return false;
 	}
 
-	if ( session.GetServerInfo().GetBool( "si_needPass" ) ) {
+	const sdNetManager::sessionRecord_t& record = manager.GetSessionRecord( session );
+	if ( record.needPass ) {
 		return false;
 	}
 
-	int maxPlayers = session.GetServerInfo().GetInt( "si_maxPlayers" );
+	int maxPlayers = record.maxPlayers;
 	if ( maxPlayers < MIN_SENSIBLE_PLAYER_LIMIT ) {
 		return false; // Gordon: ignore servers with silly player limit
 	}
@@ -176,7 +177,7 @@ int sdHotServerList::GetServerScore( const sdNetSession& session, sdNetManager&
 	}
 	score += playerBonus;
 
-	sdGameRules* rules = gameLocal.GetRulesInstance( session.GetServerInfo().GetString( "si_rules" ) );
+	sdGameRules* rules = gameLocal.GetRulesInstance( manager.GetSessionRecord( session ).rules->c_str() );
 	if ( rules != NULL ) {
 		score += rules->GetServerBrowserScore( session );
 	}
@@ -210,7 +211,7 @@ void sdHotServerList::CalcServerScores( sdNetManager& manager, int* bestServers,
 
 		int score = GetServerScore( *sessions[ i ], manager );
 
-		const char* name = sessions[ i ]->GetServerInfo().GetString( "si_name" );
+		const char* name = manager.GetSessionRecord( *sessions[ i ] ).name.c_str();
 		if ( g_debugHotServers.GetBool() ) {
 			gameLocal.Printf( "Server '%s' Score: %d Interested: %d\n", name, score, sessions[ i ]->GetNumInterestedClients() );
 		}
@@ -314,7 +315,11 @@ sdNetManager::sdNetManager() :
 	hotServers( sessions ),
 	hotServersLAN( sessionsLAN ),
 	hotServersHistory( sessionsHistory ),
-	hotServersFavorites( sessionsFavorites ) {
+	hotServersFavorites( sessionsFavorites ),
+	filterOrOnlyStart( 0 ),
+	verifySessionRecords( false ),
+	sessionRecordFrame( 0 ),
+	favoriteServersUser( NULL ) {
 }
 
 /*
@@ -329,6 +334,8 @@ void sdNetManager::Init() {
 	offlineString = declHolder.declLocStrType.LocalFind( "guis/mainmenu/offline" );
 	infinityString = declHolder.declLocStrType.LocalFind( "guis/mainmenu/infinity" );
 
+	sessionRecordHash.Clear( 4096, 4096 );
+
 	// Initialize functions
 	InitFunctions();
 
@@ -1222,6 +1229,12 @@ sdNetManager::RunFrame
 void sdNetManager::RunFrame() {
 	properties.UpdateProperties();
 
+	// the tasks fill and refresh the sessions in place, so the records are checked against the serverInfo while one runs,
+	// once a frame since the checksum copies and sorts the dict
+	sessionRecordFrame++;
+	verifySessionRecords = findServersTask != NULL || findLANServersTask != NULL || findRepeatersTask != NULL || findLANRepeatersTask != NULL ||
+		findHistoryServersTask != NULL || findFavoriteServersTask != NULL || refreshServerTask != NULL || refreshHotServerTask != NULL;
+
 	// task processing
 
 	// process parallel tasks
@@ -1241,6 +1254,9 @@ void sdNetManager::RunFrame() {
 
 			activeTask.OnCompleted( this );
 
+			// a profile restore replaces the favorites
+			favoriteServersUser = NULL;
+
 			properties.SetTaskResult( completedTask->GetErrorCode(), declHolder.FindLocStr( va( "sdnet/error/%d", completedTask->GetErrorCode() ) ) );
 			properties.SetTaskActive( false );
 
@@ -1346,21 +1362,20 @@ void sdNetManager::RunFrame() {
 
 				// replace the existing session with the updated one
 				if( netSessions != NULL ) {
-					sessionHash_t::Iterator iter = hashedSessions.Find( serverRefreshSession->GetHostAddressString() );
-					if( iter != hashedSessions.End() ) {
+					sessionIndices_t* indices = hashedSessions.Find( serverRefreshSession->GetAddress() );
+					if( indices != NULL ) {
 						if( task != NULL ) {
 							task->AcquireLock();
 						}
 
-						int index = iter->second.sessionListIndex;
+						int index = indices->sessionListIndex;
 						if( index >= 0 && index < netSessions->Num() ) {
-							const char* newIP = serverRefreshSession->GetHostAddressString();
-							const char* oldIP = (*netSessions)[ index ]->GetHostAddressString();
-							if( idStr::Cmp( newIP, oldIP ) == 0 ) {
+							if( serverRefreshSession->GetAddress() == (*netSessions)[ index ]->GetAddress() ) {
+								FreeSessionRecord( *(*netSessions)[ index ] );
 								networkService->GetSessionManager().FreeSession( (*netSessions)[ index ] );
 								(*netSessions)[ index ] = serverRefreshSession;								
 								serverRefreshSession = NULL;
-								iter->second.lastUpdateTime = sys->Milliseconds();
+								indices->lastUpdateTime = sys->Milliseconds();
 							} else {
 								assert( false );
 							}
@@ -1392,21 +1407,20 @@ void sdNetManager::RunFrame() {
 
 				// replace the existing session with the updated one
 				if( netSessions != NULL ) {
-					sessionHash_t::Iterator iter = hashedSessions.Find( hotServerRefreshSessions[ i ]->GetHostAddressString() );
-					if( iter != hashedSessions.End() ) {
+					sessionIndices_t* indices = hashedSessions.Find( hotServerRefreshSessions[ i ]->GetAddress() );
+					if( indices != NULL ) {
 						if( task != NULL ) {
 							task->AcquireLock();
 						}
 
-						int index = iter->second.sessionListIndex;
+						int index = indices->sessionListIndex;
 						if( index >= 0 && index < netSessions->Num() ) {
-							const char* newIP = hotServerRefreshSessions[ i ]->GetHostAddressString();
-							const char* oldIP = (*netSessions)[ index ]->GetHostAddressString();
-							if( idStr::Cmp( newIP, oldIP ) == 0 ) {
+							if( hotServerRefreshSessions[ i ]->GetAddress() == (*netSessions)[ index ]->GetAddress() ) {
+								FreeSessionRecord( *(*netSessions)[ index ] );
 								networkService->GetSessionManager().FreeSession( (*netSessions)[ index ] );
 								(*netSessions)[ index ] = hotServerRefreshSessions[ i ];								
 								hotServerRefreshSessions[ i ] = NULL;
-								iter->second.lastUpdateTime = sys->Milliseconds();
+								indices->lastUpdateTime = sys->Milliseconds();
 							} else {
 								assert( false );
 							}
@@ -1503,6 +1517,9 @@ void sdNetManager::GetGameType( const char* siRules, idWStr& type ) {
 	}
 }
 
+idCVar g_serverBrowserRenderAll( "g_serverBrowserRenderAll", "0", CVAR_GAME | CVAR_BOOL | CVAR_NOCHEAT, "write every cell of a server browser row on each update, not just the changed ones" );
+idCVar g_debugServerBrowser( "g_debugServerBrowser", "0", CVAR_GAME | CVAR_BOOL | CVAR_NOCHEAT, "print the time each server browser list update takes" );
+
 /*
 ================
 sdNetManager::CreateServerList
@@ -1513,6 +1530,7 @@ void sdNetManager::CreateServerList( sdUIList* list, findServerSource_e source,
 		for( int i = 0; i < list->GetNumItems(); i++ ) {
 			if( list->GetItemDataInt( i, 0 ) == -1 ) {
 				sdUIList::SetItemText( list, va( L"(%ls) %ls", offlineString->GetText(), list->GetItemText( i, 0, true ) ), i, 4 );
+				GetRenderedRow( GetRenderedList( *list, source, false ), i, true );
 			}
 		}
 		return;
@@ -1536,11 +1554,16 @@ void sdNetManager::CreateServerList( sdUIList* list, findServerSource_e source,
 	list->SetItemGranularity( 1024 );
 	list->BeginBatch();
 
+	renderedList_t& rendered = GetRenderedList( *list, source, false );
+
+	idTimer timer;
+	timer.Start();
+
 	if( lastServerUpdateIndex == 0 ) {
 		if ( mode == FSM_NEW ) {
 			hashedSessions.Clear();
-			hashedSessions.SetGranularity( 1024 );
 			sdUIList::ClearItems( list );
+			ClearRenderedRows( rendered );
 		} else if( mode == FSM_REFRESH ) {
 			for( int i = 0; i < list->GetNumItems(); i++ ) {
 				list->SetItemDataInt( -1, i, 0 );		// flag all items as not updated so servers that have dropped won't show bad info
@@ -1558,15 +1581,11 @@ void sdNetManager::CreateServerList( sdUIList* list, findServerSource_e source,
 		bool ranked = false;
 		bool tvSource = false;
 #endif /* !SD_DEMO_BUILD */
-		idStr address;		
 
 		for ( int i = lastServerUpdateIndex; i < netSessions->Num(); i++ ) {
 			sdNetSession* netSession = (*netSessions)[ i ];
-			
-			address = netSession->GetHostAddressString();
-			assert( !address.IsEmpty() );
 
-			sessionIndices_t& info = hashedSessions[ address.c_str() ];
+			sessionIndices_t& info = hashedSessions[ netSession->GetAddress() ];
 			info.sessionListIndex = i;
 			info.uiListIndex = -1;
 			info.lastUpdateTime = now;
@@ -1589,14 +1608,14 @@ void sdNetManager::CreateServerList( sdUIList* list, findServerSource_e source,
 				}
 			}
 
-			int index = sdUIList::InsertItem( list, va( L"%hs", address.c_str() ), -1, BC_IP );
+			int index = sdUIList::InsertItem( list, va( L"%hs", netSession->GetHostAddressString() ), -1, BC_IP );
 
-//			assert( hashedSessions.Find( address.c_str() ) == hashedSessions.End() );
+//			assert( hashedSessions.Find( netSession->GetAddress() ) == NULL );
 //			assert( hashedSessions.Num() == list->GetNumItems() - 1 );
 
 			info.uiListIndex = index;
 
-			UpdateSession( *list, *netSession, index );
+			UpdateSession( *list, rendered, *netSession, index, true );
 			list->SetItemDataInt( i, index, 0, true );		// store the session index
 
 		}
@@ -1605,23 +1624,28 @@ void sdNetManager::CreateServerList( sdUIList* list, findServerSource_e source,
 			sdNetSession* netSession = (*netSessions)[ i ];
 			const idDict& serverInfo = netSession->GetServerInfo();
 
-			sessionHash_t::Iterator iter = hashedSessions.Find( netSession->GetHostAddressString() );
-			if( iter == hashedSessions.End() ) {
+			sessionIndices_t* indices = hashedSessions.Find( netSession->GetAddress() );
+			if( indices == NULL ) {
 				continue;
 			} else {
-				iter->second.sessionListIndex = i;
-				iter->second.lastUpdateTime = now;
+				indices->sessionListIndex = i;
+				indices->lastUpdateTime = now;
 
-				if( iter->second.uiListIndex != -1 ) {
-					UpdateSession( *list, *netSession, iter->second.uiListIndex );
-					list->SetItemDataInt( i, iter->second.uiListIndex, BC_IP, true );		// store the session index
+				if( indices->uiListIndex != -1 ) {
+					UpdateSession( *list, rendered, *netSession, indices->uiListIndex );
+					list->SetItemDataInt( i, indices->uiListIndex, BC_IP, true );		// store the session index
 					
-					assert( idWStr::Icmp( list->GetItemText( iter->second.uiListIndex, 0 ), va( L"%hs", netSession->GetHostAddressString() ) ) == 0 );
+					assert( idWStr::Icmp( list->GetItemText( indices->uiListIndex, 0 ), va( L"%hs", netSession->GetHostAddressString() ) ) == 0 );
 				}
 			}
 		}
 	}
 
+	timer.Stop();
+	if( g_debugServerBrowser.GetBool() ) {
+		gameLocal.Printf( "CreateServerList: %d sessions, %d rows in %.2f msec\n", netSessions->Num() - lastServerUpdateIndex, list->GetNumItems(), timer.Milliseconds() );
+	}
+
 	lastServerUpdateIndex = netSessions->Num();
 //	assert( hashedSessions.Num() == list->GetNumItems() );
 
@@ -1637,7 +1661,10 @@ sdNetManager::CreateHotServerList
 ============
 */
 void sdNetManager::CreateHotServerList( sdUIList* list, findServerSource_e source ) {
+	renderedList_t& rendered = GetRenderedList( *list, source, true );
+
 	sdUIList::ClearItems( list );
+	ClearRenderedRows( rendered );
 
 	sdNetTask* task = NULL;
 	idList< sdNetSession* >* netSessions = NULL;
@@ -1649,184 +1676,274 @@ void sdNetManager::CreateHotServerList( sdUIList* list, findServerSource_e sourc
 		return;
 	}
 
-	idStr address;
 	for( int i = 0; i < netHotServers->GetNumServers(); i++ ) {
 		const sdNetSession* netSession = netHotServers->GetServer( i );
 		if( netSession == NULL ) {
 			continue;
 		}
 
-		address = netSession->GetHostAddressString();
-		int index = sdUIList::InsertItem( list, va( L"%hs", address.c_str() ), -1, BC_IP );
-		UpdateSession( *list, *netSession, index );
+		int index = sdUIList::InsertItem( list, va( L"%hs", netSession->GetHostAddressString() ), -1, BC_IP );
+		UpdateSession( *list, rendered, *netSession, index, true );
 
-		sessionHash_t::Iterator iter = hashedSessions.Find( address.c_str() );
-		if( iter != hashedSessions.End() ) {
-			list->SetItemDataInt( iter->second.sessionListIndex, index, 0, true );		// store the session index
+		const sessionIndices_t* indices = hashedSessions.Find( netSession->GetAddress() );
+		if( indices != NULL ) {
+			list->SetItemDataInt( indices->sessionListIndex, index, 0, true );		// store the session index
 		} else {
 			assert( false );
 		}
 	}
 }
+/*
+============
+sdNetManager::GetRenderedList
+
+the rows of a source's server list or hot server list; a source shown in
+another ui list starts over
+============
+*/
+sdNetManager::renderedList_t& sdNetManager::GetRenderedList( const sdUIList& list, findServerSource_e source, bool hotServers ) {
+	assert( source > FS_MIN && source < FS_MAX );
+
+	renderedList_t& rendered = renderedLists[ source ][ hotServers ? 1 : 0 ];
+	if( rendered.list != &list ) {
+		rendered.list = &list;
+		rendered.rows.SetGranularity( 1024 );
+		ClearRenderedRows( rendered );
+	}
+	return rendered;
+}
+
+/*
+============
+sdNetManager::GetRenderedRow
+
+newRow forgets what the row showed, so the next UpdateSession writes every cell
+============
+*/
+sdNetManager::renderedRow_t& sdNetManager::GetRenderedRow( renderedList_t& rendered, int index, bool newRow ) {
+	if( index >= rendered.rows.Num() ) {
+		int oldNum = rendered.rows.Num();
+		rendered.rows.SetNum( index + 1, false );
+		for( int i = oldNum; i < rendered.rows.Num(); i++ ) {
+			rendered.rows[ i ].valid = false;
+		}
+	}
+
+	renderedRow_t& row = rendered.rows[ index ];
+	if( newRow ) {
+		row.valid = false;
+	}
+	return row;
+}
+
+/*
+============
+sdNetManager::ClearRenderedRows
+============
+*/
+void sdNetManager::ClearRenderedRows( renderedList_t& rendered ) {
+	// keep the rows, their string buffers are reused; GetRenderedRow invalidates them as they come back
+	rendered.rows.SetNum( 0, false );
+}
+
 /*
 ============
 sdNetManager::UpdateSession
+
+only the cells whose values differ from what the row last showed are written
 ============
 */
-void sdNetManager::UpdateSession( sdUIList& list, const sdNetSession& netSession, int index ) {
+void sdNetManager::UpdateSession( sdUIList& list, renderedList_t& rendered, const sdNetSession& netSession, int index, bool newRow ) {
 	if( index < 0 ) {
 		return;
 	}
-	sdNetUser* activeUser = networkService->GetActiveUser();
-	bool favorite = activeUser->GetProfile().GetProperties().GetBool( va( "favorite_%s", netSession.GetHostAddressString() ), "0" );
+	renderedRow_t& row = GetRenderedRow( rendered, index, newRow || g_serverBrowserRenderAll.GetBool() );
+
+	bool favorite = IsFavoriteServer( netSession.GetAddress() );
 
 	// Favorite state
-	sdUIList::SetItemText( &list, favorite ? L"<material = 'favorite_set'>f" : L"<material = 'favorite_unset'>", index, BC_FAVORITE );
+	if( !row.valid || row.favorite != favorite ) {
+		sdUIList::SetItemText( &list, favorite ? L"<material = 'favorite_set'>f" : L"<material = 'favorite_unset'>", index, BC_FAVORITE );
+		row.favorite = favorite;
+	}
 
 	if ( netSession.GetPing() == 999 ) {
-		// Password
-		sdUIList::SetItemText( &list, L"", index, BC_PASSWORD );
+		// an offline row shows nothing but its address, which doesn't change
+		if( !row.valid || !row.offline ) {
+			// Password
+			sdUIList::SetItemText( &list, L"", index, BC_PASSWORD );
 
-		// Ranked
-		sdUIList::SetItemText( &list, L"", index, BC_RANKED );
+			// Ranked
+			sdUIList::SetItemText( &list, L"", index, BC_RANKED );
 
-		// Server name
-		sdUIList::SetItemText( &list, va( L"(%ls) %hs", offlineString->GetText(), netSession.GetHostAddressString() ), index, BC_NAME );
+			// Server name
+			sdUIList::SetItemText( &list, va( L"(%ls) %hs", offlineString->GetText(), netSession.GetHostAddressString() ), index, BC_NAME );
 
-		// Map name
-		sdUIList::SetItemText( &list, L"", index, BC_MAP );
+			// Map name
+			sdUIList::SetItemText( &list, L"", index, BC_MAP );
 
-		// Game Type Icon
-		sdUIList::SetItemText( &list, L"", index, BC_GAMETYPE_ICON );
+			// Game Type Icon
+			sdUIList::SetItemText( &list, L"", index, BC_GAMETYPE_ICON );
 
-		// Game Type
-		sdUIList::SetItemText( &list, L"", index, BC_GAMETYPE );
+			// Game Type
+			sdUIList::SetItemText( &list, L"", index, BC_GAMETYPE );
 
-		// Time left
-		list.SetItemDataInt( 0, index, BC_TIMELEFT, true );
-		sdUIList::SetItemText( &list, L"", index, BC_TIMELEFT );
+			// Time left
+			list.SetItemDataInt( 0, index, BC_TIMELEFT, true );
+			sdUIList::SetItemText( &list, L"", index, BC_TIMELEFT );
 
-		// Client Count
-		list.SetItemDataInt( 0, index, BC_PLAYERS, true );
-		sdUIList::SetItemText( &list, L"", index, BC_PLAYERS );
+			// Client Count
+			list.SetItemDataInt( 0, index, BC_PLAYERS, true );
+			sdUIList::SetItemText( &list, L"", index, BC_PLAYERS );
 
-		// Ping
-		list.SetItemDataInt( 0, index, BC_PING, true );
-		sdUIList::SetItemText( &list, L"-1", index, BC_PING );
+			// Ping
+			list.SetItemDataInt( 0, index, BC_PING, true );
+			sdUIList::SetItemText( &list, L"-1", index, BC_PING );
+		}
+		row.offline = true;
 	} else {
-		const idDict& serverInfo = netSession.GetServerInfo();
-		const idDict* mapInfo = GetMapInfo( netSession );
+		// a new row, or one that was offline, gets every cell
+		const bool rewrite = !row.valid || row.offline;
+		row.offline = false;
+
+		const sessionRecord_t& record = GetSessionRecord( netSession );
+		const idDict* mapInfo = record.mapInfo;
 
 		// Password
-		sdUIList::SetItemText( &list, va( L"%hs", serverInfo.GetBool( "si_needPass", "0" ) ? "<material = 'password'>p" : "" ), index, BC_PASSWORD);
+		if( rewrite || row.needPass != record.needPass ) {
+			sdUIList::SetItemText( &list, record.needPass ? L"<material = 'password'>p" : L"", index, BC_PASSWORD);
+			row.needPass = record.needPass;
+		}
 
 		// Ranked
-		sdUIList::SetItemText( &list, va( L"%hs", netSession.IsRanked() ? "<material = 'ranked'>r" : "" ), index, BC_RANKED );
-
-		tempWStr = L"";
-		const char* serverName = serverInfo.GetString( "si_name" );
-		if( serverName[ 0 ] == '\0' ) {
-			tempWStr = va( L"(%ls) %hs", offlineString->GetText(), netSession.GetHostAddressString() );
-		} else {
-			tempWStr = va( L"%hs", serverName );
-			sdUIList::CleanUserInput( tempWStr );
+		bool ranked = netSession.IsRanked();
+		if( rewrite || row.ranked != ranked ) {
+			sdUIList::SetItemText( &list, ranked ? L"<material = 'ranked'>r" : L"", index, BC_RANKED );
+			row.ranked = ranked;
 		}
 
-		// strip leading spaces
-		const wchar_t* nameStr = tempWStr.c_str();
-		do {
-			if( *nameStr == L'\0' ) {
-				break;
+		if( rewrite || row.name.Cmp( record.name.c_str() ) != 0 ) {
+			tempWStr = L"";
+			const char* serverName = record.name.c_str();
+			if( serverName[ 0 ] == '\0' ) {
+				tempWStr = va( L"(%ls) %hs", offlineString->GetText(), netSession.GetHostAddressString() );
+			} else {
+				tempWStr = va( L"%hs", serverName );
+				sdUIList::CleanUserInput( tempWStr );
 			}
 
-			if( *( nameStr + 1 ) != L'\0' && *( nameStr + 2 ) != L'\0' && idWStr::IsColor( nameStr ) && ( *( nameStr + 2 ) == L' ' || *( nameStr + 2 ) == L'\t' ) ) {
-				nameStr += 2;
-				continue;
-			}
+			// strip leading spaces
+			const wchar_t* nameStr = tempWStr.c_str();
+			do {
+				if( *nameStr == L'\0' ) {
+					break;
+				}
 
-			if( ( *nameStr != L' ' && *nameStr != L'\t' ) ) {
-				break;
-			}
-			nameStr++;
-		} while( true );			
+				if( *( nameStr + 1 ) != L'\0' && *( nameStr + 2 ) != L'\0' && idWStr::IsColor( nameStr ) && ( *( nameStr + 2 ) == L' ' || *( nameStr + 2 ) == L'\t' ) ) {
+					nameStr += 2;
+					continue;
+				}
+
+				if( ( *nameStr != L' ' && *nameStr != L'\t' ) ) {
+					break;
+				}
+				nameStr++;
+			} while( true );			
 
-		// Server name
-		sdUIList::SetItemText( &list, nameStr, index, BC_NAME );
+			// Server name
+			sdUIList::SetItemText( &list, nameStr, index, BC_NAME );
+			row.name = record.name;
+		}
 
 		// Map name
-		if ( mapInfo == NULL ) {
-			tempWStr = va( L"%hs", serverInfo.GetString( "si_map" ) );
-			tempWStr.StripFileExtension();
-
-			sdUIList::CleanUserInput( tempWStr );
-
-			// skip the path
-			int offset = tempWStr.Length() - 1;
-			if( offset >= 0 ) {
-				while( offset >= 0 ) {
-					if( tempWStr[ offset ] == L'/' || tempWStr[ offset ] == L'\\' ) {
-						offset++;
-						break;
+		const char* map = record.map->c_str();
+		if( rewrite || row.mapInfo != mapInfo || row.map.Cmp( map ) != 0 ) {
+			if ( mapInfo == NULL ) {
+				tempWStr = va( L"%hs", map );
+				tempWStr.StripFileExtension();
+
+				sdUIList::CleanUserInput( tempWStr );
+
+				// skip the path
+				int offset = tempWStr.Length() - 1;
+				if( offset >= 0 ) {
+					while( offset >= 0 ) {
+						if( tempWStr[ offset ] == L'/' || tempWStr[ offset ] == L'\\' ) {
+							offset++;
+							break;
+						}
+						offset--;
+					}
+					// jrad - the case of "path/" should never happen, but let's play it safe
+					if( offset >= tempWStr.Length() ) {
+						offset = 0;
 					}
-					offset--;
-				}
-				// jrad - the case of "path/" should never happen, but let's play it safe
-				if( offset >= tempWStr.Length() ) {
-					offset = 0;
-				}
 
-				sdUIList::SetItemText( &list, &tempWStr[ offset ], index, BC_MAP );
+					sdUIList::SetItemText( &list, &tempWStr[ offset ], index, BC_MAP );
+				} else {
+					sdUIList::SetItemText( &list, L"", index, BC_MAP );
+				}
 			} else {
-				sdUIList::SetItemText( &list, L"", index, BC_MAP );
+				tempWStr = va( L"%hs", mapInfo->GetString( "pretty_name", map ) );
+				tempWStr.StripFileExtension();
+				sdUIList::CleanUserInput( tempWStr );
+				sdUIList::SetItemText( &list, tempWStr.c_str(), index, BC_MAP );
 			}
-		} else {
-			tempWStr = mapInfo != NULL ? va( L"%hs", mapInfo->GetString( "pretty_name", serverInfo.GetString( "si_map" ) ) ) : L"";
-			tempWStr.StripFileExtension();
-			sdUIList::CleanUserInput( tempWStr );
-			sdUIList::SetItemText( &list, tempWStr.c_str(), index, BC_MAP );
+			row.map = map;
+			row.mapInfo = mapInfo;
 		}
 
 
 		// Game Type
-		const char* fsGame = serverInfo.GetString( "fs_game" );
+		const char* fsGame = record.fsGame->c_str();
+		const char* siRules = record.rules->c_str();
 
-		if ( *fsGame == '\0' || ( idStr::Icmp( fsGame, BASE_GAMEDIR ) == 0 ) ) {
-			const char* siRules = serverInfo.GetString( "si_rules" );
-			GetGameType( siRules, tempWStr );
+		if( rewrite || row.fsGame.Cmp( fsGame ) != 0 || row.rules.Cmp( siRules ) != 0 ) {
+			if ( *fsGame == '\0' || ( idStr::Icmp( fsGame, BASE_GAMEDIR ) == 0 ) ) {
+				GetGameType( siRules, tempWStr );
 
-			const char* mat = list.GetUI()->GetMaterial( siRules );
-			if( *mat ) {
-				sdUIList::SetItemText( &list, va( L"<material = '%hs'>", siRules ), index, BC_GAMETYPE_ICON );
+				const char* mat = list.GetUI()->GetMaterial( siRules );
+				if( *mat ) {
+					sdUIList::SetItemText( &list, va( L"<material = '%hs'>", siRules ), index, BC_GAMETYPE_ICON );
+				} else {
+					sdUIList::SetItemText( &list, L"", index, BC_GAMETYPE_ICON );
+				}
 			} else {
-				sdUIList::SetItemText( &list, L"", index, BC_GAMETYPE_ICON );
-			}
-		} else {
-			sdUIList::SetItemText( &list, L"<material = '_unknownGameType'>", index, BC_GAMETYPE_ICON );
-			tempWStr = va( L"%hs", fsGame );
-		}		
+				sdUIList::SetItemText( &list, L"<material = '_unknownGameType'>", index, BC_GAMETYPE_ICON );
+				tempWStr = va( L"%hs", fsGame );
+			}		
 
-		sdUIList::SetItemText( &list, tempWStr.c_str(), index, BC_GAMETYPE );
+			sdUIList::SetItemText( &list, tempWStr.c_str(), index, BC_GAMETYPE );
+			row.fsGame = fsGame;
+			row.rules = siRules;
+		}
 
 		// Time left
-		if( netSession.GetGameState() & sdGameRules::PGS_WARMUP ) {
-			sdUIList::SetItemText( &list, L"<loc = 'guis/mainmenu/server/warmup'>", index, BC_TIMELEFT );
-			list.SetItemDataInt( 0, index, BC_TIMELEFT, true );
-		} else if( netSession.GetGameState() & sdGameRules::PGS_REVIEWING ) {
-			sdUIList::SetItemText( &list, L"<loc = 'guis/mainmenu/server/reviewing'>", index, BC_TIMELEFT );
-			list.SetItemDataInt( 0, index, BC_TIMELEFT, true );
-		} else if( netSession.GetGameState() & sdGameRules::PGS_LOADING ) {
-			sdUIList::SetItemText( &list, L"<loc = 'guis/mainmenu/server/loading'>", index, BC_TIMELEFT );
-			list.SetItemDataInt( 0, index, BC_TIMELEFT, true );
-		} else {
-			if( netSession.GetSessionTime() == 0 ) {
-				sdUIList::SetItemText( &list, infinityString->GetText(), index, BC_TIMELEFT );
+		int gameState = netSession.GetGameState();
+		int sessionTime = netSession.GetSessionTime();
+		if( rewrite || row.gameState != gameState || row.sessionTime != sessionTime ) {
+			if( gameState & sdGameRules::PGS_WARMUP ) {
+				sdUIList::SetItemText( &list, L"<loc = 'guis/mainmenu/server/warmup'>", index, BC_TIMELEFT );
+				list.SetItemDataInt( 0, index, BC_TIMELEFT, true );
+			} else if( gameState & sdGameRules::PGS_REVIEWING ) {
+				sdUIList::SetItemText( &list, L"<loc = 'guis/mainmenu/server/reviewing'>", index, BC_TIMELEFT );
+				list.SetItemDataInt( 0, index, BC_TIMELEFT, true );
+			} else if( gameState & sdGameRules::PGS_LOADING ) {
+				sdUIList::SetItemText( &list, L"<loc = 'guis/mainmenu/server/loading'>", index, BC_TIMELEFT );
+				list.SetItemDataInt( 0, index, BC_TIMELEFT, true );
 			} else {
-				idWStr::hmsFormat_t format;
-				format.showZeroSeconds = false;
-				format.showZeroMinutes = true;
-				sdUIList::SetItemText( &list, idWStr::MS2HMS( netSession.GetSessionTime(), format ), index, BC_TIMELEFT );
+				if( sessionTime == 0 ) {
+					sdUIList::SetItemText( &list, infinityString->GetText(), index, BC_TIMELEFT );
+				} else {
+					idWStr::hmsFormat_t format;
+					format.showZeroSeconds = false;
+					format.showZeroMinutes = true;
+					sdUIList::SetItemText( &list, idWStr::MS2HMS( sessionTime, format ), index, BC_TIMELEFT );
+				}
+				list.SetItemDataInt( sessionTime, index, BC_TIMELEFT, true );
 			}
-			list.SetItemDataInt( netSession.GetSessionTime(), index, BC_TIMELEFT, true );
+			row.gameState = gameState;
+			row.sessionTime = sessionTime;
 		}
 
 		// Client Count
@@ -1839,21 +1956,31 @@ void sdNetManager::UpdateSession( sdUIList& list, const sdNetSession& netSession
 			maxClients = netSession.GetMaxRepeaterClients();
 		} else {
 			numClients = netSession.GetNumClients();
-			maxClients = serverInfo.GetInt( "si_maxPlayers" );
+			maxClients = record.maxPlayers;
 		}
 
-		if( numBots == 0 ) {
-			sdUIList::SetItemText( &list, va( L"%d/%d", numClients, maxClients ), index, BC_PLAYERS );
-		} else {
-			sdUIList::SetItemText( &list, va( L"%d/%d (%d)", numClients, maxClients, numBots ), index, BC_PLAYERS );
-		}
+		if( rewrite || row.numClients != numClients || row.maxClients != maxClients || row.numBots != numBots ) {
+			if( numBots == 0 ) {
+				sdUIList::SetItemText( &list, va( L"%d/%d", numClients, maxClients ), index, BC_PLAYERS );
+			} else {
+				sdUIList::SetItemText( &list, va( L"%d/%d (%d)", numClients, maxClients, numBots ), index, BC_PLAYERS );
+			}
 
-		list.SetItemDataInt( numClients, index, BC_PLAYERS, true );	// store the number of clients for proper numeric sorting
+			list.SetItemDataInt( numClients, index, BC_PLAYERS, true );	// store the number of clients for proper numeric sorting
+			row.numClients = numClients;
+			row.maxClients = maxClients;
+			row.numBots = numBots;
+		}
 
 		// Ping
-		list.SetItemDataInt( netSession.GetPing(), index, BC_PING, true );
-		sdUIList::SetItemText( &list, va( L"%d", netSession.GetPing() ), index, BC_PING );
+		int ping = netSession.GetPing();
+		if( rewrite || row.ping != ping ) {
+			list.SetItemDataInt( ping, index, BC_PING, true );
+			sdUIList::SetItemText( &list, va( L"%d", ping ), index, BC_PING );
+			row.ping = ping;
+		}
 	}
+	row.valid = true;
 }
 
 /*
@@ -2646,6 +2773,10 @@ void sdNetManager::Script_SetProfileString( sdUIFunctionStack& stack ) {
 
 	activeUser->GetProfile().GetProperties().Set( key.c_str(), value.c_str() );
 	activeUser->Save( sdNetUser::SI_PROFILE );
+
+	if( idStr::Icmpn( key.c_str(), "favorite_", 9 ) == 0 ) {
+		favoriteServersUser = NULL;
+	}
 }
 
 #if !defined( SD_DEMO_BUILD )
@@ -2791,6 +2922,7 @@ void sdNetManager::Script_FindServers( sdUIFunctionStack& stack ) {
 	netSessions->SetGranularity( 1024 );
 	netSessions->SetNum( 0, false );
 	lastServerUpdateIndex = 0;
+	ClearSessionRecords();
 
 #if !defined( SD_DEMO_BUILD )
 	CacheServersWithFriends();
@@ -2975,13 +3107,13 @@ void sdNetManager::Script_RefreshHotServers( sdUIFunctionStack& stack ) {
 
 	sdNetSession* ignoreSession = NULL;
 	if ( ignore.Length() > 0 ) {
-		sessionHash_t::Iterator iter = hashedSessions.Find( ignore );
-		if( iter != hashedSessions.End() ) {
+		const sessionIndices_t* indices = FindSessionIndices( ignore.c_str() );
+		if( indices != NULL ) {
 			if( task != NULL ) {
 				task->AcquireLock();
 			}
 
-			int index = iter->second.sessionListIndex;
+			int index = indices->sessionListIndex;
 			if( index >= 0 && index < netSessions->Num() ) {
 				ignoreSession = ( *netSessions )[ index ];
 			}
@@ -3011,9 +3143,9 @@ void sdNetManager::Script_RefreshHotServers( sdUIFunctionStack& stack ) {
 			continue;
 		}
 
-		sessionHash_t::Iterator iter = hashedSessions.Find( check->GetHostAddressString() );
-		if( iter != hashedSessions.End() ) {
-			if( iter->second.lastUpdateTime + 2000 > now ) {
+		const sessionIndices_t* indices = hashedSessions.Find( check->GetAddress() );
+		if( indices != NULL ) {
+			if( indices->lastUpdateTime + 2000 > now ) {
 				continue;
 			}
 		}
@@ -3086,10 +3218,10 @@ void sdNetManager::Script_RefreshServer( sdUIFunctionStack& stack ) {
 	properties.SetServerRefreshComplete( false );
 
 	// don't update too soon after a refresh
-	sessionHash_t::Iterator iter = hashedSessions.Find( sessionStr );
-	if( iter != hashedSessions.End() ) {
+	const sessionIndices_t* indices = hashedSessions.Find( addr );
+	if( indices != NULL ) {
 		int now = sys->Milliseconds();
-		if( iter->second.lastUpdateTime + 2000 > now ) {			
+		if( indices->lastUpdateTime + 2000 > now ) {			
 			properties.SetServerRefreshComplete( true );
 			stack.Push( 1.0f );
 			return;
@@ -3780,6 +3912,195 @@ const idDict* sdNetManager::GetMapInfo( const sdNetSession& netSession ) {
 	return gameLocal.mapMetaDataList->FindMetaData( mapName );
 }
 
+/*
+============
+sdNetManager::FavoriteServerKey
+
+the same hash as hashedSessions, see sdNetAddressHash
+============
+*/
+int sdNetManager::FavoriteServerKey( const netadr_t& addr ) {
+	return ( int )sdNetAddressHash::Hash( sdNetAddressHash::PackIP( addr ), addr.port );
+}
+
+/*
+============
+sdNetManager::LoadFavoriteServers
+============
+*/
+void sdNetManager::LoadFavoriteServers() const {
+	favoriteServers.SetNum( 0, false );
+	favoriteServerHash.Clear();
+
+	const sdNetUser* activeUser = networkService->GetActiveUser();
+	favoriteServersUser = activeUser;
+	if( activeUser == NULL ) {
+		return;
+	}
+
+	const idDict& dict = activeUser->GetProfile().GetProperties();
+
+	int prefixLength = idStr::Length( "favorite_" );
+	for( const idKeyValue* kv = dict.MatchPrefix( "favorite_" ); kv != NULL; kv = dict.MatchPrefix( "favorite_", kv ) ) {
+		if( atoi( kv->GetValue() ) == 0 ) {
+			continue;
+		}
+		netadr_t addr;
+		if( sys->StringToNetAdr( kv->GetKey().c_str() + prefixLength, &addr, false ) ) {
+			favoriteServerHash.Add( FavoriteServerKey( addr ), favoriteServers.Append( addr ) );
+		}
+	}
+}
+
+/*
+============
+sdNetManager::IsFavoriteServer
+============
+*/
+bool sdNetManager::IsFavoriteServer( const netadr_t& addr ) const {
+	if( favoriteServersUser != networkService->GetActiveUser() ) {
+		LoadFavoriteServers();
+	}
+
+	for( int i = favoriteServerHash.GetFirst( FavoriteServerKey( addr ) ); i != idHashIndex::NULL_INDEX; i = favoriteServerHash.GetNext( i ) ) {
+		if( favoriteServers[ i ] == addr ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+============
+sdNetManager::FindSessionIndices
+
+for the addresses the guis pass around as strings
+============
+*/
+sdNetManager::sessionIndices_t* sdNetManager::FindSessionIndices( const char* address ) {
+	netadr_t addr;
+	if( !sys->StringToNetAdr( address, &addr, false ) ) {
+		return NULL;
+	}
+	return hashedSessions.Find( addr );
+}
+
+/*
+============
+sdNetManager::ClearSessionRecords
+============
+*/
+void sdNetManager::ClearSessionRecords() {
+	// the allocator keeps the records, their name buffers are reused
+	for ( int i = 0; i < sessionRecords.Num(); i++ ) {
+		sessionRecordAllocator.Free( sessionRecords[ i ] );
+	}
+	sessionRecords.SetNum( 0, false );
+	sessionRecordHash.Clear();
+	sessionStrings.Clear();
+}
+
+/*
+============
+sdNetManager::FreeSessionRecord
+
+the session is about to be freed, a new one may get its address
+============
+*/
+void sdNetManager::FreeSessionRecord( const sdNetSession& netSession ) {
+	int hash = ( int )( ( size_t )&netSession >> 4 );
+	for ( int i = sessionRecordHash.GetFirst( hash ); i != idHashIndex::NULL_INDEX; i = sessionRecordHash.GetNext( i ) ) {
+		if( sessionRecords[ i ]->session == &netSession ) {
+			FreeSessionStrings( *sessionRecords[ i ] );
+			sessionRecordAllocator.Free( sessionRecords[ i ] );
+			sessionRecords.RemoveIndex( i );
+			sessionRecordHash.RemoveIndex( hash, i );
+			return;
+		}
+	}
+}
+
+/*
+============
+sdNetManager::FreeSessionStrings
+============
+*/
+void sdNetManager::FreeSessionStrings( sessionRecord_t& record ) const {
+	sessionStrings.FreeString( record.rules );
+	sessionStrings.FreeString( record.fsGame );
+	sessionStrings.FreeString( record.map );
+	sessionStrings.FreeString( record.filterMap );
+}
+
+/*
+============
+sdNetManager::GetSessionRecord
+
+parses the session's serverInfo the first time the browser looks at it, and
+again if a running task changed it, checked on the first lookup of each frame;
+the record never moves, so callers may hold it while they look up other sessions
+============
+*/
+const sdNetManager::sessionRecord_t& sdNetManager::GetSessionRecord( const sdNetSession& netSession ) const {
+	int hash = ( int )( ( size_t )&netSession >> 4 );
+	for ( int i = sessionRecordHash.GetFirst( hash ); i != idHashIndex::NULL_INDEX; i = sessionRecordHash.GetNext( i ) ) {
+		sessionRecord_t& record = *sessionRecords[ i ];
+		if( record.session != &netSession ) {
+			continue;
+		}
+		if( verifySessionRecords && record.verifiedFrame != sessionRecordFrame ) {
+			record.verifiedFrame = sessionRecordFrame;
+			if( record.checksum != netSession.GetServerInfo().Checksum() ) {
+				FreeSessionStrings( record );
+				ParseSessionRecord( record, netSession );
+			}
+		}
+		return record;
+	}
+
+	sessionRecord_t* record = sessionRecordAllocator.Alloc();
+	sessionRecordHash.Add( hash, sessionRecords.Append( record ) );
+	ParseSessionRecord( *record, netSession );
+	return *record;
+}
+
+/*
+============
+sdNetManager::ParseSessionRecord
+============
+*/
+void sdNetManager::ParseSessionRecord( sessionRecord_t& record, const sdNetSession& netSession ) const {
+	const idDict& serverInfo = netSession.GetServerInfo();
+	record.session = &netSession;
+	record.checksum = serverInfo.Checksum();
+	record.verifiedFrame = sessionRecordFrame;
+	record.needPass = serverInfo.GetBool( "si_needPass", "0" );
+	record.punkbuster = serverInfo.GetBool( "net_serverPunkbusterEnabled", "0" );
+	record.teamDamage = serverInfo.GetBool( "si_teamDamage", "0" );
+	record.teamForceBalance = serverInfo.GetBool( "si_teamForceBalance", "0" );
+	record.pure = serverInfo.GetBool( "si_pure", "0" );
+	record.allowLateJoin = serverInfo.GetBool( "si_allowLateJoin", "0" );
+	record.maxPlayers = serverInfo.GetInt( "si_maxPlayers" );
+	record.rules = sessionStrings.AllocString( serverInfo.GetString( "si_rules" ) );
+	record.fsGame = sessionStrings.AllocString( serverInfo.GetString( "fs_game" ) );
+
+	const char* map = serverInfo.GetString( "si_map" );
+	record.map = sessionStrings.AllocString( map );
+	record.mapInfo = NULL;
+	if( gameLocal.mapMetaDataList != NULL ) {
+		idStr mapName( map );
+		mapName.StripFileExtension();
+		record.mapInfo = gameLocal.mapMetaDataList->FindMetaData( mapName );
+	}
+	builder.Clear();
+	builder.AppendNoColors( record.mapInfo != NULL ? record.mapInfo->GetString( "pretty_name", map ) : map );
+	record.filterMap = sessionStrings.AllocString( builder.c_str() );
+
+	record.name = serverInfo.GetString( "si_name" );
+	record.cleanName = record.name;
+	record.cleanName.RemoveColors();
+}
+
 /*
 ============
 sdNetManager::GetSession
@@ -4466,6 +4787,7 @@ void sdNetManager::Script_ApplyNumericFilter( sdUIFunctionStack& stack ) {
 		gameLocal.Warning( "ApplyNumericFilter: invalid enum, filter not applied" );
 		numericFilters.RemoveIndexFast( numericFilters.Num() - 1 );
 	}
+	CompileFilters();
 }
 
 /*
@@ -4498,6 +4820,7 @@ void sdNetManager::Script_ApplyStringFilter( sdUIFunctionStack& stack ) {
 		gameLocal.Warning( "ApplyStringFilter: invalid enum, filter not applied" );
 		stringFilters.RemoveIndexFast( stringFilters.Num() - 1 );
 	}
+	CompileFilters();
 }
 
 /*
@@ -4508,6 +4831,7 @@ sdNetManager::Script_ClearFilters
 void sdNetManager::Script_ClearFilters( sdUIFunctionStack& stack ) {
 	numericFilters.Clear();
 	stringFilters.Clear();
+	CompileFilters();
 }
 
 
@@ -4529,197 +4853,292 @@ bool sdNetManager::DoFiltering( const sdNetSession& netSession ) const {
 
 /*
 ============
-sdNetManager::SessionIsFiltered
+sdNetManager::CompileFilters
+
+turns the active filters into a flat list the sessions are run through. Whether
+a session is hidden doesn't depend on the order of the filters, so the ones that
+can hide it come first and the ones that only feed the OR bin last, where they
+are skipped as soon as the bin is true
 ============
 */
-bool sdNetManager::SessionIsFiltered( const sdNetSession& netSession, bool ignoreEmptyFilter ) const {
-	if( numericFilters.Empty() && stringFilters.Empty() ) {
-		return false;
-	}
-
-	assert( networkService->GetActiveUser() != NULL );
-	sdNetUser* activeUser = networkService->GetActiveUser();
-
-	bool visible = true;
-	bool orFilters = false;
-	bool orSet = false;
+void sdNetManager::CompileFilters() {
+	filterProgram.Clear();
+	filterStringCvars.Clear();
+	filterStringFields.Clear();
 
-	for( int i = 0; i < numericFilters.Num() && visible; i++ ) {
-		const serverNumericFilter_t& filter = numericFilters[ i ];
-		if ( filter.state == SFS_DONTCARE ) {
-			continue;
+	for( int pass = 0; pass < 2; pass++ ) {
+		if( pass == 1 ) {
+			filterOrOnlyStart = filterProgram.Num();
 		}
 
-		if ( filter.type == SF_EMPTY && ignoreEmptyFilter ) {
-			continue;
-		}
+		for( int i = 0; i < numericFilters.Num(); i++ ) {
+			const serverNumericFilter_t& filter = numericFilters[ i ];
 
+			// jrad - SF_BOTS is superseded by SF_MAXBOTS, but left in for backwards compatibility while loading profiles
+			if( filter.state == SFS_DONTCARE || filter.type == SF_BOTS ) {
+				continue;
+			}
 
-		// jrad - this is superseded by SF_MAXBOTS, but left in for backwards compatibility while loading profiles
-		if( filter.type == SF_BOTS ) {
-			continue;
-		}
+			int flags = 0;
+			if( filter.state == SFS_SHOWONLY ) {
+				flags |= FIF_HIDE_IF_FALSE;
+			}
+			if( filter.resultBin == SFR_OR ) {
+				flags |= FIF_OR;
+			} else if( filter.state == SFS_HIDE ) {
+				flags |= FIF_HIDE_IF_TRUE;
+			}
+			if( ( ( flags & ( FIF_HIDE_IF_FALSE | FIF_HIDE_IF_TRUE ) ) == 0 ) != ( pass == 1 ) ) {
+				continue;
+			}
 
-		// don't filter by most items for repeaters
-		if( netSession.IsRepeater() ) {
-			if( filter.type != SF_FULL &&
-				filter.type != SF_EMPTY &&
-				filter.type != SF_PING && 
+			// don't filter by most items for repeaters
+			switch( filter.type ) {
+				case SF_FULL:
+				case SF_EMPTY:
+				case SF_PING:
 #if !defined( SD_DEMO_BUILD ) && !defined( SD_DEMO_BUILD_CONSTRUCTION )
-				filter.type != SF_FRIENDS &&
+				case SF_FRIENDS:
 #endif /* !SD_DEMO_BUILD && !SD_DEMO_BUILD_CONSTRUCTION */
-				filter.type != SF_MODS &&
-				filter.type != SF_PLAYERCOUNT ) {
-				continue;
+				case SF_MODS:
+				case SF_PLAYERCOUNT:
+					flags |= FIF_REPEATER;
+					break;
 			}
+			if( filter.type == SF_EMPTY ) {
+				flags |= FIF_EMPTY;
+			}
+
+			filterInstruction_t& instruction = *filterProgram.Alloc();
+			instruction.type = filter.type;
+			instruction.op = filter.op;
+			instruction.flags = flags;
+			instruction.value = filter.value;
+			instruction.stringField = -1;
+			instruction.needle.Clear();
 		}
 
-		float value = 0.0f;
-		switch( filter.type ) {
-			case SF_PASSWORDED:
-				value = netSession.GetServerInfo().GetBool( "si_needPass", "0" ) ? 1.0f : 0.0f;
-				break;
-			case SF_PUNKBUSTER:
-				value = netSession.GetServerInfo().GetBool( "net_serverPunkbusterEnabled", "0" ) ? 1.0f : 0.0f;
-				break;
-			case SF_FRIENDLYFIRE:
-				value = netSession.GetServerInfo().GetBool( "si_teamDamage", "0" ) ? 1.0f : 0.0f;
-				break;
-			case SF_AUTOBALANCE:	
-				value = netSession.GetServerInfo().GetBool( "si_teamForceBalance", "0" ) ? 1.0f : 0.0f;
-				break;
-			case SF_PURE:
-				value = netSession.GetServerInfo().GetBool( "si_pure", "0" ) ? 1.0f : 0.0f;
-				break;
-			case SF_LATEJOIN:
-				value = netSession.GetServerInfo().GetBool( "si_allowLateJoin", "0" ) ? 1.0f : 0.0f;
-				break;
-			case SF_EMPTY: {
-					int num = netSession.IsRepeater() ? netSession.GetNumRepeaterClients() : netSession.GetNumClients();
-					value = ( num == 0 ) ? 1.0f : 0.0f;
+		for( int i = 0; i < stringFilters.Num(); i++ ) {
+			const serverStringFilter_t& filter = stringFilters[ i ];
+			if( filter.state == SFS_DONTCARE ) {
+				continue;
+			}
+
+			// string filters apply to repeaters as well
+			int flags = FIF_REPEATER;
+			if( filter.state == SFS_SHOWONLY ) {
+				flags |= FIF_HIDE_IF_FALSE;
+				if( filter.resultBin == SFR_OR ) {
+					flags |= FIF_OR_IF_TRUE;
 				}
-				break;
-			case SF_FULL: {
-					int num = netSession.IsRepeater() ? netSession.GetNumRepeaterClients() : netSession.GetNumClients();
-					int max = netSession.IsRepeater() ? netSession.GetMaxRepeaterClients() : netSession.GetServerInfo().GetInt( "si_maxPlayers" );
-					value = ( num == max ) ? 1.0f : 0.0f;
+			} else if( filter.state == SFS_HIDE ) {
+				flags |= FIF_HIDE_IF_TRUE;
+			}
+			if( ( ( flags & ( FIF_HIDE_IF_FALSE | FIF_HIDE_IF_TRUE ) ) == 0 ) != ( pass == 1 ) ) {
+				continue;
+			}
+
+			int field;
+			for( field = 0; field < filterStringCvars.Num(); field++ ) {
+				if( filterStringCvars[ field ].Icmp( filter.cvar ) == 0 ) {
+					break;
 				}
-				break;
-			case SF_PING:
-				value = netSession.GetPing();
-				break;
-/* jrad - this is superseded by SF_MAXBOTS, but left in for backwards compatibility while loading profiles
-			case SF_BOTS:
-				value = ( ( ( netSession.GetNumClients() - netSession.GetNumBotClients() ) == 0 ) && ( netSession.GetNumBotClients() > 0 ) ) ? 1.0f : 0.0f;
-				break;
+			}
+			if( field == filterStringCvars.Num() ) {
+				filterStringCvars.Append( filter.cvar );
+
+				int& recordField = *filterStringFields.Alloc();
+				if( filter.cvar.Icmp( "si_name" ) == 0 ) {
+					recordField = SRF_NAME;
+				} else if( filter.cvar.Icmp( "si_map" ) == 0 ) {
+					recordField = SRF_MAP;
+				} else {
+					recordField = SRF_NONE;
+				}
+			}
+
+			filterInstruction_t& instruction = *filterProgram.Alloc();
+			instruction.type = SF_MAX;
+			instruction.op = filter.op;
+			instruction.flags = flags;
+			instruction.value = 0.0f;
+			instruction.stringField = field;
+
+			// the session value has its colors removed, equality ignores them in the filter as well
+			instruction.needle = filter.value;
+			if( filter.op == SFO_EQUAL || filter.op == SFO_NOT_EQUAL ) {
+				instruction.needle.RemoveColors();
+			}
+		}
+	}
+}
+
+/*
+============
+sdNetManager::GetNumericFilterValue
+============
 */
-			case SF_MAXBOTS:
-				value = netSession.GetNumBotClients();
-				break;
-			case SF_FAVORITE:
-				value = activeUser->GetProfile().GetProperties().GetBool( va( "favorite_%s", netSession.GetHostAddressString() ), "0" );
-				break;
+float sdNetManager::GetNumericFilterValue( const sdNetSession& netSession, const sessionRecord_t& record, serverFilter_e type ) const {
+	switch( type ) {
+		case SF_PASSWORDED:
+			return record.needPass ? 1.0f : 0.0f;
+		case SF_PUNKBUSTER:
+			return record.punkbuster ? 1.0f : 0.0f;
+		case SF_FRIENDLYFIRE:
+			return record.teamDamage ? 1.0f : 0.0f;
+		case SF_AUTOBALANCE:	
+			return record.teamForceBalance ? 1.0f : 0.0f;
+		case SF_PURE:
+			return record.pure ? 1.0f : 0.0f;
+		case SF_LATEJOIN:
+			return record.allowLateJoin ? 1.0f : 0.0f;
+		case SF_EMPTY: {
+				int num = netSession.IsRepeater() ? netSession.GetNumRepeaterClients() : netSession.GetNumClients();
+				return ( num == 0 ) ? 1.0f : 0.0f;
+			}
+		case SF_FULL: {
+				int num = netSession.IsRepeater() ? netSession.GetNumRepeaterClients() : netSession.GetNumClients();
+				int max = netSession.IsRepeater() ? netSession.GetMaxRepeaterClients() : record.maxPlayers;
+				return ( num == max ) ? 1.0f : 0.0f;
+			}
+		case SF_PING:
+			return netSession.GetPing();
+		case SF_MAXBOTS:
+			return netSession.GetNumBotClients();
+		case SF_FAVORITE:
+			assert( networkService->GetActiveUser() != NULL );
+			return IsFavoriteServer( netSession.GetAddress() ) ? 1.0f : 0.0f;
 #if !defined( SD_DEMO_BUILD ) && !defined( SD_DEMO_BUILD_CONSTRUCTION )
-			case SF_RANKED:
-				value = netSession.IsRanked() ? 1.0f : 0.0f;
-				break;
-			case SF_FRIENDS:
-				value = AnyFriendsOnServer( netSession ) ? 1.0f : 0.0f;
-				break;
+		case SF_RANKED:
+			return netSession.IsRanked() ? 1.0f : 0.0f;
+		case SF_FRIENDS:
+			return AnyFriendsOnServer( netSession ) ? 1.0f : 0.0f;
 #endif /* !SD_DEMO_BUILD && !SD_DEMO_BUILD_CONSTRUCTION */
-			case SF_PLAYERCOUNT: {
-					value = netSession.IsRepeater() ? netSession.GetNumRepeaterClients() : ( netSession.GetNumClients() - netSession.GetNumBotClients() );
-				}
-				break;
-			case SF_MODS:
-				value = ( netSession.GetServerInfo().GetString( "fs_game", "" )[ 0 ] != '\0' ) ? 1.0f : 0.0f;
-				break;
-		}
+		case SF_PLAYERCOUNT:
+			return netSession.IsRepeater() ? netSession.GetNumRepeaterClients() : ( netSession.GetNumClients() - netSession.GetNumBotClients() );
+		case SF_MODS:
+			return record.fsGame->Length() != 0 ? 1.0f : 0.0f;
+	}
+	return 0.0f;
+}
 
-		bool result = false;
-		switch( filter.op ) {
-			case SFO_EQUAL:
-				result = idMath::Fabs( value - filter.value ) < idMath::FLT_EPSILON;
-				break;
-			case SFO_NOT_EQUAL:
-				result = idMath::Fabs( value - filter.value ) >= idMath::FLT_EPSILON;
-				break;
-			case SFO_LESS:
-				result = value < filter.value;
-				break;
-			case SFO_GREATER:
-				result = value > filter.value;
-				break;
-		}
+/*
+============
+sdNetManager::GetStringFilterValue
 
-		if( filter.state == SFS_SHOWONLY && !result ) {
-			visible = false;
-			break;
-		}
+the serverInfo value with its colors removed, si_map matches the pretty name
+============
+*/
+const char* sdNetManager::GetStringFilterValue( const sdNetSession& netSession, const sessionRecord_t& record, int field ) const {
+	switch( filterStringFields[ field ] ) {
+		case SRF_NAME:
+			return record.cleanName.c_str();
+		case SRF_MAP:
+			return record.filterMap->c_str();
+	}
 
-		if( filter.resultBin == SFR_OR ) {
-			orFilters |= result;
-			orSet = true;
-		} else if( result && filter.state == SFS_HIDE ) {
-			visible = false;
+	idStr& value = filterStrings[ field ];
+	value = netSession.GetServerInfo().GetString( filterStringCvars[ field ].c_str() );
+	value.RemoveColors();
+	return value.c_str();
+}
+
+/*
+============
+sdNetManager::SessionIsFiltered
+
+runs filterProgram against the session's record; every field is looked up at
+most once, and only if an instruction that still matters needs it
+============
+*/
+bool sdNetManager::SessionIsFiltered( const sdNetSession& netSession, bool ignoreEmptyFilter ) const {
+	if( filterProgram.Empty() ) {
+		return false;
+	}
+
+	const sessionRecord_t& record = GetSessionRecord( netSession );
+	const bool repeater = netSession.IsRepeater();
+
+	float numericValues[ SF_MAX ];
+	int numericRead = 0;
+	const char* stringValues[ 8 ];
+	int stringsRead = 0;
+
+	bool orFilters = false;
+	bool orSet = false;
+
+	for( int i = 0; i < filterProgram.Num(); i++ ) {
+		// only the OR bin is left and it already passes
+		if( orFilters && i >= filterOrOnlyStart ) {
 			break;
 		}
-	}
 
-	for( int i = 0; i < stringFilters.Num() && visible; i++ ) {
-		const serverStringFilter_t& filter = stringFilters[ i ];
-		if( filter.state == SFS_DONTCARE ) {
+		const filterInstruction_t& instruction = filterProgram[ i ];
+		if( repeater && ( instruction.flags & FIF_REPEATER ) == 0 ) {
 			continue;
 		}
-
-		const char* value = netSession.GetServerInfo().GetString( filter.cvar.c_str() );
-
-		// allow for filtering the pretty name
-		if( gameLocal.mapMetaDataList != NULL && filter.cvar.Icmp( "si_map" ) == 0 ) {
-			idStr prettyName( value );
-			prettyName.StripFileExtension();
-			if ( const idDict* mapInfo = gameLocal.mapMetaDataList->FindMetaData( prettyName ) ) {
-				value = mapInfo->GetString( "pretty_name", value );
-			}
+		if( ignoreEmptyFilter && ( instruction.flags & FIF_EMPTY ) != 0 ) {
+			continue;
 		}
-		builder.Clear();
-		builder.AppendNoColors( value );
 
 		bool result = false;
-
-		switch( filter.op ) {
-			case SFO_EQUAL:
-				result = idStr::IcmpNoColor( builder.c_str(), filter.value.c_str() ) == 0;
-				break;
-			case SFO_NOT_EQUAL:
-				result = idStr::IcmpNoColor( builder.c_str(), filter.value.c_str() ) != 0;
-				break;
-			case SFO_CONTAINS:
-				result = idStr::FindText( builder.c_str(), filter.value.c_str(), false ) != idStr::INVALID_POSITION;
-				break;
-			case SFO_NOT_CONTAINS:
-				result = idStr::FindText( builder.c_str(), filter.value.c_str(), false ) == idStr::INVALID_POSITION;
-				break;
+		if( instruction.type != SF_MAX ) {
+			if( ( numericRead & BIT( instruction.type ) ) == 0 ) {
+				numericValues[ instruction.type ] = GetNumericFilterValue( netSession, record, instruction.type );
+				numericRead |= BIT( instruction.type );
+			}
+			const float value = numericValues[ instruction.type ];
+
+			switch( instruction.op ) {
+				case SFO_EQUAL:
+					result = idMath::Fabs( value - instruction.value ) < idMath::FLT_EPSILON;
+					break;
+				case SFO_NOT_EQUAL:
+					result = idMath::Fabs( value - instruction.value ) >= idMath::FLT_EPSILON;
+					break;
+				case SFO_LESS:
+					result = value < instruction.value;
+					break;
+				case SFO_GREATER:
+					result = value > instruction.value;
+					break;
+			}
+		} else {
+			if( ( stringsRead & BIT( instruction.stringField ) ) == 0 ) {
+				stringValues[ instruction.stringField ] = GetStringFilterValue( netSession, record, instruction.stringField );
+				stringsRead |= BIT( instruction.stringField );
+			}
+			const char* value = stringValues[ instruction.stringField ];
+
+			switch( instruction.op ) {
+				case SFO_EQUAL:
+					result = idStr::Icmp( value, instruction.needle.c_str() ) == 0;
+					break;
+				case SFO_NOT_EQUAL:
+					result = idStr::Icmp( value, instruction.needle.c_str() ) != 0;
+					break;
+				case SFO_CONTAINS:
+					result = idStr::FindText( value, instruction.needle.c_str(), false ) != idStr::INVALID_POSITION;
+					break;
+				case SFO_NOT_CONTAINS:
+					result = idStr::FindText( value, instruction.needle.c_str(), false ) == idStr::INVALID_POSITION;
+					break;
+			}
 		}
 
-		if( filter.state == SFS_SHOWONLY && !result ) {
- 			visible = false;
-			break;
+		if( result ? ( instruction.flags & FIF_HIDE_IF_TRUE ) != 0 : ( instruction.flags & FIF_HIDE_IF_FALSE ) != 0 ) {
+			return true;
 		}
-		if( result && filter.state != SFS_HIDE && filter.resultBin == SFR_OR ) {
+		if( ( instruction.flags & FIF_OR ) != 0 ) {
 			orFilters |= result;
 			orSet = true;
-		} else if( result && filter.state == SFS_HIDE ) {
-			visible = false;
-			break;
+		} else if( result && ( instruction.flags & FIF_OR_IF_TRUE ) != 0 ) {
+			orFilters = true;
+			orSet = true;
 		}
 	}
 
-	if( orSet ) {
-		visible &= orFilters;
-	}
-
-	return !visible;
+	return orSet && !orFilters;
 }
 
 /*
@@ -4863,6 +5282,7 @@ void sdNetManager::Script_LoadFilters( sdUIFunctionStack& stack ) {
 		kv = dict.MatchPrefix( va( "filter_%s_string_%i", prefix.c_str(), i ) );
 	}
 
+	CompileFilters();
 }
 
 /*
@@ -5307,6 +5727,7 @@ void sdNetManager::Script_RefreshCurrentServers( sdUIFunctionStack& stack ) {
 	}
 
 	lastServerUpdateIndex = 0;
+	ClearSessionRecords();
 
 	task = networkService->GetSessionManager().RefreshSessions( *netSessions );
 	if ( task == NULL ) {
@@ -5423,6 +5844,28 @@ void sdNetManager::Script_ToggleServerFavoriteState( sdUIFunctionStack& stack )
 		activeUser->GetProfile().GetProperties().SetBool( key.c_str(), true );
 	}
 	activeUser->Save( sdNetUser::SI_PROFILE );
+
+	// keep the favorites set in step, the next lookup loads it if it isn't yet
+	netadr_t addr;
+	if( favoriteServersUser != activeUser || !sys->StringToNetAdr( sessionName.c_str(), &addr, false ) ) {
+		favoriteServersUser = NULL;
+		return;
+	}
+
+	int hashKey = FavoriteServerKey( addr );
+	int index;
+	for( index = favoriteServerHash.GetFirst( hashKey ); index != idHashIndex::NULL_INDEX; index = favoriteServerHash.GetNext( index ) ) {
+		if( favoriteServers[ index ] == addr ) {
+			break;
+		}
+	}
+
+	if( set && index == idHashIndex::NULL_INDEX ) {
+		favoriteServerHash.Add( hashKey, favoriteServers.Append( addr ) );
+	} else if( !set && index != idHashIndex::NULL_INDEX ) {
+		favoriteServerHash.RemoveIndex( hashKey, index );
+		favoriteServers.RemoveIndex( index );
+	}
 }
 
 /*
@@ -5446,15 +5889,15 @@ void sdNetManager::UpdateServer( sdUIList& list, const char* sessionName, findSe
 	}
 
 	if( netSessions != NULL ) {
-		sessionHash_t::Iterator iter = hashedSessions.Find( sessionName );
-		if( iter != hashedSessions.End() ) {
+		const sessionIndices_t* indices = FindSessionIndices( sessionName );
+		if( indices != NULL ) {
 			if( task != NULL ) {
 				task->AcquireLock();
 			}
 
-			sdNetSession* netSession = (*netSessions)[ iter->second.sessionListIndex ];
+			sdNetSession* netSession = (*netSessions)[ indices->sessionListIndex ];
 
-			UpdateSession( list, *netSession, iter->second.uiListIndex );
+			UpdateSession( list, GetRenderedList( list, source, false ), *netSession, indices->uiListIndex );
 
 			if( task != NULL ) {
 				task->ReleaseLock();
@@ -5825,30 +6268,30 @@ void sdNetManager::Script_FormatSessionInfo( sdUIFunctionStack& stack ) {
 	for( int i = 0; i < sessions.Num(); i++ ) {
 		const sdNetSession& netSession = *sessions[ i ];
 		if( addr.Cmp( netSession.GetHostAddressString() ) == 0 ) {
-			const idDict& serverInfo = netSession.GetServerInfo();
+			const sessionRecord_t& record = GetSessionRecord( netSession );
 
 			sdWStringBuilder_Heap builder;
 
-			builder += va( L"%hs\n", serverInfo.GetString( "si_name" ) );
+			builder += va( L"%hs\n", record.name.c_str() );
 
 			builder += va( L"%ls: ", common->LocalizeText( "guis/mainmenu/mapname" ).c_str() );
 
 			// Map name
-			if ( const idDict* mapInfo = GetMapInfo( netSession ) ) {
+			if ( const idDict* mapInfo = record.mapInfo ) {
 				idStr prettyName;
-				prettyName = mapInfo != NULL ? mapInfo->GetString( "pretty_name", serverInfo.GetString( "si_map" ) ) : "";
+				prettyName = mapInfo != NULL ? mapInfo->GetString( "pretty_name", record.map->c_str() ) : "";
 				prettyName.StripFileExtension();
 				builder += va( L"%hs\n", prettyName.c_str() );
 			} else {
-				builder += va( L"%hs\n", serverInfo.GetString( "si_map" ) );
+				builder += va( L"%hs\n", record.map->c_str() );
 			}
 
 			builder += va( L"%ls: ", common->LocalizeText( "guis/mainmenu/gametype" ).c_str() );
 
-			const char* fsGame = serverInfo.GetString( "fs_game" );
+			const char* fsGame = record.fsGame->c_str();
 
 			if( !*fsGame ) {
-				const char* siRules = serverInfo.GetString( "si_rules" );
+				const char* siRules = record.rules->c_str();
 				idWStr gameType;
 				GetGameType( siRules, gameType );
 				builder += gameType.c_str();
@@ -5880,11 +6323,11 @@ void sdNetManager::Script_FormatSessionInfo( sdUIFunctionStack& stack ) {
 			int numBots = netSession.GetNumBotClients();
 			if( numBots == 0 ) {
 				int num = netSession.IsRepeater() ? netSession.GetNumRepeaterClients() : netSession.GetNumClients();
-				int max = netSession.IsRepeater() ? netSession.GetMaxRepeaterClients() : netSession.GetServerInfo().GetInt( "si_maxPlayers" );
+				int max = netSession.IsRepeater() ? netSession.GetMaxRepeaterClients() : record.maxPlayers;
 
 				builder += va( L"%d/%d\n", num, max );
 			} else {
-				builder += va( L"%d/%d (%d)\n", netSession.GetNumClients(), serverInfo.GetInt( "si_maxPlayers" ), numBots );
+				builder += va( L"%d/%d (%d)\n", netSession.GetNumClients(), record.maxPlayers, numBots );
 			}
 
 			// Ping
@@ -6091,9 +6534,9 @@ void sdNetManager::Script_GetNumInterestedInServer( sdUIFunctionStack& stack ) {
 	}
 	int interested = 0;
 
-	sessionHash_t::Iterator iter = hashedSessions.Find( address );
-	if( iter != hashedSessions.End() ) {
-		interested = (*netSessions)[ iter->second.sessionListIndex ]->GetNumInterestedClients();		
+	const sessionIndices_t* indices = FindSessionIndices( address.c_str() );
+	if( indices != NULL ) {
+		interested = (*netSessions)[ indices->sessionListIndex ]->GetNumInterestedClients();		
 	}
 
 	stack.Push( interested );
@@ -42,6 +42,147 @@ private:
 	int									nextInterestMessageTime;
 };
 
+/*
+============
+sdNetAddressHash
+
+an IPv4 address and port mixed so that servers on one host or subnet spread over a hash
+============
+*/
+class sdNetAddressHash {
+public:
+	static unsigned int					PackIP( const netadr_t& addr ) { return ( addr.ip[ 0 ] << 24 ) | ( addr.ip[ 1 ] << 16 ) | ( addr.ip[ 2 ] << 8 ) | addr.ip[ 3 ]; }
+	static unsigned int					Hash( unsigned int ip, unsigned short port ) { unsigned int key = ip ^ ( port * 2654435761u ); return key ^ ( key >> 16 ); }
+};
+
+/*
+============
+sdNetAddressMap
+
+values keyed on an IPv4 address and port, packed into the slots of an open addressing
+table with linear probing; the table only grows, so once it is big enough nothing allocates
+============
+*/
+template< class type >
+class sdNetAddressMap {
+public:
+										sdNetAddressMap( void ) : num( 0 ) {}
+
+	type*								Find( const netadr_t& addr );
+	type&								operator[]( const netadr_t& addr );		// adds the address if it isn't there yet
+	void								Clear( void );							// keeps the table
+	int									Num( void ) const { return num; }
+
+private:
+	static const int					MIN_SLOTS = 1024;
+
+	struct slot_t {
+		unsigned int					ip;
+		unsigned short					port;
+		bool							used;
+		type							value;
+	};
+
+	int									FindSlot( unsigned int ip, unsigned short port ) const;
+	void								Grow( void );
+
+	idList< slot_t >					slots;		// a power of two, at most three quarters used
+	int									num;
+};
+
+/*
+============
+sdNetAddressMap::FindSlot
+
+the slot of the address, or the empty slot it would go to
+============
+*/
+template< class type >
+ID_INLINE int sdNetAddressMap< type >::FindSlot( unsigned int ip, unsigned short port ) const {
+	unsigned int mask = slots.Num() - 1;
+	unsigned int slot = sdNetAddressHash::Hash( ip, port ) & mask;
+	while( slots[ slot ].used && ( slots[ slot ].ip != ip || slots[ slot ].port != port ) ) {
+		slot = ( slot + 1 ) & mask;
+	}
+	return slot;
+}
+
+/*
+============
+sdNetAddressMap::Find
+============
+*/
+template< class type >
+ID_INLINE type* sdNetAddressMap< type >::Find( const netadr_t& addr ) {
+	if( num == 0 ) {
+		return NULL;
+	}
+	slot_t& slot = slots[ FindSlot( sdNetAddressHash::PackIP( addr ), addr.port ) ];
+	return slot.used ? &slot.value : NULL;
+}
+
+/*
+============
+sdNetAddressMap::operator[]
+============
+*/
+template< class type >
+ID_INLINE type& sdNetAddressMap< type >::operator[]( const netadr_t& addr ) {
+	if( ( num + 1 ) * 4 > slots.Num() * 3 ) {
+		Grow();
+	}
+
+	unsigned int ip = sdNetAddressHash::PackIP( addr );
+	slot_t& slot = slots[ FindSlot( ip, addr.port ) ];
+	if( !slot.used ) {
+		slot.ip = ip;
+		slot.port = addr.port;
+		slot.used = true;
+		num++;
+	}
+	return slot.value;
+}
+
+/*
+============
+sdNetAddressMap::Clear
+============
+*/
+template< class type >
+ID_INLINE void sdNetAddressMap< type >::Clear( void ) {
+	if( num == 0 ) {
+		return;
+	}
+	for( int i = 0; i < slots.Num(); i++ ) {
+		slots[ i ].used = false;
+	}
+	num = 0;
+}
+
+/*
+============
+sdNetAddressMap::Grow
+============
+*/
+template< class type >
+ID_INLINE void sdNetAddressMap< type >::Grow( void ) {
+	idList< slot_t > old;
+	old.Swap( slots );
+
+	slots.SetGranularity( 16 );
+	slots.SetNum( old.Num() == 0 ? MIN_SLOTS : old.Num() * 2 );
+	for( int i = 0; i < slots.Num(); i++ ) {
+		slots[ i ].used = false;
+	}
+
+	for( int i = 0; i < old.Num(); i++ ) {
+		if( old[ i ].used ) {
+			slot_t& slot = slots[ FindSlot( old[ i ].ip, old[ i ].port ) ];
+			slot = old[ i ];
+		}
+	}
+}
+
 class sdNetManager {
 public:
 	typedef sdUITemplateFunction< sdNetManager > uiFunction_t;
@@ -178,6 +319,52 @@ public:
 		serverFilterResult_e	resultBin;
 	};
 
+	enum filterInstructionFlags_e {
+		FIF_HIDE_IF_FALSE		= BIT( 0 ),
+		FIF_HIDE_IF_TRUE		= BIT( 1 ),
+		FIF_OR					= BIT( 2 ),		// the result goes to the OR bin
+		FIF_OR_IF_TRUE			= BIT( 3 ),		// only a true result goes to the OR bin
+		FIF_REPEATER			= BIT( 4 ),		// also applies to repeaters
+		FIF_EMPTY				= BIT( 5 ),		// skipped with ignoreEmptyFilter
+	};
+
+	enum sessionRecordField_e {
+		SRF_NONE,
+		SRF_NAME,
+		SRF_MAP
+	};
+
+	// one active filter of numericFilters or stringFilters, see CompileFilters
+	struct filterInstruction_t {
+		serverFilter_e			type;			// SF_MAX for a string filter
+		serverFilterOp_e		op;
+		int						flags;
+		float					value;
+		int						stringField;	// index in filterStringCvars
+		idStr					needle;
+	};
+
+	// the serverInfo values the browser reads, parsed once per session, see GetSessionRecord
+	struct sessionRecord_t {
+		const sdNetSession*		session;
+		int						checksum;		// of the serverInfo it was parsed from
+		int						verifiedFrame;	// sessionRecordFrame it was last checked against the serverInfo
+		bool					needPass;
+		bool					punkbuster;
+		bool					teamDamage;
+		bool					teamForceBalance;
+		bool					pure;
+		bool					allowLateJoin;
+		int						maxPlayers;
+		const idPoolStr*		rules;			// shared with the other sessions, see sessionStrings
+		const idPoolStr*		fsGame;
+		const idPoolStr*		map;			// si_map
+		const idPoolStr*		filterMap;		// pretty name without colors, or si_map
+		const idDict*			mapInfo;
+		idStr					name;
+		idStr					cleanName;		// without colors
+	};
+
 									sdNetManager();
 									~sdNetManager() {}
 
@@ -231,6 +418,10 @@ public:
 
 	bool							SessionIsFiltered( const sdNetSession& netSession, bool ignoreEmptyFilter = false ) const;
 
+									// the record and its strings don't move until its session is freed, don't hold one across
+									// a frame; while a task fills the sessions a changed serverInfo is parsed again in place
+	const sessionRecord_t&			GetSessionRecord( const sdNetSession& netSession ) const;
+
 private:
 	struct task_t {
 					task_t() :
@@ -274,6 +465,33 @@ private:
 		void*		parm;
 	};
 
+	// what UpdateSession last wrote to a row, a row belongs to one host address until its list is cleared
+	struct renderedRow_t {
+		bool					valid;
+		bool					offline;
+		bool					favorite;
+		bool					needPass;
+		bool					ranked;
+		idStr					name;
+		idStr					map;
+		const idDict*			mapInfo;
+		idStr					rules;
+		idStr					fsGame;
+		int						gameState;
+		int						sessionTime;
+		int						numClients;
+		int						maxClients;
+		int						numBots;
+		int						ping;
+	};
+
+	struct renderedList_t {
+									renderedList_t() : list( NULL ) {}
+
+		const sdUIList*				list;		// the rows are dropped when the source is shown in another list
+		idList< renderedRow_t >		rows;		// by ui list index
+	};
+
 	static void						InitFunctions();
 	static void						ShutdownFunctions();
 	static uiFunction_t*			FindFunction( const char* name );
@@ -445,10 +663,25 @@ private:
 	void							GetGameType( const char* siRules, idWStr& type );
 
 	void							StopFindingServers( findServerSource_e source );
-	void							UpdateSession( sdUIList& list, const sdNetSession& netSession, int index );
+	void							UpdateSession( sdUIList& list, renderedList_t& rendered, const sdNetSession& netSession, int index, bool newRow = false );
+	renderedList_t&					GetRenderedList( const sdUIList& list, findServerSource_e source, bool hotServers );
+	renderedRow_t&					GetRenderedRow( renderedList_t& rendered, int index, bool newRow );
+	void							ClearRenderedRows( renderedList_t& rendered );
 
 	void							CancelUserTasks();
 	bool							DoFiltering( const sdNetSession& netSession ) const;
+
+	void							ClearSessionRecords();
+	void							FreeSessionRecord( const sdNetSession& netSession );
+	void							ParseSessionRecord( sessionRecord_t& record, const sdNetSession& netSession ) const;
+	void							FreeSessionStrings( sessionRecord_t& record ) const;
+	bool							IsFavoriteServer( const netadr_t& addr ) const;
+	void							LoadFavoriteServers() const;
+	static int						FavoriteServerKey( const netadr_t& addr );
+
+	void							CompileFilters();
+	float							GetNumericFilterValue( const sdNetSession& netSession, const sessionRecord_t& record, serverFilter_e type ) const;
+	const char*						GetStringFilterValue( const sdNetSession& netSession, const sessionRecord_t& record, int field ) const;
 	
 
 private:
@@ -506,6 +739,14 @@ private:
 	idStaticList< serverNumericFilter_t, 16 >	numericFilters;
 	idStaticList< serverStringFilter_t, 8 >		stringFilters;
 
+	idStaticList< filterInstruction_t, 24 >	filterProgram;		// built from the filters whenever they change
+	int										filterOrOnlyStart;	// the instructions from here on can't hide a session
+	idStaticList< idStr, 8 >				filterStringCvars;	// every serverInfo key read by a string filter, once
+	idStaticList< int, 8 >					filterStringFields;	// the sessionRecord_t field of each, SRF_NONE reads serverInfo
+	mutable idStr							filterStrings[ 8 ];	// SRF_NONE values during SessionIsFiltered
+
+	renderedList_t							renderedLists[ FS_MAX ][ 2 ];	// by source, the server list and the hot server list
+
 	int									lastServerUpdateIndex;
 
 	idList< netadr_t >					unfilteredSessions;
@@ -515,8 +756,21 @@ private:
 		int uiListIndex;
 		int lastUpdateTime;
 	};
-	typedef sdHashMapGeneric< idStr, sessionIndices_t, sdHashCompareStrIcmp, sdHashGeneratorIHash > sessionHash_t;
-	sessionHash_t						hashedSessions;
+	typedef sdNetAddressMap< sessionIndices_t > sessionHash_t;
+	sessionHash_t						hashedSessions;		// by the address of the session
+
+	sessionIndices_t*					FindSessionIndices( const char* address );
+
+	mutable idBlockAlloc< sessionRecord_t, 256 >	sessionRecordAllocator;	// records keep their address, and their name buffers when freed
+	mutable idList< sessionRecord_t* >	sessionRecords;		// cleared when the sessions are freed
+	mutable idHashIndex					sessionRecordHash;
+	bool								verifySessionRecords;	// a task may change the sessions in place
+	int									sessionRecordFrame;		// the records are checked at most once a frame
+	mutable idStrPool					sessionStrings;		// values that many sessions share
+
+	mutable idList< netadr_t >			favoriteServers;		// the favorite_ keys of favoriteServersUser's profile
+	mutable idHashIndex					favoriteServerHash;
+	mutable const sdNetUser*			favoriteServersUser;	// NULL to reload
 
 	idHashIndexUShort					serversWithFriendsHash;
 	idStrList							serversWithFriends;
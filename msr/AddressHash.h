@@ -0,0 +1,121 @@
+
+#ifndef __MSR_ADDRESSHASH_H__
+#define __MSR_ADDRESSHASH_H__
+
+#include "Common.h"
+
+/*
+===============================================================================
+
+	sdAddressHash
+
+	Open addressing (linear probing) map from a packed IPv4 address + port to
+	an integer index. Removal shifts the following entries back instead of
+	leaving tombstones, so probe lengths stay short under heavy churn.
+	Key 0 (0.0.0.0:0) is reserved as the empty marker.
+
+===============================================================================
+*/
+
+class sdAddressHash {
+public:
+	static const int		INVALID_INDEX	= -1;
+
+							sdAddressHash( int initialSize = 1024 ) : keys( NULL ), values( NULL ), mask( 0 ), num( 0 ) { Resize( initialSize ); }
+							~sdAddressHash( void ) { delete[] keys; delete[] values; }
+
+	int						Num( void ) const { return num; }
+
+	int						Find( u64 key ) const {
+								for ( u32 i = Hash( key ) & mask; ; i = ( i + 1 ) & mask ) {
+									if ( keys[ i ] == key ) {
+										return values[ i ];
+									}
+									if ( keys[ i ] == 0 ) {
+										return INVALID_INDEX;
+									}
+								}
+							}
+
+	void					Set( u64 key, int value ) {
+								if ( ( num + 1 ) * 4 > ( int )( mask + 1 ) * 3 ) {
+									Resize( ( mask + 1 ) * 2 );
+								}
+								u32 i = Hash( key ) & mask;
+								for ( ; keys[ i ] != 0; i = ( i + 1 ) & mask ) {
+									if ( keys[ i ] == key ) {
+										values[ i ] = value;
+										return;
+									}
+								}
+								keys[ i ] = key;
+								values[ i ] = value;
+								num++;
+							}
+
+	bool					Remove( u64 key ) {
+								u32 i = Hash( key ) & mask;
+								for ( ; keys[ i ] != key; i = ( i + 1 ) & mask ) {
+									if ( keys[ i ] == 0 ) {
+										return false;
+									}
+								}
+								// backward shift deletion
+								for ( u32 j = ( i + 1 ) & mask; keys[ j ] != 0; j = ( j + 1 ) & mask ) {
+									u32 home = Hash( keys[ j ] ) & mask;
+									if ( ( ( j - home ) & mask ) >= ( ( j - i ) & mask ) ) {
+										keys[ i ] = keys[ j ];
+										values[ i ] = values[ j ];
+										i = j;
+									}
+								}
+								keys[ i ] = 0;
+								num--;
+								return true;
+							}
+
+	void					Clear( void ) {
+								memset( keys, 0, sizeof( u64 ) * ( mask + 1 ) );
+								num = 0;
+							}
+
+	static u32				Hash( u64 key ) {
+								key ^= key >> 33;
+								key *= 0xff51afd7ed558ccdULL;
+								key ^= key >> 33;
+								return ( u32 )key;
+							}
+
+private:
+	void					Resize( int newSize ) {
+								u32 size = 16;
+								while ( size < ( u32 )newSize ) {
+									size <<= 1;
+								}
+
+								u64* oldKeys = keys;
+								int* oldValues = values;
+								u32 oldSize = oldKeys != NULL ? mask + 1 : 0;
+
+								keys = new u64[ size ];
+								values = new int[ size ];
+								memset( keys, 0, sizeof( u64 ) * size );
+								mask = size - 1;
+								num = 0;
+
+								for ( u32 i = 0; i < oldSize; i++ ) {
+									if ( oldKeys[ i ] != 0 ) {
+										Set( oldKeys[ i ], oldValues[ i ] );
+									}
+								}
+								delete[] oldKeys;
+								delete[] oldValues;
+							}
+
+	u64*					keys;
+	int*					values;
+	u32						mask;
+	int						num;
+};
+
+#endif /* !__MSR_ADDRESSHASH_H__ */
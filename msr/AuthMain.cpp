@@ -0,0 +1,88 @@
+
+#include "AuthServer.h"
+
+#include <signal.h>
+
+static sdAuthServer		authServer;
+
+/*
+================
+Sig_Stop
+================
+*/
+static void Sig_Stop( int sig ) {
+	authServer.Stop();
+}
+
+/*
+================
+Usage
+================
+*/
+static void Usage( const char* exe ) {
+	Msr_Printf( "\n"
+		"Usage: %s [options]\n"
+		"\n"
+		"  -port <n>            TCP port to listen on (%d)\n"
+		"  -maxConnections <n>  connections held at once, more are refused (16384)\n"
+		"  -idleTimeout <sec>   close connections that sent nothing for this long (800)\n"
+		"  -stats <dir>         store the writeStats uploads in dir/stats.log\n"
+		"  -v                   log one line per frame, -vv adds hex dumps\n"
+		"\n", exe, sdAuthServer::AUTH_PORT );
+}
+
+/*
+================
+main
+================
+*/
+int main( int argc, char* argv[] ) {
+	sdAuthServer::config_t config;
+
+	setvbuf( stdout, NULL, _IOLBF, 0 );
+
+	for ( int i = 1; i < argc; i++ ) {
+		const char* arg = argv[ i ];
+		const char* value = ( i + 1 < argc ) ? argv[ i + 1 ] : NULL;
+
+		if ( !strcmp( arg, "-v" ) ) {
+			config.verbosity = 1;
+		} else if ( !strcmp( arg, "-vv" ) ) {
+			config.verbosity = 2;
+		} else if ( !strcmp( arg, "-port" ) && value != NULL ) {
+			config.port = ( u16 )atoi( value );
+			i++;
+		} else if ( !strcmp( arg, "-maxConnections" ) && value != NULL ) {
+			config.maxConnections = atoi( value );
+			i++;
+		} else if ( !strcmp( arg, "-idleTimeout" ) && value != NULL ) {
+			config.idleTimeout = atoi( value );
+			i++;
+		} else if ( !strcmp( arg, "-stats" ) && value != NULL ) {
+			config.statsDirectory = value;
+			i++;
+		} else {
+			Usage( argv[ 0 ] );
+			return 1;
+		}
+	}
+
+	if ( config.maxConnections < 1 || config.idleTimeout < 1 ) {
+		Usage( argv[ 0 ] );
+		return 1;
+	}
+
+	if ( !authServer.Init( config ) ) {
+		return 1;
+	}
+
+	signal( SIGINT, Sig_Stop );
+	signal( SIGTERM, Sig_Stop );
+	signal( SIGPIPE, SIG_IGN );
+
+	authServer.Run();
+	authServer.PrintStats();
+	authServer.Shutdown();
+
+	return 0;
+}
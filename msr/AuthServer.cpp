@@ -0,0 +1,845 @@
+
+#include "AuthServer.h"
+#include "Msg.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+// epoll keys of the reactor fds, their low half is never a connection index
+static const u64 KEY_LISTEN		= ~0ULL;
+static const u64 KEY_TIMER		= ~0ULL - 1;
+static const u64 KEY_WAKE		= ~0ULL - 2;
+
+/*
+================
+sdAuthServer::messageHandlers
+================
+*/
+const sdAuthServer::messageHandlerDef_t sdAuthServer::messageHandlers[] = {
+	{ AUTH_MSG_LOGIN,			&sdAuthServer::HandleLogin },
+	{ AUTH_MSG_CREATEACCOUNT,	&sdAuthServer::HandleCreateAccount },
+	{ AUTH_MSG_WRITESTATS,		&sdAuthServer::HandleWriteStats },
+	{ AUTH_MSG_LEADERBOARD,		&sdAuthServer::HandleLeaderboard },
+	{ AUTH_MSG_PRESENCE,		&sdAuthServer::HandlePresence },
+	{ AUTH_MSG_SUBSCRIBE,		&sdAuthServer::HandleSubscribe },
+	{ AUTH_MSG_UNSUBSCRIBE,		&sdAuthServer::HandleSubscribe },
+};
+
+/*
+================
+sdAuthServer::sdAuthServer
+================
+*/
+sdAuthServer::sdAuthServer( void ) :
+	running( false ),
+	listenFd( -1 ),
+	epollFd( -1 ),
+	timerFd( -1 ),
+	wakeFd( -1 ),
+	connections( NULL ),
+	freeList( -1 ),
+	numConnections( 0 ),
+	nextStatsTime( 0 ) {
+	memset( &stats, 0, sizeof( stats ) );
+}
+
+/*
+================
+sdAuthServer::~sdAuthServer
+================
+*/
+sdAuthServer::~sdAuthServer( void ) {
+	Shutdown();
+}
+
+/*
+================
+sdAuthServer::Init
+================
+*/
+bool sdAuthServer::Init( const config_t& config ) {
+	this->config = config;
+
+	// every connection is a descriptor, the default soft limit is usually 1024
+	struct rlimit limit;
+	if ( getrlimit( RLIMIT_NOFILE, &limit ) == 0 ) {
+		rlim_t wanted = ( rlim_t )config.maxConnections + 64;
+		if ( limit.rlim_cur < wanted ) {
+			limit.rlim_cur = limit.rlim_max < wanted ? limit.rlim_max : wanted;
+			setrlimit( RLIMIT_NOFILE, &limit );
+		}
+		if ( limit.rlim_cur < wanted ) {
+			Msr_Warning( "sdAuthServer::Init: the descriptor limit (%llu) is below %d connections", ( unsigned long long )limit.rlim_cur, config.maxConnections );
+		}
+	}
+
+	listenFd = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK, IPPROTO_TCP );
+	if ( listenFd < 0 ) {
+		Msr_Warning( "sdAuthServer::Init: socket failed (%s)", strerror( errno ) );
+		return false;
+	}
+
+	int on = 1;
+	setsockopt( listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on ) );
+
+	struct sockaddr_in addr;
+	memset( &addr, 0, sizeof( addr ) );
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = INADDR_ANY;
+	addr.sin_port = htons( config.port );
+	if ( bind( listenFd, ( struct sockaddr* )&addr, sizeof( addr ) ) < 0 ) {
+		Msr_Warning( "sdAuthServer::Init: bind to TCP port %u failed (%s)", config.port, strerror( errno ) );
+		Shutdown();
+		return false;
+	}
+	if ( listen( listenFd, SOMAXCONN ) < 0 ) {
+		Msr_Warning( "sdAuthServer::Init: listen failed (%s)", strerror( errno ) );
+		Shutdown();
+		return false;
+	}
+
+	epollFd = epoll_create1( 0 );
+	timerFd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK );
+	wakeFd = eventfd( 0, EFD_NONBLOCK );
+	if ( epollFd < 0 || timerFd < 0 || wakeFd < 0 ) {
+		Msr_Warning( "sdAuthServer::Init: failed to create the reactor fds (%s)", strerror( errno ) );
+		Shutdown();
+		return false;
+	}
+
+	struct itimerspec tick;
+	tick.it_interval.tv_sec = TICK_MSEC / 1000;
+	tick.it_interval.tv_nsec = ( TICK_MSEC % 1000 ) * 1000000;
+	tick.it_value = tick.it_interval;
+	timerfd_settime( timerFd, 0, &tick, NULL );
+
+	const int fds[ 3 ] = { listenFd, timerFd, wakeFd };
+	const u64 keys[ 3 ] = { KEY_LISTEN, KEY_TIMER, KEY_WAKE };
+	for ( int i = 0; i < 3; i++ ) {
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.u64 = keys[ i ];
+		if ( epoll_ctl( epollFd, EPOLL_CTL_ADD, fds[ i ], &ev ) < 0 ) {
+			Msr_Warning( "sdAuthServer::Init: epoll_ctl failed (%s)", strerror( errno ) );
+			Shutdown();
+			return false;
+		}
+	}
+
+	// the receive buffers are only touched once a connection uses them
+	connections = new connection_t[ config.maxConnections ];
+	for ( int i = 0; i < config.maxConnections; i++ ) {
+		connection_t& conn = connections[ i ];
+		conn.fd = -1;
+		conn.generation = 0;
+		conn.client = 0;
+		conn.sendBuffer = NULL;
+		conn.nextFree = i + 1 < config.maxConnections ? i + 1 : -1;
+	}
+	freeList = config.maxConnections > 0 ? 0 : -1;
+	numConnections = 0;
+
+	idleTimers.Init( TICK_MSEC, Sys_Milliseconds() );
+	nextStatsTime = Sys_Milliseconds() + STATS_INTERVAL;
+
+	log.Start( config.verbosity );
+
+	if ( config.statsDirectory[ 0 ] != '\0' && !statsStore.Open( config.statsDirectory ) ) {
+		Shutdown();
+		return false;
+	}
+
+	Msr_Printf( "- listening on TCP port %u, up to %d connections\n", config.port, config.maxConnections );
+	return true;
+}
+
+/*
+================
+sdAuthServer::Shutdown
+================
+*/
+void sdAuthServer::Shutdown( void ) {
+	log.Stop();
+	statsStore.Close();
+
+	if ( connections != NULL ) {
+		for ( int i = 0; i < config.maxConnections; i++ ) {
+			if ( connections[ i ].fd >= 0 ) {
+				close( connections[ i ].fd );
+			}
+			free( connections[ i ].sendBuffer );
+		}
+		delete[] connections;
+		connections = NULL;
+	}
+
+	const int fds[ 4 ] = { listenFd, epollFd, timerFd, wakeFd };
+	for ( int i = 0; i < 4; i++ ) {
+		if ( fds[ i ] >= 0 ) {
+			close( fds[ i ] );
+		}
+	}
+	listenFd = epollFd = timerFd = wakeFd = -1;
+}
+
+/*
+================
+sdAuthServer::Run
+================
+*/
+void sdAuthServer::Run( void ) {
+	struct epoll_event events[ MAX_EVENTS ];
+
+	auto deliver = [this]( u64 recipient, const sdPresence::change_t* changes, int numChanges ) {
+		DeliverPresence( recipient, changes, numChanges );
+	};
+
+	running.store( true );
+	while ( running.load( std::memory_order_relaxed ) ) {
+		// sleep until the next presence batch is due at the latest
+		int timeout = -1;
+		const int flushTime = presence.GetNextFlushTime();
+		if ( flushTime >= 0 ) {
+			timeout = flushTime - Sys_Milliseconds();
+			timeout = timeout < 0 ? 0 : timeout;
+		}
+
+		int num = epoll_wait( epollFd, events, MAX_EVENTS, timeout );
+		if ( num < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			Msr_Warning( "sdAuthServer::Run: epoll_wait failed (%s)", strerror( errno ) );
+			break;
+		}
+
+		for ( int i = 0; i < num; i++ ) {
+			const u64 key = events[ i ].data.u64;
+			if ( key == KEY_LISTEN ) {
+				AcceptConnections();
+			} else if ( key == KEY_TIMER ) {
+				u64 expirations;
+				if ( read( timerFd, &expirations, sizeof( expirations ) ) > 0 ) {
+					OnTick();
+				}
+			} else if ( key == KEY_WAKE ) {
+				u64 value;
+				ssize_t ret = read( wakeFd, &value, sizeof( value ) );
+				( void )ret;
+			} else {
+				connection_t& conn = connections[ ( u32 )key ];
+				// closed earlier in this batch, possibly already reused
+				if ( conn.fd < 0 || conn.generation != ( u32 )( key >> 32 ) ) {
+					continue;
+				}
+				if ( events[ i ].events & EPOLLOUT ) {
+					WriteConnection( conn );
+				}
+				if ( conn.fd >= 0 && ( events[ i ].events & ( EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR ) ) ) {
+					ReadConnection( conn );
+				}
+			}
+		}
+
+		presence.Flush( Sys_Milliseconds(), deliver );
+	}
+
+	// commits what is still queued, PrintStats can read the store's counters afterwards
+	statsStore.Close();
+}
+
+/*
+================
+sdAuthServer::Stop
+================
+*/
+void sdAuthServer::Stop( void ) {
+	running.store( false );
+	if ( wakeFd >= 0 ) {
+		u64 one = 1;
+		ssize_t ret = write( wakeFd, &one, sizeof( one ) );
+		( void )ret;
+	}
+}
+
+/*
+================
+sdAuthServer::AcceptConnections
+================
+*/
+void sdAuthServer::AcceptConnections( void ) {
+	while ( true ) {
+		struct sockaddr_in from;
+		socklen_t fromLength = sizeof( from );
+		int fd = accept4( listenFd, ( struct sockaddr* )&from, &fromLength, SOCK_NONBLOCK );
+		if ( fd < 0 ) {
+			if ( errno == EINTR || errno == ECONNABORTED ) {
+				continue;
+			}
+			if ( errno != EAGAIN && errno != EWOULDBLOCK ) {
+				Msr_Warning( "sdAuthServer::AcceptConnections: accept failed (%s)", strerror( errno ) );
+			}
+			return;
+		}
+
+		if ( freeList < 0 ) {
+			stats.refused++;
+			close( fd );
+			continue;
+		}
+
+		int index = freeList;
+		connection_t& conn = connections[ index ];
+		freeList = conn.nextFree;
+
+		int on = 1;
+		setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on ) );
+
+		conn.fd = fd;
+		conn.generation++;
+		conn.addr = from.sin_addr.s_addr;
+		conn.port = from.sin_port;
+		conn.client = 0;
+		conn.recvLength = 0;
+		conn.sendLength = 0;
+
+		struct epoll_event ev;
+		ev.events = EPOLLIN | EPOLLRDHUP;
+		ev.data.u64 = ConnectionKey( index, conn.generation );
+		if ( epoll_ctl( epollFd, EPOLL_CTL_ADD, fd, &ev ) < 0 ) {
+			Msr_Warning( "sdAuthServer::AcceptConnections: epoll_ctl failed (%s)", strerror( errno ) );
+			close( fd );
+			conn.fd = -1;
+			conn.nextFree = freeList;
+			freeList = index;
+			continue;
+		}
+
+		conn.timer = idleTimers.Schedule( Sys_Milliseconds() + config.idleTimeout * 1000, ConnectionKey( index, conn.generation ) );
+		numConnections++;
+		stats.accepted++;
+	}
+}
+
+/*
+================
+sdAuthServer::CloseConnection
+================
+*/
+void sdAuthServer::CloseConnection( connection_t& conn ) {
+	const int index = ( int )( &conn - connections );
+
+	close( conn.fd );
+	conn.fd = -1;
+	if ( conn.timer != sdTimerWheel::INVALID_TIMER ) {
+		idleTimers.Cancel( conn.timer );
+		conn.timer = sdTimerWheel::INVALID_TIMER;
+	}
+	free( conn.sendBuffer );
+	conn.sendBuffer = NULL;
+
+	// a newer connection may have taken over the client
+	if ( conn.client != 0 && presenceConnections.Find( conn.client ) == index ) {
+		presenceConnections.Remove( conn.client );
+		presence.Disconnect( conn.client, Sys_Milliseconds() );
+	}
+	conn.client = 0;
+
+	conn.nextFree = freeList;
+	freeList = index;
+	numConnections--;
+	stats.closed++;
+}
+
+/*
+================
+sdAuthServer::ReadConnection
+
+one read per readiness event keeps a busy peer from starving the others
+================
+*/
+void sdAuthServer::ReadConnection( connection_t& conn ) {
+	ssize_t num = read( conn.fd, conn.recvBuffer + conn.recvLength, RECV_BUFFER_SIZE - conn.recvLength );
+	if ( num < 0 ) {
+		if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) {
+			CloseConnection( conn );
+		}
+		return;
+	}
+	if ( num == 0 ) {
+		CloseConnection( conn );
+		return;
+	}
+
+	stats.bytesIn += num;
+	conn.recvLength += ( int )num;
+	idleTimers.Reschedule( conn.timer, Sys_Milliseconds() + config.idleTimeout * 1000 );
+
+	if ( !ParseFrames( conn ) ) {
+		stats.protocolErrors++;
+		CloseConnection( conn );
+	}
+}
+
+/*
+================
+sdAuthServer::ParseFrames
+
+processes every complete frame in place and moves the incomplete rest to the
+front of the buffer, false if the peer broke the framing
+================
+*/
+bool sdAuthServer::ParseFrames( connection_t& conn ) {
+	int offset = 0;
+	while ( conn.recvLength - offset >= FRAME_HEADER_SIZE ) {
+		const byte* header = conn.recvBuffer + offset;
+		u32 length = ( u32 )header[ 0 ] | ( ( u32 )header[ 1 ] << 8 ) | ( ( u32 )header[ 2 ] << 16 ) | ( ( u32 )header[ 3 ] << 24 );
+		if ( length > ( u32 )MAX_FRAME_SIZE ) {
+			return false;
+		}
+		if ( conn.recvLength - offset < FRAME_HEADER_SIZE + ( int )length ) {
+			break;
+		}
+
+		ProcessFrame( conn, header + FRAME_HEADER_SIZE, ( int )length );
+		if ( conn.fd < 0 ) {
+			return true;		// a handler closed it
+		}
+		offset += FRAME_HEADER_SIZE + ( int )length;
+	}
+
+	if ( offset > 0 ) {
+		conn.recvLength -= offset;
+		memmove( conn.recvBuffer, conn.recvBuffer + offset, conn.recvLength );
+	}
+	return true;
+}
+
+/*
+================
+sdAuthServer::ProcessFrame
+================
+*/
+void sdAuthServer::ProcessFrame( connection_t& conn, const byte* payload, int length ) {
+	stats.frames++;
+	if ( log.IsActive() ) {
+		log.Push( sdLogQueue::LD_IN, conn.addr, conn.port, payload, length );
+	}
+
+	if ( length == 0 ) {
+		stats.keepAlives++;
+		return;
+	}
+	if ( length < 2 ) {
+		stats.unknown++;
+		return;
+	}
+
+	for ( size_t i = 0; i < sizeof( messageHandlers ) / sizeof( messageHandlers[ 0 ] ); i++ ) {
+		if ( messageHandlers[ i ].type == payload[ 1 ] ) {
+			( this->*messageHandlers[ i ].handler )( conn, payload, length );
+			return;
+		}
+	}
+	stats.unknown++;
+}
+
+/*
+================
+sdAuthServer::Send
+
+writes what the socket takes and queues the rest, a peer that lets more than
+SEND_BUFFER_SIZE pile up is disconnected
+================
+*/
+bool sdAuthServer::Send( connection_t& conn, const byte* data, int length ) {
+	if ( conn.sendLength == 0 ) {
+		ssize_t num = write( conn.fd, data, length );
+		if ( num < 0 ) {
+			if ( errno != EAGAIN && errno != EWOULDBLOCK ) {
+				CloseConnection( conn );
+				return false;
+			}
+			num = 0;
+		}
+		stats.bytesOut += num;
+		data += num;
+		length -= ( int )num;
+		if ( length == 0 ) {
+			return true;
+		}
+	}
+
+	if ( conn.sendLength + length > SEND_BUFFER_SIZE ) {
+		stats.sendOverflows++;
+		CloseConnection( conn );
+		return false;
+	}
+	if ( conn.sendBuffer == NULL ) {
+		conn.sendBuffer = ( byte* )malloc( SEND_BUFFER_SIZE );
+	}
+	memcpy( conn.sendBuffer + conn.sendLength, data, length );
+
+	if ( conn.sendLength == 0 ) {
+		struct epoll_event ev;
+		ev.events = EPOLLIN | EPOLLRDHUP | EPOLLOUT;
+		ev.data.u64 = ConnectionKey( ( int )( &conn - connections ), conn.generation );
+		epoll_ctl( epollFd, EPOLL_CTL_MOD, conn.fd, &ev );
+	}
+	conn.sendLength += length;
+	return true;
+}
+
+/*
+================
+sdAuthServer::WriteConnection
+================
+*/
+void sdAuthServer::WriteConnection( connection_t& conn ) {
+	if ( conn.sendLength == 0 ) {
+		return;
+	}
+
+	ssize_t num = write( conn.fd, conn.sendBuffer, conn.sendLength );
+	if ( num < 0 ) {
+		if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) {
+			CloseConnection( conn );
+		}
+		return;
+	}
+
+	stats.bytesOut += num;
+	conn.sendLength -= ( int )num;
+	if ( conn.sendLength > 0 ) {
+		memmove( conn.sendBuffer, conn.sendBuffer + num, conn.sendLength );
+		return;
+	}
+
+	// drained, the buffer goes back until the next reply that doesn't fit
+	free( conn.sendBuffer );
+	conn.sendBuffer = NULL;
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLRDHUP;
+	ev.data.u64 = ConnectionKey( ( int )( &conn - connections ), conn.generation );
+	epoll_ctl( epollFd, EPOLL_CTL_MOD, conn.fd, &ev );
+}
+
+/*
+================
+sdAuthServer::OnTick
+================
+*/
+void sdAuthServer::OnTick( void ) {
+	int now = Sys_Milliseconds();
+
+	auto expired = [this]( u64 key ) {
+		connection_t& conn = connections[ ( u32 )key ];
+		conn.timer = sdTimerWheel::INVALID_TIMER;		// already released by the wheel
+		stats.timedOut++;
+		CloseConnection( conn );
+	};
+	idleTimers.Advance( now, expired );
+
+	if ( config.verbosity > 0 && now >= nextStatsTime ) {
+		PrintStats();
+		nextStatsTime = now + STATS_INTERVAL;
+	}
+}
+
+/*
+================
+sdAuthServer::HandleLogin
+
+the credentials are encrypted, nothing to answer with yet
+================
+*/
+void sdAuthServer::HandleLogin( connection_t& conn, const byte* payload, int length ) {
+	stats.logins++;
+}
+
+/*
+================
+sdAuthServer::HandleCreateAccount
+
+the CD key and account are encrypted, nothing to answer with yet
+================
+*/
+void sdAuthServer::HandleCreateAccount( connection_t& conn, const byte* payload, int length ) {
+	stats.createAccounts++;
+}
+
+/*
+================
+sdAuthServer::HandleWriteStats
+
+one sdNetStatsManager::WriteDictionary, a dictionary larger than a frame is
+sent as several; the values are kept as their raw int or float bits
+
+	payload:	byte 0, byte AUTH_MSG_WRITESTATS, long clientId[ 0 ], long clientId[ 1 ], byte count,
+				count * ( byte type, string key, long value )
+================
+*/
+void sdAuthServer::HandleWriteStats( connection_t& conn, const byte* payload, int length ) {
+	stats.writeStats++;
+
+	sdMsgReader msg( payload + 2, length - 2 );
+	u32 high = msg.ReadLong();
+	u32 low = msg.ReadLong();
+	int count = msg.ReadByte();
+	if ( msg.IsOverflowed() || !statsStore.IsOpen() ) {
+		stats.protocolErrors += msg.IsOverflowed();
+		return;
+	}
+
+	const u64 client = ( ( u64 )high << 32 ) | low;		// sdNetEntityId::ToUInt64
+	for ( int i = 0; i < count; i++ ) {
+		int type = msg.ReadByte();
+		const char* key = msg.ReadString();
+		u32 value = msg.ReadLong();
+		if ( msg.IsOverflowed() || key == NULL || type < 0 || type >= sdStatsStore::SVT_NUM_TYPES ) {
+			stats.protocolErrors++;
+			return;
+		}
+		statsStore.Add( client, statsStore.InternKey( key, type ), value );
+		stats.statRecords++;
+	}
+}
+
+/*
+================
+sdAuthServer::HandleLeaderboard
+
+the client's rank and total plus one page of the board, for
+Script_QueryXPStats and the award lookups; rank -1 if the client has no value
+
+	payload:	byte 0, byte AUTH_MSG_LEADERBOARD, byte type, string key, long clientId[ 0 ], long clientId[ 1 ],
+				long first, byte count
+	reply:		byte 0, byte AUTH_MSG_LEADERBOARD, long numEntries, long rank, long value, byte count,
+				count * ( long clientId[ 0 ], long clientId[ 1 ], long value )
+================
+*/
+void sdAuthServer::HandleLeaderboard( connection_t& conn, const byte* payload, int length ) {
+	stats.leaderboards++;
+
+	sdMsgReader msg( payload + 2, length - 2 );
+	int type = msg.ReadByte();
+	const char* key = msg.ReadString();
+	u32 high = msg.ReadLong();
+	u32 low = msg.ReadLong();
+	int first = ( int )msg.ReadLong();
+	int count = msg.ReadByte();
+	if ( msg.IsOverflowed() || key == NULL ) {
+		stats.protocolErrors++;
+		return;
+	}
+	if ( count > MAX_LEADERBOARD_PAGE ) {
+		count = MAX_LEADERBOARD_PAGE;
+	}
+
+	sdLeaderboard::entry_t entries[ MAX_LEADERBOARD_PAGE ];
+	int rank = sdLeaderboard::INVALID_RANK;
+	u32 value = 0;
+	int numEntries = 0;
+	int numReturned = 0;
+	if ( statsStore.IsOpen() ) {
+		const u64 client = ( ( u64 )high << 32 ) | low;
+		statsStore.QueryLeaderboard( statsStore.FindKey( key, type ), client, rank, value, numEntries, first, count, entries, numReturned );
+	}
+
+	byte frame[ FRAME_HEADER_SIZE + MAX_FRAME_SIZE ];
+	sdMsgWriter reply( frame, sizeof( frame ) );
+	reply.WriteLong( 0 );		// length, filled in below
+	reply.WriteByte( 0 );
+	reply.WriteByte( AUTH_MSG_LEADERBOARD );
+	reply.WriteLong( numEntries );
+	reply.WriteLong( ( u32 )rank );
+	reply.WriteLong( value );
+	reply.WriteByte( numReturned );
+	for ( int i = 0; i < numReturned; i++ ) {
+		reply.WriteLong( ( u32 )( entries[ i ].client >> 32 ) );
+		reply.WriteLong( ( u32 )entries[ i ].client );
+		reply.WriteLong( entries[ i ].value );
+	}
+
+	const int frameLength = reply.GetLength();
+	sdMsgWriter header( frame, FRAME_HEADER_SIZE );
+	header.WriteLong( frameLength - FRAME_HEADER_SIZE );
+	if ( log.IsActive() ) {
+		log.Push( sdLogQueue::LD_OUT, conn.addr, conn.port, frame + FRAME_HEADER_SIZE, frameLength - FRAME_HEADER_SIZE );
+	}
+	Send( conn, frame, frameLength );
+}
+
+/*
+================
+sdAuthServer::HandlePresence
+
+the connection speaks for the client from now on, state is sdNetFriend::onlineState_e
+and the session address is 0 outside of a game
+
+	payload:	byte 0, byte AUTH_MSG_PRESENCE, long clientId[ 0 ], long clientId[ 1 ], byte state,
+				long sessionIP, short sessionPort
+================
+*/
+void sdAuthServer::HandlePresence( connection_t& conn, const byte* payload, int length ) {
+	stats.presenceUpdates++;
+
+	sdMsgReader msg( payload + 2, length - 2 );
+	u32 high = msg.ReadLong();
+	u32 low = msg.ReadLong();
+	int state = msg.ReadByte();
+	u32 ip = msg.ReadLong();
+	u16 port = ( u16 )msg.ReadShort();
+	const u64 client = ( ( u64 )high << 32 ) | low;
+	if ( msg.IsOverflowed() || client == 0 || state < 0 || state >= sdPresence::OS_NUM_STATES ) {
+		stats.protocolErrors++;
+		return;
+	}
+
+	const int index = ( int )( &conn - connections );
+	const int now = Sys_Milliseconds();
+	if ( conn.client != client ) {
+		if ( conn.client != 0 && presenceConnections.Find( conn.client ) == index ) {
+			presenceConnections.Remove( conn.client );
+			presence.Disconnect( conn.client, now );
+		}
+		conn.client = client;
+		presenceConnections.Set( client, index );
+	}
+
+	sdPresence::presence_t update;
+	update.state = ( byte )state;
+	update.session = ( ip != 0 || port != 0 ) ? Msr_PackAddress( ip, port ) : 0;
+	presence.SetPresence( client, update, now );
+}
+
+/*
+================
+sdAuthServer::HandleSubscribe
+
+AUTH_MSG_SUBSCRIBE adds friends, AUTH_MSG_UNSUBSCRIBE removes them; a long
+friends list is sent as several frames. Needs an AUTH_MSG_PRESENCE first,
+the current presence of new friends arrives with the next batch
+
+	payload:	byte 0, byte AUTH_MSG_SUBSCRIBE or AUTH_MSG_UNSUBSCRIBE, byte count,
+				count * ( long clientId[ 0 ], long clientId[ 1 ] )
+================
+*/
+void sdAuthServer::HandleSubscribe( connection_t& conn, const byte* payload, int length ) {
+	stats.subscribes++;
+
+	sdMsgReader msg( payload + 2, length - 2 );
+	int count = msg.ReadByte();
+	if ( msg.IsOverflowed() || conn.client == 0 ) {
+		stats.protocolErrors++;
+		return;
+	}
+
+	const int now = Sys_Milliseconds();
+	for ( int i = 0; i < count; i++ ) {
+		u32 high = msg.ReadLong();
+		u32 low = msg.ReadLong();
+		if ( msg.IsOverflowed() ) {
+			stats.protocolErrors++;
+			return;
+		}
+		const u64 friendClient = ( ( u64 )high << 32 ) | low;
+		if ( payload[ 1 ] == AUTH_MSG_UNSUBSCRIBE ) {
+			presence.Unsubscribe( conn.client, friendClient );
+		} else if ( !presence.Subscribe( conn.client, friendClient, now ) ) {
+			stats.protocolErrors++;
+			return;
+		}
+	}
+}
+
+/*
+================
+sdAuthServer::DeliverPresence
+
+one batch of sdPresence, split into frames of MAX_PRESENCE_BATCH
+
+	frame:		byte 0, byte AUTH_MSG_PRESENCEUPDATE, byte count,
+				count * ( long clientId[ 0 ], long clientId[ 1 ], byte state, long sessionIP, short sessionPort )
+================
+*/
+void sdAuthServer::DeliverPresence( u64 recipient, const sdPresence::change_t* changes, int numChanges ) {
+	const int index = presenceConnections.Find( recipient );
+	if ( index == sdAddressHash::INVALID_INDEX ) {
+		return;
+	}
+	connection_t& conn = connections[ index ];
+
+	for ( int first = 0; first < numChanges && conn.fd >= 0; first += MAX_PRESENCE_BATCH ) {
+		const int count = numChanges - first < MAX_PRESENCE_BATCH ? numChanges - first : MAX_PRESENCE_BATCH;
+
+		byte frame[ FRAME_HEADER_SIZE + MAX_FRAME_SIZE ];
+		sdMsgWriter msg( frame, sizeof( frame ) );
+		msg.WriteLong( 0 );		// length, filled in below
+		msg.WriteByte( 0 );
+		msg.WriteByte( AUTH_MSG_PRESENCEUPDATE );
+		msg.WriteByte( count );
+		for ( int i = first; i < first + count; i++ ) {
+			const sdPresence::change_t& change = changes[ i ];
+			u32 ip = Msr_AddressIP( change.presence.session );
+			u16 port = Msr_AddressPort( change.presence.session );
+			msg.WriteLong( ( u32 )( change.client >> 32 ) );
+			msg.WriteLong( ( u32 )change.client );
+			msg.WriteByte( change.presence.state );
+			msg.WriteData( &ip, 4 );
+			msg.WriteData( &port, 2 );
+		}
+
+		const int frameLength = msg.GetLength();
+		sdMsgWriter header( frame, FRAME_HEADER_SIZE );
+		header.WriteLong( frameLength - FRAME_HEADER_SIZE );
+		if ( log.IsActive() ) {
+			log.Push( sdLogQueue::LD_OUT, conn.addr, conn.port, frame + FRAME_HEADER_SIZE, frameLength - FRAME_HEADER_SIZE );
+		}
+		Send( conn, frame, frameLength );
+	}
+}
+
+/*
+================
+sdAuthServer::PrintStats
+================
+*/
+void sdAuthServer::PrintStats( void ) const {
+	Msr_Printf( "- connections %d, accepted %llu, refused %llu, closed %llu, timed out %llu, protocol errors %llu, send overflows %llu\n",
+		numConnections, ( unsigned long long )stats.accepted, ( unsigned long long )stats.refused,
+		( unsigned long long )stats.closed, ( unsigned long long )stats.timedOut,
+		( unsigned long long )stats.protocolErrors, ( unsigned long long )stats.sendOverflows );
+	Msr_Printf( "- bytes in %llu out %llu, frames %llu: keep alive %llu, login %llu, createAccount %llu, unknown %llu\n",
+		( unsigned long long )stats.bytesIn, ( unsigned long long )stats.bytesOut, ( unsigned long long )stats.frames,
+		( unsigned long long )stats.keepAlives, ( unsigned long long )stats.logins,
+		( unsigned long long )stats.createAccounts, ( unsigned long long )stats.unknown );
+	if ( presence.Num() > 0 ) {
+		const sdPresence::stats_t& p = presence.GetStats();
+		Msr_Printf( "- presence %llu, subscribe %llu, clients %d: changes %llu, queued %llu, coalesced %llu, unchanged %llu, delivered %llu in %llu batches\n",
+			( unsigned long long )stats.presenceUpdates, ( unsigned long long )stats.subscribes, presence.Num(),
+			( unsigned long long )p.updates, ( unsigned long long )p.queued, ( unsigned long long )p.coalesced,
+			( unsigned long long )p.unchanged, ( unsigned long long )p.delivered, ( unsigned long long )p.batches );
+	}
+	if ( config.statsDirectory[ 0 ] == '\0' ) {
+		return;
+	}
+	Msr_Printf( "- writeStats %llu, stat records %llu, dropped %llu, leaderboard queries %llu\n",
+		( unsigned long long )stats.writeStats, ( unsigned long long )stats.statRecords, ( unsigned long long )statsStore.GetNumDropped(),
+		( unsigned long long )stats.leaderboards );
+	if ( !statsStore.IsOpen() ) {
+		const sdStatsStore::stats_t& store = statsStore.GetStats();
+		Msr_Printf( "- committed %llu records in %llu groups, %llu bytes, %.1f msec average sync\n",
+			( unsigned long long )store.records, ( unsigned long long )store.groups, ( unsigned long long )store.bytes,
+			store.groups != 0 ? store.syncMicroseconds / 1000.0 / store.groups : 0.0 );
+	}
+}
@@ -0,0 +1,185 @@
+
+#ifndef __MSR_AUTHSERVER_H__
+#define __MSR_AUTHSERVER_H__
+
+#include "Common.h"
+#include "Log.h"
+#include "Presence.h"
+#include "StatsStore.h"
+#include "TimerWheel.h"
+
+#include <atomic>
+
+/*
+===============================================================================
+
+	sdAuthServer
+
+	TCP listener for the login and account creation exchanges the game sends
+	to port 3074 (collected_packet_data.txt), in place of packet_testing.js.
+
+	Frames are a little endian u32 payload length followed by the payload; a
+	zero length frame is a keep alive. The second payload byte selects the
+	message, the rest is encrypted and not understood yet, so the handlers
+	only account for what arrives.
+
+	The stats uploads of sdNetStatsManager travel inside the same encrypted
+	stream. Until that is understood, servers (or msr_replay) can send them
+	in the clear as AUTH_MSG_WRITESTATS; with -stats <dir> they are handed
+	to an sdStatsStore, whose writer thread does all the disk work, and
+	AUTH_MSG_LEADERBOARD reads a player's rank and a page of any stat key.
+
+	Friend presence works the same way for now: a connection that sends
+	AUTH_MSG_PRESENCE speaks for that client, AUTH_MSG_SUBSCRIBE lists the
+	friends it wants to hear about, and sdPresence sends it coalesced
+	AUTH_MSG_PRESENCEUPDATE batches when they change. Closing the
+	connection takes the client offline. The reactor wakes up for the next
+	batch that is due instead of waiting for the tick.
+
+	One non-blocking epoll loop serves every connection. Connections come
+	from a pool allocated at start up and each owns a fixed receive buffer:
+	frames are parsed in place, handed to the handlers as pointers into that
+	buffer, and only the bytes of an incomplete frame are moved to the front
+	after each read. Any number of pipelined frames per read is fine, a frame
+	longer than MAX_FRAME_SIZE closes the connection. Replies that the socket
+	can't take right away go to a send buffer of the same fixed size that is
+	only allocated while it is in use. Idle connections are closed from a
+	timer wheel.
+
+===============================================================================
+*/
+
+class sdAuthServer {
+public:
+	static const int			AUTH_PORT				= 3074;
+	static const int			MAX_FRAME_SIZE			= 1024;		// payload, the captured frames are at most 116
+	static const int			FRAME_HEADER_SIZE		= 4;
+	static const int			RECV_BUFFER_SIZE		= 2048;		// fits a full frame, so parsing always progresses
+	static const int			SEND_BUFFER_SIZE		= 2048;
+	static const int			MAX_EVENTS				= 64;
+	static const int			TICK_MSEC				= 1000;
+	static const int			STATS_INTERVAL			= 10 * 1000;
+	static const int			MAX_LEADERBOARD_PAGE	= 64;		// entries per reply, keeps it in one frame
+	static const int			MAX_PRESENCE_BATCH		= 64;		// entries per AUTH_MSG_PRESENCEUPDATE frame
+
+	// payload[ 1 ] of the captured frames, payload[ 0 ] is always 0
+	enum authMessage_e {
+		AUTH_MSG_CREATEACCOUNT	= 0x00,
+		AUTH_MSG_LOGIN			= 0x0a,
+		AUTH_MSG_WRITESTATS		= 0x30,		// not in the captures, see HandleWriteStats
+		AUTH_MSG_LEADERBOARD	= 0x31,		// not in the captures, see HandleLeaderboard
+		AUTH_MSG_PRESENCE		= 0x32,		// not in the captures, see HandlePresence
+		AUTH_MSG_SUBSCRIBE		= 0x33,		// not in the captures, see HandleSubscribe
+		AUTH_MSG_UNSUBSCRIBE	= 0x34,
+		AUTH_MSG_PRESENCEUPDATE	= 0x35,		// sent only, see DeliverPresence
+	};
+
+	struct config_t {
+								config_t( void ) : port( AUTH_PORT ), maxConnections( 16384 ), idleTimeout( 800 ), verbosity( 0 ), statsDirectory( "" ) {}
+
+		u16						port;
+		int						maxConnections;
+		int						idleTimeout;			// seconds, the same as packet_testing.js
+		int						verbosity;
+		const char*				statsDirectory;			// stats uploads are stored when set
+	};
+
+	struct stats_t {
+		u64						accepted;
+		u64						refused;				// the pool was full
+		u64						closed;
+		u64						timedOut;
+		u64						protocolErrors;
+		u64						sendOverflows;			// the peer stopped reading replies
+		u64						bytesIn;
+		u64						bytesOut;
+		u64						frames;
+		u64						keepAlives;
+		u64						logins;
+		u64						createAccounts;
+		u64						writeStats;
+		u64						statRecords;			// handed to the stats store
+		u64						leaderboards;
+		u64						presenceUpdates;
+		u64						subscribes;
+		u64						unknown;
+	};
+
+								sdAuthServer( void );
+								~sdAuthServer( void );
+
+	bool						Init( const config_t& config );
+	void						Shutdown( void );
+
+								// runs the reactor until Stop is called
+	void						Run( void );
+								// safe to call from a signal handler or another thread
+	void						Stop( void );
+
+	void						PrintStats( void ) const;
+
+private:
+	struct connection_t {
+		int						fd;
+		u32						generation;				// tells events of a closed connection from its successor
+		u32						addr;					// network byte order
+		u16						port;
+		u64						client;					// set by AUTH_MSG_PRESENCE, 0 before
+		int						timer;
+		int						recvLength;
+		int						sendLength;
+		byte*					sendBuffer;				// NULL while nothing is queued
+		byte					recvBuffer[ RECV_BUFFER_SIZE ];
+		int						nextFree;
+	};
+
+	struct messageHandlerDef_t {
+		int						type;
+		void					( sdAuthServer::*handler )( connection_t& conn, const byte* payload, int length );
+	};
+
+	static const messageHandlerDef_t messageHandlers[];
+
+	static u64					ConnectionKey( int index, u32 generation ) { return ( ( u64 )generation << 32 ) | ( u32 )index; }
+
+	void						AcceptConnections( void );
+	void						CloseConnection( connection_t& conn );
+	void						ReadConnection( connection_t& conn );
+	void						WriteConnection( connection_t& conn );
+	bool						ParseFrames( connection_t& conn );
+	void						ProcessFrame( connection_t& conn, const byte* payload, int length );
+	bool						Send( connection_t& conn, const byte* data, int length );
+	void						OnTick( void );
+	void						DeliverPresence( u64 recipient, const sdPresence::change_t* changes, int numChanges );
+
+	void						HandleLogin( connection_t& conn, const byte* payload, int length );
+	void						HandleCreateAccount( connection_t& conn, const byte* payload, int length );
+	void						HandleWriteStats( connection_t& conn, const byte* payload, int length );
+	void						HandleLeaderboard( connection_t& conn, const byte* payload, int length );
+	void						HandlePresence( connection_t& conn, const byte* payload, int length );
+	void						HandleSubscribe( connection_t& conn, const byte* payload, int length );
+
+	config_t					config;
+	std::atomic< bool >			running;
+
+	int							listenFd;
+	int							epollFd;
+	int							timerFd;
+	int							wakeFd;
+
+	connection_t*				connections;
+	int							freeList;
+	int							numConnections;
+
+	sdTimerWheel				idleTimers;
+	int							nextStatsTime;
+
+	stats_t						stats;
+	sdLogQueue					log;
+	sdStatsStore				statsStore;
+
+	sdPresence					presence;
+	sdAddressHash				presenceConnections;	// client id to the connection that speaks for it
+};
+
+#endif /* !__MSR_AUTHSERVER_H__ */
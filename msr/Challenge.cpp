@@ -0,0 +1,95 @@
+
+#include "Challenge.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#define SIP_ROTL( x, b )	( ( ( x ) << ( b ) ) | ( ( x ) >> ( 64 - ( b ) ) ) )
+
+#define SIP_ROUND( v0, v1, v2, v3 )												\
+	do {																		\
+		v0 += v1; v1 = SIP_ROTL( v1, 13 ); v1 ^= v0; v0 = SIP_ROTL( v0, 32 );	\
+		v2 += v3; v3 = SIP_ROTL( v3, 16 ); v3 ^= v2;							\
+		v0 += v3; v3 = SIP_ROTL( v3, 21 ); v3 ^= v0;							\
+		v2 += v1; v1 = SIP_ROTL( v1, 17 ); v1 ^= v2; v2 = SIP_ROTL( v2, 32 );	\
+	} while ( 0 )
+
+/*
+================
+sdChallengeGenerator::Init
+================
+*/
+void sdChallengeGenerator::Init( void ) {
+	int fd = open( "/dev/urandom", O_RDONLY );
+	if ( fd >= 0 ) {
+		ssize_t num = read( fd, key, sizeof( key ) );
+		close( fd );
+		if ( num == ( ssize_t )sizeof( key ) ) {
+			return;
+		}
+	}
+
+	Msr_Warning( "couldn't read /dev/urandom, challenges are predictable" );
+	key[ 0 ] = ( u64 )time( NULL ) * 0x9e3779b97f4a7c15ULL;
+	key[ 1 ] = ( ( u64 )getpid() << 32 ) ^ Sys_Microseconds();
+}
+
+/*
+================
+sdChallengeGenerator::Hash
+
+SipHash-2-4 of the two words address and epoch
+================
+*/
+u32 sdChallengeGenerator::Hash( u64 address, u32 epoch ) const {
+	u64 v0 = key[ 0 ] ^ 0x736f6d6570736575ULL;
+	u64 v1 = key[ 1 ] ^ 0x646f72616e646f6dULL;
+	u64 v2 = key[ 0 ] ^ 0x6c7967656e657261ULL;
+	u64 v3 = key[ 1 ] ^ 0x7465646279746573ULL;
+
+	const u64 words[ 2 ] = { address, epoch };
+	for ( int i = 0; i < 2; i++ ) {
+		v3 ^= words[ i ];
+		SIP_ROUND( v0, v1, v2, v3 );
+		SIP_ROUND( v0, v1, v2, v3 );
+		v0 ^= words[ i ];
+	}
+
+	// length in the top byte, no tail
+	const u64 last = ( u64 )16 << 56;
+	v3 ^= last;
+	SIP_ROUND( v0, v1, v2, v3 );
+	SIP_ROUND( v0, v1, v2, v3 );
+	v0 ^= last;
+
+	v2 ^= 0xff;
+	SIP_ROUND( v0, v1, v2, v3 );
+	SIP_ROUND( v0, v1, v2, v3 );
+	SIP_ROUND( v0, v1, v2, v3 );
+	SIP_ROUND( v0, v1, v2, v3 );
+
+	u64 hash = v0 ^ v1 ^ v2 ^ v3;
+	return ( u32 )( hash ^ ( hash >> 32 ) );
+}
+
+/*
+================
+sdChallengeGenerator::Generate
+================
+*/
+u32 sdChallengeGenerator::Generate( u64 address, u32 epoch ) const {
+	return ( Hash( address, epoch ) & ~1u ) | ( epoch & 1 );
+}
+
+/*
+================
+sdChallengeGenerator::Validate
+
+bit 0 tells the current epoch from the previous one, anything older fails
+the hash
+================
+*/
+bool sdChallengeGenerator::Validate( u64 address, u32 challenge, u32 epoch ) const {
+	u32 issued = ( ( challenge ^ epoch ) & 1 ) != 0 ? epoch - 1 : epoch;
+	return Generate( address, issued ) == challenge;
+}
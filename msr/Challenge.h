@@ -0,0 +1,47 @@
+
+#ifndef __MSR_CHALLENGE_H__
+#define __MSR_CHALLENGE_H__
+
+#include "Common.h"
+
+/*
+===============================================================================
+
+	sdChallengeGenerator
+
+	Stateless challenges for the challenge / connect handshake, the same idea
+	as SYN cookies. Instead of remembering what was handed to every client,
+	the challenge is a keyed hash (SipHash-2-4) of the client's address and
+	the current EPOCH_MSEC epoch; bit 0 carries the low bit of the epoch, so
+	a challenge can be checked against the epoch it was issued in without
+	storing anything. Challenges of the current and the previous epoch are
+	accepted, one lives for EPOCH_MSEC to 2 * EPOCH_MSEC.
+
+	The key is drawn once at start up and only read afterwards, so every
+	worker can issue and check challenges without sharing anything else.
+
+===============================================================================
+*/
+
+class sdChallengeGenerator {
+public:
+	static const int		EPOCH_MSEC			= 10 * 1000;		// the client gives up on a connect after 10 seconds
+
+							sdChallengeGenerator( void ) { key[ 0 ] = key[ 1 ] = 0; }
+
+							// draws a new key, every challenge issued before is invalid
+	void					Init( void );
+
+							// address is the packed ip and port of the client, see Msr_PackAddress
+	u32						Generate( u64 address, u32 epoch ) const;
+	bool					Validate( u64 address, u32 challenge, u32 epoch ) const;
+
+	static u32				CurrentEpoch( void ) { return ( u32 )( Sys_Microseconds() / ( EPOCH_MSEC * 1000ULL ) ); }
+
+private:
+	u32						Hash( u64 address, u32 epoch ) const;
+
+	u64						key[ 2 ];
+};
+
+#endif /* !__MSR_CHALLENGE_H__ */
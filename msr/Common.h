@@ -0,0 +1,83 @@
+
+#ifndef __MSR_COMMON_H__
+#define __MSR_COMMON_H__
+
+/*
+===============================================================================
+
+	Shared definitions for the native etqw-msr service stand-ins.
+
+	These daemons are built outside of the game tree, so they only depend on
+	libc, POSIX and the C++ runtime; nothing here may pull in idLib.
+
+===============================================================================
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef uint8_t		byte;
+typedef uint8_t		u8;
+typedef uint16_t	u16;
+typedef uint32_t	u32;
+typedef uint64_t	u64;
+
+const int BUFFSZ					= 32768;	// max used by ETQW
+const int MASTER_PORT				= 27733;
+
+const int OOB_MAGIC					= 0xffff;	// every connectionless packet starts with ff ff
+const int OOB_HEADER_SIZE			= 2;
+
+// the retail protocol; the demo uses 19 / 12
+const int PROTOCOL_MINOR			= 21;
+const int PROTOCOL_MAJOR			= 10;
+
+/*
+================
+Msr_PackAddress
+
+ip and port are kept in network byte order, key 0 is never a valid address
+================
+*/
+inline u64 Msr_PackAddress( u32 ip, u16 port ) {
+	return ( ( u64 )ip << 16 ) | port;
+}
+
+inline u32 Msr_AddressIP( u64 address ) {
+	return ( u32 )( address >> 16 );
+}
+
+inline u16 Msr_AddressPort( u64 address ) {
+	return ( u16 )address;
+}
+
+/*
+================
+Sys_Microseconds
+================
+*/
+inline u64 Sys_Microseconds( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ( u64 )ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+================
+Sys_Milliseconds
+================
+*/
+inline int Sys_Milliseconds( void ) {
+	static const u64 base = Sys_Microseconds();
+	return ( int )( ( Sys_Microseconds() - base ) / 1000 );
+}
+
+void	Msr_Printf( const char* fmt, ... );
+void	Msr_Warning( const char* fmt, ... );
+void	Msr_Error( const char* fmt, ... );
+
+#endif /* !__MSR_COMMON_H__ */
@@ -0,0 +1,79 @@
+
+#include "Epoch.h"
+
+/*
+================
+sdEpochManager::Init
+================
+*/
+void sdEpochManager::Init( int numThreads ) {
+	delete[] threadEpochs;
+
+	this->numThreads = numThreads;
+	threadEpochs = new threadEpoch_t[ numThreads ];
+	for ( int i = 0; i < numThreads; i++ ) {
+		threadEpochs[ i ].value.store( OFFLINE );
+	}
+	retired.assign( numThreads, std::vector< retired_t >() );
+}
+
+/*
+================
+sdEpochManager::Retire
+================
+*/
+void sdEpochManager::Retire( int thread, void* object, deleter_t deleter ) {
+	if ( object == NULL ) {
+		return;
+	}
+
+	retired_t r;
+	r.object = object;
+	r.deleter = deleter;
+	r.epoch = globalEpoch.fetch_add( 1 ) + 1;
+	retired[ thread ].push_back( r );
+}
+
+/*
+================
+sdEpochManager::Collect
+================
+*/
+void sdEpochManager::Collect( int thread ) {
+	std::vector< retired_t >& list = retired[ thread ];
+	if ( list.empty() ) {
+		return;
+	}
+
+	u64 safe = MinEpoch();
+
+	size_t kept = 0;
+	for ( size_t i = 0; i < list.size(); i++ ) {
+		if ( list[ i ].epoch <= safe ) {
+			list[ i ].deleter( list[ i ].object );
+		} else {
+			list[ kept++ ] = list[ i ];
+		}
+	}
+	list.resize( kept );
+}
+
+/*
+================
+sdEpochManager::MinEpoch
+================
+*/
+u64 sdEpochManager::MinEpoch( void ) const {
+	u64 minEpoch = OFFLINE;
+	for ( int i = 0; i < numThreads; i++ ) {
+		u64 epoch = threadEpochs[ i ].value.load();
+		if ( epoch < minEpoch ) {
+			minEpoch = epoch;
+		}
+	}
+	if ( minEpoch == OFFLINE ) {
+		// nobody is online, everything retired so far is unreachable
+		return globalEpoch.load();
+	}
+	return minEpoch;
+}
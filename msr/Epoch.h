@@ -0,0 +1,68 @@
+
+#ifndef __MSR_EPOCH_H__
+#define __MSR_EPOCH_H__
+
+#include "Common.h"
+
+#include <atomic>
+#include <vector>
+
+/*
+===============================================================================
+
+	sdEpochManager
+
+	Quiescent state based reclamation for data that one worker publishes and
+	every worker reads without taking a lock (the per shard session snapshots).
+
+	A worker is online while it may hold pointers to published data and
+	offline while it is blocked in epoll_wait. Retired objects are deleted by
+	the thread that retired them once every online worker has passed through
+	a quiescent point after the object was unpublished.
+
+===============================================================================
+*/
+
+class sdEpochManager {
+public:
+	typedef void			( *deleter_t )( void* object );
+
+							sdEpochManager( void ) : globalEpoch( 1 ), threadEpochs( NULL ), numThreads( 0 ) {}
+							~sdEpochManager( void ) { delete[] threadEpochs; }
+
+	void					Init( int numThreads );
+
+							// call before reading any published pointer after a wait
+	void					Online( int thread ) { threadEpochs[ thread ].value.store( globalEpoch.load() ); }
+							// call before blocking, no published pointers may be held afterwards
+	void					Offline( int thread ) { threadEpochs[ thread ].value.store( OFFLINE ); }
+							// call between events, no published pointers may be held across it
+	void					Quiescent( int thread ) { Online( thread ); }
+
+							// the object must already be unreachable for new readers
+	void					Retire( int thread, void* object, deleter_t deleter );
+	void					Collect( int thread );
+
+private:
+	static const u64		OFFLINE = ~0ULL;
+
+	struct retired_t {
+		void*				object;
+		deleter_t			deleter;
+		u64					epoch;
+	};
+
+	struct threadEpoch_t {
+		std::atomic< u64 >	value;
+		char				pad[ 64 - sizeof( std::atomic< u64 > ) ];	// keep every worker on its own cache line
+	};
+
+	u64						MinEpoch( void ) const;
+
+	std::atomic< u64 >		globalEpoch;
+	threadEpoch_t*			threadEpochs;
+	std::vector< std::vector< retired_t > >	retired;
+	int						numThreads;
+};
+
+#endif /* !__MSR_EPOCH_H__ */
@@ -0,0 +1,261 @@
+
+#include "InterestCounters.h"
+#include "AddressHash.h"
+
+/*
+================
+sdInterestCounters::sdInterestCounters
+================
+*/
+sdInterestCounters::sdInterestCounters( void ) {
+	servers = new serverEntry_t[ SERVER_TABLE_SIZE ];
+	for ( int i = 0; i < SERVER_TABLE_SIZE; i++ ) {
+		servers[ i ].server.store( 0, std::memory_order_relaxed );
+		for ( int j = 0; j < NUM_BUCKETS; j++ ) {
+			servers[ i ].buckets[ j ].store( 0, std::memory_order_relaxed );
+		}
+	}
+
+	pairs = new pairEntry_t[ PAIR_TABLE_SIZE ];
+	swapPairs = new pairEntry_t[ PAIR_TABLE_SIZE ];
+	memset( pairs, 0, sizeof( pairEntry_t ) * PAIR_TABLE_SIZE );
+}
+
+/*
+================
+sdInterestCounters::~sdInterestCounters
+================
+*/
+sdInterestCounters::~sdInterestCounters( void ) {
+	delete[] servers;
+	delete[] pairs;
+	delete[] swapPairs;
+}
+
+/*
+================
+sdInterestCounters::Hash
+================
+*/
+u32 sdInterestCounters::Hash( u64 server, u64 client ) {
+	return sdAddressHash::Hash( server ^ ( client * 0x9e3779b97f4a7c15ULL ) );
+}
+
+/*
+================
+sdInterestCounters::IsStale
+
+nothing in the window, the entry can be given to another server
+================
+*/
+bool sdInterestCounters::IsStale( const serverEntry_t& entry, u32 epoch ) const {
+	for ( int i = 0; i < NUM_BUCKETS; i++ ) {
+		u64 bucket = entry.buckets[ i ].load( std::memory_order_relaxed );
+		if ( ( u32 )bucket != 0 && InWindow( ( u32 )( bucket >> 32 ), epoch ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+================
+sdInterestCounters::AddCount
+
+a bucket still holding an older epoch starts over at zero
+================
+*/
+void sdInterestCounters::AddCount( serverEntry_t& entry, u32 epoch, int delta ) {
+	std::atomic< u64 >& bucket = entry.buckets[ epoch % NUM_BUCKETS ];
+	u64 value = bucket.load( std::memory_order_relaxed );
+	if ( ( u32 )( value >> 32 ) != epoch ) {
+		if ( delta < 0 ) {
+			return;
+		}
+		value = ( u64 )epoch << 32;
+	}
+	value = ( value & 0xffffffff00000000ULL ) | ( u32 )( ( u32 )value + delta );
+	bucket.store( value, std::memory_order_release );
+}
+
+/*
+================
+sdInterestCounters::FindServer
+
+the entry of server, or a free or stale one claimed for it
+================
+*/
+sdInterestCounters::serverEntry_t* sdInterestCounters::FindServer( u64 server, u32 epoch ) {
+	const u32 home = sdAddressHash::Hash( server );
+	serverEntry_t* reuse = NULL;
+
+	for ( int i = 0; i < MAX_PROBES; i++ ) {
+		serverEntry_t* entry = &servers[ ( home + i ) & ( SERVER_TABLE_SIZE - 1 ) ];
+		u64 key = entry->server.load( std::memory_order_relaxed );
+		if ( key == server ) {
+			return entry;
+		}
+		if ( key == 0 ) {
+			if ( reuse == NULL ) {
+				reuse = entry;
+			}
+			break;
+		}
+		if ( reuse == NULL && IsStale( *entry, epoch ) ) {
+			reuse = entry;
+		}
+	}
+	if ( reuse == NULL ) {
+		return NULL;
+	}
+
+	// readers already ignore the old buckets, they are cleared before the key changes
+	for ( int i = 0; i < NUM_BUCKETS; i++ ) {
+		reuse->buckets[ i ].store( 0, std::memory_order_relaxed );
+	}
+	reuse->server.store( server, std::memory_order_release );
+	return reuse;
+}
+
+/*
+================
+sdInterestCounters::FindPair
+
+the entry of the pair, or a free or stale one it can be stored in
+================
+*/
+sdInterestCounters::pairEntry_t* sdInterestCounters::FindPair( u64 server, u64 client, u32 epoch ) {
+	const u32 home = Hash( server, client );
+	pairEntry_t* reuse = NULL;
+
+	for ( int i = 0; i < MAX_PROBES; i++ ) {
+		pairEntry_t* entry = &pairs[ ( home + i ) & ( PAIR_TABLE_SIZE - 1 ) ];
+		if ( entry->server == server && entry->client == client ) {
+			return entry;
+		}
+		if ( entry->server == 0 ) {
+			return reuse != NULL ? reuse : entry;
+		}
+		if ( reuse == NULL && !InWindow( entry->epoch, epoch ) ) {
+			reuse = entry;
+		}
+	}
+	return reuse;
+}
+
+/*
+================
+sdInterestCounters::Register
+
+moves the client's count to the current bucket, a client seen again within
+the window is never counted twice
+================
+*/
+bool sdInterestCounters::Register( u64 server, u64 client, u32 epoch ) {
+	if ( server == 0 ) {
+		return false;
+	}
+
+	pairEntry_t* pair = FindPair( server, client, epoch );
+	if ( pair == NULL ) {
+		return false;
+	}
+
+	if ( pair->server == server && pair->client == client && InWindow( pair->epoch, epoch ) ) {
+		if ( pair->epoch == epoch ) {
+			return true;
+		}
+		serverEntry_t* entry = FindServer( server, epoch );
+		if ( entry == NULL ) {
+			return false;
+		}
+		AddCount( *entry, pair->epoch, -1 );
+		AddCount( *entry, epoch, 1 );
+		pair->epoch = epoch;
+		return true;
+	}
+
+	serverEntry_t* entry = FindServer( server, epoch );
+	if ( entry == NULL ) {
+		return false;
+	}
+	pair->server = server;
+	pair->client = client;
+	pair->epoch = epoch;
+	AddCount( *entry, epoch, 1 );
+	return true;
+}
+
+/*
+================
+sdInterestCounters::Rotate
+
+rebuilds the pair table without the pairs that left the window, so probe
+chains don't fill up with dead entries
+================
+*/
+void sdInterestCounters::Rotate( u32 epoch ) {
+	memset( swapPairs, 0, sizeof( pairEntry_t ) * PAIR_TABLE_SIZE );
+
+	for ( int i = 0; i < PAIR_TABLE_SIZE; i++ ) {
+		const pairEntry_t& pair = pairs[ i ];
+		if ( pair.server == 0 || !InWindow( pair.epoch, epoch ) ) {
+			continue;
+		}
+
+		const u32 home = Hash( pair.server, pair.client );
+		int j;
+		for ( j = 0; j < MAX_PROBES; j++ ) {
+			pairEntry_t& entry = swapPairs[ ( home + j ) & ( PAIR_TABLE_SIZE - 1 ) ];
+			if ( entry.server == 0 ) {
+				entry = pair;
+				break;
+			}
+		}
+		if ( j == MAX_PROBES ) {
+			// forgetting the pair without its count would count the client twice
+			serverEntry_t* entry = FindServer( pair.server, epoch );
+			if ( entry != NULL ) {
+				AddCount( *entry, pair.epoch, -1 );
+			}
+		}
+	}
+
+	pairEntry_t* swap = pairs;
+	pairs = swapPairs;
+	swapPairs = swap;
+}
+
+/*
+================
+sdInterestCounters::Count
+================
+*/
+int sdInterestCounters::Count( u64 server, u32 epoch ) const {
+	const u32 home = sdAddressHash::Hash( server );
+
+	for ( int i = 0; i < MAX_PROBES; i++ ) {
+		const serverEntry_t& entry = servers[ ( home + i ) & ( SERVER_TABLE_SIZE - 1 ) ];
+		u64 key = entry.server.load( std::memory_order_acquire );
+		if ( key == 0 ) {
+			return 0;
+		}
+		if ( key != server ) {
+			continue;
+		}
+
+		int count = 0;
+		for ( int j = 0; j < NUM_BUCKETS; j++ ) {
+			u64 bucket = entry.buckets[ j ].load( std::memory_order_acquire );
+			if ( InWindow( ( u32 )( bucket >> 32 ), epoch ) ) {
+				count += ( int )( u32 )bucket;
+			}
+		}
+		// the entry was handed to another server while it was read
+		if ( entry.server.load( std::memory_order_acquire ) != server ) {
+			return 0;
+		}
+		return count;
+	}
+	return 0;
+}
@@ -0,0 +1,84 @@
+
+#ifndef __MSR_INTERESTCOUNTERS_H__
+#define __MSR_INTERESTCOUNTERS_H__
+
+#include "Common.h"
+
+#include <atomic>
+
+/*
+===============================================================================
+
+	sdInterestCounters
+
+	Counts the clients that registered interest in a server (the hot server
+	list sends serverInterest for its top three every 10 seconds) over a
+	sliding window of NUM_BUCKETS buckets of BUCKET_MSEC each.
+
+	The interest packet arrives at the worker that owns the client's address,
+	the session it names usually lives in another shard. So every worker has
+	its own counters and only ever writes those, the owner of a session sums
+	the counters of all workers; nothing on the interest path is locked or
+	even contended.
+
+	A client always hashes to the same worker, so de-duplication is local:
+	every (server, client) pair is counted once, in the bucket it was seen
+	in last, and the window sum is the number of distinct clients.
+
+	Both tables have a fixed size and expire lazily, an entry whose buckets
+	all left the window is reused. Interest that finds no free entry within
+	MAX_PROBES is dropped.
+
+===============================================================================
+*/
+
+class sdInterestCounters {
+public:
+	static const int		NUM_BUCKETS			= 6;
+	static const int		BUCKET_MSEC			= 10 * 1000;		// same as the client's interval
+	static const int		SERVER_TABLE_SIZE	= 1 << 16;
+	static const int		PAIR_TABLE_SIZE		= 1 << 17;
+	static const int		MAX_PROBES			= 32;
+
+							sdInterestCounters( void );
+							~sdInterestCounters( void );
+
+							// the same on every thread
+	static u32				CurrentEpoch( void ) { return ( u32 )( Sys_Microseconds() / ( BUCKET_MSEC * 1000ULL ) ); }
+
+							// owning worker only, false if the interest was dropped
+	bool					Register( u64 server, u64 client, u32 epoch );
+							// owning worker only, call once per epoch to drop the expired pairs
+	void					Rotate( u32 epoch );
+
+							// any thread, the distinct clients seen in the window ending at epoch
+	int						Count( u64 server, u32 epoch ) const;
+
+private:
+	struct serverEntry_t {
+		std::atomic< u64 >	server;
+		std::atomic< u64 >	buckets[ NUM_BUCKETS ];		// epoch << 32 | count, indexed by epoch % NUM_BUCKETS
+		u64					pad;
+	};
+
+	struct pairEntry_t {
+		u64					server;
+		u64					client;
+		u32					epoch;						// bucket the pair is counted in
+	};
+
+	static bool				InWindow( u32 bucketEpoch, u32 epoch ) { return epoch - bucketEpoch < ( u32 )NUM_BUCKETS; }
+	static u32				Hash( u64 server, u64 client );
+
+	serverEntry_t*			FindServer( u64 server, u32 epoch );
+	bool					IsStale( const serverEntry_t& entry, u32 epoch ) const;
+	void					AddCount( serverEntry_t& entry, u32 epoch, int delta );
+
+	pairEntry_t*			FindPair( u64 server, u64 client, u32 epoch );
+
+	serverEntry_t*			servers;					// read by every worker
+	pairEntry_t*			pairs;						// private to the owning worker
+	pairEntry_t*			swapPairs;					// Rotate rebuilds into this one
+};
+
+#endif /* !__MSR_INTERESTCOUNTERS_H__ */
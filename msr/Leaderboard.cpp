@@ -0,0 +1,277 @@
+
+#include "Leaderboard.h"
+#include "StatsStore.h"
+
+/*
+================
+sdLeaderboard::sdLeaderboard
+================
+*/
+sdLeaderboard::sdLeaderboard( int type ) :
+	type( type ),
+	root( -1 ),
+	seed( 0x9e3779b9 ) {
+}
+
+/*
+================
+sdLeaderboard::OrderKey
+
+maps the raw bits to an unsigned key that sorts like the int or float
+================
+*/
+u32 sdLeaderboard::OrderKey( u32 value ) const {
+	if ( type == sdStatsStore::SVT_FLOAT || type == sdStatsStore::SVT_FLOAT_MAX ) {
+		return ( value & 0x80000000 ) != 0 ? ~value : value | 0x80000000;
+	}
+	return value ^ 0x80000000;
+}
+
+/*
+================
+sdLeaderboard::Before
+================
+*/
+bool sdLeaderboard::Before( int a, int b ) const {
+	const u32 keyA = OrderKey( nodes[ a ].value );
+	const u32 keyB = OrderKey( nodes[ b ].value );
+	if ( keyA != keyB ) {
+		return keyA > keyB;
+	}
+	return nodes[ a ].client < nodes[ b ].client;
+}
+
+/*
+================
+sdLeaderboard::Split
+
+nodes of tree that rank above node go to before, the rest to after
+================
+*/
+void sdLeaderboard::Split( int tree, int node, int& before, int& after ) {
+	if ( tree < 0 ) {
+		before = after = -1;
+		return;
+	}
+	if ( Before( tree, node ) ) {
+		Split( nodes[ tree ].right, node, nodes[ tree ].right, after );
+		before = tree;
+	} else {
+		Split( nodes[ tree ].left, node, before, nodes[ tree ].left );
+		after = tree;
+	}
+	Fix( tree );
+}
+
+/*
+================
+sdLeaderboard::Merge
+
+every node of a ranks above every node of b
+================
+*/
+int sdLeaderboard::Merge( int a, int b ) {
+	if ( a < 0 ) {
+		return b;
+	}
+	if ( b < 0 ) {
+		return a;
+	}
+	if ( nodes[ a ].priority > nodes[ b ].priority ) {
+		int right = Merge( nodes[ a ].right, b );
+		nodes[ a ].right = right;
+		Fix( a );
+		return a;
+	}
+	int left = Merge( a, nodes[ b ].left );
+	nodes[ b ].left = left;
+	Fix( b );
+	return b;
+}
+
+/*
+================
+sdLeaderboard::Insert
+================
+*/
+int sdLeaderboard::Insert( int tree, int node ) {
+	if ( tree < 0 ) {
+		return node;
+	}
+	if ( nodes[ node ].priority > nodes[ tree ].priority ) {
+		Split( tree, node, nodes[ node ].left, nodes[ node ].right );
+		Fix( node );
+		return node;
+	}
+	if ( Before( node, tree ) ) {
+		int left = Insert( nodes[ tree ].left, node );
+		nodes[ tree ].left = left;
+	} else {
+		int right = Insert( nodes[ tree ].right, node );
+		nodes[ tree ].right = right;
+	}
+	Fix( tree );
+	return tree;
+}
+
+/*
+================
+sdLeaderboard::Remove
+================
+*/
+int sdLeaderboard::Remove( int tree, int node ) {
+	if ( tree == node ) {
+		int merged = Merge( nodes[ node ].left, nodes[ node ].right );
+		nodes[ node ].left = nodes[ node ].right = -1;
+		nodes[ node ].size = 1;
+		return merged;
+	}
+	if ( Before( node, tree ) ) {
+		int left = Remove( nodes[ tree ].left, node );
+		nodes[ tree ].left = left;
+	} else {
+		int right = Remove( nodes[ tree ].right, node );
+		nodes[ tree ].right = right;
+	}
+	Fix( tree );
+	return tree;
+}
+
+/*
+================
+sdLeaderboard::Add
+================
+*/
+void sdLeaderboard::Add( u64 client, u32 value ) {
+	if ( client == 0 ) {
+		return;
+	}
+
+	int index = clients.Find( client );
+	if ( index == sdAddressHash::INVALID_INDEX ) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+
+		node_t node;
+		node.client = client;
+		node.value = value;
+		node.priority = seed;
+		node.left = node.right = -1;
+		node.size = 1;
+
+		index = ( int )nodes.size();
+		nodes.push_back( node );
+		clients.Set( client, index );
+		root = Insert( root, index );
+		return;
+	}
+
+	const u32 old = nodes[ index ].value;
+	u32 total;
+	switch ( type ) {
+		case sdStatsStore::SVT_INT: {
+			total = ( u32 )( ( int )old + ( int )value );
+			break;
+		}
+		case sdStatsStore::SVT_FLOAT: {
+			float a, b;
+			memcpy( &a, &old, 4 );
+			memcpy( &b, &value, 4 );
+			a += b;
+			memcpy( &total, &a, 4 );
+			break;
+		}
+		default: {
+			total = OrderKey( value ) > OrderKey( old ) ? value : old;
+			break;
+		}
+	}
+	if ( total == old ) {
+		return;
+	}
+
+	root = Remove( root, index );
+	nodes[ index ].value = total;
+	root = Insert( root, index );
+}
+
+/*
+================
+sdLeaderboard::GetRank
+================
+*/
+int sdLeaderboard::GetRank( u64 client ) const {
+	const int index = clients.Find( client );
+	if ( index == sdAddressHash::INVALID_INDEX ) {
+		return INVALID_RANK;
+	}
+
+	int rank = Size( nodes[ index ].left );
+	for ( int tree = root; tree != index; ) {
+		if ( Before( index, tree ) ) {
+			tree = nodes[ tree ].left;
+		} else {
+			rank += Size( nodes[ tree ].left ) + 1;
+			tree = nodes[ tree ].right;
+		}
+	}
+	return rank;
+}
+
+/*
+================
+sdLeaderboard::GetValue
+================
+*/
+bool sdLeaderboard::GetValue( u64 client, u32& value ) const {
+	const int index = clients.Find( client );
+	if ( index == sdAddressHash::INVALID_INDEX ) {
+		return false;
+	}
+	value = nodes[ index ].value;
+	return true;
+}
+
+/*
+================
+sdLeaderboard::Collect
+
+in order, whole subtrees before the range are skipped by their size
+================
+*/
+void sdLeaderboard::Collect( int tree, int& skip, int count, entry_t* entries, int& num ) const {
+	if ( tree < 0 || num == count ) {
+		return;
+	}
+	const node_t& node = nodes[ tree ];
+	if ( skip >= node.size ) {
+		skip -= node.size;
+		return;
+	}
+
+	Collect( node.left, skip, count, entries, num );
+	if ( num == count ) {
+		return;
+	}
+	if ( skip > 0 ) {
+		skip--;
+	} else {
+		entries[ num ].client = node.client;
+		entries[ num ].value = node.value;
+		num++;
+	}
+	Collect( node.right, skip, count, entries, num );
+}
+
+/*
+================
+sdLeaderboard::GetRange
+================
+*/
+int sdLeaderboard::GetRange( int first, int count, entry_t* entries ) const {
+	int skip = first > 0 ? first : 0;
+	int num = 0;
+	Collect( root, skip, count, entries, num );
+	return num;
+}
@@ -0,0 +1,86 @@
+
+#ifndef __MSR_LEADERBOARD_H__
+#define __MSR_LEADERBOARD_H__
+
+#include "Common.h"
+#include "AddressHash.h"
+
+#include <vector>
+
+/*
+===============================================================================
+
+	sdLeaderboard
+
+	Every client's total of one stat key, kept ordered so a client's rank and
+	any page of the board cost O(log n) instead of a sort per query.
+
+	An order statistic treap: every node knows the size of its subtree, the
+	random priorities keep it balanced in expectation without rotations on
+	the read path. Nodes live in one array and link by index; clients are
+	never removed, an update takes the node out, changes the value and puts
+	it back. sdAddressHash finds a client's node (client id 0 is invalid in
+	sdnet as well).
+
+	Rank 0 is the best: highest value first, ties go to the lower client id.
+	Values are the raw int or float bits, the type decides how they order
+	and how an upload is folded into the total (sum, or max for the _MAX
+	types of sdNetStatKeyValue).
+
+===============================================================================
+*/
+
+class sdLeaderboard {
+public:
+	static const int		INVALID_RANK		= -1;
+
+	struct entry_t {
+		u64					client;
+		u32					value;
+	};
+
+							// type is sdStatsStore::valueType_e
+	explicit				sdLeaderboard( int type );
+
+	int						Num( void ) const { return ( int )nodes.size(); }
+	int						GetType( void ) const { return type; }
+
+							// folds one uploaded value into the client's total
+	void					Add( u64 client, u32 value );
+
+							// INVALID_RANK if the client has no value
+	int						GetRank( u64 client ) const;
+	bool					GetValue( u64 client, u32& value ) const;
+							// the entries ranked first to first + count - 1, fewer at the end of the board
+	int						GetRange( int first, int count, entry_t* entries ) const;
+
+private:
+	struct node_t {
+		u64					client;
+		u32					value;
+		u32					priority;
+		int					left;
+		int					right;
+		int					size;
+	};
+
+	u32						OrderKey( u32 value ) const;
+	bool					Before( int a, int b ) const;		// a ranks above b
+	int						Size( int node ) const { return node >= 0 ? nodes[ node ].size : 0; }
+	void					Fix( int node ) { nodes[ node ].size = 1 + Size( nodes[ node ].left ) + Size( nodes[ node ].right ); }
+
+							// the subtree functions return the new root of the subtree
+	void					Split( int tree, int node, int& before, int& after );
+	int						Merge( int a, int b );
+	int						Insert( int tree, int node );
+	int						Remove( int tree, int node );
+	void					Collect( int tree, int& skip, int count, entry_t* entries, int& num ) const;
+
+	int						type;
+	std::vector< node_t >	nodes;
+	int						root;
+	u32						seed;
+	sdAddressHash			clients;
+};
+
+#endif /* !__MSR_LEADERBOARD_H__ */
@@ -0,0 +1,203 @@
+
+#include "Log.h"
+
+#include <stdarg.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+/*
+================
+Msr_Printf
+================
+*/
+void Msr_Printf( const char* fmt, ... ) {
+	va_list args;
+	va_start( args, fmt );
+	vfprintf( stdout, fmt, args );
+	va_end( args );
+}
+
+/*
+================
+Msr_Warning
+================
+*/
+void Msr_Warning( const char* fmt, ... ) {
+	va_list args;
+	fputs( "WARNING: ", stderr );
+	va_start( args, fmt );
+	vfprintf( stderr, fmt, args );
+	va_end( args );
+	fputc( '\n', stderr );
+}
+
+/*
+================
+Msr_Error
+================
+*/
+void Msr_Error( const char* fmt, ... ) {
+	va_list args;
+	fputs( "ERROR: ", stderr );
+	va_start( args, fmt );
+	vfprintf( stderr, fmt, args );
+	va_end( args );
+	fputc( '\n', stderr );
+	exit( 1 );
+}
+
+/*
+================
+Msr_HexDump
+
+same layout as show_dump: 16 bytes per row followed by the printable characters
+================
+*/
+void Msr_HexDump( const byte* data, int length, FILE* out ) {
+	for ( int row = 0; row < length; row += 16 ) {
+		int num = length - row;
+		if ( num > 16 ) {
+			num = 16;
+		}
+		for ( int i = 0; i < 16; i++ ) {
+			if ( i < num ) {
+				fprintf( out, "%02x ", data[ row + i ] );
+			} else {
+				fputs( "   ", out );
+			}
+		}
+		fputs( "  ", out );
+		for ( int i = 0; i < num; i++ ) {
+			byte c = data[ row + i ];
+			fputc( ( c >= 0x20 && c < 0x7f ) ? c : '.', out );
+		}
+		fputc( '\n', out );
+	}
+}
+
+/*
+================
+sdLogQueue::sdLogQueue
+================
+*/
+sdLogQueue::sdLogQueue( void ) :
+	verbosity( 0 ),
+	running( false ),
+	records( NULL ),
+	head( 0 ),
+	tail( 0 ),
+	numDropped( 0 ) {
+}
+
+/*
+================
+sdLogQueue::~sdLogQueue
+================
+*/
+sdLogQueue::~sdLogQueue( void ) {
+	Stop();
+}
+
+/*
+================
+sdLogQueue::Start
+================
+*/
+void sdLogQueue::Start( int verbosity ) {
+	this->verbosity = verbosity;
+	if ( verbosity <= 0 || running.load() ) {
+		return;
+	}
+
+	records = new record_t[ MAX_RECORDS ];
+	head.store( 0 );
+	tail.store( 0 );
+	running.store( true );
+	thread = std::thread( &sdLogQueue::Run, this );
+}
+
+/*
+================
+sdLogQueue::Stop
+================
+*/
+void sdLogQueue::Stop( void ) {
+	if ( !running.exchange( false ) ) {
+		return;
+	}
+	thread.join();
+
+	delete[] records;
+	records = NULL;
+	verbosity = 0;
+}
+
+/*
+================
+sdLogQueue::Push
+================
+*/
+void sdLogQueue::Push( direction_e direction, u32 addr, u16 port, const byte* data, int length ) {
+	if ( verbosity <= 0 ) {
+		return;
+	}
+
+	u32 h = head.load( std::memory_order_relaxed );
+	if ( h - tail.load( std::memory_order_acquire ) >= MAX_RECORDS ) {
+		numDropped.fetch_add( 1, std::memory_order_relaxed );
+		return;
+	}
+
+	record_t& record = records[ h & ( MAX_RECORDS - 1 ) ];
+	record.time = Sys_Microseconds();
+	record.addr = addr;
+	record.port = port;
+	record.direction = ( u8 )direction;
+	record.length = length;
+	memcpy( record.data, data, length < MAX_DUMP_BYTES ? length : MAX_DUMP_BYTES );
+
+	head.store( h + 1, std::memory_order_release );
+}
+
+/*
+================
+sdLogQueue::Run
+================
+*/
+void sdLogQueue::Run( void ) {
+	for ( ;; ) {
+		u32 t = tail.load( std::memory_order_relaxed );
+		u32 h = head.load( std::memory_order_acquire );
+
+		if ( t == h ) {
+			if ( !running.load( std::memory_order_relaxed ) ) {
+				break;
+			}
+			fflush( stdout );
+			usleep( 10000 );
+			continue;
+		}
+
+		for ( ; t != h; t++ ) {
+			Print( records[ t & ( MAX_RECORDS - 1 ) ] );
+		}
+		tail.store( t, std::memory_order_release );
+	}
+	fflush( stdout );
+}
+
+/*
+================
+sdLogQueue::Print
+================
+*/
+void sdLogQueue::Print( const record_t& record ) const {
+	struct in_addr in;
+	in.s_addr = record.addr;
+
+	fprintf( stdout, "  %s %s:%hu (%d bytes)\n", record.direction == LD_IN ? "<-" : "->", inet_ntoa( in ), ntohs( record.port ), record.length );
+	if ( verbosity > 1 ) {
+		Msr_HexDump( record.data, record.length < MAX_DUMP_BYTES ? record.length : MAX_DUMP_BYTES, stdout );
+		fputc( '\n', stdout );
+	}
+}
@@ -0,0 +1,72 @@
+
+#ifndef __MSR_LOG_H__
+#define __MSR_LOG_H__
+
+#include "Common.h"
+
+#include <atomic>
+#include <thread>
+
+/*
+===============================================================================
+
+	sdLogQueue
+
+	Single producer / single consumer ring of fixed size packet records.
+	The network thread only copies a few bytes into the ring; formatting,
+	hex dumps and stdout writes happen on the logger thread. When the ring
+	is full the record is dropped and counted instead of stalling the caller.
+
+===============================================================================
+*/
+
+class sdLogQueue {
+public:
+	static const int			MAX_RECORDS		= 4096;		// must be a power of two
+	static const int			MAX_DUMP_BYTES	= 64;
+
+	enum direction_e {
+		LD_IN,
+		LD_OUT
+	};
+
+	struct record_t {
+		u64						time;
+		u32						addr;			// network byte order
+		u16						port;			// network byte order
+		u8						direction;
+		u8						pad;
+		int						length;
+		byte					data[ MAX_DUMP_BYTES ];
+	};
+
+								sdLogQueue( void );
+								~sdLogQueue( void );
+
+								// 0 = silent, 1 = one line per packet, 2 = hex dumps
+	void						Start( int verbosity );
+	void						Stop( void );
+
+	bool						IsActive( void ) const { return verbosity > 0; }
+
+	void						Push( direction_e direction, u32 addr, u16 port, const byte* data, int length );
+
+	u64							GetNumDropped( void ) const { return numDropped.load( std::memory_order_relaxed ); }
+
+private:
+	void						Run( void );
+	void						Print( const record_t& record ) const;
+
+	int							verbosity;
+	std::atomic< bool >			running;
+	std::thread					thread;
+
+	record_t*					records;
+	std::atomic< u32 >			head;			// written by the producer
+	std::atomic< u32 >			tail;			// written by the consumer
+	std::atomic< u64 >			numDropped;
+};
+
+void	Msr_HexDump( const byte* data, int length, FILE* out );
+
+#endif /* !__MSR_LOG_H__ */
@@ -0,0 +1,343 @@
+
+#include "Common.h"
+#include "Msg.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/*
+===============================================================================
+
+	msr_bench
+
+	Load generator for msr_master. Every thread keeps a window of queries in
+	flight on its own set of sockets; the sockets have distinct source ports
+	so SO_REUSEPORT spreads them over all master workers. Run it against
+	masters started with -threads 1, 2, 4 and 8 to see the scaling.
+
+	Against a loopback master every socket binds its own 127.x.y.z address,
+	the master's per source rate limit would otherwise see a single client.
+	-flood adds sockets that all share one address and send getStatus as
+	fast as they can without waiting for replies, to check that the other
+	clients keep their reply rate while that source is throttled.
+
+===============================================================================
+*/
+
+struct benchConfig_t {
+							benchConfig_t( void ) :
+								host( "127.0.0.1" ),
+								port( MASTER_PORT ),
+								numThreads( 1 ),
+								numSockets( 16 ),
+								window( 32 ),
+								duration( 10 ),
+								numSessions( 0 ),
+								numFloodSockets( 0 ),
+								query( "getStatus" ) {
+							}
+
+	const char*				host;
+	u16						port;
+	int						numThreads;
+	int						numSockets;			// per thread
+	int						window;				// queries in flight per socket
+	int						duration;			// seconds
+	int						numSessions;		// fake sessions to advertise before the run
+	int						numFloodSockets;	// abusive source
+	const char*				query;
+};
+
+// loopback source addresses, in host byte order
+static const u32			SOURCE_QUERIES		= 0x7f020000;		// 127.2.0.0 + socket
+static const u32			SOURCE_FLOOD		= 0x7f030001;		// 127.3.0.1
+static const u32			SOURCE_SESSIONS		= 0x7f100000;		// 127.16.0.0 + session
+
+static benchConfig_t		benchConfig;
+static sockaddr_in			masterAddr;
+static std::atomic< bool >	benchRunning( true );
+static std::atomic< u64 >	numReplies( 0 );
+static std::atomic< u64 >	numSent( 0 );
+static std::atomic< u64 >	numFloodSent( 0 );
+static std::atomic< u64 >	numFloodReplies( 0 );
+
+/*
+================
+Bench_BuildQuery
+================
+*/
+static int Bench_BuildQuery( byte* buffer, int size ) {
+	sdMsgWriter msg( buffer, size );
+	msg.WriteOOBHeader();
+	msg.WriteString( benchConfig.query );
+	if ( !strcmp( benchConfig.query, "getStatus" ) ) {
+		msg.WriteLong( 0xffffffff );
+		msg.WriteLong( 0xffffffff );
+	} else if ( !strcmp( benchConfig.query, "challenge" ) ) {
+		msg.WriteLong( 0x345d09cc );
+		msg.WriteByte( 0 );
+	} else if ( !strcmp( benchConfig.query, "findSessions" ) ) {
+		msg.WriteByte( 2 );		// SS_INTERNET_ALL
+	}
+	return msg.GetLength();
+}
+
+/*
+================
+Bench_OpenSocket
+
+source is only used against a loopback master, anything else sees the one
+address of this host
+================
+*/
+static int Bench_OpenSocket( u32 source ) {
+	int fd = socket( AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, IPPROTO_UDP );
+	if ( fd < 0 ) {
+		Msr_Error( "socket failed (%s)", strerror( errno ) );
+	}
+	int size = 4 * 1024 * 1024;
+	setsockopt( fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof( size ) );
+	if ( ( ntohl( masterAddr.sin_addr.s_addr ) >> 24 ) == 127 ) {
+		sockaddr_in local;
+		memset( &local, 0, sizeof( local ) );
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl( source );
+		if ( bind( fd, ( sockaddr* )&local, sizeof( local ) ) < 0 ) {
+			Msr_Error( "bind failed (%s)", strerror( errno ) );
+		}
+	}
+	if ( connect( fd, ( sockaddr* )&masterAddr, sizeof( masterAddr ) ) < 0 ) {
+		Msr_Error( "connect failed (%s)", strerror( errno ) );
+	}
+	return fd;
+}
+
+/*
+================
+Bench_AdvertiseSessions
+
+every fake session needs its own source address, so each one gets a short lived socket
+================
+*/
+static void Bench_AdvertiseSessions( int num ) {
+	static const char serverInfo[] = "si_name\0bench\0si_map\0maps/valley.entities\0si_maxPlayers\0" "24\0si_rules\0sdGameRulesCampaign\0";
+
+	byte buffer[ 1024 ];
+	for ( int i = 0; i < num; i++ ) {
+		sdMsgWriter msg( buffer, sizeof( buffer ) );
+		msg.WriteOOBHeader();
+		msg.WriteString( "updateSession" );
+		msg.WriteByte( i % 25 );			// numClients
+		msg.WriteByte( i % 3 );				// numBots
+		msg.WriteByte( 0 );					// gameState
+		msg.WriteByte( i % 4 == 0 ? 1 : 0 );	// ranked
+		msg.WriteLong( 20 * 60 * 1000 );	// sessionTime
+		msg.WriteShort( 0 );
+		msg.WriteShort( 0 );
+		msg.WriteData( serverInfo, sizeof( serverInfo ) );
+
+		int fd = Bench_OpenSocket( SOURCE_SESSIONS + i );
+		if ( send( fd, buffer, msg.GetLength(), 0 ) < 0 ) {
+			Msr_Warning( "updateSession send failed (%s)", strerror( errno ) );
+		}
+		close( fd );
+		if ( ( i & 255 ) == 255 ) {
+			usleep( 1000 );		// don't overrun the master's socket buffer
+		}
+	}
+}
+
+/*
+================
+Bench_Thread
+================
+*/
+static void Bench_Thread( int thread ) {
+	std::vector< int > fds;
+	std::vector< pollfd > pfds;
+	std::vector< int > inFlight;
+
+	for ( int i = 0; i < benchConfig.numSockets; i++ ) {
+		int fd = Bench_OpenSocket( SOURCE_QUERIES + thread * benchConfig.numSockets + i );
+		fds.push_back( fd );
+		pollfd p;
+		p.fd = fd;
+		p.events = POLLIN;
+		pfds.push_back( p );
+		inFlight.push_back( 0 );
+	}
+
+	byte query[ 256 ];
+	int queryLength = Bench_BuildQuery( query, sizeof( query ) );
+	byte* reply = new byte[ BUFFSZ ];
+
+	u64 sent = 0;
+	u64 received = 0;
+	while ( benchRunning.load( std::memory_order_relaxed ) ) {
+		for ( size_t i = 0; i < fds.size(); i++ ) {
+			for ( ; inFlight[ i ] < benchConfig.window; inFlight[ i ]++ ) {
+				if ( send( fds[ i ], query, queryLength, 0 ) < 0 ) {
+					break;
+				}
+				sent++;
+			}
+		}
+
+		if ( poll( pfds.data(), pfds.size(), 50 ) <= 0 ) {
+			// replies were lost, refill the windows
+			for ( size_t i = 0; i < fds.size(); i++ ) {
+				inFlight[ i ] = 0;
+			}
+			continue;
+		}
+
+		for ( size_t i = 0; i < fds.size(); i++ ) {
+			if ( ( pfds[ i ].revents & POLLIN ) == 0 ) {
+				continue;
+			}
+			while ( recv( fds[ i ], reply, BUFFSZ, 0 ) > 0 ) {
+				received++;
+				if ( inFlight[ i ] > 0 ) {
+					inFlight[ i ]--;
+				}
+			}
+		}
+	}
+
+	numSent.fetch_add( sent );
+	numReplies.fetch_add( received );
+
+	for ( size_t i = 0; i < fds.size(); i++ ) {
+		close( fds[ i ] );
+	}
+	delete[] reply;
+}
+
+/*
+================
+Bench_FloodThread
+
+sends getStatus from one source as fast as the sockets take it, replies are
+only drained
+================
+*/
+static void Bench_FloodThread( void ) {
+	std::vector< int > fds;
+	for ( int i = 0; i < benchConfig.numFloodSockets; i++ ) {
+		fds.push_back( Bench_OpenSocket( SOURCE_FLOOD ) );
+	}
+
+	byte query[ 256 ];
+	sdMsgWriter msg( query, sizeof( query ) );
+	msg.WriteOOBHeader();
+	msg.WriteString( "getStatus" );
+	msg.WriteLong( 0xffffffff );
+	msg.WriteLong( 0xffffffff );
+	byte* reply = new byte[ BUFFSZ ];
+
+	u64 sent = 0;
+	u64 received = 0;
+	while ( benchRunning.load( std::memory_order_relaxed ) ) {
+		for ( size_t i = 0; i < fds.size(); i++ ) {
+			for ( int j = 0; j < 64 && send( fds[ i ], query, msg.GetLength(), 0 ) >= 0; j++ ) {
+				sent++;
+			}
+			while ( recv( fds[ i ], reply, BUFFSZ, 0 ) > 0 ) {
+				received++;
+			}
+		}
+	}
+
+	numFloodSent.fetch_add( sent );
+	numFloodReplies.fetch_add( received );
+
+	for ( size_t i = 0; i < fds.size(); i++ ) {
+		close( fds[ i ] );
+	}
+	delete[] reply;
+}
+
+/*
+================
+main
+================
+*/
+int main( int argc, char* argv[] ) {
+	for ( int i = 1; i < argc; i++ ) {
+		const char* arg = argv[ i ];
+		const char* value = ( i + 1 < argc ) ? argv[ i + 1 ] : NULL;
+		if ( value == NULL ) {
+			Msr_Error( "missing value for '%s'", arg );
+		}
+
+		if ( !strcmp( arg, "-host" ) ) {
+			benchConfig.host = value;
+		} else if ( !strcmp( arg, "-port" ) ) {
+			benchConfig.port = ( u16 )atoi( value );
+		} else if ( !strcmp( arg, "-threads" ) ) {
+			benchConfig.numThreads = atoi( value );
+		} else if ( !strcmp( arg, "-sockets" ) ) {
+			benchConfig.numSockets = atoi( value );
+		} else if ( !strcmp( arg, "-window" ) ) {
+			benchConfig.window = atoi( value );
+		} else if ( !strcmp( arg, "-duration" ) ) {
+			benchConfig.duration = atoi( value );
+		} else if ( !strcmp( arg, "-sessions" ) ) {
+			benchConfig.numSessions = atoi( value );
+		} else if ( !strcmp( arg, "-query" ) ) {
+			benchConfig.query = value;
+		} else if ( !strcmp( arg, "-flood" ) ) {
+			benchConfig.numFloodSockets = atoi( value );
+		} else {
+			Msr_Error( "unknown option '%s'\n"
+				"usage: %s [-host <ip>] [-port <n>] [-threads <n>] [-sockets <n per thread>] [-window <n>]\n"
+				"          [-duration <sec>] [-sessions <n>] [-query getStatus|challenge|findSessions] [-flood <sockets>]", arg, argv[ 0 ] );
+		}
+		i++;
+	}
+
+	memset( &masterAddr, 0, sizeof( masterAddr ) );
+	masterAddr.sin_family = AF_INET;
+	masterAddr.sin_port = htons( benchConfig.port );
+	if ( inet_pton( AF_INET, benchConfig.host, &masterAddr.sin_addr ) != 1 ) {
+		Msr_Error( "invalid host '%s'", benchConfig.host );
+	}
+
+	if ( benchConfig.numSessions > 0 ) {
+		Msr_Printf( "- advertising %d sessions\n", benchConfig.numSessions );
+		Bench_AdvertiseSessions( benchConfig.numSessions );
+		sleep( 1 );		// let the workers publish their snapshots
+	}
+
+	Msr_Printf( "- %d threads x %d sockets, window %d, '%s' for %d seconds\n", benchConfig.numThreads, benchConfig.numSockets, benchConfig.window, benchConfig.query, benchConfig.duration );
+
+	std::vector< std::thread > threads;
+	for ( int i = 0; i < benchConfig.numThreads; i++ ) {
+		threads.push_back( std::thread( Bench_Thread, i ) );
+	}
+	if ( benchConfig.numFloodSockets > 0 ) {
+		Msr_Printf( "- flooding from %d sockets of one source\n", benchConfig.numFloodSockets );
+		threads.push_back( std::thread( Bench_FloodThread ) );
+	}
+
+	sleep( benchConfig.duration );
+	benchRunning.store( false );
+
+	for ( size_t i = 0; i < threads.size(); i++ ) {
+		threads[ i ].join();
+	}
+
+	Msr_Printf( "- sent %llu, replies %llu, %.0f replies/sec\n", ( unsigned long long )numSent.load(), ( unsigned long long )numReplies.load(), ( double )numReplies.load() / benchConfig.duration );
+	if ( benchConfig.numFloodSockets > 0 ) {
+		Msr_Printf( "- flood sent %llu, replies %llu\n", ( unsigned long long )numFloodSent.load(), ( unsigned long long )numFloodReplies.load() );
+	}
+	return 0;
+}
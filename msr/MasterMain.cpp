@@ -0,0 +1,102 @@
+
+#include "MasterServer.h"
+
+#include <signal.h>
+
+static sdMasterServer	masterServer;
+
+/*
+================
+Sig_Stop
+================
+*/
+static void Sig_Stop( int sig ) {
+	masterServer.Stop();
+}
+
+/*
+================
+Usage
+================
+*/
+static void Usage( const char* exe ) {
+	Msr_Printf( "\n"
+		"Usage: %s [options]\n"
+		"\n"
+		"  -port <n>       UDP port to bind (%d)\n"
+		"  -threads <n>    number of SO_REUSEPORT workers, one per core (1)\n"
+		"  -name <s>       server name reported by getStatus (si_name)\n"
+		"  -map <s>        map reported by getStatus (si_map)\n"
+		"  -set <key> <s>  any other serverInfo key reported by getStatus\n"
+		"  -download <url> URL sent in downloadInfo, downloads are refused when empty\n"
+		"  -rateLimit <n>  packets per second a source IP may send each worker, 0 for no limit (100)\n"
+		"  -rateBurst <n>  packets a source IP may send on top of that in a burst (200)\n"
+		"  -journal <dir>  keep the sessions in dir and restore them on start up\n"
+		"  -v              log one line per packet, -vv adds hex dumps\n"
+		"\n", exe, MASTER_PORT );
+}
+
+/*
+================
+main
+================
+*/
+int main( int argc, char* argv[] ) {
+	sdMasterServer::config_t config;
+
+	setvbuf( stdout, NULL, _IOLBF, 0 );
+
+	for ( int i = 1; i < argc; i++ ) {
+		const char* arg = argv[ i ];
+		const char* value = ( i + 1 < argc ) ? argv[ i + 1 ] : NULL;
+
+		if ( !strcmp( arg, "-v" ) ) {
+			config.verbosity = 1;
+		} else if ( !strcmp( arg, "-vv" ) ) {
+			config.verbosity = 2;
+		} else if ( !strcmp( arg, "-port" ) && value != NULL ) {
+			config.port = ( u16 )atoi( value );
+			i++;
+		} else if ( !strcmp( arg, "-threads" ) && value != NULL ) {
+			config.numWorkers = atoi( value );
+			i++;
+		} else if ( !strcmp( arg, "-name" ) && value != NULL ) {
+			config.serverInfo.Set( "si_name", value );
+			i++;
+		} else if ( !strcmp( arg, "-map" ) && value != NULL ) {
+			config.serverInfo.Set( "si_map", value );
+			i++;
+		} else if ( !strcmp( arg, "-set" ) && value != NULL && i + 2 < argc ) {
+			config.serverInfo.Set( value, argv[ i + 2 ] );
+			i += 2;
+		} else if ( !strcmp( arg, "-download" ) && value != NULL ) {
+			config.downloadURL = value;
+			i++;
+		} else if ( !strcmp( arg, "-journal" ) && value != NULL ) {
+			config.journalDirectory = value;
+			i++;
+		} else if ( !strcmp( arg, "-rateLimit" ) && value != NULL ) {
+			config.rateLimit = atoi( value );
+			i++;
+		} else if ( !strcmp( arg, "-rateBurst" ) && value != NULL ) {
+			config.rateBurst = atoi( value );
+			i++;
+		} else {
+			Usage( argv[ 0 ] );
+			return 1;
+		}
+	}
+
+	if ( !masterServer.Init( config ) ) {
+		return 1;
+	}
+
+	signal( SIGINT, Sig_Stop );
+	signal( SIGTERM, Sig_Stop );
+	signal( SIGPIPE, SIG_IGN );
+
+	masterServer.Run();
+	masterServer.Shutdown();
+
+	return 0;
+}
@@ -0,0 +1,161 @@
+
+#include "MasterServer.h"
+#include "MasterWorker.h"
+
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
+/*
+================
+sdMasterServer::sdMasterServer
+================
+*/
+sdMasterServer::sdMasterServer( void ) :
+	sessionVersion( 1 ),
+	generation( 0 ),
+	coordQueues( NULL ),
+	numWorkers( 0 ) {
+	memset( workers, 0, sizeof( workers ) );
+}
+
+/*
+================
+sdMasterServer::~sdMasterServer
+================
+*/
+sdMasterServer::~sdMasterServer( void ) {
+	Shutdown();
+}
+
+/*
+================
+sdMasterServer::Init
+================
+*/
+bool sdMasterServer::Init( const config_t& config ) {
+	this->config = config;
+	if ( this->config.numWorkers < 1 ) {
+		this->config.numWorkers = 1;
+	} else if ( this->config.numWorkers > MAX_WORKERS ) {
+		this->config.numWorkers = MAX_WORKERS;
+	}
+
+	epochManager.Init( this->config.numWorkers );
+	challenges.Init();
+
+	// version 0 means "never synchronized" to the clients
+	sessionVersion.store( 1 );
+	generation = ( ( u32 )time( NULL ) ^ ( u32 )getpid() * 0x9e3779b9 ) | 1;
+
+	coordQueues = new sdCoordQueue[ this->config.numWorkers * this->config.numWorkers ];
+
+	for ( int i = 0; i < this->config.numWorkers; i++ ) {
+		workers[ i ] = new sdMasterWorker;
+		numWorkers++;
+		if ( !workers[ i ]->Init( *this, i ) ) {
+			Shutdown();
+			return false;
+		}
+	}
+
+	Msr_Printf( "- bind UDP port %u with %d worker%s\n", config.port, numWorkers, numWorkers == 1 ? "" : "s" );
+	return true;
+}
+
+/*
+================
+sdMasterServer::Shutdown
+================
+*/
+void sdMasterServer::Shutdown( void ) {
+	for ( int i = 0; i < numWorkers; i++ ) {
+		delete workers[ i ];
+		workers[ i ] = NULL;
+	}
+	numWorkers = 0;
+
+	delete[] coordQueues;
+	coordQueues = NULL;
+}
+
+/*
+================
+sdMasterServer::Run
+================
+*/
+void sdMasterServer::Run( void ) {
+	std::vector< std::thread > threads;
+	for ( int i = 1; i < numWorkers; i++ ) {
+		threads.push_back( std::thread( &sdMasterWorker::Run, workers[ i ] ) );
+	}
+
+	workers[ 0 ]->Run();
+
+	for ( size_t i = 0; i < threads.size(); i++ ) {
+		threads[ i ].join();
+	}
+
+	PrintStats();
+}
+
+/*
+================
+sdMasterServer::Stop
+================
+*/
+void sdMasterServer::Stop( void ) {
+	for ( int i = 0; i < numWorkers; i++ ) {
+		workers[ i ]->Stop();
+	}
+}
+
+/*
+================
+sdMasterServer::PrintStats
+
+only called once every worker thread has been joined
+================
+*/
+void sdMasterServer::PrintStats( void ) {
+	sdMasterWorker::stats_t total;
+	memset( &total, 0, sizeof( total ) );
+
+	u64 logDropped = 0;
+	for ( int i = 0; i < numWorkers; i++ ) {
+		const sdMasterWorker::stats_t& stats = workers[ i ]->GetStats();
+		total.packetsIn += stats.packetsIn;
+		total.packetsOut += stats.packetsOut;
+		total.malformed += stats.malformed;
+		total.commands[ sdMasterWorker::OOB_SERVERINTEREST ] += stats.commands[ sdMasterWorker::OOB_SERVERINTEREST ];
+		total.unknown += stats.unknown;
+		total.sendFailures += stats.sendFailures;
+		total.recvBatches += stats.recvBatches;
+		total.sendBatches += stats.sendBatches;
+		total.interestDropped += stats.interestDropped;
+		total.badChallenges += stats.badChallenges;
+		total.throttled += stats.throttled;
+		total.commands[ sdMasterWorker::OOB_FINDSESSIONS ] += stats.commands[ sdMasterWorker::OOB_FINDSESSIONS ];
+		total.pagedFinds += stats.pagedFinds;
+		total.pageBuilds += stats.pageBuilds;
+		total.pingSamples += stats.pingSamples;
+		total.coordDropped += stats.coordDropped;
+		logDropped += workers[ i ]->GetNumLogDropped();
+	}
+
+	double recvFill = total.recvBatches != 0 ? ( double )total.packetsIn / total.recvBatches : 0.0;
+	double sendFill = total.sendBatches != 0 ? ( double )total.packetsOut / total.sendBatches : 0.0;
+
+	Msr_Printf( "- packets in %llu out %llu, malformed %llu, unknown %llu, send failures %llu, log drops %llu\n",
+		( unsigned long long )total.packetsIn, ( unsigned long long )total.packetsOut,
+		( unsigned long long )total.malformed, ( unsigned long long )total.unknown,
+		( unsigned long long )total.sendFailures, ( unsigned long long )logDropped );
+	Msr_Printf( "- average batch fill: recv %.1f / %d, send %.1f / %d\n", recvFill, sdMasterWorker::PACKET_BATCH, sendFill, sdMasterWorker::PACKET_BATCH );
+	Msr_Printf( "- interest registrations %llu, dropped %llu\n",
+		( unsigned long long )total.commands[ sdMasterWorker::OOB_SERVERINTEREST ], ( unsigned long long )total.interestDropped );
+	Msr_Printf( "- bad challenges %llu, throttled %llu\n", ( unsigned long long )total.badChallenges, ( unsigned long long )total.throttled );
+	Msr_Printf( "- find sessions %llu, from pages %llu, page builds %llu\n",
+		( unsigned long long )total.commands[ sdMasterWorker::OOB_FINDSESSIONS ], ( unsigned long long )total.pagedFinds, ( unsigned long long )total.pageBuilds );
+	Msr_Printf( "- ping samples %llu, dropped %llu\n", ( unsigned long long )total.pingSamples, ( unsigned long long )total.coordDropped );
+}
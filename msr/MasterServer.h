@@ -0,0 +1,98 @@
+
+#ifndef __MSR_MASTERSERVER_H__
+#define __MSR_MASTERSERVER_H__
+
+#include "Common.h"
+#include "Challenge.h"
+#include "Epoch.h"
+#include "NetCoords.h"
+#include "ServerInfo.h"
+
+#include <atomic>
+
+class sdMasterWorker;
+
+/*
+===============================================================================
+
+	sdMasterServer
+
+	Owns the per core workers and the state they agree on: the configuration,
+	the challenge key, the epoch manager guarding the published session
+	snapshots and the queues that carry coordinate samples between workers.
+
+===============================================================================
+*/
+
+class sdMasterServer {
+public:
+	static const int			MAX_WORKERS			= 64;
+
+	struct config_t {
+								config_t( void ) :
+									port( MASTER_PORT ),
+									numWorkers( 1 ),
+									verbosity( 0 ),
+									rateLimit( 100 ),
+									rateBurst( 200 ),
+									downloadURL( "" ),
+									journalDirectory( "" ) {
+									serverInfo.Set( "si_name", "ETQW Server" );
+									serverInfo.Set( "si_map", "maps/valley.entities" );
+									serverInfo.Set( "si_maxPlayers", "24" );
+									serverInfo.Set( "si_teamDamage", "1" );
+									serverInfo.Set( "si_rules", "sdGameRulesCampaign" );
+									serverInfo.Set( "si_teamForceBalance", "1" );
+									serverInfo.Set( "si_allowLateJoin", "1" );
+								}
+
+		u16						port;
+		int						numWorkers;
+		int						verbosity;
+		int						rateLimit;			// packets per second and source IP, 0 disables
+		int						rateBurst;
+		const char*				downloadURL;
+		const char*				journalDirectory;	// sessions survive restarts when set
+		sdServerInfo			serverInfo;			// reported by getStatus
+	};
+
+								sdMasterServer( void );
+								~sdMasterServer( void );
+
+	bool						Init( const config_t& config );
+	void						Shutdown( void );
+
+								// runs every worker until Stop is called, worker 0 runs on the calling thread
+	void						Run( void );
+								// safe to call from a signal handler
+	void						Stop( void );
+
+	const config_t&				GetConfig( void ) const { return config; }
+	sdEpochManager&				GetEpochManager( void ) { return epochManager; }
+	const sdChallengeGenerator&	GetChallenges( void ) const { return challenges; }
+
+								// session versions are shared by every shard, the generation changes with every run
+	std::atomic< u32 >&			GetSessionVersionCounter( void ) { return sessionVersion; }
+	u32							GetGeneration( void ) const { return generation; }
+
+	int							GetNumWorkers( void ) const { return numWorkers; }
+	const sdMasterWorker&		GetWorker( int index ) const { return *workers[ index ]; }
+								// samples worker from queued for the sessions of worker to
+	sdCoordQueue&				GetCoordQueue( int from, int to ) { return coordQueues[ from * numWorkers + to ]; }
+
+private:
+	void						PrintStats( void );
+
+	config_t					config;
+	sdEpochManager				epochManager;
+	sdChallengeGenerator		challenges;
+
+	std::atomic< u32 >			sessionVersion;
+	u32							generation;
+
+	sdMasterWorker*				workers[ MAX_WORKERS ];
+	sdCoordQueue*				coordQueues;		// numWorkers * numWorkers
+	int							numWorkers;
+};
+
+#endif /* !__MSR_MASTERSERVER_H__ */
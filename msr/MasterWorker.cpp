@@ -0,0 +1,1084 @@
+
+#include "MasterWorker.h"
+#include "MasterServer.h"
+#include "Msg.h"
+#include "OOBPackets.h"
+#include "SessionFilter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+/*
+================
+sdMasterWorker::oobHandlers
+================
+*/
+const sdMasterWorker::oobHandlerDef_t sdMasterWorker::oobHandlers[ OOB_NUM_COMMANDS ] = {
+	{ "getStatus",			OOB_GETSTATUS,			&sdMasterWorker::HandleGetStatus },
+	{ "challenge",			OOB_CHALLENGE,			&sdMasterWorker::HandleChallenge },
+	{ "connect",			OOB_CONNECT,			&sdMasterWorker::HandleConnect },
+	{ "downloadRequest",	OOB_DOWNLOADREQUEST,	&sdMasterWorker::HandleDownloadRequest },
+	{ "updateSession",		OOB_UPDATESESSION,		&sdMasterWorker::HandleUpdateSession },
+	{ "deleteSession",		OOB_DELETESESSION,		&sdMasterWorker::HandleDeleteSession },
+	{ "findSessions",		OOB_FINDSESSIONS,		&sdMasterWorker::HandleFindSessions },
+	{ "refreshSessions",	OOB_REFRESHSESSIONS,	&sdMasterWorker::HandleRefreshSessions },
+	{ "serverInterest",		OOB_SERVERINTEREST,		&sdMasterWorker::HandleServerInterest },
+	{ "pingReport",			OOB_PINGREPORT,			&sdMasterWorker::HandlePingReport },
+	{ "estimatePings",		OOB_ESTIMATEPINGS,		&sdMasterWorker::HandleEstimatePings },
+};
+
+/*
+================
+sdMasterWorker::sdMasterWorker
+================
+*/
+sdMasterWorker::sdMasterWorker( void ) :
+	server( NULL ),
+	index( 0 ),
+	socketFd( -1 ),
+	epollFd( -1 ),
+	timerFd( -1 ),
+	wakeFd( -1 ),
+	running( false ),
+	recvBuffers( NULL ),
+	sendBuffers( NULL ),
+	recvHeaders( NULL ),
+	sendHeaders( NULL ),
+	recvVecs( NULL ),
+	sendVecs( NULL ),
+	recvAddrs( NULL ),
+	sendAddrs( NULL ),
+	numReplies( 0 ),
+	snapshot( NULL ),
+	publishedVersion( 0 ),
+	interestEpoch( 0 ),
+	nextStatsTime( 0 ) {
+	memset( &stats, 0, sizeof( stats ) );
+	for ( int i = 0; i < sessionPages_t::NUM_SOURCES; i++ ) {
+		sessionPages[ i ].store( NULL );
+	}
+}
+
+/*
+================
+sdMasterWorker::~sdMasterWorker
+================
+*/
+sdMasterWorker::~sdMasterWorker( void ) {
+	Shutdown();
+}
+
+/*
+================
+sdMasterWorker::Init
+================
+*/
+bool sdMasterWorker::Init( sdMasterServer& server, int index ) {
+	this->server = &server;
+	this->index = index;
+
+	const sdMasterServer::config_t& config = server.GetConfig();
+
+	socketFd = socket( AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, IPPROTO_UDP );
+	if ( socketFd < 0 ) {
+		Msr_Warning( "sdMasterWorker::Init: socket failed (%s)", strerror( errno ) );
+		return false;
+	}
+
+	// every worker binds the same port, the kernel spreads the sources over them
+	int on = 1;
+	setsockopt( socketFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on ) );
+	if ( setsockopt( socketFd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof( on ) ) < 0 ) {
+		Msr_Warning( "sdMasterWorker::Init: SO_REUSEPORT failed (%s)", strerror( errno ) );
+		Shutdown();
+		return false;
+	}
+
+	struct sockaddr_in addr;
+	memset( &addr, 0, sizeof( addr ) );
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = INADDR_ANY;
+	addr.sin_port = htons( config.port );
+	if ( bind( socketFd, ( struct sockaddr* )&addr, sizeof( addr ) ) < 0 ) {
+		Msr_Warning( "sdMasterWorker::Init: bind to UDP port %u failed (%s)", config.port, strerror( errno ) );
+		Shutdown();
+		return false;
+	}
+
+	epollFd = epoll_create1( 0 );
+	timerFd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK );
+	wakeFd = eventfd( 0, EFD_NONBLOCK );
+	if ( epollFd < 0 || timerFd < 0 || wakeFd < 0 ) {
+		Msr_Warning( "sdMasterWorker::Init: failed to create the reactor fds (%s)", strerror( errno ) );
+		Shutdown();
+		return false;
+	}
+
+	struct itimerspec tick;
+	tick.it_interval.tv_sec = TICK_MSEC / 1000;
+	tick.it_interval.tv_nsec = ( TICK_MSEC % 1000 ) * 1000000;
+	tick.it_value = tick.it_interval;
+	timerfd_settime( timerFd, 0, &tick, NULL );
+
+	const int fds[ 3 ] = { socketFd, timerFd, wakeFd };
+	for ( int i = 0; i < 3; i++ ) {
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.fd = fds[ i ];
+		if ( epoll_ctl( epollFd, EPOLL_CTL_ADD, fds[ i ], &ev ) < 0 ) {
+			Msr_Warning( "sdMasterWorker::Init: epoll_ctl failed (%s)", strerror( errno ) );
+			Shutdown();
+			return false;
+		}
+	}
+
+	recvBuffers = new byte[ PACKET_BATCH * BUFFSZ ];
+	sendBuffers = new byte[ PACKET_BATCH * BUFFSZ ];
+	recvHeaders = new mmsghdr[ PACKET_BATCH ];
+	sendHeaders = new mmsghdr[ PACKET_BATCH ];
+	recvVecs = new iovec[ PACKET_BATCH ];
+	sendVecs = new iovec[ PACKET_BATCH ];
+	recvAddrs = new sockaddr_in[ PACKET_BATCH ];
+	sendAddrs = new sockaddr_in[ PACKET_BATCH ];
+
+	memset( recvHeaders, 0, sizeof( mmsghdr ) * PACKET_BATCH );
+	memset( sendHeaders, 0, sizeof( mmsghdr ) * PACKET_BATCH );
+	for ( int i = 0; i < PACKET_BATCH; i++ ) {
+		recvVecs[ i ].iov_base = recvBuffers + i * BUFFSZ;
+		recvVecs[ i ].iov_len = BUFFSZ;
+		recvHeaders[ i ].msg_hdr.msg_iov = &recvVecs[ i ];
+		recvHeaders[ i ].msg_hdr.msg_iovlen = 1;
+		recvHeaders[ i ].msg_hdr.msg_name = &recvAddrs[ i ];
+
+		sendVecs[ i ].iov_base = sendBuffers + i * BUFFSZ;
+		sendHeaders[ i ].msg_hdr.msg_iov = &sendVecs[ i ];
+		sendHeaders[ i ].msg_hdr.msg_iovlen = 1;
+		sendHeaders[ i ].msg_hdr.msg_name = &sendAddrs[ i ];
+		sendHeaders[ i ].msg_hdr.msg_namelen = sizeof( sockaddr_in );
+	}
+	numReplies = 0;
+
+	sessions.SetVersionCounter( &server.GetSessionVersionCounter() );
+	if ( config.journalDirectory[ 0 ] != '\0' ) {
+		u64 start = Sys_Microseconds();
+		if ( journal.Open( config.journalDirectory, index, config.numWorkers, sessions ) && sessions.Num() > 0 ) {
+			Msr_Printf( "- [%d] restored %d sessions in %.1f msec\n", index, sessions.Num(), ( Sys_Microseconds() - start ) / 1000.0 );
+		}
+	}
+	snapshot.store( sessions.BuildSnapshot() );
+	publishedVersion.store( server.GetSessionVersionCounter().load() );
+
+	limiter.Init( config.rateLimit, config.rateBurst );
+	clientCoords.Init();
+	nextStatsTime = Sys_Milliseconds() + STATS_INTERVAL;
+
+	log.Start( config.verbosity );
+
+	return true;
+}
+
+/*
+================
+sdMasterWorker::Shutdown
+================
+*/
+void sdMasterWorker::Shutdown( void ) {
+	log.Stop();
+
+	// the next start only has to map the snapshot
+	journal.Compact( sessions, Sys_Milliseconds() );
+	journal.Close();
+
+	const int fds[ 4 ] = { socketFd, epollFd, timerFd, wakeFd };
+	for ( int i = 0; i < 4; i++ ) {
+		if ( fds[ i ] >= 0 ) {
+			close( fds[ i ] );
+		}
+	}
+	socketFd = epollFd = timerFd = wakeFd = -1;
+
+	delete[] recvBuffers;
+	recvBuffers = NULL;
+	delete[] sendBuffers;
+	sendBuffers = NULL;
+	delete[] recvHeaders;
+	recvHeaders = NULL;
+	delete[] sendHeaders;
+	sendHeaders = NULL;
+	delete[] recvVecs;
+	recvVecs = NULL;
+	delete[] sendVecs;
+	sendVecs = NULL;
+	delete[] recvAddrs;
+	recvAddrs = NULL;
+	delete[] sendAddrs;
+	sendAddrs = NULL;
+
+	// every worker has been joined by now, nobody can be reading the snapshot
+	sessionSnapshot_t::Free( snapshot.exchange( NULL ) );
+	for ( int i = 0; i < sessionPages_t::NUM_SOURCES; i++ ) {
+		sessionPages_t::Free( sessionPages[ i ].exchange( NULL ) );
+	}
+}
+
+/*
+================
+sdMasterWorker::Stop
+================
+*/
+void sdMasterWorker::Stop( void ) {
+	running.store( false );
+	if ( wakeFd >= 0 ) {
+		u64 one = 1;
+		ssize_t ret = write( wakeFd, &one, sizeof( one ) );
+		( void )ret;
+	}
+}
+
+/*
+================
+sdMasterWorker::Run
+================
+*/
+void sdMasterWorker::Run( void ) {
+	struct epoll_event events[ MAX_EVENTS ];
+	sdEpochManager& epochManager = server->GetEpochManager();
+
+	running.store( true );
+	while ( running.load( std::memory_order_relaxed ) ) {
+		epochManager.Offline( index );
+		int num = epoll_wait( epollFd, events, MAX_EVENTS, -1 );
+		epochManager.Online( index );
+
+		if ( num < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			Msr_Warning( "sdMasterWorker::Run: epoll_wait failed (%s)", strerror( errno ) );
+			break;
+		}
+
+		for ( int i = 0; i < num; i++ ) {
+			int fd = events[ i ].data.fd;
+			if ( fd == socketFd ) {
+				ReadPackets();
+			} else if ( fd == timerFd ) {
+				u64 expirations;
+				if ( read( timerFd, &expirations, sizeof( expirations ) ) > 0 ) {
+					OnTick();
+				}
+			} else if ( fd == wakeFd ) {
+				u64 value;
+				ssize_t ret = read( wakeFd, &value, sizeof( value ) );
+				( void )ret;
+			}
+		}
+	}
+
+	epochManager.Offline( index );
+}
+
+/*
+================
+sdMasterWorker::ReadPackets
+
+drains the socket a batch at a time, but yields back to epoll after a bounded
+number of packets
+================
+*/
+void sdMasterWorker::ReadPackets( void ) {
+	for ( int total = 0; total < MAX_PACKETS_PER_WAKE; ) {
+		for ( int i = 0; i < PACKET_BATCH; i++ ) {
+			recvHeaders[ i ].msg_hdr.msg_namelen = sizeof( sockaddr_in );
+		}
+
+		int numPackets = recvmmsg( socketFd, recvHeaders, PACKET_BATCH, MSG_DONTWAIT, NULL );
+		if ( numPackets <= 0 ) {
+			if ( numPackets < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) {
+				Msr_Warning( "sdMasterWorker::ReadPackets: recvmmsg failed (%s)", strerror( errno ) );
+			}
+			return;
+		}
+
+		stats.recvBatches++;
+		total += numPackets;
+
+		const int now = Sys_Milliseconds();
+		for ( int i = 0; i < numPackets; i++ ) {
+			const byte* data = recvBuffers + i * BUFFSZ;
+			int length = ( int )recvHeaders[ i ].msg_len;
+			const sockaddr_in& from = recvAddrs[ i ];
+
+			stats.packetsIn++;
+			stats.bytesIn += length;
+
+			if ( !limiter.Admit( from.sin_addr.s_addr, now ) ) {
+				stats.throttled++;
+				continue;
+			}
+			log.Push( sdLogQueue::LD_IN, from.sin_addr.s_addr, from.sin_port, data, length );
+
+			ProcessPacket( data, length, from );
+		}
+
+		FlushReplies();
+
+		if ( numPackets < PACKET_BATCH ) {
+			return;
+		}
+	}
+}
+
+/*
+================
+sdMasterWorker::BeginReply
+================
+*/
+sdMsgWriter sdMasterWorker::BeginReply( void ) {
+	if ( numReplies == PACKET_BATCH ) {
+		FlushReplies();
+	}
+
+	sdMsgWriter reply( sendBuffers + numReplies * BUFFSZ, BUFFSZ );
+	reply.WriteOOBHeader();
+	return reply;
+}
+
+/*
+================
+sdMasterWorker::EndReply
+================
+*/
+void sdMasterWorker::EndReply( const sdMsgWriter& reply, const sockaddr_in& to ) {
+	if ( reply.IsOverflowed() ) {
+		stats.malformed++;
+		return;
+	}
+
+	sendVecs[ numReplies ].iov_base = sendBuffers + numReplies * BUFFSZ;
+	sendVecs[ numReplies ].iov_len = reply.GetLength();
+	sendAddrs[ numReplies ] = to;
+	numReplies++;
+}
+
+/*
+================
+sdMasterWorker::QueueReply
+
+the batch points at the data instead of copying it into the send buffers
+================
+*/
+void sdMasterWorker::QueueReply( const byte* data, int length, const sockaddr_in& to ) {
+	if ( numReplies == PACKET_BATCH ) {
+		FlushReplies();
+	}
+
+	sendVecs[ numReplies ].iov_base = const_cast< byte* >( data );
+	sendVecs[ numReplies ].iov_len = length;
+	sendAddrs[ numReplies ] = to;
+	numReplies++;
+}
+
+/*
+================
+sdMasterWorker::FlushReplies
+================
+*/
+void sdMasterWorker::FlushReplies( void ) {
+	int sent = 0;
+	while ( sent < numReplies ) {
+		int num = sendmmsg( socketFd, sendHeaders + sent, numReplies - sent, MSG_DONTWAIT );
+		if ( num < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			// socket buffer is full, the remaining replies are dropped like any lost datagram
+			stats.sendFailures += numReplies - sent;
+			break;
+		}
+
+		stats.sendBatches++;
+		for ( int i = sent; i < sent + num; i++ ) {
+			int length = ( int )sendVecs[ i ].iov_len;
+
+			stats.packetsOut++;
+			stats.bytesOut += length;
+			log.Push( sdLogQueue::LD_OUT, sendAddrs[ i ].sin_addr.s_addr, sendAddrs[ i ].sin_port, ( const byte* )sendVecs[ i ].iov_base, length );
+		}
+		sent += num;
+	}
+	numReplies = 0;
+}
+
+/*
+================
+sdMasterWorker::OnTick
+================
+*/
+void sdMasterWorker::OnTick( void ) {
+	int now = Sys_Milliseconds();
+
+	sessions.Expire( now );
+
+	journal.Flush();
+	journal.PollCompaction();
+	if ( journal.NeedsCompaction( now ) ) {
+		journal.BeginCompaction( sessions, now );
+	}
+
+	u32 epoch = sdInterestCounters::CurrentEpoch();
+	if ( epoch != interestEpoch ) {
+		interestEpoch = epoch;
+		interest.Rotate( epoch );
+		UpdateInterest( epoch );
+	}
+
+	ApplyCoordSamples();
+
+	if ( sessions.IsDirty() ) {
+		PublishSnapshot();
+	}
+	// nothing in this shard changed since the snapshot, so it is current up to here
+	publishedVersion.store( server->GetSessionVersionCounter().load(), std::memory_order_release );
+	if ( index == 0 ) {
+		PublishSessionPages();
+	}
+	server->GetEpochManager().Collect( index );
+
+	if ( server->GetConfig().verbosity > 0 && now >= nextStatsTime ) {
+		PrintStats();
+		nextStatsTime = now + STATS_INTERVAL;
+	}
+}
+
+/*
+================
+sdMasterWorker::UpdateInterest
+
+sums the counters every worker keeps for the sessions of this shard
+================
+*/
+void sdMasterWorker::UpdateInterest( u32 epoch ) {
+	const int numWorkers = server->GetNumWorkers();
+	for ( int i = 0; i < sessions.Num(); i++ ) {
+		const u64 address = sessions.GetAddress( i );
+		int count = 0;
+		for ( int j = 0; j < numWorkers; j++ ) {
+			count += server->GetWorker( j ).GetInterest().Count( address, epoch );
+		}
+		sessions.SetInterestedClients( i, count );
+	}
+}
+
+/*
+================
+sdMasterWorker::ApplyCoordSamples
+
+moves the coordinates of this shard's sessions by the samples every worker queued for them
+================
+*/
+void sdMasterWorker::ApplyCoordSamples( void ) {
+	const int numWorkers = server->GetNumWorkers();
+	for ( int i = 0; i < numWorkers; i++ ) {
+		sdCoordQueue& queue = server->GetCoordQueue( i, index );
+		coordSample_t sample;
+		while ( queue.Pop( sample ) ) {
+			// the session may have been removed since the sample was queued
+			int session = sessions.Find( sample.server );
+			if ( session == sdAddressHash::INVALID_INDEX ) {
+				continue;
+			}
+			netCoord_t coord = sessions.GetCoord( session );
+			coord.Update( sample.client, sample.rtt, ( u32 )sample.server );
+			sessions.SetCoord( session, coord );
+		}
+	}
+}
+
+/*
+================
+sdMasterWorker::PublishSnapshot
+
+the old snapshot may still be read by other workers, it is freed once they are quiescent
+================
+*/
+void sdMasterWorker::PublishSnapshot( void ) {
+	sessionSnapshot_t* old = snapshot.exchange( sessions.BuildSnapshot() );
+	server->GetEpochManager().Retire( index, old, sessionSnapshot_t::Free );
+	// the old snapshot may point at serverInfo blocks the registry has dropped since
+	server->GetEpochManager().Retire( index, sessions.TakeGarbage(), sessionGarbage_t::Free );
+}
+
+/*
+================
+sdMasterWorker::PublishSessionPages
+
+rebuilds the unfiltered lists once some shard published a change since the
+last build; the watermarks only move when sessions change, so an idle master
+builds nothing
+================
+*/
+void sdMasterWorker::PublishSessionPages( void ) {
+	const int numWorkers = server->GetNumWorkers();
+
+	// the watermarks are read before the snapshots they describe
+	u32 version = server->GetWorker( 0 ).GetPublishedVersion();
+	for ( int i = 1; i < numWorkers; i++ ) {
+		u32 v = server->GetWorker( i ).GetPublishedVersion();
+		if ( Msr_VersionBefore( v, version ) ) {
+			version = v;
+		}
+	}
+
+	const sessionPages_t* current = sessionPages[ 0 ].load( std::memory_order_relaxed );
+	if ( current != NULL && current->version == version ) {
+		return;
+	}
+
+	const sessionSnapshot_t* snapshots[ sdMasterServer::MAX_WORKERS ];
+	for ( int i = 0; i < numWorkers; i++ ) {
+		snapshots[ i ] = server->GetWorker( i ).GetSnapshot();
+	}
+
+	for ( int i = 0; i < sessionPages_t::NUM_SOURCES; i++ ) {
+		sessionSource_e source = ( sessionSource_e )( sessionPages_t::FIRST_SOURCE + i );
+		sessionPages_t* pages = sessionPages_t::Build( snapshots, numWorkers, source, SESSIONS_PER_PACKET, version );
+		sessionPages_t* old = sessionPages[ i ].exchange( pages, std::memory_order_acq_rel );
+		if ( old != NULL ) {
+			server->GetEpochManager().Retire( index, old, sessionPages_t::Free );
+		}
+	}
+	stats.pageBuilds++;
+}
+
+/*
+================
+sdMasterWorker::GetSessionPages
+================
+*/
+const sessionPages_t* sdMasterWorker::GetSessionPages( int source ) const {
+	if ( source < sessionPages_t::FIRST_SOURCE || source >= sessionPages_t::FIRST_SOURCE + sessionPages_t::NUM_SOURCES ) {
+		return NULL;
+	}
+	return sessionPages[ source - sessionPages_t::FIRST_SOURCE ].load( std::memory_order_acquire );
+}
+
+/*
+================
+sdMasterWorker::PrintStats
+================
+*/
+void sdMasterWorker::PrintStats( void ) {
+	double recvFill = stats.recvBatches != 0 ? ( double )stats.packetsIn / stats.recvBatches : 0.0;
+
+	Msr_Printf( "- [%d] sessions %d, packets in %llu out %llu, malformed %llu, unknown %llu, throttled %llu, send failures %llu, recv batch fill %.1f / %d\n",
+		index, sessions.Num(), ( unsigned long long )stats.packetsIn, ( unsigned long long )stats.packetsOut,
+		( unsigned long long )stats.malformed, ( unsigned long long )stats.unknown, ( unsigned long long )stats.throttled,
+		( unsigned long long )stats.sendFailures, recvFill, PACKET_BATCH );
+}
+
+/*
+================
+sdMasterWorker::ProcessPacket
+================
+*/
+void sdMasterWorker::ProcessPacket( const byte* data, int length, const sockaddr_in& from ) {
+	if ( length < OOB_HEADER_SIZE || data[ 0 ] != 0xff || data[ 1 ] != 0xff ) {
+		stats.malformed++;
+		return;
+	}
+
+	sdMsgReader msg( data + OOB_HEADER_SIZE, length - OOB_HEADER_SIZE );
+	const char* command = msg.ReadString();
+	if ( command == NULL ) {
+		stats.malformed++;
+		return;
+	}
+
+	for ( int i = 0; i < OOB_NUM_COMMANDS; i++ ) {
+		const oobHandlerDef_t& def = oobHandlers[ i ];
+		if ( strcasecmp( command, def.name ) != 0 ) {
+			continue;
+		}
+
+		stats.commands[ def.command ]++;
+		( this->*def.handler )( msg, from );
+		return;
+	}
+
+	stats.unknown++;
+}
+
+/*
+================
+sdMasterWorker::HandleGetStatus
+
+the encoded reply is cached until the serverInfo checksum changes
+================
+*/
+void sdMasterWorker::HandleGetStatus( sdMsgReader& msg, const sockaddr_in& from ) {
+	const sdServerInfo& serverInfo = server->GetConfig().serverInfo;
+	if ( !statusCache.IsValid( serverInfo.Checksum() ) ) {
+		statusCache.Build( serverInfo );
+	}
+
+	// the two longs of the query are echoed back, the client sends -1 for both
+	u32 challenge = 0xffffffff;
+	u32 queryId = 0xffffffff;
+	getStatusPacket_t::Decode( msg, challenge, queryId );
+
+	sdMsgWriter reply = BeginReply();
+	statusCache.Write( reply, challenge, queryId );
+	EndReply( reply, from );
+}
+
+/*
+================
+sdMasterWorker::HandleChallenge
+
+the challenge is derived from the address, nothing is remembered
+================
+*/
+void sdMasterWorker::HandleChallenge( sdMsgReader& msg, const sockaddr_in& from ) {
+	u32 challenge = server->GetChallenges().Generate( Msr_PackAddress( from.sin_addr.s_addr, from.sin_port ), sdChallengeGenerator::CurrentEpoch() );
+
+	sdMsgWriter reply = BeginReply();
+	challengeResponsePacket_t::Encode( reply, challenge, 15996, 0, 0, "", "" );
+	EndReply( reply, from );
+}
+
+/*
+================
+sdMasterWorker::IsValidChallenge
+================
+*/
+bool sdMasterWorker::IsValidChallenge( u32 challenge, const sockaddr_in& from ) {
+	if ( server->GetChallenges().Validate( Msr_PackAddress( from.sin_addr.s_addr, from.sin_port ), challenge, sdChallengeGenerator::CurrentEpoch() ) ) {
+		return true;
+	}
+	stats.badChallenges++;
+	return false;
+}
+
+/*
+================
+sdMasterWorker::HandleConnect
+
+the master is not pure, so only the delimiter and the game code pak are sent
+================
+*/
+void sdMasterWorker::HandleConnect( sdMsgReader& msg, const sockaddr_in& from ) {
+	int minor, major, unknown, clientPort;
+	u32 checksum, challenge, clientChallenge;
+	if ( !connectPacket_t::Decode( msg, minor, major, unknown, checksum, challenge, clientChallenge, clientPort ) ) {
+		stats.malformed++;
+		return;
+	}
+	if ( !IsValidChallenge( challenge, from ) ) {
+		return;
+	}
+
+	sdMsgWriter reply = BeginReply();
+	pureServerPacket_t::Encode( reply, 0, 0 );
+	EndReply( reply, from );
+}
+
+/*
+================
+sdMasterWorker::HandleDownloadRequest
+================
+*/
+void sdMasterWorker::HandleDownloadRequest( sdMsgReader& msg, const sockaddr_in& from ) {
+	const sdMasterServer::config_t& config = server->GetConfig();
+	if ( config.downloadURL[ 0 ] == '\0' ) {
+		return;
+	}
+
+	u32 challenge;
+	int clientPort;
+	u32 requestId;
+	if ( !downloadRequestPacket_t::Decode( msg, challenge, clientPort, requestId ) ) {
+		stats.malformed++;
+		return;
+	}
+	if ( !IsValidChallenge( challenge, from ) ) {
+		return;
+	}
+
+	sdMsgWriter reply = BeginReply();
+	downloadInfoPacket_t::Encode( reply, requestId, 1, config.downloadURL );
+	EndReply( reply, from );
+}
+
+/*
+================
+sdMasterWorker::HandleUpdateSession
+
+sent by sdNetSessionManager::CreateSession / UpdateSession, the session is keyed on the source address
+
+	byte	numClients
+	byte	numBots
+	byte	gameState
+	byte	flags
+	long	sessionTime
+	short	numRepeaterClients
+	short	maxRepeaterClients
+	key\0value\0 ... \0		serverInfo
+================
+*/
+void sdMasterWorker::HandleUpdateSession( sdMsgReader& msg, const sockaddr_in& from ) {
+	sessionInfo_t info;
+	info.numClients = msg.ReadByte();
+	info.numBots = msg.ReadByte();
+	info.gameState = msg.ReadByte();
+	info.flags = msg.ReadByte();
+	info.sessionTime = ( int )msg.ReadLong();
+	info.numRepeaterClients = msg.ReadShort();
+	info.maxRepeaterClients = msg.ReadShort();
+
+	const byte* serverInfo = msg.GetCursor();
+	int serverInfoLength = msg.GetRemaining();
+	if ( msg.IsOverflowed() || serverInfoLength > sdSessionRegistry::MAX_SERVERINFO_SIZE ) {
+		stats.malformed++;
+		return;
+	}
+	if ( serverInfoLength > 0 && serverInfo[ serverInfoLength - 1 ] != '\0' ) {
+		stats.malformed++;
+		return;
+	}
+
+	const u64 address = Msr_PackAddress( from.sin_addr.s_addr, from.sin_port );
+	const int expireTime = Sys_Milliseconds() + SESSION_TIMEOUT;
+	sessions.Update( address, info, serverInfo, serverInfoLength, expireTime );
+	journal.LogUpdate( address, info, serverInfo, serverInfoLength, expireTime );
+}
+
+/*
+================
+sdMasterWorker::HandleDeleteSession
+================
+*/
+void sdMasterWorker::HandleDeleteSession( sdMsgReader& msg, const sockaddr_in& from ) {
+	const u64 address = Msr_PackAddress( from.sin_addr.s_addr, from.sin_port );
+	if ( sessions.Remove( address ) ) {
+		journal.LogRemove( address );
+	}
+}
+
+/*
+================
+sdMasterWorker::HandleFindSessions
+
+merges the published snapshots of every shard into "sessions" packets,
+unfiltered queries are answered from the pages worker 0 built from them
+
+	request:	byte source (sessionSource_e), optional filter block, see sdSessionFilter
+	reply:		short packetIndex, short numPackets, short count, count * ( long ip, short port )
+================
+*/
+void sdMasterWorker::HandleFindSessions( sdMsgReader& msg, const sockaddr_in& from ) {
+	int source = msg.ReadByte();
+	sdSessionFilter filter;
+	if ( msg.IsOverflowed() || !filter.Read( msg ) ) {
+		stats.malformed++;
+		return;
+	}
+
+	if ( filter.IsEmpty() ) {
+		const sessionPages_t* pages = server->GetWorker( 0 ).GetSessionPages( source );
+		if ( pages != NULL ) {
+			for ( int i = 0; i < pages->numPackets; i++ ) {
+				QueueReply( pages->GetPacket( i ), pages->GetPacketLength( i ), from );
+			}
+			stats.pagedFinds++;
+			return;
+		}
+	}
+
+	findResults.clear();
+	const int numWorkers = server->GetNumWorkers();
+	for ( int i = 0; i < numWorkers; i++ ) {
+		const sessionSnapshot_t& s = *server->GetWorker( i ).GetSnapshot();
+		for ( int j = 0; j < s.numEntries; j++ ) {
+			if ( !sessionSnapshot_t::MatchesSource( s.flags[ j ], ( sessionSource_e )source ) ) {
+				continue;
+			}
+			if ( filter.IsFiltered( s, j ) ) {
+				continue;
+			}
+			findResults.push_back( s.addresses[ j ] );
+		}
+	}
+
+	const int numMatches = ( int )findResults.size();
+	const int numPackets = numMatches > 0 ? ( numMatches + SESSIONS_PER_PACKET - 1 ) / SESSIONS_PER_PACKET : 1;
+
+	for ( int packetIndex = 0; packetIndex < numPackets; packetIndex++ ) {
+		int first = packetIndex * SESSIONS_PER_PACKET;
+		int count = numMatches - first < SESSIONS_PER_PACKET ? numMatches - first : SESSIONS_PER_PACKET;
+
+		sdMsgWriter reply = BeginReply();
+		reply.WriteString( "sessions" );
+		reply.WriteShort( packetIndex );
+		reply.WriteShort( numPackets );
+		reply.WriteShort( count );
+		for ( int i = first; i < first + count; i++ ) {
+			u32 ip = Msr_AddressIP( findResults[ i ] );
+			u16 port = Msr_AddressPort( findResults[ i ] );
+			reply.WriteData( &ip, 4 );
+			reply.WriteData( &port, 2 );
+		}
+		EndReply( reply, from );
+	}
+}
+
+/*
+================
+sdMasterWorker::HandleRefreshSessions
+
+sends the sessions that changed since the version the client saw last; a
+client on another generation, one that is too old for the tombstones, or one
+that sends version 0 gets the full list. Removals apply before updates.
+
+	request:	byte source, long generation, long version, optional filter block
+	reply:		short packetIndex, short numPackets, long generation, long version, byte full,
+				short numUpdated, short numRemoved, ( numUpdated + numRemoved ) * ( long ip, short port )
+================
+*/
+void sdMasterWorker::HandleRefreshSessions( sdMsgReader& msg, const sockaddr_in& from ) {
+	int source = msg.ReadByte();
+	u32 generation = msg.ReadLong();
+	u32 since = msg.ReadLong();
+	sdSessionFilter filter;
+	if ( msg.IsOverflowed() || !filter.Read( msg ) ) {
+		stats.malformed++;
+		return;
+	}
+
+	const int numWorkers = server->GetNumWorkers();
+	const sessionSnapshot_t* snapshots[ sdMasterServer::MAX_WORKERS ];
+
+	// the watermarks are read before the snapshots they describe
+	u32 version = server->GetWorker( 0 ).GetPublishedVersion();
+	for ( int i = 1; i < numWorkers; i++ ) {
+		u32 v = server->GetWorker( i ).GetPublishedVersion();
+		if ( Msr_VersionBefore( v, version ) ) {
+			version = v;
+		}
+	}
+
+	bool full = generation != server->GetGeneration() || since == 0 || Msr_VersionBefore( version, since );
+	for ( int i = 0; i < numWorkers; i++ ) {
+		snapshots[ i ] = server->GetWorker( i ).GetSnapshot();
+		if ( Msr_VersionBefore( since, snapshots[ i ]->oldestVersion ) ) {
+			full = true;
+		}
+	}
+
+	findResults.clear();
+	findRemoved.clear();
+	for ( int i = 0; i < numWorkers; i++ ) {
+		const sessionSnapshot_t& s = *snapshots[ i ];
+		for ( int j = 0; j < s.numEntries; j++ ) {
+			if ( !full && Msr_VersionBefore( s.versions[ j ], since ) ) {
+				continue;
+			}
+			if ( !sessionSnapshot_t::MatchesSource( s.flags[ j ], ( sessionSource_e )source ) || filter.IsFiltered( s, j ) ) {
+				// it may have matched before the change
+				if ( !full ) {
+					findRemoved.push_back( s.addresses[ j ] );
+				}
+				continue;
+			}
+			findResults.push_back( s.addresses[ j ] );
+		}
+		if ( full ) {
+			continue;
+		}
+		// tombstones are ordered by version
+		for ( int j = s.numTombstones - 1; j >= 0 && !Msr_VersionBefore( s.tombstones[ j ].version, since ); j-- ) {
+			findRemoved.push_back( s.tombstones[ j ].address );
+		}
+	}
+
+	const int numUpdated = ( int )findResults.size();
+	const int numTotal = numUpdated + ( int )findRemoved.size();
+	const int numPackets = numTotal > 0 ? ( numTotal + SESSIONS_PER_PACKET - 1 ) / SESSIONS_PER_PACKET : 1;
+
+	for ( int packetIndex = 0; packetIndex < numPackets; packetIndex++ ) {
+		int first = packetIndex * SESSIONS_PER_PACKET;
+		int last = numTotal - first < SESSIONS_PER_PACKET ? numTotal : first + SESSIONS_PER_PACKET;
+		int packetUpdated = ( last < numUpdated ? last : numUpdated ) - first;
+		if ( packetUpdated < 0 ) {
+			packetUpdated = 0;
+		}
+
+		sdMsgWriter reply = BeginReply();
+		reply.WriteString( "sessionsDelta" );
+		reply.WriteShort( packetIndex );
+		reply.WriteShort( numPackets );
+		reply.WriteLong( server->GetGeneration() );
+		reply.WriteLong( version );
+		reply.WriteByte( full ? 1 : 0 );
+		reply.WriteShort( packetUpdated );
+		reply.WriteShort( last - first - packetUpdated );
+		for ( int i = first; i < last; i++ ) {
+			u64 address = i < numUpdated ? findResults[ i ] : findRemoved[ i - numUpdated ];
+			u32 ip = Msr_AddressIP( address );
+			u16 port = Msr_AddressPort( address );
+			reply.WriteData( &ip, 4 );
+			reply.WriteData( &port, 2 );
+		}
+		EndReply( reply, from );
+	}
+}
+
+/*
+================
+sdMasterWorker::HandleServerInterest
+
+sdHotServerList::SendServerInterestMessages, the address is in the same
+byte order as in the sessions reply
+================
+*/
+void sdMasterWorker::HandleServerInterest( sdMsgReader& msg, const sockaddr_in& from ) {
+	u32 ip = msg.ReadLong();
+	u16 port = ( u16 )msg.ReadShort();
+	if ( msg.IsOverflowed() ) {
+		stats.malformed++;
+		return;
+	}
+
+	if ( !interest.Register( Msr_PackAddress( ip, port ), Msr_PackAddress( from.sin_addr.s_addr, from.sin_port ), sdInterestCounters::CurrentEpoch() ) ) {
+		stats.interestDropped++;
+	}
+}
+
+/*
+================
+sdMasterWorker::HandlePingReport
+
+round trips the client's browser measured to the listed sessions; the
+client's coordinate moves right away, the sessions' are moved by the workers
+that own them on their next tick
+
+	request:	byte count, count * ( long ip, short port, short msec )
+================
+*/
+void sdMasterWorker::HandlePingReport( sdMsgReader& msg, const sockaddr_in& from ) {
+	int count = msg.ReadByte();
+	if ( msg.IsOverflowed() || count > MAX_PING_SAMPLES || msg.GetRemaining() < count * 8 ) {
+		stats.malformed++;
+		return;
+	}
+
+	netCoord_t* client = clientCoords.FindOrAdd( from.sin_addr.s_addr, Sys_Milliseconds() );
+	if ( client == NULL ) {
+		stats.coordDropped += count;
+		return;
+	}
+
+	const int numWorkers = server->GetNumWorkers();
+	for ( int i = 0; i < count; i++ ) {
+		u32 ip = msg.ReadLong();
+		u16 port = ( u16 )msg.ReadShort();
+		int msec = ( u16 )msg.ReadShort();
+		if ( msec == 0 || msec > COORD_MAX_RTT ) {
+			continue;
+		}
+
+		const u64 address = Msr_PackAddress( ip, port );
+		int owner = 0;
+		int entry = -1;
+		const sessionSnapshot_t* s = NULL;
+		for ( ; owner < numWorkers; owner++ ) {
+			s = server->GetWorker( owner ).GetSnapshot();
+			entry = s->Find( address );
+			if ( entry >= 0 ) {
+				break;
+			}
+		}
+		if ( entry < 0 ) {
+			continue;
+		}
+
+		coordSample_t sample;
+		sample.server = address;
+		sample.client = *client;
+		sample.rtt = ( float )msec;
+		if ( !server->GetCoordQueue( index, owner ).Push( sample ) ) {
+			stats.coordDropped++;
+		}
+
+		client->Update( s->coords[ entry ], ( float )msec, ( u32 )address ^ from.sin_addr.s_addr );
+		stats.pingSamples++;
+	}
+}
+
+/*
+================
+sdMasterWorker::HandleEstimatePings
+
+the estimated round trip from the client to every session of the source that
+has a coordinate; nothing is listed until the client reported pings itself
+
+	request:	byte source
+	reply:		short packetIndex, short numPackets, short count, count * ( long ip, short port, short msec )
+================
+*/
+void sdMasterWorker::HandleEstimatePings( sdMsgReader& msg, const sockaddr_in& from ) {
+	int source = msg.ReadByte();
+	if ( msg.IsOverflowed() ) {
+		stats.malformed++;
+		return;
+	}
+
+	findResults.clear();
+	findPings.clear();
+
+	const netCoord_t* client = clientCoords.Find( from.sin_addr.s_addr, Sys_Milliseconds() );
+	if ( client != NULL && client->IsKnown() ) {
+		const int numWorkers = server->GetNumWorkers();
+		for ( int i = 0; i < numWorkers; i++ ) {
+			const sessionSnapshot_t& s = *server->GetWorker( i ).GetSnapshot();
+			for ( int j = 0; j < s.numEntries; j++ ) {
+				if ( !sessionSnapshot_t::MatchesSource( s.flags[ j ], ( sessionSource_e )source ) || !s.coords[ j ].IsKnown() ) {
+					continue;
+				}
+				int msec = ( int )( client->Distance( s.coords[ j ] ) + 0.5f );
+				findResults.push_back( s.addresses[ j ] );
+				findPings.push_back( ( u16 )( msec < 1 ? 1 : ( msec > 0xffff ? 0xffff : msec ) ) );
+			}
+		}
+	}
+
+	const int numMatches = ( int )findResults.size();
+	const int numPackets = numMatches > 0 ? ( numMatches + PINGS_PER_PACKET - 1 ) / PINGS_PER_PACKET : 1;
+
+	for ( int packetIndex = 0; packetIndex < numPackets; packetIndex++ ) {
+		int first = packetIndex * PINGS_PER_PACKET;
+		int count = numMatches - first < PINGS_PER_PACKET ? numMatches - first : PINGS_PER_PACKET;
+
+		sdMsgWriter reply = BeginReply();
+		reply.WriteString( "sessionPings" );
+		reply.WriteShort( packetIndex );
+		reply.WriteShort( numPackets );
+		reply.WriteShort( count );
+		for ( int i = first; i < first + count; i++ ) {
+			u32 ip = Msr_AddressIP( findResults[ i ] );
+			u16 port = Msr_AddressPort( findResults[ i ] );
+			reply.WriteData( &ip, 4 );
+			reply.WriteData( &port, 2 );
+			reply.WriteShort( findPings[ i ] );
+		}
+		EndReply( reply, from );
+	}
+}
@@ -0,0 +1,197 @@
+
+#ifndef __MSR_MASTERWORKER_H__
+#define __MSR_MASTERWORKER_H__
+
+#include "Common.h"
+#include "InterestCounters.h"
+#include "Log.h"
+#include "SessionJournal.h"
+#include "SessionPages.h"
+#include "SessionRegistry.h"
+#include "SourceLimiter.h"
+#include "StatusCache.h"
+
+#include <atomic>
+#include <vector>
+
+struct mmsghdr;
+struct iovec;
+struct sockaddr_in;
+class sdMsgReader;
+class sdMsgWriter;
+class sdMasterServer;
+
+/*
+===============================================================================
+
+	sdMasterWorker
+
+	One non-blocking epoll reactor per core. Every worker binds its own
+	SO_REUSEPORT socket and owns one shard of the session registry, so the
+	OOB path never touches another worker's state. Full list queries read the
+	other shards through their published snapshots.
+
+===============================================================================
+*/
+
+class sdMasterWorker {
+public:
+	static const int			MAX_EVENTS				= 16;
+	static const int			MAX_PACKETS_PER_WAKE	= 256;		// keep the timer and wake fds responsive under load
+	static const int			PACKET_BATCH			= 64;		// datagrams per recvmmsg / sendmmsg
+	static const int			TICK_MSEC				= 100;
+	static const int			STATS_INTERVAL			= 10 * 1000;
+	static const int			SESSIONS_PER_PACKET		= 200;
+	static const int			PINGS_PER_PACKET		= 150;
+	static const int			MAX_PING_SAMPLES		= 64;		// per pingReport
+
+	static const int			SESSION_UPDATE_INTERVAL	= 10 * 60 * 1000;	// same as sdNetManager
+	static const int			SESSION_TIMEOUT			= 2 * SESSION_UPDATE_INTERVAL + 60 * 1000;
+
+	enum oobCommand_e {
+		OOB_GETSTATUS,
+		OOB_CHALLENGE,
+		OOB_CONNECT,
+		OOB_DOWNLOADREQUEST,
+		OOB_UPDATESESSION,
+		OOB_DELETESESSION,
+		OOB_FINDSESSIONS,
+		OOB_REFRESHSESSIONS,
+		OOB_SERVERINTEREST,
+		OOB_PINGREPORT,
+		OOB_ESTIMATEPINGS,
+		OOB_NUM_COMMANDS
+	};
+
+	struct stats_t {
+		u64						packetsIn;
+		u64						packetsOut;
+		u64						bytesIn;
+		u64						bytesOut;
+		u64						malformed;
+		u64						unknown;
+		u64						sendFailures;
+		u64						recvBatches;		// recvmmsg calls that returned packets
+		u64						sendBatches;		// sendmmsg calls that sent packets
+		u64						interestDropped;	// serverInterest that found no room in the counters
+		u64						badChallenges;		// connect or downloadRequest with a stale or forged challenge
+		u64						throttled;			// dropped by the source limiter
+		u64						pagedFinds;			// findSessions answered from the prebuilt pages
+		u64						pageBuilds;			// only worker 0 builds them
+		u64						pingSamples;		// pingReport samples for a known session
+		u64						coordDropped;		// samples that found no room in the client table or the queue
+		u64						commands[ OOB_NUM_COMMANDS ];
+	};
+
+								sdMasterWorker( void );
+								~sdMasterWorker( void );
+
+	bool						Init( sdMasterServer& server, int index );
+	void						Shutdown( void );
+
+								// runs the reactor until Stop is called
+	void						Run( void );
+								// safe to call from a signal handler or another thread
+	void						Stop( void );
+
+	const stats_t&				GetStats( void ) const { return stats; }
+	u64							GetNumLogDropped( void ) const { return log.GetNumDropped(); }
+
+								// only valid while the calling worker is online, see sdEpochManager
+	const sessionSnapshot_t*	GetSnapshot( void ) const { return snapshot.load( std::memory_order_acquire ); }
+								// every change of this shard before this version is in the snapshot, load it before the snapshot
+	u32							GetPublishedVersion( void ) const { return publishedVersion.load( std::memory_order_acquire ); }
+								// read by the workers that own the sessions
+	const sdInterestCounters&	GetInterest( void ) const { return interest; }
+								// unfiltered findSessions replies, NULL for the LAN sources or until worker 0 built them,
+								// only valid while the calling worker is online
+	const sessionPages_t*		GetSessionPages( int source ) const;
+
+private:
+	typedef void				( sdMasterWorker::*oobHandler_t )( sdMsgReader& msg, const sockaddr_in& from );
+
+	struct oobHandlerDef_t {
+		const char*				name;
+		oobCommand_e			command;
+		oobHandler_t			handler;
+	};
+
+	static const oobHandlerDef_t	oobHandlers[ OOB_NUM_COMMANDS ];
+
+	void						ReadPackets( void );
+	void						OnTick( void );
+	void						PrintStats( void );
+	void						PublishSnapshot( void );
+	void						PublishSessionPages( void );
+	void						UpdateInterest( u32 epoch );
+	void						ApplyCoordSamples( void );
+
+	void						ProcessPacket( const byte* data, int length, const sockaddr_in& from );
+
+								// replies are queued into the send batch and flushed with one sendmmsg
+	sdMsgWriter					BeginReply( void );
+	void						EndReply( const sdMsgWriter& reply, const sockaddr_in& to );
+	void						FlushReplies( void );
+								// queues a prebuilt datagram that stays valid until the batch is flushed
+	void						QueueReply( const byte* data, int length, const sockaddr_in& to );
+
+	void						HandleGetStatus( sdMsgReader& msg, const sockaddr_in& from );
+	void						HandleChallenge( sdMsgReader& msg, const sockaddr_in& from );
+	void						HandleConnect( sdMsgReader& msg, const sockaddr_in& from );
+	void						HandleDownloadRequest( sdMsgReader& msg, const sockaddr_in& from );
+	void						HandleUpdateSession( sdMsgReader& msg, const sockaddr_in& from );
+	void						HandleDeleteSession( sdMsgReader& msg, const sockaddr_in& from );
+	void						HandleFindSessions( sdMsgReader& msg, const sockaddr_in& from );
+	void						HandleRefreshSessions( sdMsgReader& msg, const sockaddr_in& from );
+	void						HandleServerInterest( sdMsgReader& msg, const sockaddr_in& from );
+	void						HandlePingReport( sdMsgReader& msg, const sockaddr_in& from );
+	void						HandleEstimatePings( sdMsgReader& msg, const sockaddr_in& from );
+
+								// counts the failures
+	bool						IsValidChallenge( u32 challenge, const sockaddr_in& from );
+
+	sdMasterServer*				server;
+	int							index;
+
+	int							socketFd;
+	int							epollFd;
+	int							timerFd;
+	int							wakeFd;
+	std::atomic< bool >			running;
+
+								// one BUFFSZ slot per datagram of a batch, allocated once in Init
+	byte*						recvBuffers;
+	byte*						sendBuffers;
+	struct mmsghdr*				recvHeaders;
+	struct mmsghdr*				sendHeaders;
+	struct iovec*				recvVecs;
+	struct iovec*				sendVecs;
+	struct sockaddr_in*			recvAddrs;
+	struct sockaddr_in*			sendAddrs;
+	int							numReplies;
+
+	sdSessionRegistry			sessions;
+	sdSessionJournal			journal;
+	std::atomic< sessionSnapshot_t* >	snapshot;
+	std::atomic< u32 >			publishedVersion;
+	std::atomic< sessionPages_t* >	sessionPages[ sessionPages_t::NUM_SOURCES ];
+	std::vector< u64 >			findResults;		// scratch for HandleFindSessions / HandleRefreshSessions
+	std::vector< u64 >			findRemoved;
+	std::vector< u16 >			findPings;			// scratch for HandleEstimatePings
+
+	sdStatusCache				statusCache;
+
+	sdInterestCounters			interest;
+	u32							interestEpoch;
+
+	sdSourceLimiter				limiter;
+
+	sdClientCoords				clientCoords;
+
+	int							nextStatsTime;
+
+	stats_t						stats;
+	sdLogQueue					log;
+};
+
+#endif /* !__MSR_MASTERWORKER_H__ */
@@ -0,0 +1,2057 @@
+
+#include "AddressHash.h"
+#include "Common.h"
+#include "InterestCounters.h"
+#include "Leaderboard.h"
+#include "Msg.h"
+#include "NetCoords.h"
+#include "Presence.h"
+#include "ServerInfo.h"
+#include "SessionFilter.h"
+#include "SessionRegistry.h"
+#include "SourceLimiter.h"
+#include "StatsStore.h"
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <map>
+#include <string>
+#include <strings.h>
+#include <unistd.h>
+#include <vector>
+#include <wchar.h>
+
+/*
+===============================================================================
+
+	msr_microbench
+
+	In process benchmarks of the master's data structures, without sockets.
+	Every test runs over a range of sizes so it shows how the cost scales:
+
+		msr_microbench [-test <name>] [-size <n>]
+
+	Without -size each test runs at 1k, 10k, 100k and 1M.
+
+===============================================================================
+*/
+
+static const int	BENCH_TICK_MSEC		= 100;							// same as sdMasterWorker::TICK_MSEC
+static const int	BENCH_HEARTBEAT		= 10 * 60 * 1000;				// sdMasterWorker::SESSION_UPDATE_INTERVAL
+static const int	BENCH_TIMEOUT		= 2 * BENCH_HEARTBEAT + 60 * 1000;	// sdMasterWorker::SESSION_TIMEOUT
+static const int	BENCH_RATE_LIMIT	= 100;							// sdMasterServer::config_t::rateLimit
+static const int	BENCH_RATE_BURST	= 200;
+
+static u32			benchSeed = 0x2545f491;
+static volatile int	benchSink;		// keeps the compiler from dropping loops whose result is unused
+
+/*
+================
+Bench_Random
+================
+*/
+static u32 Bench_Random( void ) {
+	benchSeed ^= benchSeed << 13;
+	benchSeed ^= benchSeed >> 17;
+	benchSeed ^= benchSeed << 5;
+	return benchSeed;
+}
+
+/*
+================
+Bench_Nanoseconds
+================
+*/
+static u64 Bench_Nanoseconds( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ( u64 )ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+================
+Bench_WheelWrap
+
+Sys_Milliseconds is an int, it turns negative after 24.8 days and the
+difference from the wheel's start leaves the u32 range after 49.7 days. The
+wheel is started at startTime, runs empty for skipMsec, then
+numTimers timers are scheduled up to BENCH_TIMEOUT ahead and the clock is
+ticked past all of them; every timer must fire on the tick its time rounds
+up to, skipMsec keeps the clock on tick boundaries so that is exact. Returns
+the number of timers that fired early, late or never.
+================
+*/
+static int Bench_WheelWrap( int startTime, u32 skipMsec, int numTimers ) {
+	sdTimerWheel wheel;
+	wheel.Init( BENCH_TICK_MSEC, startTime );
+
+	// the wheel has to see the clock at least every 24 days, a worker ticks it every BENCH_TICK_MSEC
+	int now = startTime;
+	int none = 0;
+	auto ignore = [&]( u64 key ) { none++; };
+	for ( u32 skipped = 0; skipped < skipMsec; ) {
+		const u32 step = skipMsec - skipped < 3600 * 1000u ? skipMsec - skipped : 3600 * 1000u;
+		now = ( int )( ( u32 )now + step );
+		skipped += step;
+		wheel.Advance( now, ignore );
+	}
+
+	std::vector< int > dueTimes( numTimers );
+	for ( int i = 0; i < numTimers; i++ ) {
+		dueTimes[ i ] = ( int )( ( u32 )now + 1 + Bench_Random() % BENCH_TIMEOUT );
+		wheel.Schedule( dueTimes[ i ], ( u64 )i );
+	}
+
+	int errors = 0;
+	int numFired = 0;
+	auto expired = [&]( u64 key ) {
+		const int late = ( int )( ( u32 )now - ( u32 )dueTimes[ ( int )key ] );
+		errors += late < 0 || late >= BENCH_TICK_MSEC;
+		numFired++;
+	};
+	for ( int tick = 0; tick <= BENCH_TIMEOUT / BENCH_TICK_MSEC + 1; tick++ ) {
+		now = ( int )( ( u32 )now + BENCH_TICK_MSEC );
+		wheel.Advance( now, expired );
+	}
+
+	return errors + ( numTimers - numFired ) + none;
+}
+
+/*
+================
+Bench_Wheel
+
+numSessions sessions heartbeat every BENCH_HEARTBEAT with their phases spread
+evenly, one in a hundred stops after the first advertisement and has to be
+expired. Simulates BENCH_TIMEOUT plus a minute of ticks and compares the cost
+of a wheel tick against the full sweep sdSessionRegistry::Expire used to do.
+Bench_WheelWrap checks the timers across both clock wraps on top.
+================
+*/
+static void Bench_Wheel( int numSessions ) {
+	const int heartbeatTicks = BENCH_HEARTBEAT / BENCH_TICK_MSEC;
+	const int numTicks = ( BENCH_TIMEOUT + 60 * 1000 ) / BENCH_TICK_MSEC;
+
+	sdTimerWheel wheel;
+	wheel.Init( BENCH_TICK_MSEC, 0 );
+
+	std::vector< int > timers( numSessions );
+	std::vector< int > phases( numSessions );
+	std::vector< bool > dead( numSessions );
+	std::vector< std::vector< int > > heartbeats( heartbeatTicks );
+	for ( int i = 0; i < numSessions; i++ ) {
+		phases[ i ] = ( int )( ( u64 )i * heartbeatTicks / numSessions );
+		dead[ i ] = Bench_Random() % 100 == 0;
+		timers[ i ] = wheel.Schedule( phases[ i ] * BENCH_TICK_MSEC + BENCH_TIMEOUT, ( u64 )i );
+		heartbeats[ phases[ i ] ].push_back( i );
+	}
+
+	int numExpired = 0;
+	auto expired = [&]( u64 key ) { timers[ ( int )key ] = sdTimerWheel::INVALID_TIMER; numExpired++; };
+
+	u64 advanceTime = 0;
+	u64 maxAdvanceTime = 0;
+	u64 rescheduleTime = 0;
+	int numReschedules = 0;
+
+	for ( int tick = 1; tick <= numTicks; tick++ ) {
+		const int now = tick * BENCH_TICK_MSEC;
+
+		u64 start = Bench_Nanoseconds();
+		const std::vector< int >& due = heartbeats[ tick % heartbeatTicks ];
+		for ( size_t j = 0; j < due.size(); j++ ) {
+			int i = due[ j ];
+			if ( !dead[ i ] ) {
+				wheel.Reschedule( timers[ i ], now + BENCH_TIMEOUT );
+				numReschedules++;
+			}
+		}
+		u64 mid = Bench_Nanoseconds();
+		wheel.Advance( now, expired );
+		u64 end = Bench_Nanoseconds();
+
+		rescheduleTime += mid - start;
+		advanceTime += end - mid;
+		if ( end - mid > maxAdvanceTime ) {
+			maxAdvanceTime = end - mid;
+		}
+	}
+
+	// what a tick cost before: every EXPIRE_INTERVAL the whole registry was compared against the cutoff
+	std::vector< int > lastUpdateTimes( numSessions );
+	for ( int i = 0; i < numSessions; i++ ) {
+		lastUpdateTimes[ i ] = ( int )( Bench_Random() % BENCH_TIMEOUT );
+	}
+	const int numSweeps = 20;
+	int numSwept = 0;
+	u64 start = Bench_Nanoseconds();
+	for ( int s = 0; s < numSweeps; s++ ) {
+		const int oldestTime = ( int )( Bench_Random() % BENCH_TIMEOUT );
+		for ( int i = numSessions - 1; i >= 0; i-- ) {
+			numSwept += lastUpdateTimes[ i ] - oldestTime < 0;
+		}
+	}
+	u64 sweepTime = ( Bench_Nanoseconds() - start ) / numSweeps / 1000;
+	benchSink = numSwept;
+
+	// a minute before Sys_Milliseconds turns negative, and before the u32 offset from the start wraps
+	const int wrapTimers = numSessions < 10000 ? numSessions : 10000;
+	int wrapErrors = Bench_WheelWrap( INT_MAX - 60 * 1000, 0, wrapTimers );
+	wrapErrors += Bench_WheelWrap( 12345, ( 0xffffffffu - 60 * 1000 ) / BENCH_TICK_MSEC * BENCH_TICK_MSEC, wrapTimers );
+
+	Msr_Printf( "%8d sessions: tick %6.0f nsec (max %6llu), heartbeat %5.1f nsec, expired %6d, full sweep %7llu usec, wrap errors %d\n",
+		numSessions, ( double )advanceTime / numTicks, ( unsigned long long )maxAdvanceTime,
+		numReschedules != 0 ? ( double )rescheduleTime / numReschedules : 0.0,
+		numExpired, ( unsigned long long )sweepTime, wrapErrors );
+}
+
+/*
+================
+Bench_Limiter
+
+numSources well behaved clients send one packet a second each while a single
+abusive source sends ten times as much as all of them together (at least 100k
+packets a second), for ten simulated seconds through one worker's limiter.
+The clients should all get through and the abusive source should be held at
+the rate limit.
+================
+*/
+static void Bench_Limiter( int numSources ) {
+	const int numMsec = 10 * 1000;
+	const int floodPerMsec = numSources / 100 > 100 ? numSources / 100 : 100;
+	const u32 floodIP = 0xc0a80001;
+
+	sdSourceLimiter limiter;
+	limiter.Init( BENCH_RATE_LIMIT, BENCH_RATE_BURST );
+
+	u64 numLegit = 0;
+	u64 legitAdmitted = 0;
+	u64 numFlood = 0;
+	u64 floodAdmitted = 0;
+
+	u64 start = Bench_Nanoseconds();
+	for ( int now = 0; now < numMsec; now++ ) {
+		for ( int i = 0; i < floodPerMsec; i++ ) {
+			numFlood++;
+			floodAdmitted += limiter.Admit( floodIP, now );
+		}
+		for ( int i = now % 1000; i < numSources; i += 1000 ) {
+			numLegit++;
+			legitAdmitted += limiter.Admit( 0x0a000000 + i, now );
+		}
+	}
+	u64 elapsed = Bench_Nanoseconds() - start;
+
+	Msr_Printf( "%8d sources: admit %5.1f nsec, clients admitted %6.2f%%, flood %9llu / sec admitted %5llu / sec, untracked %llu\n",
+		numSources, ( double )elapsed / ( numLegit + numFlood ), 100.0 * legitAdmitted / numLegit,
+		( unsigned long long )( numFlood * 1000 / numMsec ), ( unsigned long long )( floodAdmitted * 1000 / numMsec ),
+		( unsigned long long )limiter.GetNumUntracked() );
+}
+
+/*
+================
+Bench_Coords
+
+numHosts servers and as many clients at random spots of a 200 msec wide plane
+with 1 to 20 msec access links, every round trip measured with up to 10%
+jitter. Every client reports pings to 8 random servers a round for 50 rounds,
+then the estimates for random client / server pairs are compared against the
+real round trips.
+================
+*/
+static void Bench_Coords( int numHosts ) {
+	const int numRounds = 50;
+	const int pingsPerRound = 8;
+	const int numChecks = 100000;
+
+	struct host_t {
+		float				x;
+		float				y;
+		float				access;
+		netCoord_t			coord;
+	};
+
+	auto random = []( float range ) { return ( Bench_Random() & 0xffffff ) * ( range / 16777216.0f ); };
+	auto rtt = []( const host_t& a, const host_t& b ) {
+		float dx = a.x - b.x;
+		float dy = a.y - b.y;
+		return sqrtf( dx * dx + dy * dy ) + a.access + b.access;
+	};
+
+	std::vector< host_t > servers( numHosts );
+	std::vector< host_t > clients( numHosts );
+	for ( int i = 0; i < numHosts; i++ ) {
+		host_t* hosts[ 2 ] = { &servers[ i ], &clients[ i ] };
+		for ( int j = 0; j < 2; j++ ) {
+			hosts[ j ]->x = random( 200.0f );
+			hosts[ j ]->y = random( 200.0f );
+			hosts[ j ]->access = 1.0f + random( 19.0f );
+			hosts[ j ]->coord.Init();
+		}
+	}
+
+	u64 numUpdates = 0;
+	u64 start = Bench_Nanoseconds();
+	for ( int round = 0; round < numRounds; round++ ) {
+		for ( int i = 0; i < numHosts; i++ ) {
+			host_t& client = clients[ i ];
+			for ( int j = 0; j < pingsPerRound; j++ ) {
+				host_t& server = servers[ Bench_Random() % numHosts ];
+				float measured = rtt( client, server ) * ( 1.0f + random( 0.1f ) );
+				// the server moves by the client's coordinate from before the sample, like a queued sample
+				netCoord_t before = client.coord;
+				client.coord.Update( server.coord, measured, Bench_Random() );
+				server.coord.Update( before, measured, Bench_Random() );
+				numUpdates += 2;
+			}
+		}
+	}
+	u64 updateTime = Bench_Nanoseconds() - start;
+
+	std::vector< float > errors( numChecks );
+	float sum = 0.0f;
+	start = Bench_Nanoseconds();
+	for ( int i = 0; i < numChecks; i++ ) {
+		const host_t& client = clients[ Bench_Random() % numHosts ];
+		const host_t& server = servers[ Bench_Random() % numHosts ];
+		float estimate = client.coord.Distance( server.coord );
+		sum += estimate;
+		errors[ i ] = fabsf( estimate - rtt( client, server ) ) / rtt( client, server );
+	}
+	u64 checkTime = Bench_Nanoseconds() - start;
+	benchSink = ( int )sum;
+
+	std::sort( errors.begin(), errors.end() );
+	Msr_Printf( "%8d hosts: update %5.1f nsec, estimate %5.1f nsec, relative error median %5.1f%% p90 %5.1f%%\n",
+		numHosts, ( double )updateTime / numUpdates, ( double )checkTime / numChecks,
+		100.0f * errors[ numChecks / 2 ], 100.0f * errors[ numChecks * 9 / 10 ] );
+}
+
+/*
+================
+Bench_Leaderboard
+
+numPlayers players upload a random score, then as many uploads add to random
+players' totals. Times the updates, rank lookups and 50 entry pages at random
+offsets against sorting the board once per query, and checks a sample of
+ranks and pages against the sorted board.
+================
+*/
+static void Bench_Leaderboard( int numPlayers ) {
+	const int numQueries = 100000;
+	const int pageSize = 50;
+
+	sdLeaderboard board( sdStatsStore::SVT_INT );
+
+	u64 start = Bench_Nanoseconds();
+	for ( int i = 0; i < numPlayers; i++ ) {
+		board.Add( i + 1, Bench_Random() % 100000 );
+	}
+	u64 insertTime = Bench_Nanoseconds() - start;
+
+	start = Bench_Nanoseconds();
+	for ( int i = 0; i < numPlayers; i++ ) {
+		board.Add( Bench_Random() % numPlayers + 1, Bench_Random() % 1000 );
+	}
+	u64 updateTime = Bench_Nanoseconds() - start;
+
+	int sum = 0;
+	start = Bench_Nanoseconds();
+	for ( int i = 0; i < numQueries; i++ ) {
+		sum += board.GetRank( Bench_Random() % numPlayers + 1 );
+	}
+	u64 rankTime = Bench_Nanoseconds() - start;
+
+	sdLeaderboard::entry_t page[ pageSize ];
+	start = Bench_Nanoseconds();
+	for ( int i = 0; i < numQueries; i++ ) {
+		sum += board.GetRange( Bench_Random() % numPlayers, pageSize, page );
+	}
+	u64 pageTime = Bench_Nanoseconds() - start;
+	benchSink = sum;
+
+	// what every query would cost without the tree
+	std::vector< sdLeaderboard::entry_t > sorted( numPlayers );
+	start = Bench_Nanoseconds();
+	sorted.resize( board.GetRange( 0, numPlayers, sorted.data() ) );
+	std::sort( sorted.begin(), sorted.end(), []( const sdLeaderboard::entry_t& a, const sdLeaderboard::entry_t& b ) {
+		return ( int )a.value != ( int )b.value ? ( int )a.value > ( int )b.value : a.client < b.client;
+	} );
+	u64 sortTime = Bench_Nanoseconds() - start;
+
+	int errors = 0;
+	for ( int i = 0; i < 1000; i++ ) {
+		int rank = Bench_Random() % numPlayers;
+		errors += board.GetRank( sorted[ rank ].client ) != rank;
+		int num = board.GetRange( rank, pageSize, page );
+		for ( int j = 0; j < num; j++ ) {
+			errors += page[ j ].client != sorted[ rank + j ].client;
+		}
+	}
+
+	Msr_Printf( "%8d players: insert %6.1f nsec, update %6.1f nsec, rank %6.1f nsec, page of %d %7.1f nsec, sort per query %9.1f usec, errors %d\n",
+		numPlayers, ( double )insertTime / numPlayers, ( double )updateTime / numPlayers, ( double )rankTime / numQueries,
+		pageSize, ( double )pageTime / numQueries, sortTime / 1000.0, errors );
+}
+
+/*
+================
+Ref_StripColors
+
+what sdStringBuilder_Heap::AppendNoColors leaves of a serverInfo value
+================
+*/
+static std::string Ref_StripColors( const char* s ) {
+	std::string out;
+	while ( *s != '\0' ) {
+		if ( s[ 0 ] == '^' && s[ 1 ] != '\0' && s[ 1 ] != ' ' ) {
+			s += 2;
+			continue;
+		}
+		out += *s++;
+	}
+	return out;
+}
+
+/*
+================
+Ref_Lower
+================
+*/
+static std::string Ref_Lower( const std::string& s ) {
+	std::string out = s;
+	for ( size_t i = 0; i < out.size(); i++ ) {
+		if ( out[ i ] >= 'A' && out[ i ] <= 'Z' ) {
+			out[ i ] += 'a' - 'A';
+		}
+	}
+	return out;
+}
+
+struct refSession_t {
+	u64						address;
+	bool					repeater;
+	bool					ranked;
+	int						numClients;
+	int						numBots;
+	int						numRepeaterClients;
+	int						maxRepeaterClients;
+	std::vector< std::pair< std::string, std::string > >	serverInfo;
+	int						ping;				// client only
+	bool					favorite;			// client only
+	bool					friends;			// client only
+
+	const char*				GetString( const char* key ) const {
+								for ( size_t i = 0; i < serverInfo.size(); i++ ) {
+									if ( !strcasecmp( serverInfo[ i ].first.c_str(), key ) ) {
+										return serverInfo[ i ].second.c_str();
+									}
+								}
+								return "";
+							}
+	bool					GetBool( const char* key ) const { return atoi( GetString( key ) ) != 0; }
+};
+
+struct refNumericFilter_t {
+	int						type;
+	int						state;
+	int						op;
+	int						resultBin;
+	float					value;
+};
+
+struct refStringFilter_t {
+	int						state;
+	int						op;
+	int						resultBin;
+	std::string				key;
+	std::string				value;
+};
+
+/*
+================
+Ref_NumericValue
+================
+*/
+static float Ref_NumericValue( const refSession_t& session, int type ) {
+	switch ( type ) {
+		case SFT_PASSWORDED:
+			return session.GetBool( "si_needPass" ) ? 1.0f : 0.0f;
+		case SFT_PUNKBUSTER:
+			return session.GetBool( "net_serverPunkbusterEnabled" ) ? 1.0f : 0.0f;
+		case SFT_FRIENDLYFIRE:
+			return session.GetBool( "si_teamDamage" ) ? 1.0f : 0.0f;
+		case SFT_AUTOBALANCE:
+			return session.GetBool( "si_teamForceBalance" ) ? 1.0f : 0.0f;
+		case SFT_PURE:
+			return session.GetBool( "si_pure" ) ? 1.0f : 0.0f;
+		case SFT_LATEJOIN:
+			return session.GetBool( "si_allowLateJoin" ) ? 1.0f : 0.0f;
+		case SFT_EMPTY: {
+				int num = session.repeater ? session.numRepeaterClients : session.numClients;
+				return ( num == 0 ) ? 1.0f : 0.0f;
+			}
+		case SFT_FULL: {
+				int num = session.repeater ? session.numRepeaterClients : session.numClients;
+				int max = session.repeater ? session.maxRepeaterClients : atoi( session.GetString( "si_maxPlayers" ) );
+				return ( num == max ) ? 1.0f : 0.0f;
+			}
+		case SFT_PING:
+			return session.ping;
+		case SFT_MAXBOTS:
+			return session.numBots;
+		case SFT_FAVORITE:
+			return session.favorite;
+		case SFT_RANKED:
+			return session.ranked ? 1.0f : 0.0f;
+		case SFT_FRIENDS:
+			return session.friends ? 1.0f : 0.0f;
+		case SFT_PLAYERCOUNT:
+			return session.repeater ? session.numRepeaterClients : ( session.numClients - session.numBots );
+		case SFT_MODS:
+			return ( session.GetString( "fs_game" )[ 0 ] != '\0' ) ? 1.0f : 0.0f;
+	}
+	return 0.0f;
+}
+
+/*
+================
+Ref_SessionIsFiltered
+
+sdNetManager::SessionIsFiltered as the client shipped it, with ignoreEmptyFilter false,
+the retail filter numbering and no map metadata (si_map compares the raw value)
+================
+*/
+static bool Ref_SessionIsFiltered( const refSession_t& session, const std::vector< refNumericFilter_t >& numericFilters, const std::vector< refStringFilter_t >& stringFilters ) {
+	if ( numericFilters.empty() && stringFilters.empty() ) {
+		return false;
+	}
+
+	bool visible = true;
+	bool orFilters = false;
+	bool orSet = false;
+
+	for ( size_t i = 0; i < numericFilters.size() && visible; i++ ) {
+		const refNumericFilter_t& filter = numericFilters[ i ];
+		if ( filter.state == SFS_DONTCARE ) {
+			continue;
+		}
+		if ( filter.type == SFT_BOTS ) {
+			continue;
+		}
+		if ( session.repeater ) {
+			if ( filter.type != SFT_FULL &&
+				filter.type != SFT_EMPTY &&
+				filter.type != SFT_PING &&
+				filter.type != SFT_FRIENDS &&
+				filter.type != SFT_MODS &&
+				filter.type != SFT_PLAYERCOUNT ) {
+				continue;
+			}
+		}
+
+		const float value = Ref_NumericValue( session, filter.type );
+
+		bool result = false;
+		switch ( filter.op ) {
+			case SFO_EQUAL:
+				result = fabsf( value - filter.value ) < FLT_EPSILON;
+				break;
+			case SFO_NOT_EQUAL:
+				result = fabsf( value - filter.value ) >= FLT_EPSILON;
+				break;
+			case SFO_LESS:
+				result = value < filter.value;
+				break;
+			case SFO_GREATER:
+				result = value > filter.value;
+				break;
+		}
+
+		if ( filter.state == SFS_SHOWONLY && !result ) {
+			visible = false;
+			break;
+		}
+
+		if ( filter.resultBin == SFR_OR ) {
+			orFilters |= result;
+			orSet = true;
+		} else if ( result && filter.state == SFS_HIDE ) {
+			visible = false;
+			break;
+		}
+	}
+
+	for ( size_t i = 0; i < stringFilters.size() && visible; i++ ) {
+		const refStringFilter_t& filter = stringFilters[ i ];
+		if ( filter.state == SFS_DONTCARE ) {
+			continue;
+		}
+
+		std::string value = Ref_Lower( Ref_StripColors( session.GetString( filter.key.c_str() ) ) );
+		std::string text = Ref_Lower( Ref_StripColors( filter.value.c_str() ) );
+
+		bool result = false;
+		switch ( filter.op ) {
+			case SFO_EQUAL:
+				result = value == text;
+				break;
+			case SFO_NOT_EQUAL:
+				result = value != text;
+				break;
+			case SFO_CONTAINS:
+				result = value.find( Ref_Lower( filter.value ) ) != std::string::npos;
+				break;
+			case SFO_NOT_CONTAINS:
+				result = value.find( Ref_Lower( filter.value ) ) == std::string::npos;
+				break;
+		}
+
+		if ( filter.state == SFS_SHOWONLY && !result ) {
+			visible = false;
+			break;
+		}
+		if ( result && filter.state != SFS_HIDE && filter.resultBin == SFR_OR ) {
+			orFilters |= result;
+			orSet = true;
+		} else if ( result && filter.state == SFS_HIDE ) {
+			visible = false;
+			break;
+		}
+	}
+
+	if ( orSet ) {
+		visible &= orFilters;
+	}
+
+	return !visible;
+}
+
+/*
+================
+Ref_CompileFilters / Ref_ProgramIsFiltered
+
+sdNetManager::CompileFilters and the SessionIsFiltered that runs its program,
+transcribed; string values are read from the session every time instead of
+once per field
+================
+*/
+enum {
+	REF_FIF_HIDE_IF_TRUE	= 1 << 0,
+	REF_FIF_HIDE_IF_FALSE	= 1 << 1,
+	REF_FIF_OR				= 1 << 2,
+	REF_FIF_OR_IF_TRUE		= 1 << 3,
+	REF_FIF_REPEATER		= 1 << 4,
+};
+
+struct refInstruction_t {
+	int						type;				// SFT_MAX for a string filter
+	int						op;
+	int						flags;
+	float					value;
+	std::string				key;
+	std::string				needle;
+};
+
+static int Ref_CompileFilters( const std::vector< refNumericFilter_t >& numericFilters, const std::vector< refStringFilter_t >& stringFilters, std::vector< refInstruction_t >& program ) {
+	int orOnlyStart = 0;
+	program.clear();
+
+	for ( int pass = 0; pass < 2; pass++ ) {
+		if ( pass == 1 ) {
+			orOnlyStart = ( int )program.size();
+		}
+
+		for ( size_t i = 0; i < numericFilters.size(); i++ ) {
+			const refNumericFilter_t& filter = numericFilters[ i ];
+			if ( filter.state == SFS_DONTCARE || filter.type == SFT_BOTS ) {
+				continue;
+			}
+
+			int flags = 0;
+			if ( filter.state == SFS_SHOWONLY ) {
+				flags |= REF_FIF_HIDE_IF_FALSE;
+			}
+			if ( filter.resultBin == SFR_OR ) {
+				flags |= REF_FIF_OR;
+			} else if ( filter.state == SFS_HIDE ) {
+				flags |= REF_FIF_HIDE_IF_TRUE;
+			}
+			if ( ( ( flags & ( REF_FIF_HIDE_IF_FALSE | REF_FIF_HIDE_IF_TRUE ) ) == 0 ) != ( pass == 1 ) ) {
+				continue;
+			}
+			switch ( filter.type ) {
+				case SFT_FULL:
+				case SFT_EMPTY:
+				case SFT_PING:
+				case SFT_FRIENDS:
+				case SFT_MODS:
+				case SFT_PLAYERCOUNT:
+					flags |= REF_FIF_REPEATER;
+					break;
+			}
+
+			refInstruction_t instruction;
+			instruction.type = filter.type;
+			instruction.op = filter.op;
+			instruction.flags = flags;
+			instruction.value = filter.value;
+			program.push_back( instruction );
+		}
+
+		for ( size_t i = 0; i < stringFilters.size(); i++ ) {
+			const refStringFilter_t& filter = stringFilters[ i ];
+			if ( filter.state == SFS_DONTCARE ) {
+				continue;
+			}
+
+			int flags = REF_FIF_REPEATER;
+			if ( filter.state == SFS_SHOWONLY ) {
+				flags |= REF_FIF_HIDE_IF_FALSE;
+				if ( filter.resultBin == SFR_OR ) {
+					flags |= REF_FIF_OR_IF_TRUE;
+				}
+			} else if ( filter.state == SFS_HIDE ) {
+				flags |= REF_FIF_HIDE_IF_TRUE;
+			}
+			if ( ( ( flags & ( REF_FIF_HIDE_IF_FALSE | REF_FIF_HIDE_IF_TRUE ) ) == 0 ) != ( pass == 1 ) ) {
+				continue;
+			}
+
+			refInstruction_t instruction;
+			instruction.type = SFT_MAX;
+			instruction.op = filter.op;
+			instruction.flags = flags;
+			instruction.value = 0.0f;
+			instruction.key = filter.key;
+			instruction.needle = ( filter.op == SFO_EQUAL || filter.op == SFO_NOT_EQUAL ) ? Ref_StripColors( filter.value.c_str() ) : filter.value;
+			program.push_back( instruction );
+		}
+	}
+	return orOnlyStart;
+}
+
+static bool Ref_ProgramIsFiltered( const refSession_t& session, const std::vector< refInstruction_t >& program, int orOnlyStart ) {
+	bool orFilters = false;
+	bool orSet = false;
+
+	for ( size_t i = 0; i < program.size(); i++ ) {
+		if ( orFilters && ( int )i >= orOnlyStart ) {
+			break;
+		}
+
+		const refInstruction_t& instruction = program[ i ];
+		if ( session.repeater && ( instruction.flags & REF_FIF_REPEATER ) == 0 ) {
+			continue;
+		}
+
+		bool result = false;
+		if ( instruction.type != SFT_MAX ) {
+			const float value = Ref_NumericValue( session, instruction.type );
+			switch ( instruction.op ) {
+				case SFO_EQUAL:
+					result = fabsf( value - instruction.value ) < FLT_EPSILON;
+					break;
+				case SFO_NOT_EQUAL:
+					result = fabsf( value - instruction.value ) >= FLT_EPSILON;
+					break;
+				case SFO_LESS:
+					result = value < instruction.value;
+					break;
+				case SFO_GREATER:
+					result = value > instruction.value;
+					break;
+			}
+		} else {
+			const std::string value = Ref_Lower( Ref_StripColors( session.GetString( instruction.key.c_str() ) ) );
+			const std::string needle = Ref_Lower( instruction.needle );
+			switch ( instruction.op ) {
+				case SFO_EQUAL:
+					result = value == needle;
+					break;
+				case SFO_NOT_EQUAL:
+					result = value != needle;
+					break;
+				case SFO_CONTAINS:
+					result = value.find( needle ) != std::string::npos;
+					break;
+				case SFO_NOT_CONTAINS:
+					result = value.find( needle ) == std::string::npos;
+					break;
+			}
+		}
+
+		if ( result ? ( instruction.flags & REF_FIF_HIDE_IF_TRUE ) != 0 : ( instruction.flags & REF_FIF_HIDE_IF_FALSE ) != 0 ) {
+			return true;
+		}
+		if ( ( instruction.flags & REF_FIF_OR ) != 0 ) {
+			orFilters |= result;
+			orSet = true;
+		} else if ( result && ( instruction.flags & REF_FIF_OR_IF_TRUE ) != 0 ) {
+			orFilters = true;
+			orSet = true;
+		}
+	}
+
+	return orSet && !orFilters;
+}
+
+/*
+================
+Bench_Filter
+
+Differential test of sdSessionFilter against Ref_SessionIsFiltered. numSessions
+random sessions (a quarter of them repeaters) go through sdSessionRegistry,
+then random filter sets are sent the way msr/SessionFilter.h tells a client
+to: si_map string filters are left out, and the whole SFR_OR bin with them
+if one of them was in it. A set the master evaluates in full must agree with
+the client on every session, any other set must never hide a session the
+client shows, and a set with client only filters must come back empty. The
+client's compiled filter program must agree with the shipped client on every
+session and set, repeaters included.
+================
+*/
+static void Bench_Filter( int numSessions ) {
+	static const char* names[] = { "^1Clan ^7Server", "Public", "^2Stopwatch ^3only", "Newbie ^4friendly", "^7", "" };
+	static const char* rules[] = { "sdGameRulesCampaign", "sdGameRulesObjective", "sdGameRulesStopWatch" };
+	static const char* maps[] = { "maps/area22.entities", "maps/salvage", "maps/Valley" };
+	static const char* mods[] = { "", "", "", "mymod" };
+	static const char* keys[] = { "si_name", "si_rules", "si_map", "fs_game", "si_missing" };
+	static const char* needles[] = { "clan", "SERVER", "^1clan server", "public", "stop", "", "sdgamerulescampaign", "valley", "mymod", "x" };
+	static const float values[] = { 0.0f, 1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 24.0f, 32.0f, 0.5f };
+
+	const int numSets = numSessions >= 4000000 ? 1 : 4000000 / numSessions;
+
+	std::atomic< u32 > versionCounter( 1 );
+	sdSessionRegistry registry;
+	registry.SetVersionCounter( &versionCounter );
+
+	std::vector< refSession_t > sessions( numSessions );
+	std::vector< byte > block;
+	for ( int i = 0; i < numSessions; i++ ) {
+		refSession_t& session = sessions[ i ];
+		session.address = Msr_PackAddress( 0x0a000000 + i, 27733 );
+		session.repeater = Bench_Random() % 4 == 0;
+		session.ranked = Bench_Random() % 2 == 0;
+		const int maxPlayers = Bench_Random() % 33;
+		session.numClients = Bench_Random() % 33;
+		session.numBots = Bench_Random() % 8 < 2 ? Bench_Random() % ( session.numClients + 1 ) : 0;
+		session.numRepeaterClients = Bench_Random() % 17;
+		session.maxRepeaterClients = Bench_Random() % 17;
+		session.ping = Bench_Random() % 300;
+		session.favorite = Bench_Random() % 8 == 0;
+		session.friends = Bench_Random() % 8 == 0;
+
+		static const char* boolKeys[] = { "si_needPass", "si_pure", "net_serverPunkbusterEnabled", "si_teamDamage", "si_allowLateJoin", "si_teamForceBalance" };
+		for ( size_t k = 0; k < sizeof( boolKeys ) / sizeof( boolKeys[ 0 ] ); k++ ) {
+			if ( Bench_Random() % 4 != 0 ) {
+				session.serverInfo.push_back( std::make_pair( boolKeys[ k ], Bench_Random() % 2 ? "1" : "0" ) );
+			}
+		}
+		if ( Bench_Random() % 8 != 0 ) {
+			session.serverInfo.push_back( std::make_pair( "si_maxPlayers", std::to_string( maxPlayers ) ) );
+		}
+		session.serverInfo.push_back( std::make_pair( "si_name", names[ Bench_Random() % 6 ] ) );
+		session.serverInfo.push_back( std::make_pair( "si_rules", rules[ Bench_Random() % 3 ] ) );
+		session.serverInfo.push_back( std::make_pair( "si_map", maps[ Bench_Random() % 3 ] ) );
+		session.serverInfo.push_back( std::make_pair( "fs_game", mods[ Bench_Random() % 4 ] ) );
+
+		block.clear();
+		for ( size_t k = 0; k < session.serverInfo.size(); k++ ) {
+			block.insert( block.end(), session.serverInfo[ k ].first.begin(), session.serverInfo[ k ].first.end() );
+			block.push_back( '\0' );
+			block.insert( block.end(), session.serverInfo[ k ].second.begin(), session.serverInfo[ k ].second.end() );
+			block.push_back( '\0' );
+		}
+		block.push_back( '\0' );
+
+		sessionInfo_t info;
+		memset( &info, 0, sizeof( info ) );
+		info.numClients = session.numClients;
+		info.numBots = session.numBots;
+		info.flags = ( session.repeater ? SESSION_FLAG_REPEATER : 0 ) | ( session.ranked ? SESSION_FLAG_RANKED : 0 );
+		info.numRepeaterClients = session.numRepeaterClients;
+		info.maxRepeaterClients = session.maxRepeaterClients;
+		registry.Update( session.address, info, block.data(), ( int )block.size(), BENCH_TIMEOUT );
+	}
+	sessionSnapshot_t* snapshot = registry.BuildSnapshot();
+
+	std::vector< int > entries( numSessions );
+	for ( int i = 0; i < numSessions; i++ ) {
+		entries[ i ] = snapshot->Find( sessions[ i ].address );
+	}
+
+	int numExact = 0;
+	int numSuperset = 0;
+	int numClientOnly = 0;
+	u64 numHidden = 0;
+	u64 errors = 0;
+	u64 refTime = 0;
+	u64 masterTime = 0;
+
+	std::vector< refNumericFilter_t > numericFilters;
+	std::vector< refStringFilter_t > stringFilters;
+	std::vector< bool > refResults( numSessions );
+	std::vector< refInstruction_t > program;
+	u64 programErrors = 0;
+	byte request[ 1400 ];
+
+	for ( int set = 0; set < numSets; set++ ) {
+		numericFilters.resize( Bench_Random() % 6 );
+		for ( size_t i = 0; i < numericFilters.size(); i++ ) {
+			refNumericFilter_t& filter = numericFilters[ i ];
+			filter.type = Bench_Random() % SFT_MAX;
+			filter.state = Bench_Random() % SFS_MAX;
+			filter.op = Bench_Random() % ( SFO_GREATER + 1 );
+			filter.resultBin = Bench_Random() % SFR_MAX;
+			filter.value = values[ Bench_Random() % ( sizeof( values ) / sizeof( values[ 0 ] ) ) ];
+		}
+		stringFilters.resize( Bench_Random() % 4 );
+		for ( size_t i = 0; i < stringFilters.size(); i++ ) {
+			refStringFilter_t& filter = stringFilters[ i ];
+			filter.state = Bench_Random() % SFS_MAX;
+			filter.op = Bench_Random() % 4;
+			filter.op = filter.op < 2 ? filter.op : filter.op - 2 + SFO_CONTAINS;
+			filter.resultBin = Bench_Random() % SFR_MAX;
+			filter.key = keys[ Bench_Random() % ( sizeof( keys ) / sizeof( keys[ 0 ] ) ) ];
+			filter.value = needles[ Bench_Random() % ( sizeof( needles ) / sizeof( needles[ 0 ] ) ) ];
+		}
+
+		// what a client may send
+		bool sendOrBin = true;
+		for ( size_t i = 0; i < stringFilters.size(); i++ ) {
+			if ( stringFilters[ i ].state != SFS_DONTCARE && stringFilters[ i ].resultBin == SFR_OR && stringFilters[ i ].key == "si_map" ) {
+				sendOrBin = false;
+			}
+		}
+
+		bool complete = true;
+		bool clientOnly = false;
+		sdMsgWriter writer( request, sizeof( request ) );
+		int numNumeric = 0;
+		for ( size_t i = 0; i < numericFilters.size(); i++ ) {
+			numNumeric += numericFilters[ i ].state != SFS_DONTCARE && ( numericFilters[ i ].resultBin != SFR_OR || sendOrBin );
+		}
+		writer.WriteByte( numNumeric );
+		for ( size_t i = 0; i < numericFilters.size(); i++ ) {
+			const refNumericFilter_t& filter = numericFilters[ i ];
+			if ( filter.state == SFS_DONTCARE ) {
+				continue;
+			}
+			if ( filter.resultBin == SFR_OR && !sendOrBin ) {
+				complete = false;
+				continue;
+			}
+			if ( filter.type == SFT_PING || filter.type == SFT_FAVORITE || filter.type == SFT_FRIENDS ) {
+				clientOnly = true;
+			}
+			u32 bits;
+			memcpy( &bits, &filter.value, sizeof( bits ) );
+			writer.WriteByte( filter.type );
+			writer.WriteByte( filter.state );
+			writer.WriteByte( filter.op );
+			writer.WriteByte( filter.resultBin );
+			writer.WriteLong( bits );
+		}
+		int numString = 0;
+		for ( size_t i = 0; i < stringFilters.size(); i++ ) {
+			const refStringFilter_t& filter = stringFilters[ i ];
+			numString += filter.state != SFS_DONTCARE && filter.key != "si_map" && ( filter.resultBin != SFR_OR || sendOrBin );
+		}
+		writer.WriteByte( numString );
+		for ( size_t i = 0; i < stringFilters.size(); i++ ) {
+			const refStringFilter_t& filter = stringFilters[ i ];
+			if ( filter.state == SFS_DONTCARE ) {
+				continue;
+			}
+			if ( filter.key == "si_map" || ( filter.resultBin == SFR_OR && !sendOrBin ) ) {
+				complete = false;
+				continue;
+			}
+			writer.WriteByte( filter.state );
+			writer.WriteByte( filter.op );
+			writer.WriteByte( filter.resultBin );
+			writer.WriteString( filter.key.c_str() );
+			writer.WriteString( filter.value.c_str() );
+		}
+
+		sdSessionFilter filter;
+		sdMsgReader reader( request, writer.GetLength() );
+		if ( !filter.Read( reader ) ) {
+			errors++;
+			continue;
+		}
+		if ( clientOnly ) {
+			numClientOnly++;
+			errors += !filter.IsEmpty();
+			complete = false;
+		} else if ( complete ) {
+			numExact++;
+		} else {
+			numSuperset++;
+		}
+
+		u64 start = Bench_Nanoseconds();
+		for ( int i = 0; i < numSessions; i++ ) {
+			refResults[ i ] = Ref_SessionIsFiltered( sessions[ i ], numericFilters, stringFilters );
+		}
+		u64 mid = Bench_Nanoseconds();
+		if ( numSessions * ( set + 1 ) <= 1000000 ) {
+			int orOnlyStart = Ref_CompileFilters( numericFilters, stringFilters, program );
+			for ( int i = 0; i < numSessions; i++ ) {
+				programErrors += Ref_ProgramIsFiltered( sessions[ i ], program, orOnlyStart ) != refResults[ i ];
+			}
+		}
+		u64 masterStart = Bench_Nanoseconds();
+		for ( int i = 0; i < numSessions; i++ ) {
+			bool filtered = filter.IsFiltered( *snapshot, entries[ i ] );
+			numHidden += filtered;
+			// the master may show more than the client, never less, and exactly as much when it saw every filter
+			errors += ( filtered && !refResults[ i ] ) || ( complete && filtered != refResults[ i ] );
+		}
+		masterTime += Bench_Nanoseconds() - masterStart;
+		refTime += mid - start;
+	}
+
+	sessionSnapshot_t::Free( snapshot );
+
+	const double numEvaluated = ( double )numSets * numSessions;
+	Msr_Printf( "%8d sessions: %6d sets (%d exact, %d superset, %d client only), client %5.1f nsec, master %5.1f nsec, hidden %5.1f%%, errors %llu, program errors %llu\n",
+		numSessions, numSets, numExact, numSuperset, numClientOnly, refTime / numEvaluated, masterTime / numEvaluated,
+		100.0 * numHidden / numEvaluated, ( unsigned long long )errors, ( unsigned long long )programErrors );
+}
+
+/*
+================
+Ref_InterestHash
+
+the home slot of a pair, transcribed from sdInterestCounters::Hash
+================
+*/
+static u32 Ref_InterestHash( u64 server, u64 client ) {
+	return sdAddressHash::Hash( server ^ ( client * 0x9e3779b97f4a7c15ULL ) ) & ( sdInterestCounters::PAIR_TABLE_SIZE - 1 );
+}
+
+/*
+================
+Bench_InterestRotateDrop
+
+Rotate rebuilds the pair table in slot order, so pairs that wrapped around
+the end of the table are placed first and can push the pair left at the
+last slot out of its probe range. 32 pairs hashing to the last slot and one
+hashing to slot 0 are laid out so exactly that happens; the dropped pair
+must give its count back. Returns the number of errors.
+================
+*/
+static int Bench_InterestRotateDrop( void ) {
+	const u64 server = Msr_PackAddress( 0x0c000000, 27733 );
+	const u32 lastSlot = sdInterestCounters::PAIR_TABLE_SIZE - 1;
+	const u32 epoch = 1000;
+
+	std::vector< u64 > wrapped;
+	u64 first = 0;
+	for ( u32 ip = 0x0d000000; wrapped.size() < ( size_t )sdInterestCounters::MAX_PROBES || first == 0; ip++ ) {
+		const u64 client = Msr_PackAddress( ip, 27733 );
+		const u32 home = Ref_InterestHash( server, client );
+		if ( home == lastSlot && wrapped.size() < ( size_t )sdInterestCounters::MAX_PROBES ) {
+			wrapped.push_back( client );
+		} else if ( home == 0 && first == 0 ) {
+			first = client;
+		}
+	}
+
+	sdInterestCounters* counters = new sdInterestCounters;
+	int errors = 0;
+
+	// the wrapped pairs take the last slot and slots 0-30, the slot 0 pair lands in 31
+	for ( size_t i = 0; i < wrapped.size(); i++ ) {
+		errors += !counters->Register( server, wrapped[ i ], epoch );
+	}
+	errors += !counters->Register( server, first, epoch );
+	errors += counters->Count( server, epoch ) != ( int )wrapped.size() + 1;
+
+	// the pair in the last slot is rebuilt last and finds slots 0-30 taken
+	counters->Rotate( epoch + 1 );
+	errors += counters->Count( server, epoch + 1 ) != ( int )wrapped.size();
+
+	delete counters;
+	return errors;
+}
+
+/*
+================
+Bench_Interest
+
+numClients clients each come back to three servers of their own (one
+server per eight clients) for 40 buckets; every bucket a client registers
+with probability 1/2, sometimes twice, and one in ten goes quiet for ten
+buckets so its pairs leave the window and their entries get reused. After
+every bucket the window count of every server is compared against a naive
+model: the clients whose last accepted interest is inside the window. The
+counters must never count more than the model, and exactly as much while
+the live pairs fit the pair table at half load. Bench_InterestRotateDrop
+runs once per size on top.
+================
+*/
+static void Bench_Interest( int numClients ) {
+	const int numEpochs = 40;
+	const int numServers = numClients / 8 > 16 ? numClients / 8 : 16;
+	const u32 firstEpoch = 1000;
+
+	sdInterestCounters* counters = new sdInterestCounters;
+	std::map< std::pair< u64, u64 >, u32 > model;		// last accepted epoch of every pair
+	std::vector< int > quietUntil( numClients );
+	std::vector< int > modelCounts( numServers );
+
+	u64 numRegisters = 0;
+	u64 numDropped = 0;
+	u64 registerTime = 0;
+	u64 rotateTime = 0;
+	u64 countTime = 0;
+	u64 numCounts = 0;
+	u64 errors = 0;
+	int maxLive = 0;
+
+	for ( int e = 0; e < numEpochs; e++ ) {
+		const u32 epoch = firstEpoch + e;
+
+		u64 start = Bench_Nanoseconds();
+		counters->Rotate( epoch );
+		rotateTime += Bench_Nanoseconds() - start;
+
+		for ( int c = 0; c < numClients; c++ ) {
+			if ( quietUntil[ c ] > e || Bench_Random() % 2 != 0 ) {
+				continue;
+			}
+			if ( Bench_Random() % 10 == 0 ) {
+				quietUntil[ c ] = e + 10;
+			}
+
+			const u64 client = Msr_PackAddress( 0x0a000000 + c, 27733 );
+			const int repeats = Bench_Random() % 4 == 0 ? 2 : 1;
+			for ( int r = 0; r < repeats; r++ ) {
+				const int s = ( int )( ( ( u64 )c * 7 + Bench_Random() % 3 ) % numServers );
+				const u64 server = Msr_PackAddress( 0x0b000000 + s, 27733 );
+
+				start = Bench_Nanoseconds();
+				bool accepted = counters->Register( server, client, epoch );
+				registerTime += Bench_Nanoseconds() - start;
+				numRegisters++;
+
+				if ( accepted ) {
+					model[ std::make_pair( server, client ) ] = epoch;
+				} else {
+					numDropped++;
+				}
+			}
+		}
+
+		std::fill( modelCounts.begin(), modelCounts.end(), 0 );
+		int numLive = 0;
+		for ( std::map< std::pair< u64, u64 >, u32 >::const_iterator it = model.begin(); it != model.end(); ++it ) {
+			if ( epoch - it->second < ( u32 )sdInterestCounters::NUM_BUCKETS ) {
+				modelCounts[ Msr_AddressIP( it->first.first ) - 0x0b000000 ]++;
+				numLive++;
+			}
+		}
+		maxLive = numLive > maxLive ? numLive : maxLive;
+		const bool exact = numLive <= sdInterestCounters::PAIR_TABLE_SIZE / 2;
+
+		for ( int s = 0; s < numServers; s++ ) {
+			start = Bench_Nanoseconds();
+			int count = counters->Count( Msr_PackAddress( 0x0b000000 + s, 27733 ), epoch );
+			countTime += Bench_Nanoseconds() - start;
+			numCounts++;
+
+			errors += count > modelCounts[ s ] || ( exact && count != modelCounts[ s ] );
+		}
+	}
+
+	delete counters;
+
+	errors += Bench_InterestRotateDrop();
+
+	Msr_Printf( "%8d clients: register %5.1f nsec, rotate %6.1f usec, count %5.1f nsec, live pairs %7d, dropped %5.2f%%, errors %llu\n",
+		numClients, ( double )registerTime / numRegisters, rotateTime / 1000.0 / numEpochs, ( double )countTime / numCounts,
+		maxLive, 100.0 * numDropped / numRegisters, ( unsigned long long )errors );
+}
+
+/*
+================
+Bench_Browser
+
+sdNetManager::UpdateSession transcribed over a stand-in ui list: a cell write
+copies the text and scans it for a <material> or <loc> tag, the way
+sdUIList::SetItemText does. numRows sessions are added to the list, then
+refreshed 20 times; every refresh about half the pings move, one in ten
+player counts and the time left of every timed server change, and one in fifty
+servers is offline. The same passes run once writing only the cells whose
+values differ from the row cache, and once writing every cell like
+g_serverBrowserRenderAll.
+================
+*/
+enum {
+	BENCH_BC_FAVORITE,
+	BENCH_BC_PASSWORD,
+	BENCH_BC_RANKED,
+	BENCH_BC_NAME,
+	BENCH_BC_MAP,
+	BENCH_BC_GAMETYPE_ICON,
+	BENCH_BC_GAMETYPE,
+	BENCH_BC_TIMELEFT,
+	BENCH_BC_PLAYERS,
+	BENCH_BC_PING,
+	BENCH_BC_MAX
+};
+
+struct benchBrowserSession_t {
+	std::string		name;
+	std::string		map;
+	std::string		rules;
+	bool			favorite;
+	bool			needPass;
+	bool			ranked;
+	int				sessionTime;
+	int				numClients;
+	int				maxClients;
+	int				numBots;
+	int				ping;
+};
+
+struct benchRenderedRow_t {
+	bool			valid;
+	bool			offline;
+	bool			favorite;
+	bool			needPass;
+	bool			ranked;
+	std::string		name;
+	std::string		map;
+	std::string		rules;
+	int				sessionTime;
+	int				numClients;
+	int				maxClients;
+	int				numBots;
+	int				ping;
+};
+
+struct benchUIList_t {
+	std::vector< std::wstring >	cells;		// row * BENCH_BC_MAX + column
+	int							numWrites;
+};
+
+static void Bench_SetItemText( benchUIList_t& list, const wchar_t* text, int index, int column ) {
+	std::wstring& cell = list.cells[ index * BENCH_BC_MAX + column ];
+	cell = text;
+	if ( cell[ 0 ] == L'<' ) {
+		benchSink += ( int )cell.find( L'>' );
+	}
+	list.numWrites++;
+}
+
+static void Bench_UpdateRow( benchUIList_t& list, benchRenderedRow_t& row, const benchBrowserSession_t& session, int index, bool renderAll ) {
+	wchar_t text[ 256 ];
+
+	if ( renderAll ) {
+		row.valid = false;
+	}
+
+	if ( !row.valid || row.favorite != session.favorite ) {
+		Bench_SetItemText( list, session.favorite ? L"<material = 'favorite_set'>f" : L"<material = 'favorite_unset'>", index, BENCH_BC_FAVORITE );
+		row.favorite = session.favorite;
+	}
+
+	if ( session.ping == 999 ) {
+		if ( !row.valid || !row.offline ) {
+			Bench_SetItemText( list, L"", index, BENCH_BC_PASSWORD );
+			Bench_SetItemText( list, L"", index, BENCH_BC_RANKED );
+			swprintf( text, 256, L"(offline) %d.%d.%d.%d:27733", 10, index >> 16 & 255, index >> 8 & 255, index & 255 );
+			Bench_SetItemText( list, text, index, BENCH_BC_NAME );
+			Bench_SetItemText( list, L"", index, BENCH_BC_MAP );
+			Bench_SetItemText( list, L"", index, BENCH_BC_GAMETYPE_ICON );
+			Bench_SetItemText( list, L"", index, BENCH_BC_GAMETYPE );
+			Bench_SetItemText( list, L"", index, BENCH_BC_TIMELEFT );
+			Bench_SetItemText( list, L"", index, BENCH_BC_PLAYERS );
+			Bench_SetItemText( list, L"-1", index, BENCH_BC_PING );
+		}
+		row.offline = true;
+		row.valid = true;
+		return;
+	}
+
+	const bool rewrite = !row.valid || row.offline;
+	row.offline = false;
+
+	if ( rewrite || row.needPass != session.needPass ) {
+		Bench_SetItemText( list, session.needPass ? L"<material = 'password'>p" : L"", index, BENCH_BC_PASSWORD );
+		row.needPass = session.needPass;
+	}
+
+	if ( rewrite || row.ranked != session.ranked ) {
+		Bench_SetItemText( list, session.ranked ? L"<material = 'ranked'>r" : L"", index, BENCH_BC_RANKED );
+		row.ranked = session.ranked;
+	}
+
+	if ( rewrite || row.name != session.name ) {
+		// CleanUserInput drops the color escapes
+		int length = 0;
+		for ( const char* s = session.name.c_str(); *s != '\0' && length < 255; s++ ) {
+			if ( s[ 0 ] == '^' && s[ 1 ] != '\0' ) {
+				s++;
+				continue;
+			}
+			text[ length++ ] = ( unsigned char )*s;
+		}
+		text[ length ] = L'\0';
+		Bench_SetItemText( list, text, index, BENCH_BC_NAME );
+		row.name = session.name;
+	}
+
+	if ( rewrite || row.map != session.map ) {
+		// skip the path and the extension
+		const char* map = session.map.c_str();
+		const char* slash = strrchr( map, '/' );
+		map = slash != NULL ? slash + 1 : map;
+		const char* dot = strrchr( map, '.' );
+		swprintf( text, 256, L"%.*hs", dot != NULL ? ( int )( dot - map ) : ( int )strlen( map ), map );
+		Bench_SetItemText( list, text, index, BENCH_BC_MAP );
+		row.map = session.map;
+	}
+
+	if ( rewrite || row.rules != session.rules ) {
+		swprintf( text, 256, L"<material = '%hs'>", session.rules.c_str() );
+		Bench_SetItemText( list, text, index, BENCH_BC_GAMETYPE_ICON );
+		swprintf( text, 256, L"<loc = 'game/rules/%hs'>", session.rules.c_str() );
+		Bench_SetItemText( list, text, index, BENCH_BC_GAMETYPE );
+		row.rules = session.rules;
+	}
+
+	if ( rewrite || row.sessionTime != session.sessionTime ) {
+		if ( session.sessionTime == 0 ) {
+			Bench_SetItemText( list, L"<loc = 'guis/mainmenu/infinity'>", index, BENCH_BC_TIMELEFT );
+		} else {
+			swprintf( text, 256, L"%d:%02d", session.sessionTime / 60000, session.sessionTime / 1000 % 60 );
+			Bench_SetItemText( list, text, index, BENCH_BC_TIMELEFT );
+		}
+		row.sessionTime = session.sessionTime;
+	}
+
+	if ( rewrite || row.numClients != session.numClients || row.maxClients != session.maxClients || row.numBots != session.numBots ) {
+		if ( session.numBots == 0 ) {
+			swprintf( text, 256, L"%d/%d", session.numClients, session.maxClients );
+		} else {
+			swprintf( text, 256, L"%d/%d (%d)", session.numClients, session.maxClients, session.numBots );
+		}
+		Bench_SetItemText( list, text, index, BENCH_BC_PLAYERS );
+		row.numClients = session.numClients;
+		row.maxClients = session.maxClients;
+		row.numBots = session.numBots;
+	}
+
+	if ( rewrite || row.ping != session.ping ) {
+		swprintf( text, 256, L"%d", session.ping );
+		Bench_SetItemText( list, text, index, BENCH_BC_PING );
+		row.ping = session.ping;
+	}
+
+	row.valid = true;
+}
+
+static void Bench_Browser( int numRows ) {
+	static const char* maps[] = { "maps/area22.entities", "maps/ark.entities", "maps/canyon.entities", "maps/island.entities", "maps/outskirts.entities", "maps/quarry.entities", "maps/refinery.entities", "maps/salvage.entities", "maps/sewer.entities", "maps/slipgate.entities", "maps/valley.entities", "maps/volcano.entities" };
+	static const char* rules[] = { "sdGameRulesCampaign", "sdGameRulesObjective", "sdGameRulesStopWatch" };
+	const int numRefreshes = 20;
+
+	std::vector< benchBrowserSession_t > sessions( numRows );
+	for ( int i = 0; i < numRows; i++ ) {
+		benchBrowserSession_t& session = sessions[ i ];
+		char name[ 64 ];
+		snprintf( name, sizeof( name ), "^1Clan^7 server #%d ^3[%s]", i, ( i & 1 ) ? "EU" : "US" );
+		session.name = name;
+		session.map = maps[ Bench_Random() % ( sizeof( maps ) / sizeof( maps[ 0 ] ) ) ];
+		session.rules = rules[ Bench_Random() % ( sizeof( rules ) / sizeof( rules[ 0 ] ) ) ];
+		session.favorite = Bench_Random() % 20 == 0;
+		session.needPass = Bench_Random() % 10 == 0;
+		session.ranked = Bench_Random() % 4 == 0;
+		session.sessionTime = Bench_Random() % 10 < 7 ? 20 * 60 * 1000 : 0;
+		session.maxClients = 32;
+		session.numClients = Bench_Random() % 33;
+		session.numBots = Bench_Random() % 4 == 0 ? Bench_Random() % 8 : 0;
+		session.ping = Bench_Random() % 50 == 0 ? 999 : 20 + Bench_Random() % 200;
+	}
+
+	// both runs see the same changes
+	const u32 seed = benchSeed;
+
+	for ( int renderAll = 0; renderAll < 2; renderAll++ ) {
+		benchSeed = seed;
+
+		std::vector< benchBrowserSession_t > passSessions = sessions;
+		std::vector< benchRenderedRow_t > rows( numRows );
+		benchUIList_t list;
+		list.cells.resize( numRows * BENCH_BC_MAX );
+		list.numWrites = 0;
+
+		u64 start = Bench_Nanoseconds();
+		for ( int i = 0; i < numRows; i++ ) {
+			rows[ i ].valid = false;
+			Bench_UpdateRow( list, rows[ i ], passSessions[ i ], i, true );
+		}
+		u64 addTime = Bench_Nanoseconds() - start;
+
+		list.numWrites = 0;
+		u64 refreshTime = 0;
+		for ( int r = 0; r < numRefreshes; r++ ) {
+			for ( int i = 0; i < numRows; i++ ) {
+				benchBrowserSession_t& session = passSessions[ i ];
+				if ( session.ping != 999 && Bench_Random() % 2 == 0 ) {
+					session.ping = 20 + Bench_Random() % 200;
+				}
+				if ( Bench_Random() % 10 == 0 ) {
+					session.numClients = Bench_Random() % 33;
+				}
+				if ( session.sessionTime > 15000 ) {
+					session.sessionTime -= 15000;
+				}
+			}
+
+			start = Bench_Nanoseconds();
+			for ( int i = 0; i < numRows; i++ ) {
+				Bench_UpdateRow( list, rows[ i ], passSessions[ i ], i, renderAll != 0 );
+			}
+			refreshTime += Bench_Nanoseconds() - start;
+		}
+		Msr_Printf( "%8d rows: %-11s add %7.0f usec, refresh %7.0f usec, %5.1f cells written per row\n",
+			numRows, renderAll != 0 ? "render all," : "changed,", addTime / 1000.0, refreshTime / 1000.0 / numRefreshes,
+			( double )list.numWrites / numRefreshes / numRows );
+	}
+}
+
+/*
+================
+Bench_AddressMap
+
+the client's session index: sdNetAddressMap transcribed with the slots in a
+std::vector, against the sdHashMapGeneric it replaced, which was keyed on
+the host address formatted as a string, hashed case insensitively
+(idStr::IHash) into a 1024 entry idHashIndex and compared with stricmp.
+numAddresses servers are inserted, then looked up in random order the way a
+refresh does; the string map only runs up to 100k.
+================
+*/
+struct benchAddress_t {
+	u32				ip;
+	u16				port;
+};
+
+static u32 Bench_AddressHash( u32 ip, u16 port ) {
+	u32 key = ip ^ ( port * 2654435761u );		// sdNetAddressHash::Hash
+	return key ^ ( key >> 16 );
+}
+
+class benchAddressMap_t {
+public:
+					benchAddressMap_t( void ) : num( 0 ) {}
+
+	int*			Find( u32 ip, u16 port ) {
+						if ( num == 0 ) {
+							return NULL;
+						}
+						slot_t& slot = slots[ FindSlot( ip, port ) ];
+						return slot.used ? &slot.value : NULL;
+					}
+	int&			Insert( u32 ip, u16 port ) {
+						if ( ( num + 1 ) * 4 > ( int )slots.size() * 3 ) {
+							Grow();
+						}
+						slot_t& slot = slots[ FindSlot( ip, port ) ];
+						if ( !slot.used ) {
+							slot.ip = ip;
+							slot.port = port;
+							slot.used = true;
+							num++;
+						}
+						return slot.value;
+					}
+
+private:
+	struct slot_t {
+		u32			ip;
+		u16			port;
+		bool		used;
+		int			value;
+	};
+
+	int				FindSlot( u32 ip, u16 port ) const {
+						u32 mask = ( u32 )slots.size() - 1;
+						u32 slot = Bench_AddressHash( ip, port ) & mask;
+						while ( slots[ slot ].used && ( slots[ slot ].ip != ip || slots[ slot ].port != port ) ) {
+							slot = ( slot + 1 ) & mask;
+						}
+						return ( int )slot;
+					}
+	void			Grow( void ) {
+						std::vector< slot_t > old;
+						old.swap( slots );
+						slots.resize( old.empty() ? 1024 : old.size() * 2 );
+						for ( size_t i = 0; i < slots.size(); i++ ) {
+							slots[ i ].used = false;
+						}
+						for ( size_t i = 0; i < old.size(); i++ ) {
+							if ( old[ i ].used ) {
+								slot_t& slot = slots[ FindSlot( old[ i ].ip, old[ i ].port ) ];
+								slot = old[ i ];
+							}
+						}
+					}
+
+	std::vector< slot_t >	slots;
+	int						num;
+};
+
+class benchStringMap_t {
+public:
+	static const int		HASH_SIZE = 1024;		// idHashIndex's default
+
+					benchStringMap_t( void ) : heads( HASH_SIZE, -1 ) {}
+
+	int*			Find( const char* key ) {
+						for ( int i = heads[ Hash( key ) ]; i != -1; i = next[ i ] ) {
+							if ( strcasecmp( keys[ i ].c_str(), key ) == 0 ) {
+								return &values[ i ];
+							}
+						}
+						return NULL;
+					}
+	int&			Insert( const char* key ) {
+						int* value = Find( key );
+						if ( value != NULL ) {
+							return *value;
+						}
+						int h = Hash( key );
+						keys.push_back( key );
+						values.push_back( 0 );
+						next.push_back( heads[ h ] );
+						heads[ h ] = ( int )keys.size() - 1;
+						return values.back();
+					}
+
+private:
+	static int		Hash( const char* key ) {
+						int hash = 0;
+						for ( int i = 0; key[ i ] != '\0'; i++ ) {
+							hash += tolower( ( unsigned char )key[ i ] ) * ( i + 119 );		// idStr::IHash
+						}
+						return hash & ( HASH_SIZE - 1 );
+					}
+
+	std::vector< int >			heads;
+	std::vector< int >			next;
+	std::vector< std::string >	keys;
+	std::vector< int >			values;
+};
+
+static const char* Bench_AddressString( const benchAddress_t& address ) {
+	static char buffer[ 32 ];		// NetAdrToString's static buffer
+	snprintf( buffer, sizeof( buffer ), "%u.%u.%u.%u:%u", address.ip >> 24, address.ip >> 16 & 255, address.ip >> 8 & 255, address.ip & 255, address.port );
+	return buffer;
+}
+
+static void Bench_AddressMap( int numAddresses ) {
+	std::vector< benchAddress_t > addresses( numAddresses );
+	for ( int i = 0; i < numAddresses; i++ ) {
+		addresses[ i ].ip = Bench_Random();
+		addresses[ i ].port = ( u16 )( 27733 + Bench_Random() % 4 );
+	}
+	std::vector< int > order( numAddresses );
+	for ( int i = 0; i < numAddresses; i++ ) {
+		order[ i ] = ( int )( Bench_Random() % numAddresses );
+	}
+
+	benchAddressMap_t addressMap;
+	u64 start = Bench_Nanoseconds();
+	for ( int i = 0; i < numAddresses; i++ ) {
+		addressMap.Insert( addresses[ i ].ip, addresses[ i ].port ) = i;
+	}
+	u64 addressInsert = Bench_Nanoseconds() - start;
+
+	int found = 0;
+	start = Bench_Nanoseconds();
+	for ( int i = 0; i < numAddresses; i++ ) {
+		const benchAddress_t& address = addresses[ order[ i ] ];
+		found += addressMap.Find( address.ip, address.port ) != NULL;
+	}
+	u64 addressFind = Bench_Nanoseconds() - start;
+
+	// the 1024 chains make the string map quadratic, a browser list never gets that big
+	if ( numAddresses > 100000 ) {
+		benchSink = found;
+		Msr_Printf( "%8d servers: find %5.1f nsec, insert %6.1f nsec\n",
+			numAddresses, ( double )addressFind / numAddresses, ( double )addressInsert / numAddresses );
+		return;
+	}
+
+	benchStringMap_t* stringMap = new benchStringMap_t;
+	start = Bench_Nanoseconds();
+	for ( int i = 0; i < numAddresses; i++ ) {
+		stringMap->Insert( Bench_AddressString( addresses[ i ] ) ) = i;
+	}
+	u64 stringInsert = Bench_Nanoseconds() - start;
+
+	start = Bench_Nanoseconds();
+	for ( int i = 0; i < numAddresses; i++ ) {
+		found += stringMap->Find( Bench_AddressString( addresses[ order[ i ] ] ) ) != NULL;
+	}
+	u64 stringFind = Bench_Nanoseconds() - start;
+	delete stringMap;
+
+	benchSink = found;
+
+	Msr_Printf( "%8d servers: find %5.1f nsec, insert %6.1f nsec, by string find %6.1f nsec, insert %6.1f nsec\n",
+		numAddresses, ( double )addressFind / numAddresses, ( double )addressInsert / numAddresses,
+		( double )stringFind / numAddresses, ( double )stringInsert / numAddresses );
+}
+
+/*
+================
+Bench_Presence
+
+numClients clients come online and each subscribes to 50 random friends, then
+every client goes through two bursts of four transitions, 10 to 150 msec apart
+and a third of them back to where it was before the previous one, starting
+at random in a 20 second span. The clock runs in 10 msec steps with a flush
+after every step. A naive model pushes every transition to every subscriber:
+every entry delivered must carry the friend's presence and differ from what
+the recipient saw last, every transition must have reached its subscribers
+COALESCE_MSEC later, and in the end every recipient must see every friend as
+it is.
+================
+*/
+static void Bench_Presence( int numClients ) {
+	const int numFriends = 50;
+	const int numBursts = 2;
+	const int burstLength = 4;
+	const int stepMsec = 10;
+
+	// 50M subscriptions don't fit in memory next to the model
+	if ( numClients > 100000 ) {
+		Msr_Printf( "%8d clients: skipped\n", numClients );
+		return;
+	}
+
+	struct event_t {
+		int						time;
+		int						client;
+		sdPresence::presence_t	presence;
+		int						next;			// the client's next transition
+
+		bool					operator<( const event_t& other ) const { return time < other.time; }
+	};
+
+	struct model_t {
+		std::vector< int >						friends;		// numFriends per recipient
+		std::vector< sdPresence::presence_t >	seen;			// same index, what the recipient was handed last
+		std::vector< int >						seenTime;
+		std::vector< sdPresence::presence_t >	presences;
+		int										now;
+		u64										errors;
+	};
+
+	sdPresence* presence = new sdPresence;
+	model_t model;
+	model.friends.resize( ( size_t )numClients * numFriends );
+	model.seen.resize( model.friends.size() );
+	model.seenTime.resize( model.friends.size() );
+	model.presences.resize( numClients );
+	model.now = 0;
+	model.errors = 0;
+
+	auto deliver = [&model]( u64 recipient, const sdPresence::change_t* changes, int numChanges ) {
+		const int r = ( int )recipient - 1;
+		for ( int i = 0; i < numChanges; i++ ) {
+			const int c = ( int )changes[ i ].client - 1;
+			int s = r * numFriends;
+			while ( s < ( r + 1 ) * numFriends && model.friends[ s ] != c ) {
+				s++;
+			}
+			if ( s == ( r + 1 ) * numFriends || changes[ i ].presence != model.presences[ c ] || changes[ i ].presence == model.seen[ s ] ) {
+				model.errors++;
+				continue;
+			}
+			model.seen[ s ] = changes[ i ].presence;
+			model.seenTime[ s ] = model.now;
+		}
+	};
+
+	// everybody online, then the subscriptions are answered
+	sdPresence::presence_t online;
+	online.state = sdPresence::OS_ONLINE;
+	online.session = 0;
+	for ( int c = 0; c < numClients; c++ ) {
+		presence->SetPresence( c + 1, online, 0 );
+		model.presences[ c ] = online;
+	}
+	std::vector< std::vector< int > > subscribers( numClients );
+	for ( int r = 0; r < numClients; r++ ) {
+		for ( int j = 0; j < numFriends; j++ ) {
+			int c;
+			bool repeated;
+			do {
+				c = ( int )( Bench_Random() % numClients );
+				repeated = c == r;
+				for ( int k = 0; k < j && !repeated; k++ ) {
+					repeated = model.friends[ r * numFriends + k ] == c;
+				}
+			} while ( repeated && numClients > numFriends );
+			const int s = r * numFriends + j;
+			model.friends[ s ] = c;
+			model.seen[ s ].state = sdPresence::OS_NUM_STATES;
+			model.seen[ s ].session = 0;
+			model.seenTime[ s ] = 0;
+			subscribers[ c ].push_back( s );
+			presence->Subscribe( r + 1, c + 1, 0 );
+		}
+	}
+	model.now = sdPresence::COALESCE_MSEC;
+	presence->Flush( model.now, deliver );
+	const sdPresence::stats_t initial = presence->GetStats();
+
+	std::vector< event_t > events;
+	events.reserve( ( size_t )numClients * numBursts * burstLength );
+	const int numSessions = numClients / 10 > 1 ? numClients / 10 : 1;
+	for ( int c = 0; c < numClients; c++ ) {
+		sdPresence::presence_t current = online;
+		sdPresence::presence_t previous = online;
+		for ( int b = 0; b < numBursts; b++ ) {
+			int time = 1000 + ( int )( Bench_Random() % 20000 );
+			for ( int i = 0; i < burstLength; i++ ) {
+				event_t event;
+				event.time = time;
+				event.client = c;
+				if ( Bench_Random() % 3 == 0 ) {
+					event.presence = previous;
+				} else {
+					event.presence.state = Bench_Random() % 8 == 0 ? sdPresence::OS_GHOST : sdPresence::OS_ONLINE;
+					event.presence.session = Bench_Random() % 2 == 0 ? 0 : Msr_PackAddress( 0x0b000000 + Bench_Random() % numSessions, 27733 );
+				}
+				events.push_back( event );
+				previous = current;
+				current = event.presence;
+				time += 10 + ( int )( Bench_Random() % 140 );
+			}
+		}
+	}
+	std::stable_sort( events.begin(), events.end() );
+
+	u64 numTransitions = 0;
+	u64 numPushes = 0;
+	u64 setTime = 0;
+	u64 flushTime = 0;
+	size_t next = 0;
+	size_t checked = 0;
+	std::vector< event_t > transitions;		// the events that changed something, in order
+	std::vector< int > lastTransition( numClients, -1 );
+	transitions.reserve( events.size() );
+	const int endTime = events.back().time + 2 * sdPresence::COALESCE_MSEC;
+	for ( model.now = 1000; model.now <= endTime; model.now += stepMsec ) {
+		for ( ; next < events.size() && events[ next ].time <= model.now; next++ ) {
+			event_t event = events[ next ];
+			event.time = model.now;
+
+			u64 start = Bench_Nanoseconds();
+			presence->SetPresence( event.client + 1, event.presence, model.now );
+			setTime += Bench_Nanoseconds() - start;
+
+			if ( event.presence == model.presences[ event.client ] ) {
+				continue;
+			}
+			model.presences[ event.client ] = event.presence;
+			numTransitions++;
+			numPushes += subscribers[ event.client ].size();
+			event.next = -1;
+			if ( lastTransition[ event.client ] >= 0 ) {
+				transitions[ lastTransition[ event.client ] ].next = ( int )transitions.size();
+			}
+			lastTransition[ event.client ] = ( int )transitions.size();
+			transitions.push_back( event );
+		}
+
+		u64 start = Bench_Nanoseconds();
+		presence->Flush( model.now, deliver );
+		flushTime += Bench_Nanoseconds() - start;
+
+		// a transition is late if a subscriber was handed nothing since and sees none of the presences
+		// the friend had from then on
+		for ( ; checked < transitions.size() && transitions[ checked ].time + sdPresence::COALESCE_MSEC <= model.now; checked++ ) {
+			const event_t& event = transitions[ checked ];
+			const std::vector< int >& subs = subscribers[ event.client ];
+			for ( size_t i = 0; i < subs.size(); i++ ) {
+				if ( model.seenTime[ subs[ i ] ] >= event.time ) {
+					continue;
+				}
+				bool seen = false;
+				for ( int t = ( int )checked; t >= 0 && !seen; t = transitions[ t ].next ) {
+					seen = model.seen[ subs[ i ] ] == transitions[ t ].presence;
+				}
+				model.errors += !seen;
+			}
+		}
+	}
+
+	for ( size_t s = 0; s < model.friends.size(); s++ ) {
+		if ( model.seen[ s ] != model.presences[ model.friends[ s ] ] ) {
+			model.errors++;
+		}
+	}
+
+	const sdPresence::stats_t& stats = presence->GetStats();
+	const u64 numEntries = stats.delivered - initial.delivered;
+	const u64 numFrames = stats.batches - initial.batches;
+	delete presence;
+
+	Msr_Printf( "%8d clients: set %5.1f nsec, flush %5.1f nsec / entry, %7llu transitions: %8llu entries in %7llu frames instead of %9llu pushes, errors %llu\n",
+		numClients, ( double )setTime / events.size(), ( double )flushTime / ( numEntries > 0 ? numEntries : 1 ),
+		( unsigned long long )numTransitions, ( unsigned long long )numEntries, ( unsigned long long )numFrames,
+		( unsigned long long )numPushes, ( unsigned long long )model.errors );
+}
+
+/*
+================
+Bench_StatsRecordHash
+
+order independent, the segments group the records by key
+================
+*/
+static u64 Bench_StatsRecordHash( u64 client, u32 value ) {
+	return ( client ^ ( ( u64 )value << 32 | value ) ) * 0x9e3779b97f4a7c15ull;
+}
+
+/*
+================
+Bench_StatsPass
+
+numRecords uploads of 64 keys go through a fresh sdStatsStore in a temporary
+directory, paced at recordsPerSecond in 1 msec slices or as fast as Add takes
+them if it is 0. Then stats.log is read back: every segment must pass its crc
+and every key must hold exactly the records Add didn't drop. Returns the
+number of errors.
+================
+*/
+static u64 Bench_StatsPass( int numRecords, int recordsPerSecond, u64& elapsed, u64& dropped, sdStatsStore::stats_t& stats ) {
+	const int numKeys = 64;
+
+	char directory[] = "/tmp/msr_microbench.XXXXXX";
+	if ( mkdtemp( directory ) == NULL ) {
+		Msr_Warning( "Bench_StatsPass: can't create a directory in /tmp (%s)", strerror( errno ) );
+		return 1;
+	}
+	char path[ 64 ];
+	snprintf( path, sizeof( path ), "%s/stats.log", directory );
+
+	sdStatsStore* store = new sdStatsStore;
+	if ( !store->Open( directory ) ) {
+		delete store;
+		rmdir( directory );
+		return 1;
+	}
+
+	int keys[ numKeys ];
+	for ( int k = 0; k < numKeys; k++ ) {
+		char name[ 32 ];
+		snprintf( name, sizeof( name ), "bench_stat_%d", k );
+		keys[ k ] = store->InternKey( name, k % sdStatsStore::SVT_NUM_TYPES );
+	}
+
+	// what the log must hold per key
+	std::vector< u64 > modelCounts( numKeys );
+	std::vector< u64 > modelHashes( numKeys );
+
+	const int perSlice = recordsPerSecond / 1000;
+	u64 start = Bench_Nanoseconds();
+	for ( int i = 0; i < numRecords; i++ ) {
+		if ( perSlice > 0 && i % perSlice == 0 ) {
+			const u64 due = start + ( u64 )( i / perSlice ) * 1000000;
+			const u64 now = Bench_Nanoseconds();
+			if ( now < due ) {
+				usleep( ( useconds_t )( ( due - now ) / 1000 ) );
+			}
+		}
+		const int k = ( int )( Bench_Random() % numKeys );
+		const u64 client = Bench_Random() % 100000 + 1;
+		const u32 value = Bench_Random() % 1000;
+		const u64 before = store->GetNumDropped();
+		store->Add( client, keys[ k ], value );
+		if ( store->GetNumDropped() == before ) {
+			modelCounts[ k ]++;
+			modelHashes[ k ] += Bench_StatsRecordHash( client, value );
+		}
+	}
+	store->Close();
+	elapsed = Bench_Nanoseconds() - start;
+	dropped = store->GetNumDropped();
+	stats = store->GetStats();
+
+	std::vector< byte > log;
+	FILE* f = fopen( path, "rb" );
+	if ( f != NULL ) {
+		byte buffer[ 65536 ];
+		size_t num;
+		while ( ( num = fread( buffer, 1, sizeof( buffer ), f ) ) > 0 ) {
+			log.insert( log.end(), buffer, buffer + num );
+		}
+		fclose( f );
+	}
+	unlink( path );
+	rmdir( directory );
+
+	u64 errors = 0;
+	std::vector< u64 > counts( numKeys );
+	std::vector< u64 > hashes( numKeys );
+	u64 numSegments = 0;
+	size_t offset = 0;
+	while ( offset < log.size() ) {
+		sdMsgReader header( log.data() + offset, ( int )( log.size() - offset ) );
+		header.Skip( 4 );
+		const u32 length = header.ReadLong();
+		const u32 crc = header.ReadLong();
+		if ( header.IsOverflowed() || memcmp( log.data() + offset, "MSTS", 4 ) != 0 || length > ( u32 )header.GetRemaining() ||
+			( Msr_CRC32( 0xffffffff, header.GetCursor(), ( int )length ) ^ 0xffffffff ) != crc ) {
+			errors++;
+			break;
+		}
+		numSegments++;
+
+		sdMsgReader msg( header.GetCursor(), ( int )length );
+		msg.ReadLong();		// wall clock
+		const int segmentKeys = msg.ReadShort();
+		for ( int i = 0; i < segmentKeys && !msg.IsOverflowed(); i++ ) {
+			const int type = msg.ReadByte();
+			const char* name = msg.ReadString();
+			const u32 count = msg.ReadLong();
+			const int key = name != NULL ? store->FindKey( name, type ) : -1;
+			if ( key < 0 || ( u64 )count * 12 > ( u64 )msg.GetRemaining() ) {
+				errors++;
+				break;
+			}
+			int k = 0;
+			while ( keys[ k ] != key ) {
+				k++;
+			}
+			const byte* clients = msg.GetCursor();
+			const byte* values = clients + count * sizeof( u64 );
+			for ( u32 j = 0; j < count; j++ ) {
+				u64 client;
+				u32 value;
+				memcpy( &client, clients + j * sizeof( u64 ), sizeof( u64 ) );
+				memcpy( &value, values + j * sizeof( u32 ), sizeof( u32 ) );
+				hashes[ k ] += Bench_StatsRecordHash( client, value );
+			}
+			counts[ k ] += count;
+			msg.Skip( ( int )( count * 12 ) );
+		}
+		errors += msg.IsOverflowed() || msg.GetRemaining() != 0;
+		offset += 12 + length;
+	}
+	errors += numSegments != stats.groups;
+	for ( int k = 0; k < numKeys; k++ ) {
+		errors += counts[ k ] != modelCounts[ k ] || hashes[ k ] != modelHashes[ k ];
+	}
+
+	delete store;
+	return errors;
+}
+
+/*
+================
+Bench_Stats
+
+numRecords stats uploads paced at 200k a second, the rate the README quotes,
+then as many again as fast as the network thread can hand them over. Shows
+the drops, the syncs a second and the rate the writer kept up with, and that
+stats.log reads back intact.
+================
+*/
+static void Bench_Stats( int numRecords ) {
+	const int pacedRate = 200000;
+
+	u64 pacedTime, pacedDropped, burstTime, burstDropped;
+	sdStatsStore::stats_t paced, burst;
+	u64 errors = Bench_StatsPass( numRecords, pacedRate, pacedTime, pacedDropped, paced );
+	errors += Bench_StatsPass( numRecords, 0, burstTime, burstDropped, burst );
+
+	Msr_Printf( "%8d records: at %dk / sec dropped %llu, %4.0f syncs / sec, %4.2f msec each; burst %5.0fk / sec dropped %llu; errors %llu\n",
+		numRecords, pacedRate / 1000, ( unsigned long long )pacedDropped, paced.groups * 1e9 / pacedTime,
+		paced.syncMicroseconds / 1000.0 / ( paced.groups > 0 ? paced.groups : 1 ),
+		( numRecords - burstDropped ) * 1e6 / burstTime, ( unsigned long long )burstDropped, ( unsigned long long )errors );
+}
+
+struct benchTest_t {
+	const char*			name;
+	void				( *func )( int size );
+};
+
+static const benchTest_t benchTests[] = {
+	{ "wheel",			Bench_Wheel },
+	{ "limiter",		Bench_Limiter },
+	{ "coords",			Bench_Coords },
+	{ "leaderboard",	Bench_Leaderboard },
+	{ "filter",			Bench_Filter },
+	{ "interest",		Bench_Interest },
+	{ "browser",		Bench_Browser },
+	{ "addressmap",		Bench_AddressMap },
+	{ "presence",		Bench_Presence },
+	{ "stats",			Bench_Stats },
+};
+
+/*
+================
+main
+================
+*/
+int main( int argc, char* argv[] ) {
+	const char* test = NULL;
+	int size = 0;
+
+	for ( int i = 1; i < argc; i++ ) {
+		const char* arg = argv[ i ];
+		const char* value = ( i + 1 < argc ) ? argv[ i + 1 ] : NULL;
+		if ( value == NULL ) {
+			Msr_Error( "missing value for '%s'", arg );
+		}
+
+		if ( !strcmp( arg, "-test" ) ) {
+			test = value;
+		} else if ( !strcmp( arg, "-size" ) ) {
+			size = atoi( value );
+		} else {
+			Msr_Error( "unknown option '%s'\nusage: %s [-test <name>] [-size <n>]", arg, argv[ 0 ] );
+		}
+		i++;
+	}
+
+	static const int defaultSizes[] = { 1000, 10000, 100000, 1000000 };
+
+	bool found = false;
+	for ( size_t t = 0; t < sizeof( benchTests ) / sizeof( benchTests[ 0 ] ); t++ ) {
+		if ( test != NULL && strcmp( test, benchTests[ t ].name ) != 0 ) {
+			continue;
+		}
+		found = true;
+
+		Msr_Printf( "- %s\n", benchTests[ t ].name );
+		if ( size > 0 ) {
+			benchTests[ t ].func( size );
+			continue;
+		}
+		for ( size_t s = 0; s < sizeof( defaultSizes ) / sizeof( defaultSizes[ 0 ] ); s++ ) {
+			benchTests[ t ].func( defaultSizes[ s ] );
+		}
+	}
+	if ( !found ) {
+		Msr_Error( "unknown test '%s'", test );
+	}
+	return 0;
+}
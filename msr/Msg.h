@@ -0,0 +1,111 @@
+
+#ifndef __MSR_MSG_H__
+#define __MSR_MSG_H__
+
+#include "Common.h"
+
+/*
+===============================================================================
+
+	sdMsgWriter / sdMsgReader
+
+	Byte aligned little endian helpers for connectionless packets, the bounded
+	replacement for putss / putxx / putcc. Every write is checked against the
+	buffer size; once a write fails the writer is flagged as overflowed and
+	the packet must not be sent.
+
+===============================================================================
+*/
+
+class sdMsgWriter {
+public:
+						sdMsgWriter( byte* data, int size ) : data( data ), size( size ), length( 0 ), overflowed( false ) {}
+
+	byte*				GetData( void ) const { return data; }
+	int					GetLength( void ) const { return length; }
+	int					GetRemaining( void ) const { return size - length; }
+	bool				IsOverflowed( void ) const { return overflowed; }
+
+	void				WriteByte( int c ) { byte* p = Reserve( 1 ); if ( p != NULL ) { p[ 0 ] = ( byte )c; } }
+	void				WriteShort( int c ) { byte* p = Reserve( 2 ); if ( p != NULL ) { p[ 0 ] = ( byte )c; p[ 1 ] = ( byte )( c >> 8 ); } }
+	void				WriteLong( u32 c ) { byte* p = Reserve( 4 ); if ( p != NULL ) { p[ 0 ] = ( byte )c; p[ 1 ] = ( byte )( c >> 8 ); p[ 2 ] = ( byte )( c >> 16 ); p[ 3 ] = ( byte )( c >> 24 ); } }
+	void				WriteData( const void* src, int num ) { byte* p = Reserve( num ); if ( p != NULL ) { memcpy( p, src, num ); } }
+	void				WriteFill( int c, int num ) { byte* p = Reserve( num ); if ( p != NULL ) { memset( p, c, num ); } }
+	void				WriteString( const char* s ) { WriteData( s, ( int )strlen( s ) + 1 ); }
+	void				WriteOOBHeader( void ) { WriteShort( OOB_MAGIC ); }
+
+						// direct access for encoders that know their maximum size up front,
+						// returns NULL and flags the writer if maxSize bytes are not available
+	byte*				GetWriteBuffer( int maxSize ) {
+							if ( overflowed || maxSize > size - length ) {
+								overflowed = true;
+								return NULL;
+							}
+							return data + length;
+						}
+	void				CommitWrite( int num ) { length += num; }
+
+private:
+	byte*				Reserve( int num ) {
+							if ( overflowed || num < 0 || num > size - length ) {
+								overflowed = true;
+								return NULL;
+							}
+							byte* p = data + length;
+							length += num;
+							return p;
+						}
+
+	byte*				data;
+	int					size;
+	int					length;
+	bool				overflowed;
+};
+
+class sdMsgReader {
+public:
+						sdMsgReader( const byte* data, int length ) : data( data ), length( length ), count( 0 ), overflowed( false ) {}
+
+	int					GetRemaining( void ) const { return length - count; }
+	int					GetReadCount( void ) const { return count; }
+	const byte*			GetCursor( void ) const { return data + count; }
+	bool				IsOverflowed( void ) const { return overflowed; }
+
+	int					ReadByte( void ) { const byte* p = Consume( 1 ); return p != NULL ? p[ 0 ] : -1; }
+	int					ReadShort( void ) { const byte* p = Consume( 2 ); return p != NULL ? ( short )( p[ 0 ] | ( p[ 1 ] << 8 ) ) : -1; }
+	u32					ReadLong( void ) { const byte* p = Consume( 4 ); return p != NULL ? ( u32 )p[ 0 ] | ( ( u32 )p[ 1 ] << 8 ) | ( ( u32 )p[ 2 ] << 16 ) | ( ( u32 )p[ 3 ] << 24 ) : 0; }
+	void				Skip( int num ) { Consume( num ); }
+
+						// returns a pointer to the NUL terminated string inside the packet, or NULL if it is not terminated
+	const char*			ReadString( void ) {
+							if ( overflowed ) {
+								return NULL;
+							}
+							const byte* start = data + count;
+							const byte* end = ( const byte* )memchr( start, 0, length - count );
+							if ( end == NULL ) {
+								overflowed = true;
+								return NULL;
+							}
+							count += ( int )( end - start ) + 1;
+							return ( const char* )start;
+						}
+
+private:
+	const byte*			Consume( int num ) {
+							if ( overflowed || num > length - count ) {
+								overflowed = true;
+								return NULL;
+							}
+							const byte* p = data + count;
+							count += num;
+							return p;
+						}
+
+	const byte*			data;
+	int					length;
+	int					count;
+	bool				overflowed;
+};
+
+#endif /* !__MSR_MSG_H__ */
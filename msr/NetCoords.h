@@ -0,0 +1,229 @@
+
+#ifndef __MSR_NETCOORDS_H__
+#define __MSR_NETCOORDS_H__
+
+#include "Common.h"
+#include "AddressHash.h"
+
+#include <atomic>
+#include <math.h>
+
+/*
+===============================================================================
+
+	netCoord_t
+
+	Vivaldi network coordinate: a point in the plane plus a height for the
+	access link, so the estimated round trip between two hosts is their
+	distance in the plane plus both heights, in msec. Every measured ping
+	pulls the two coordinates towards (or pushes them away from) the distance
+	that was measured, weighted by how confident each side is; error is the
+	running relative error of the host's own estimates.
+
+	Clients report the pings their browser measured (pingReport). The client
+	side is moved right away, the server side is queued to the worker that
+	owns the session. Once a client has a coordinate, estimatePings returns
+	the estimated round trip to every session, so the browser can sort and
+	score before it pinged anything and only needs to probe the top
+	candidates.
+
+===============================================================================
+*/
+
+const float COORD_ERROR_MAX			= 1.5f;		// a new coordinate, nothing known yet
+const float COORD_CE				= 0.25f;	// error smoothing
+const float COORD_CC				= 0.25f;	// fraction of the force applied per sample
+const float COORD_HEIGHT_MIN		= 0.01f;	// msec
+const float COORD_ZERO				= 1.0e-6f;
+const int COORD_MAX_RTT				= 5000;		// msec, longer samples are dropped
+
+struct netCoord_t {
+	float					pos[ 2 ];
+	float					height;
+	float					error;
+
+	void					Init( void ) { pos[ 0 ] = pos[ 1 ] = 0.0f; height = COORD_HEIGHT_MIN; error = COORD_ERROR_MAX; }
+	bool					IsKnown( void ) const { return error < COORD_ERROR_MAX; }
+
+							// estimated round trip in msec
+	float					Distance( const netCoord_t& other ) const {
+								float dx = pos[ 0 ] - other.pos[ 0 ];
+								float dy = pos[ 1 ] - other.pos[ 1 ];
+								return sqrtf( dx * dx + dy * dy ) + height + other.height;
+							}
+
+							// one measured round trip to remote, seed picks the direction when both sit on the same spot
+	void					Update( const netCoord_t& remote, float rtt, u32 seed ) {
+								if ( rtt < 1.0f ) {
+									rtt = 1.0f;
+								}
+								const float dist = Distance( remote );
+								const float wrongness = fabsf( dist - rtt ) / rtt;
+
+								float totalError = error + remote.error;
+								if ( totalError < COORD_ZERO ) {
+									totalError = COORD_ZERO;
+								}
+								const float weight = error / totalError;
+
+								error = COORD_CE * weight * wrongness + error * ( 1.0f - COORD_CE * weight );
+								if ( error > COORD_ERROR_MAX ) {
+									error = COORD_ERROR_MAX;
+								}
+
+								// move along the unit vector from remote, whose length is the whole distance: the plane
+								// and the heights each take their share of the force
+								const float force = COORD_CC * weight * ( rtt - dist );
+								float dx = pos[ 0 ] - remote.pos[ 0 ];
+								float dy = pos[ 1 ] - remote.pos[ 1 ];
+								const float mag = sqrtf( dx * dx + dy * dy );
+								if ( mag < COORD_ZERO ) {
+									// no direction in the plane, push apart along a random one
+									const float angle = seed * ( 2.0f * 3.14159265f / 4294967296.0f );
+									dx = cosf( angle );
+									dy = sinf( angle );
+								} else {
+									dx /= dist;
+									dy /= dist;
+								}
+								pos[ 0 ] += dx * force;
+								pos[ 1 ] += dy * force;
+								height += ( height + remote.height ) * force / dist;
+								if ( height < COORD_HEIGHT_MIN ) {
+									height = COORD_HEIGHT_MIN;
+								}
+							}
+};
+
+/*
+===============================================================================
+
+	sdClientCoords
+
+	The coordinates of the clients that reported pings to one worker, keyed
+	by IP. SO_REUSEPORT sends a client's pingReport and estimatePings to the
+	same worker, so nothing is shared.
+
+	Fixed open addressing table like sdSourceLimiter: nothing is removed, an
+	entry idle for IDLE_MSEC is taken over by the next client probing past
+	it, and a client that finds no room within MAX_PROBES gets no coordinate.
+
+===============================================================================
+*/
+
+class sdClientCoords {
+public:
+	static const int		TABLE_SIZE			= 1 << 16;		// 1.5 MB per worker
+	static const int		MAX_PROBES			= 16;
+	static const int		IDLE_MSEC			= 30 * 60 * 1000;
+
+							sdClientCoords( void ) : entries( NULL ) {}
+							~sdClientCoords( void ) { delete[] entries; }
+
+	void					Init( void ) {
+								delete[] entries;
+								entries = new entry_t[ TABLE_SIZE ];
+								memset( entries, 0, sizeof( entry_t ) * TABLE_SIZE );
+							}
+
+							// NULL if the client never reported
+	const netCoord_t*		Find( u32 ip, int now ) const {
+								u32 slot = sdAddressHash::Hash( ip );
+								for ( int i = 0; i < MAX_PROBES; i++, slot++ ) {
+									const entry_t& entry = entries[ slot & ( TABLE_SIZE - 1 ) ];
+									if ( entry.ip == ip && now - entry.lastUsed < IDLE_MSEC ) {
+										return &entry.coord;
+									}
+								}
+								return NULL;
+							}
+
+							// creates the coordinate, NULL if the table has no room around the client
+	netCoord_t*				FindOrAdd( u32 ip, int now ) {
+								entry_t* reuse = NULL;
+								u32 slot = sdAddressHash::Hash( ip );
+								for ( int i = 0; i < MAX_PROBES; i++, slot++ ) {
+									entry_t& entry = entries[ slot & ( TABLE_SIZE - 1 ) ];
+									const bool idle = entry.ip == 0 || now - entry.lastUsed >= IDLE_MSEC;
+									if ( entry.ip == ip && !idle ) {
+										entry.lastUsed = now;
+										return &entry.coord;
+									}
+									if ( idle && reuse == NULL ) {
+										reuse = &entry;
+									}
+								}
+								if ( reuse == NULL ) {
+									return NULL;
+								}
+								reuse->ip = ip;
+								reuse->lastUsed = now;
+								reuse->coord.Init();
+								return &reuse->coord;
+							}
+
+private:
+	struct entry_t {
+		u32					ip;
+		int					lastUsed;
+		netCoord_t			coord;
+	};
+
+	entry_t*				entries;
+};
+
+/*
+===============================================================================
+
+	sdCoordQueue
+
+	Server side samples from the worker that received a pingReport to the
+	worker that owns the session, one single producer single consumer ring
+	per pair of workers. A full ring drops the sample.
+
+===============================================================================
+*/
+
+struct coordSample_t {
+	u64						server;
+	netCoord_t				client;			// the client's coordinate the round trip was measured from
+	float					rtt;
+};
+
+class sdCoordQueue {
+public:
+	static const int		SIZE				= 1024;
+
+							sdCoordQueue( void ) : head( 0 ), tail( 0 ) {}
+
+							// producer only
+	bool					Push( const coordSample_t& sample ) {
+								u32 t = tail.load( std::memory_order_relaxed );
+								if ( t - head.load( std::memory_order_acquire ) == ( u32 )SIZE ) {
+									return false;
+								}
+								samples[ t & ( SIZE - 1 ) ] = sample;
+								tail.store( t + 1, std::memory_order_release );
+								return true;
+							}
+
+							// consumer only
+	bool					Pop( coordSample_t& sample ) {
+								u32 h = head.load( std::memory_order_relaxed );
+								if ( h == tail.load( std::memory_order_acquire ) ) {
+									return false;
+								}
+								sample = samples[ h & ( SIZE - 1 ) ];
+								head.store( h + 1, std::memory_order_release );
+								return true;
+							}
+
+private:
+	std::atomic< u32 >		head;
+	char					pad0[ 64 - sizeof( std::atomic< u32 > ) ];	// producer and consumer on their own cache lines
+	std::atomic< u32 >		tail;
+	char					pad1[ 64 - sizeof( std::atomic< u32 > ) ];
+	coordSample_t			samples[ SIZE ];
+};
+
+#endif /* !__MSR_NETCOORDS_H__ */
@@ -0,0 +1,88 @@
+
+#ifndef __MSR_OOBPACKETS_H__
+#define __MSR_OOBPACKETS_H__
+
+#include "Packet.h"
+
+/*
+===============================================================================
+
+	Layouts of the connectionless packets captured in packet_from_etqwcbof.txt
+
+===============================================================================
+*/
+
+const int MAX_HOSTNAME_LENGTH		= 63;
+const int MAX_QPATH_LENGTH			= 255;
+const int MAX_STATUS_SERVERINFO		= 1024;
+const int MAX_DOWNLOAD_URL_LENGTH	= 1023;
+
+MSR_PACKET_NAME( getStatus );
+MSR_PACKET_NAME( statusResponse );
+MSR_PACKET_NAME( challengeResponse );
+MSR_PACKET_NAME( connect );
+MSR_PACKET_NAME( pureServer );
+MSR_PACKET_NAME( downloadRequest );
+MSR_PACKET_NAME( downloadInfo );
+
+// client -> server, both longs are echoed in the statusResponse
+typedef sdPacket< pkName_getStatus,
+	pkLong,							// challenge
+	pkLong							// query id
+> getStatusPacket_t;
+
+typedef sdPacket< pkName_statusResponse,
+	pkLong,							// echoed challenge
+	pkLong,							// echoed query id
+	pkShort,						// PROTOCOL_MINOR
+	pkShort,						// PROTOCOL_MAJOR
+	pkLong,							// purpose unknown, always 153 in the captures
+	pkString< MAX_HOSTNAME_LENGTH >,	// si_name
+	pkShort,						// si_maxPlayers
+	pkString< MAX_QPATH_LENGTH >,	// si_map
+	pkShort,
+	pkKeyValues< MAX_STATUS_SERVERINFO >,	// remaining si_* pairs
+	pkLong,
+	pkLong,
+	pkLong,
+	pkLong
+> statusResponsePacket_t;
+
+typedef sdPacket< pkName_challengeResponse,
+	pkLong,							// challenge
+	pkLong,							// 15996, doom3 compatible?
+	pkLong,
+	pkLong,
+	pkString< MAX_QPATH_LENGTH >,	// mod
+	pkString< MAX_QPATH_LENGTH >
+> challengeResponsePacket_t;
+
+// client -> server
+typedef sdPacket< pkName_connect,
+	pkShort,						// PROTOCOL_MINOR
+	pkShort,						// PROTOCOL_MAJOR
+	pkShort,
+	pkLong,							// purpose unknown, a checksum?
+	pkLong,							// challenge from the challengeResponse
+	pkLong,							// echoed from the challenge request
+	pkShort							// client port
+> connectPacket_t;
+
+typedef sdPacket< pkName_pureServer,
+	pkLong,							// checksum list delimiter
+	pkLong							// game code pak
+> pureServerPacket_t;
+
+typedef sdPacket< pkName_downloadRequest,
+	pkLong,							// challenge
+	pkShort,						// client port
+	pkLong							// request id
+> downloadRequestPacket_t;
+
+typedef sdPacket< pkName_downloadInfo,
+	pkLong,							// request id
+	pkByte,							// 1 = download from URL
+	pkString< MAX_DOWNLOAD_URL_LENGTH >
+> downloadInfoPacket_t;
+
+#endif /* !__MSR_OOBPACKETS_H__ */
@@ -0,0 +1,249 @@
+
+#ifndef __MSR_PACKET_H__
+#define __MSR_PACKET_H__
+
+#include "Common.h"
+#include "Msg.h"
+
+/*
+===============================================================================
+
+	sdPacket
+
+	Compile time layouts for connectionless packets. A packet is declared as
+	its command name followed by a list of field types; the field list fixes
+	the encoding of every field and the maximum encoded size, so
+
+		- Encode takes exactly one argument per field, in order,
+		- MAX_SIZE is a constant and is checked against BUFFSZ at compile time,
+		- the encoder does a single bounds check and then writes straight into
+		  the send buffer, variable sized fields are clamped to their maximum.
+
+	Decode reads the fields that follow the command string, which has already
+	been consumed by the dispatcher.
+
+===============================================================================
+*/
+
+// declares the command name of a packet, e.g. MSR_PACKET_NAME( statusResponse );
+#define MSR_PACKET_NAME( name )												\
+	struct pkName_##name {													\
+		static const char* String( void ) { return #name; }					\
+		static const int SIZE = sizeof( #name );							\
+	}
+
+struct pkData_t {
+	const void*				data;
+	int						length;
+};
+
+/*
+================
+pkByte
+================
+*/
+struct pkByte {
+	typedef int				argType;
+	typedef int				type;
+	static const int		MAX_SIZE = 1;
+
+	static byte*			Write( byte* p, int value ) { p[ 0 ] = ( byte )value; return p + 1; }
+	static bool				Read( const byte*& p, const byte* end, int& value ) {
+								if ( end - p < 1 ) {
+									return false;
+								}
+								value = p[ 0 ];
+								p += 1;
+								return true;
+							}
+};
+
+/*
+================
+pkShort
+================
+*/
+struct pkShort {
+	typedef int				argType;
+	typedef int				type;
+	static const int		MAX_SIZE = 2;
+
+	static byte*			Write( byte* p, int value ) { p[ 0 ] = ( byte )value; p[ 1 ] = ( byte )( value >> 8 ); return p + 2; }
+	static bool				Read( const byte*& p, const byte* end, int& value ) {
+								if ( end - p < 2 ) {
+									return false;
+								}
+								value = p[ 0 ] | ( p[ 1 ] << 8 );
+								p += 2;
+								return true;
+							}
+};
+
+/*
+================
+pkLong
+================
+*/
+struct pkLong {
+	typedef u32				argType;
+	typedef u32				type;
+	static const int		MAX_SIZE = 4;
+
+	static byte*			Write( byte* p, u32 value ) {
+								p[ 0 ] = ( byte )value;
+								p[ 1 ] = ( byte )( value >> 8 );
+								p[ 2 ] = ( byte )( value >> 16 );
+								p[ 3 ] = ( byte )( value >> 24 );
+								return p + 4;
+							}
+	static bool				Read( const byte*& p, const byte* end, u32& value ) {
+								if ( end - p < 4 ) {
+									return false;
+								}
+								value = ( u32 )p[ 0 ] | ( ( u32 )p[ 1 ] << 8 ) | ( ( u32 )p[ 2 ] << 16 ) | ( ( u32 )p[ 3 ] << 24 );
+								p += 4;
+								return true;
+							}
+};
+
+/*
+================
+pkString
+
+NUL terminated, at most MAX_LENGTH characters; longer strings are truncated
+================
+*/
+template< int MAX_LENGTH >
+struct pkString {
+	typedef const char*		argType;
+	typedef const char*		type;
+	static const int		MAX_SIZE = MAX_LENGTH + 1;
+
+	static byte*			Write( byte* p, const char* value ) {
+								int length = ( int )strnlen( value, MAX_LENGTH );
+								memcpy( p, value, length );
+								p[ length ] = '\0';
+								return p + length + 1;
+							}
+	static bool				Read( const byte*& p, const byte* end, const char*& value ) {
+								int available = ( int )( end - p ) < MAX_SIZE ? ( int )( end - p ) : MAX_SIZE;
+								const byte* nul = ( const byte* )memchr( p, 0, available );
+								if ( nul == NULL ) {
+									return false;
+								}
+								value = ( const char* )p;
+								p = nul + 1;
+								return true;
+							}
+};
+
+/*
+================
+pkKeyValues
+
+an already encoded key\0value\0 ... block of at most MAX_LENGTH bytes. The list
+is not terminated by the field itself, the reader stops at the first empty key
+without consuming it.
+================
+*/
+template< int MAX_LENGTH >
+struct pkKeyValues {
+	typedef pkData_t		argType;
+	typedef pkData_t		type;
+	static const int		MAX_SIZE = MAX_LENGTH;
+
+	static byte*			Write( byte* p, const pkData_t& value ) {
+								int length = value.length < MAX_LENGTH ? value.length : MAX_LENGTH;
+								memcpy( p, value.data, length );
+								return p + length;
+							}
+	static bool				Read( const byte*& p, const byte* end, pkData_t& value ) {
+								const byte* start = p;
+								while ( p < end && *p != '\0' ) {
+									for ( int i = 0; i < 2; i++ ) {
+										const byte* nul = ( const byte* )memchr( p, 0, end - p );
+										if ( nul == NULL || nul + 1 - start > MAX_LENGTH ) {
+											p = start;
+											return false;
+										}
+										p = nul + 1;
+									}
+								}
+								value.data = start;
+								value.length = ( int )( p - start );
+								return true;
+							}
+};
+
+/*
+================
+sdPacketFields
+================
+*/
+template< typename... FIELDS >
+struct sdPacketFields;
+
+template<>
+struct sdPacketFields<> {
+	static const int		MAX_SIZE = 0;
+
+	static byte*			Write( byte* p ) { return p; }
+	static bool				Read( const byte*& p, const byte* end ) { return true; }
+};
+
+template< typename FIELD, typename... REST >
+struct sdPacketFields< FIELD, REST... > {
+	static const int		MAX_SIZE = FIELD::MAX_SIZE + sdPacketFields< REST... >::MAX_SIZE;
+
+	static byte*			Write( byte* p, typename FIELD::argType value, typename REST::argType... rest ) {
+								return sdPacketFields< REST... >::Write( FIELD::Write( p, value ), rest... );
+							}
+	static bool				Read( const byte*& p, const byte* end, typename FIELD::type& value, typename REST::type&... rest ) {
+								return FIELD::Read( p, end, value ) && sdPacketFields< REST... >::Read( p, end, rest... );
+							}
+};
+
+/*
+================
+sdPacket
+================
+*/
+template< typename NAME, typename... FIELDS >
+class sdPacket {
+public:
+	typedef sdPacketFields< FIELDS... >	fields_t;
+
+	static const int		NAME_SIZE = NAME::SIZE;
+	static const int		MAX_SIZE = NAME::SIZE + fields_t::MAX_SIZE;		// without the OOB header
+
+	static_assert( OOB_HEADER_SIZE + MAX_SIZE <= BUFFSZ, "packet layout does not fit in a datagram buffer" );
+
+							// dest must have room for MAX_SIZE bytes, returns the encoded length
+	static int				Encode( byte* dest, typename FIELDS::argType... values ) {
+								memcpy( dest, NAME::String(), NAME_SIZE );
+								return ( int )( fields_t::Write( dest + NAME_SIZE, values... ) - dest );
+							}
+
+							// appends the packet to msg, false and msg flagged as overflowed if MAX_SIZE bytes are not left
+	static bool				Encode( sdMsgWriter& msg, typename FIELDS::argType... values ) {
+								byte* dest = msg.GetWriteBuffer( MAX_SIZE );
+								if ( dest == NULL ) {
+									return false;
+								}
+								msg.CommitWrite( Encode( dest, values... ) );
+								return true;
+							}
+
+							// msg must be positioned after the command string, nothing is consumed on failure
+	static bool				Decode( sdMsgReader& msg, typename FIELDS::type&... values ) {
+								const byte* start = msg.GetCursor();
+								const byte* p = start;
+								if ( !fields_t::Read( p, start + msg.GetRemaining(), values... ) ) {
+									return false;
+								}
+								msg.Skip( ( int )( p - start ) );
+								return true;
+							}
+};
+
+#endif /* !__MSR_PACKET_H__ */
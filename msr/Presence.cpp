@@ -0,0 +1,245 @@
+
+#include "Presence.h"
+
+/*
+================
+sdPresence::sdPresence
+================
+*/
+sdPresence::sdPresence( void ) :
+	flushHead( 0 ) {
+	memset( &stats, 0, sizeof( stats ) );
+}
+
+/*
+================
+sdPresence::FindOrAdd
+
+client id 0 is invalid in sdnet and the empty key of clientHash, callers check it
+================
+*/
+int sdPresence::FindOrAdd( u64 id ) {
+	int index = clientHash.Find( id );
+	if ( index != sdAddressHash::INVALID_INDEX ) {
+		return index;
+	}
+
+	index = ( int )clients.size();
+	clients.push_back( client_t() );
+	client_t& client = clients.back();
+	client.id = id;
+	client.presence.state = OS_OFFLINE;
+	client.presence.session = 0;
+	client.connected = false;
+	client.flushQueued = false;
+	clientHash.Set( id, index );
+	return index;
+}
+
+/*
+================
+sdPresence::FindSubscriber
+================
+*/
+int sdPresence::FindSubscriber( const client_t& client, int recipient ) const {
+	for ( size_t i = 0; i < client.subscribers.size(); i++ ) {
+		if ( client.subscribers[ i ].client == recipient ) {
+			return ( int )i;
+		}
+	}
+	return -1;
+}
+
+/*
+================
+sdPresence::FindWatch
+================
+*/
+int sdPresence::FindWatch( const client_t& client, int friendIndex ) const {
+	for ( size_t i = 0; i < client.watches.size(); i++ ) {
+		if ( client.watches[ i ].client == friendIndex ) {
+			return ( int )i;
+		}
+	}
+	return -1;
+}
+
+/*
+================
+sdPresence::MarkPending
+
+the first change in a window starts it, later ones ride along
+================
+*/
+void sdPresence::MarkPending( int recipient, int watch, int now ) {
+	client_t& client = clients[ recipient ];
+	watch_t& w = client.watches[ watch ];
+	if ( w.pending ) {
+		stats.coalesced++;
+		return;
+	}
+	w.pending = true;
+	client.pending.push_back( watch );
+	stats.queued++;
+
+	if ( !client.flushQueued ) {
+		client.flushQueued = true;
+		flush_t flush;
+		flush.client = recipient;
+		flush.time = now + COALESCE_MSEC;
+		flushQueue.push_back( flush );
+	}
+}
+
+/*
+================
+sdPresence::Notify
+================
+*/
+void sdPresence::Notify( int index, int now ) {
+	const std::vector< subscriber_t >& subscribers = clients[ index ].subscribers;
+	for ( size_t i = 0; i < subscribers.size(); i++ ) {
+		MarkPending( subscribers[ i ].client, subscribers[ i ].watch, now );
+	}
+}
+
+/*
+================
+sdPresence::SetPresence
+================
+*/
+void sdPresence::SetPresence( u64 id, const presence_t& presence, int now ) {
+	if ( id == 0 ) {
+		return;
+	}
+
+	const int index = FindOrAdd( id );
+	client_t& client = clients[ index ];
+	client.connected = true;
+	if ( client.presence == presence ) {
+		return;
+	}
+	client.presence = presence;
+	stats.updates++;
+	Notify( index, now );
+}
+
+/*
+================
+sdPresence::Disconnect
+================
+*/
+void sdPresence::Disconnect( u64 id, int now ) {
+	const int index = clientHash.Find( id );
+	if ( index == sdAddressHash::INVALID_INDEX ) {
+		return;
+	}
+
+	client_t& client = clients[ index ];
+	client.connected = false;
+	while ( !client.watches.empty() ) {
+		RemoveWatch( index, ( int )client.watches.size() - 1 );
+	}
+
+	if ( client.presence.state != OS_OFFLINE || client.presence.session != 0 ) {
+		client.presence.state = OS_OFFLINE;
+		client.presence.session = 0;
+		stats.updates++;
+		Notify( index, now );
+	}
+}
+
+/*
+================
+sdPresence::Subscribe
+================
+*/
+bool sdPresence::Subscribe( u64 id, u64 friendId, int now ) {
+	if ( id == 0 || friendId == 0 || id == friendId ) {
+		return true;
+	}
+
+	const int index = FindOrAdd( id );
+	const int friendIndex = FindOrAdd( friendId );
+	client_t& client = clients[ index ];
+	if ( FindWatch( client, friendIndex ) >= 0 ) {
+		return true;
+	}
+	if ( ( int )client.watches.size() >= MAX_WATCHES ) {
+		return false;
+	}
+
+	watch_t watch;
+	watch.client = friendIndex;
+	watch.delivered.state = OS_NUM_STATES;
+	watch.delivered.session = 0;
+	watch.pending = false;
+	client.watches.push_back( watch );
+
+	subscriber_t subscriber;
+	subscriber.client = index;
+	subscriber.watch = ( int )client.watches.size() - 1;
+	clients[ friendIndex ].subscribers.push_back( subscriber );
+
+	MarkPending( index, subscriber.watch, now );
+	return true;
+}
+
+/*
+================
+sdPresence::Unsubscribe
+================
+*/
+void sdPresence::Unsubscribe( u64 id, u64 friendId ) {
+	const int index = clientHash.Find( id );
+	const int friendIndex = clientHash.Find( friendId );
+	if ( index == sdAddressHash::INVALID_INDEX || friendIndex == sdAddressHash::INVALID_INDEX ) {
+		return;
+	}
+
+	const int watch = FindWatch( clients[ index ], friendIndex );
+	if ( watch >= 0 ) {
+		RemoveWatch( index, watch );
+	}
+}
+
+/*
+================
+sdPresence::RemoveWatch
+
+the last watch moves into the hole, its subscriber and pending entries follow it
+================
+*/
+void sdPresence::RemoveWatch( int recipient, int watch ) {
+	client_t& client = clients[ recipient ];
+	const int last = ( int )client.watches.size() - 1;
+
+	std::vector< subscriber_t >& subscribers = clients[ client.watches[ watch ].client ].subscribers;
+	subscribers[ FindSubscriber( clients[ client.watches[ watch ].client ], recipient ) ] = subscribers.back();
+	subscribers.pop_back();
+
+	if ( client.watches[ watch ].pending ) {
+		for ( size_t i = 0; i < client.pending.size(); i++ ) {
+			if ( client.pending[ i ] == watch ) {
+				client.pending[ i ] = client.pending.back();
+				client.pending.pop_back();
+				break;
+			}
+		}
+	}
+
+	if ( watch != last ) {
+		client.watches[ watch ] = client.watches[ last ];
+		client_t& moved = clients[ client.watches[ watch ].client ];
+		moved.subscribers[ FindSubscriber( moved, recipient ) ].watch = watch;
+		if ( client.watches[ watch ].pending ) {
+			for ( size_t i = 0; i < client.pending.size(); i++ ) {
+				if ( client.pending[ i ] == last ) {
+					client.pending[ i ] = watch;
+					break;
+				}
+			}
+		}
+	}
+	client.watches.pop_back();
+}
@@ -0,0 +1,186 @@
+
+#ifndef __MSR_PRESENCE_H__
+#define __MSR_PRESENCE_H__
+
+#include "Common.h"
+#include "AddressHash.h"
+
+#include <vector>
+
+/*
+===============================================================================
+
+	sdPresence
+
+	Who is online and which session they are in, pushed to the friends that
+	watch them instead of every client polling its whole friends list
+	(sdNetProperties::UpdateProperties counts the online friends under the
+	friends lock once a second).
+
+	A client sets its own presence and subscribes to the clients on its
+	friends list; the subscription answers with their current presence right
+	away, after that only changes are sent. A change is not sent at once: the
+	recipient gets COALESCE_MSEC to collect more, then every friend that
+	changed in that window goes out in one batch with the presence it has at
+	that moment. A friend that flips back and forth inside the window costs
+	one entry, or nothing if it ends where the recipient last saw it.
+
+	Each subscription is one watch_t in the recipient's list plus one
+	subscriber_t in the friend's list that points back at it, so a change
+	reaches its subscribers without any search and a batch is built from the
+	recipient's pending watches only. Recipients wait for their flush in one
+	FIFO; every window has the same length, so it is ordered by due time.
+
+	Clients are never removed, one that went offline keeps its (empty) entry.
+	Only a connected client is a recipient, Disconnect drops its subscriptions.
+
+===============================================================================
+*/
+
+class sdPresence {
+public:
+	static const int		COALESCE_MSEC		= 250;
+	static const int		MAX_WATCHES			= 1024;			// friends a client can subscribe to
+
+	// same values as sdNetFriend::onlineState_e
+	enum onlineState_e {
+		OS_OFFLINE,
+		OS_ONLINE,
+		OS_GHOST,
+		OS_NUM_STATES
+	};
+
+	struct presence_t {
+		byte				state;
+		u64					session;			// packed address of the session the client is in, 0 if none
+
+		bool				operator==( const presence_t& other ) const { return state == other.state && session == other.session; }
+		bool				operator!=( const presence_t& other ) const { return !( *this == other ); }
+	};
+
+	struct change_t {
+		u64					client;
+		presence_t			presence;
+	};
+
+	struct stats_t {
+		u64					updates;			// SetPresence calls that changed something
+		u64					queued;				// changes that reached a subscriber
+		u64					coalesced;			// changes folded into one already pending
+		u64					unchanged;			// pending changes that ended where the recipient last saw them
+		u64					delivered;			// entries sent
+		u64					batches;
+	};
+
+							sdPresence( void );
+
+							// client connected and set its presence, or changed it
+	void					SetPresence( u64 client, const presence_t& presence, int now );
+							// client went offline, its subscriptions are dropped
+	void					Disconnect( u64 client, int now );
+
+							// false once the client watches MAX_WATCHES friends; the friend's current presence
+							// is added to the pending batch, so the first flush answers the subscription
+	bool					Subscribe( u64 client, u64 friendClient, int now );
+	void					Unsubscribe( u64 client, u64 friendClient );
+
+							// -1 if no recipient is waiting
+	int						GetNextFlushTime( void ) const { return flushHead < ( int )flushQueue.size() ? flushQueue[ flushHead ].time : -1; }
+
+							// hands every recipient whose window is over to deliver( recipient, changes, numChanges )
+	template< typename FUNC >
+	int						Flush( int now, FUNC& deliver );
+
+	int						Num( void ) const { return ( int )clients.size(); }
+	const stats_t&			GetStats( void ) const { return stats; }
+
+private:
+	struct watch_t {
+		int					client;				// the friend
+		presence_t			delivered;			// what the recipient saw last, state OS_NUM_STATES before the first flush
+		bool				pending;
+	};
+
+	struct subscriber_t {
+		int					client;				// the recipient
+		int					watch;				// index in its watches
+	};
+
+	struct client_t {
+		u64					id;
+		presence_t			presence;
+		bool				connected;
+		bool				flushQueued;
+		std::vector< watch_t >		watches;
+		std::vector< subscriber_t >	subscribers;
+		std::vector< int >			pending;	// indices in watches
+	};
+
+	struct flush_t {
+		int					client;
+		int					time;
+	};
+
+	int						FindOrAdd( u64 id );
+	int						FindSubscriber( const client_t& client, int recipient ) const;
+	int						FindWatch( const client_t& client, int friendIndex ) const;
+	void					MarkPending( int recipient, int watch, int now );
+	void					Notify( int index, int now );
+	void					RemoveWatch( int recipient, int watch );
+
+	sdAddressHash			clientHash;
+	std::vector< client_t >	clients;
+	std::vector< flush_t >	flushQueue;
+	int						flushHead;
+	std::vector< change_t >	batch;
+	stats_t					stats;
+};
+
+/*
+================
+sdPresence::Flush
+================
+*/
+template< typename FUNC >
+int sdPresence::Flush( int now, FUNC& deliver ) {
+	int numFlushed = 0;
+	for ( ; flushHead < ( int )flushQueue.size() && now - flushQueue[ flushHead ].time >= 0; flushHead++ ) {
+		client_t& recipient = clients[ flushQueue[ flushHead ].client ];
+		recipient.flushQueued = false;
+
+		batch.clear();
+		for ( size_t i = 0; i < recipient.pending.size(); i++ ) {
+			watch_t& watch = recipient.watches[ recipient.pending[ i ] ];
+			watch.pending = false;
+
+			const client_t& friendClient = clients[ watch.client ];
+			if ( friendClient.presence == watch.delivered ) {
+				stats.unchanged++;
+				continue;
+			}
+			watch.delivered = friendClient.presence;
+
+			change_t change;
+			change.client = friendClient.id;
+			change.presence = friendClient.presence;
+			batch.push_back( change );
+		}
+		recipient.pending.clear();
+
+		if ( !batch.empty() && recipient.connected ) {
+			stats.delivered += batch.size();
+			stats.batches++;
+			numFlushed++;
+			deliver( recipient.id, batch.data(), ( int )batch.size() );
+		}
+	}
+
+	// the queue is only empty between bursts, don't let a steady load grow it forever
+	if ( flushHead * 2 >= ( int )flushQueue.size() ) {
+		flushQueue.erase( flushQueue.begin(), flushQueue.begin() + flushHead );
+		flushHead = 0;
+	}
+	return numFlushed;
+}
+
+#endif /* !__MSR_PRESENCE_H__ */
@@ -0,0 +1,928 @@
+
+#include "Common.h"
+#include "OOBPackets.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/*
+===============================================================================
+
+	msr_replay
+
+	Replays captured client traffic at volume. The hex dumps in the repository
+	are converted once into a binary corpus:
+
+		msr_replay -convert corpus.bin packet_from_etqwcbof.txt collected_packet_data.txt
+
+	and the corpus is then sent round robin, open loop, at a fixed rate or a
+	ramp of rates, from many sockets so SO_REUSEPORT and the per source code
+	paths see many clients:
+
+		msr_replay -corpus corpus.bin -rate 5000:50000 -steps 10 -stepTime 5
+
+	The UDP packets go to a master; every packet the dump shows a server reply
+	for is timed until its reply arrives, and each step reports the throughput
+	and p50 / p99 / p999 reply latency. A getStatus is sent with a sequence
+	number as its challenge and matched by the echo in the statusResponse; a
+	reply that echoes nothing can't be told apart from the next one, so each
+	socket times at most one of those at a time. With -tcp the TCP streams are replayed against msr_auth over
+	-sockets connections per thread instead; the auth stand-in doesn't reply,
+	so only the throughput is reported.
+
+	Corpus file:
+
+		"MSRC", long version, long numRecords
+		numRecords * ( byte transport, byte expectsReply, short length, length bytes )
+
+===============================================================================
+*/
+
+static const u32			CORPUS_VERSION		= 1;
+static const int			MAX_RECORD_SIZE		= 4096;
+static const int			REPLY_TIMEOUT		= 1000 * 1000;		// usec, later replies count as lost
+static const int			CALIBRATE_TIMEOUT	= 500;				// msec
+
+// loopback source addresses, in host byte order
+static const u32			SOURCE_REPLAY		= 0x7f040000;		// 127.4.0.0 + socket
+static const u32			SOURCE_CALIBRATE	= 0x7f050000;		// 127.5.0.0 + record
+
+enum transport_e {
+	TRANSPORT_UDP,
+	TRANSPORT_TCP
+};
+
+struct corpusRecord_t {
+	int						transport;
+	bool					expectsReply;
+	bool					echoesChallenge;	// a getStatus, not stored in the corpus
+	std::vector< byte >		data;
+};
+
+struct replayConfig_t {
+							replayConfig_t( void ) :
+								host( "127.0.0.1" ),
+								port( 0 ),
+								numThreads( 1 ),
+								numSockets( 1024 ),
+								startRate( 1000 ),
+								endRate( 1000 ),
+								numSteps( 1 ),
+								stepTime( 10 ),
+								tcp( false ) {
+							}
+
+	const char*				host;
+	u16						port;				// MASTER_PORT, or 3074 with -tcp
+	int						numThreads;
+	int						numSockets;			// per thread
+	int						startRate;			// packets per second over all threads
+	int						endRate;
+	int						numSteps;
+	int						stepTime;			// seconds
+	bool					tcp;
+};
+
+/*
+================
+latencyHistogram_t
+
+log linear buckets, 32 per power of two above 64 usec, within 3%
+================
+*/
+struct latencyHistogram_t {
+	static const int		SUB_BITS		= 5;
+	static const int		SUB_BUCKETS		= 1 << SUB_BITS;
+	static const int		NUM_BUCKETS		= 2 * SUB_BUCKETS + 25 * SUB_BUCKETS;
+
+							latencyHistogram_t( void ) : total( 0 ) { memset( counts, 0, sizeof( counts ) ); }
+
+	void					Add( u64 usec ) {
+								counts[ Bucket( usec ) ]++;
+								total++;
+							}
+
+	void					Merge( const latencyHistogram_t& other ) {
+								for ( int i = 0; i < NUM_BUCKETS; i++ ) {
+									counts[ i ] += other.counts[ i ];
+								}
+								total += other.total;
+							}
+
+	u64						Percentile( double fraction ) const {
+								if ( total == 0 ) {
+									return 0;
+								}
+								u64 rank = ( u64 )( fraction * ( double )( total - 1 ) ) + 1;
+								u64 seen = 0;
+								for ( int i = 0; i < NUM_BUCKETS; i++ ) {
+									seen += counts[ i ];
+									if ( seen >= rank ) {
+										return Value( i );
+									}
+								}
+								return Value( NUM_BUCKETS - 1 );
+							}
+
+	static int				Bucket( u64 usec ) {
+								if ( usec < 2 * SUB_BUCKETS ) {
+									return ( int )usec;
+								}
+								int shift = 63 - __builtin_clzll( usec ) - SUB_BITS;
+								int index = 2 * SUB_BUCKETS + ( shift - 1 ) * SUB_BUCKETS + ( int )( ( usec >> shift ) - SUB_BUCKETS );
+								return index < NUM_BUCKETS ? index : NUM_BUCKETS - 1;
+							}
+
+							// middle of the bucket
+	static u64				Value( int index ) {
+								if ( index < 2 * SUB_BUCKETS ) {
+									return ( u64 )index;
+								}
+								int shift = ( index - 2 * SUB_BUCKETS ) / SUB_BUCKETS + 1;
+								u64 low = ( u64 )( ( index - 2 * SUB_BUCKETS ) % SUB_BUCKETS + SUB_BUCKETS ) << shift;
+								return low + ( ( 1ULL << shift ) >> 1 );
+							}
+
+	u64						counts[ NUM_BUCKETS ];
+	u64						total;
+};
+
+struct stepStats_t {
+	u64						sent;
+	u64						replies;
+	u64						lost;
+	u64						sendErrors;
+	u64						held;				// sends skipped while a reply without an echo was outstanding
+	latencyHistogram_t		latency;
+};
+
+/*
+================
+replaySocket_t
+
+the getStatus send times are kept by sequence number, a lost reply costs only
+its own entry
+================
+*/
+struct replaySocket_t {
+	int						fd;
+	int						nextRecord;			// a TCP stream has to arrive in order
+	u32						baseSequence;		// of sendTimes[ 0 ]
+	std::vector< u64 >		sendTimes;			// 0 once answered
+	size_t					head;				// older entries are answered or lost
+	u64						waitSince;			// send time of the timed request without an echo, 0 if none
+};
+
+static replayConfig_t			replayConfig;
+static sockaddr_in				targetAddr;
+static std::vector< corpusRecord_t >	corpus;
+static std::vector< int >		replayRecords;			// the corpus records of the replayed transport
+static u64						replayStart;
+
+/*
+================
+Replay_HexValue
+================
+*/
+static int Replay_HexValue( char c ) {
+	if ( c >= '0' && c <= '9' ) {
+		return c - '0';
+	}
+	if ( c >= 'a' && c <= 'f' ) {
+		return c - 'a' + 10;
+	}
+	if ( c >= 'A' && c <= 'F' ) {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+/*
+================
+Replay_ParseSpacedHex
+
+one line of a "ff ff 67 65 ...   ..getStatus" dump, false if it holds no bytes
+================
+*/
+static bool Replay_ParseSpacedHex( const char* line, std::vector< byte >& out ) {
+	bool found = false;
+	// 16 columns of "xx ", the ascii column follows
+	for ( int column = 0; column < 16; column++ ) {
+		const char* p = line + column * 3;
+		if ( ( int )strlen( line ) < column * 3 + 2 ) {
+			break;
+		}
+		int high = Replay_HexValue( p[ 0 ] );
+		int low = Replay_HexValue( p[ 1 ] );
+		if ( high < 0 || low < 0 || ( p[ 2 ] != ' ' && p[ 2 ] != '\0' && p[ 2 ] != '\r' && p[ 2 ] != '\n' ) ) {
+			break;
+		}
+		out.push_back( ( byte )( high * 16 + low ) );
+		found = true;
+	}
+	return found;
+}
+
+/*
+================
+Replay_ParseHexStream
+
+one line of packet_testing.js output. The listener decoded the stream as UTF-8
+before dumping it, so every byte that wasn't valid UTF-8 reads as ef bf bd
+(U+FFFD); each of those stands for one lost byte and becomes 0x80, which keeps
+the frame lengths right.
+================
+*/
+static bool Replay_ParseHexStream( const char* line, std::vector< byte >& out ) {
+	int length = ( int )strlen( line );
+	while ( length > 0 && ( line[ length - 1 ] == '\r' || line[ length - 1 ] == '\n' || line[ length - 1 ] == ' ' ) ) {
+		length--;
+	}
+	if ( length < 8 || ( length & 1 ) != 0 ) {
+		return false;
+	}
+	for ( int i = 0; i < length; i++ ) {
+		if ( Replay_HexValue( line[ i ] ) < 0 ) {
+			return false;
+		}
+	}
+
+	for ( int i = 0; i < length; ) {
+		if ( length - i >= 6 && !strncasecmp( line + i, "efbfbd", 6 ) ) {
+			out.push_back( 0x80 );
+			i += 6;
+			continue;
+		}
+		out.push_back( ( byte )( Replay_HexValue( line[ i ] ) * 16 + Replay_HexValue( line[ i + 1 ] ) ) );
+		i += 2;
+	}
+	return true;
+}
+
+/*
+================
+Replay_RepairFrames
+
+the decoder also folded some truncated sequences into a single U+FFFD, so a
+stream can come out a few bytes short of what its frame headers declare; the
+last frame is padded back to its length, the headers themselves are intact
+================
+*/
+static void Replay_RepairFrames( std::vector< byte >& stream ) {
+	size_t offset = 0;
+	while ( stream.size() - offset >= 4 ) {
+		size_t length = ( size_t )stream[ offset ] | ( ( size_t )stream[ offset + 1 ] << 8 ) | ( ( size_t )stream[ offset + 2 ] << 16 ) | ( ( size_t )stream[ offset + 3 ] << 24 );
+		offset += 4;
+		if ( length > ( size_t )MAX_RECORD_SIZE ) {
+			return;
+		}
+		if ( stream.size() - offset < length ) {
+			stream.resize( offset + length, 0x80 );
+		}
+		offset += length;
+	}
+}
+
+/*
+================
+Replay_LoadDump
+
+the CLIENT blocks of a spaced dump become UDP records that expect a reply when
+a SERVER block follows them, every unspaced hex line becomes a TCP record
+================
+*/
+static void Replay_LoadDump( const char* fileName ) {
+	FILE* f = fopen( fileName, "rb" );
+	if ( f == NULL ) {
+		Msr_Error( "couldn't open '%s' (%s)", fileName, strerror( errno ) );
+	}
+
+	enum { BLOCK_NONE, BLOCK_CLIENT, BLOCK_SERVER } block = BLOCK_NONE;
+	const size_t first = corpus.size();
+	int pending = -1;			// last client record, waiting to see if a reply follows
+
+	char line[ 8192 ];
+	while ( fgets( line, sizeof( line ), f ) != NULL ) {
+		if ( !strncmp( line, "CLIENT", 6 ) ) {
+			block = BLOCK_CLIENT;
+			corpusRecord_t record;
+			record.transport = TRANSPORT_UDP;
+			record.expectsReply = false;
+			record.echoesChallenge = false;
+			corpus.push_back( record );
+			pending = ( int )corpus.size() - 1;
+			continue;
+		}
+		if ( !strncmp( line, "SERVER", 6 ) ) {
+			block = BLOCK_SERVER;
+			if ( pending >= 0 ) {
+				corpus[ pending ].expectsReply = true;
+				pending = -1;
+			}
+			continue;
+		}
+
+		if ( block == BLOCK_CLIENT ) {
+			Replay_ParseSpacedHex( line, corpus.back().data );
+			continue;
+		}
+		if ( block == BLOCK_SERVER ) {
+			continue;
+		}
+
+		corpusRecord_t record;
+		record.transport = TRANSPORT_TCP;
+		record.expectsReply = false;
+		record.echoesChallenge = false;
+		if ( Replay_ParseHexStream( line, record.data ) ) {
+			Replay_RepairFrames( record.data );
+			corpus.push_back( record );
+		}
+	}
+	fclose( f );
+
+	// drop client blocks that had no bytes
+	for ( size_t i = first; i < corpus.size(); ) {
+		if ( corpus[ i ].data.empty() || ( int )corpus[ i ].data.size() > MAX_RECORD_SIZE ) {
+			corpus.erase( corpus.begin() + i );
+			continue;
+		}
+		i++;
+	}
+
+	Msr_Printf( "- %s: %d records\n", fileName, ( int )( corpus.size() - first ) );
+}
+
+/*
+================
+Replay_WriteCorpus
+================
+*/
+static void Replay_WriteCorpus( const char* fileName ) {
+	FILE* f = fopen( fileName, "wb" );
+	if ( f == NULL ) {
+		Msr_Error( "couldn't create '%s' (%s)", fileName, strerror( errno ) );
+	}
+
+	std::vector< byte > out;
+	auto writeLong = [&out]( u32 value ) {
+		for ( int i = 0; i < 4; i++ ) {
+			out.push_back( ( byte )( value >> ( i * 8 ) ) );
+		}
+	};
+
+	const char* magic = "MSRC";
+	for ( int i = 0; i < 4; i++ ) {
+		out.push_back( ( byte )magic[ i ] );
+	}
+	writeLong( CORPUS_VERSION );
+	writeLong( ( u32 )corpus.size() );
+	for ( size_t i = 0; i < corpus.size(); i++ ) {
+		const corpusRecord_t& record = corpus[ i ];
+		out.push_back( ( byte )record.transport );
+		out.push_back( record.expectsReply ? 1 : 0 );
+		out.push_back( ( byte )record.data.size() );
+		out.push_back( ( byte )( record.data.size() >> 8 ) );
+		out.insert( out.end(), record.data.begin(), record.data.end() );
+	}
+
+	if ( fwrite( out.data(), 1, out.size(), f ) != out.size() ) {
+		Msr_Error( "couldn't write '%s'", fileName );
+	}
+	fclose( f );
+}
+
+/*
+================
+Replay_ReadCorpus
+================
+*/
+static void Replay_ReadCorpus( const char* fileName ) {
+	FILE* f = fopen( fileName, "rb" );
+	if ( f == NULL ) {
+		Msr_Error( "couldn't open '%s' (%s)", fileName, strerror( errno ) );
+	}
+	std::vector< byte > in;
+	byte buffer[ 65536 ];
+	size_t num;
+	while ( ( num = fread( buffer, 1, sizeof( buffer ), f ) ) > 0 ) {
+		in.insert( in.end(), buffer, buffer + num );
+	}
+	fclose( f );
+
+	const byte* p = in.data();
+	const byte* end = p + in.size();
+	auto readLong = [&p]( void ) {
+		u32 value = ( u32 )p[ 0 ] | ( ( u32 )p[ 1 ] << 8 ) | ( ( u32 )p[ 2 ] << 16 ) | ( ( u32 )p[ 3 ] << 24 );
+		p += 4;
+		return value;
+	};
+
+	if ( end - p < 12 || memcmp( p, "MSRC", 4 ) != 0 ) {
+		Msr_Error( "'%s' is not a corpus", fileName );
+	}
+	p += 4;
+	if ( readLong() != CORPUS_VERSION ) {
+		Msr_Error( "'%s' has an unsupported version", fileName );
+	}
+	u32 numRecords = readLong();
+	for ( u32 i = 0; i < numRecords; i++ ) {
+		if ( end - p < 4 ) {
+			Msr_Error( "'%s' is truncated", fileName );
+		}
+		corpusRecord_t record;
+		record.transport = p[ 0 ];
+		record.expectsReply = p[ 1 ] != 0;
+		record.echoesChallenge = false;
+		int length = p[ 2 ] | ( p[ 3 ] << 8 );
+		p += 4;
+		if ( end - p < length ) {
+			Msr_Error( "'%s' is truncated", fileName );
+		}
+		record.data.assign( p, p + length );
+		p += length;
+		corpus.push_back( record );
+	}
+}
+
+/*
+================
+Replay_TargetRate
+
+packets per second of a step, the ramp is linear
+================
+*/
+static double Replay_TargetRate( int step ) {
+	if ( replayConfig.numSteps <= 1 ) {
+		return replayConfig.startRate;
+	}
+	return replayConfig.startRate + ( double )( replayConfig.endRate - replayConfig.startRate ) * step / ( replayConfig.numSteps - 1 );
+}
+
+/*
+================
+Replay_StepAt
+
+the step a time falls in, numSteps once the run is over
+================
+*/
+static int Replay_StepAt( u64 now ) {
+	u64 step = ( now - replayStart ) / ( ( u64 )replayConfig.stepTime * 1000000 );
+	return step < ( u64 )replayConfig.numSteps ? ( int )step : replayConfig.numSteps;
+}
+
+/*
+================
+Replay_Due
+
+packets a thread should have sent by now, the integral of its share of the ramp
+================
+*/
+static u64 Replay_Due( u64 now ) {
+	const u64 stepUsec = ( u64 )replayConfig.stepTime * 1000000;
+	double due = 0.0;
+	u64 elapsed = now - replayStart;
+	for ( int step = 0; step < replayConfig.numSteps && elapsed > 0; step++ ) {
+		u64 t = elapsed < stepUsec ? elapsed : stepUsec;
+		due += Replay_TargetRate( step ) * ( double )t / 1000000.0;
+		elapsed -= t;
+	}
+	return ( u64 )( due / replayConfig.numThreads );
+}
+
+/*
+================
+Replay_OpenSocket
+
+against a loopback target every UDP socket binds its own source address, the
+master rate limits per source IP, see msr_bench
+================
+*/
+static int Replay_OpenSocket( u32 source ) {
+	int fd;
+	if ( replayConfig.tcp ) {
+		fd = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+		if ( fd < 0 || connect( fd, ( sockaddr* )&targetAddr, sizeof( targetAddr ) ) < 0 ) {
+			Msr_Error( "connect failed (%s)", strerror( errno ) );
+		}
+		int on = 1;
+		setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on ) );
+		fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+		return fd;
+	}
+
+	fd = socket( AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, IPPROTO_UDP );
+	if ( fd < 0 ) {
+		Msr_Error( "socket failed (%s)", strerror( errno ) );
+	}
+	int size = 4 * 1024 * 1024;
+	setsockopt( fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof( size ) );
+	if ( ( ntohl( targetAddr.sin_addr.s_addr ) >> 24 ) == 127 ) {
+		sockaddr_in local;
+		memset( &local, 0, sizeof( local ) );
+		local.sin_family = AF_INET;
+		local.sin_addr.s_addr = htonl( source );
+		if ( bind( fd, ( sockaddr* )&local, sizeof( local ) ) < 0 ) {
+			Msr_Error( "bind failed (%s)", strerror( errno ) );
+		}
+	}
+	if ( connect( fd, ( sockaddr* )&targetAddr, sizeof( targetAddr ) ) < 0 ) {
+		Msr_Error( "connect failed (%s)", strerror( errno ) );
+	}
+	return fd;
+}
+
+/*
+================
+Replay_EchoesChallenge
+================
+*/
+static bool Replay_EchoesChallenge( const corpusRecord_t& record ) {
+	return record.transport == TRANSPORT_UDP && record.data.size() >= ( size_t )( OOB_HEADER_SIZE + getStatusPacket_t::NAME_SIZE + 4 ) &&
+		memcmp( record.data.data() + OOB_HEADER_SIZE, pkName_getStatus::String(), pkName_getStatus::SIZE ) == 0;
+}
+
+/*
+================
+Replay_Expire
+
+requests that went unanswered for REPLY_TIMEOUT are lost
+================
+*/
+static void Replay_Expire( replaySocket_t& s, u64 now, stepStats_t& stats ) {
+	for ( ; s.head < s.sendTimes.size(); s.head++ ) {
+		if ( s.sendTimes[ s.head ] == 0 ) {
+			continue;
+		}
+		if ( now - s.sendTimes[ s.head ] <= ( u64 )REPLY_TIMEOUT ) {
+			break;
+		}
+		stats.lost++;
+	}
+	if ( s.head > 1024 && s.head * 2 > s.sendTimes.size() ) {
+		s.sendTimes.erase( s.sendTimes.begin(), s.sendTimes.begin() + s.head );
+		s.baseSequence += ( u32 )s.head;
+		s.head = 0;
+	}
+
+	if ( s.waitSince != 0 && now - s.waitSince > ( u64 )REPLY_TIMEOUT ) {
+		s.waitSince = 0;
+		stats.lost++;
+	}
+}
+
+/*
+================
+Replay_Receive
+
+a statusResponse is matched by its echoed challenge, anything else answers the
+request without an echo
+================
+*/
+static void Replay_Receive( replaySocket_t& s, const byte* reply, int length, u64 now, stepStats_t& stats ) {
+	const int echoOffset = OOB_HEADER_SIZE + statusResponsePacket_t::NAME_SIZE;
+	if ( length >= echoOffset + 4 && memcmp( reply + OOB_HEADER_SIZE, pkName_statusResponse::String(), pkName_statusResponse::SIZE ) == 0 ) {
+		const byte* p = reply + echoOffset;
+		u32 sequence;
+		pkLong::Read( p, reply + length, sequence );
+		const size_t index = sequence - s.baseSequence;
+		// late replies of requests already counted as lost are dropped
+		if ( index >= s.head && index < s.sendTimes.size() && s.sendTimes[ index ] != 0 ) {
+			stats.latency.Add( now - s.sendTimes[ index ] );
+			stats.replies++;
+			s.sendTimes[ index ] = 0;
+		}
+		return;
+	}
+
+	if ( s.waitSince != 0 ) {
+		stats.latency.Add( now - s.waitSince );
+		stats.replies++;
+		s.waitSince = 0;
+	}
+}
+
+/*
+================
+Replay_Thread
+
+sends its share of the ramp round robin over its sockets and times the replies
+================
+*/
+static void Replay_Thread( int thread, std::vector< stepStats_t >* steps ) {
+	const int numSockets = replayConfig.numSockets;
+	const int numRecords = ( int )replayRecords.size();
+
+	std::vector< replaySocket_t > sockets( numSockets );
+	std::vector< pollfd > pfds( numSockets );
+	for ( int i = 0; i < numSockets; i++ ) {
+		sockets[ i ].fd = Replay_OpenSocket( SOURCE_REPLAY + thread * numSockets + i );
+		sockets[ i ].nextRecord = replayConfig.tcp ? 0 : ( thread * numSockets + i ) % numRecords;
+		sockets[ i ].baseSequence = 0;
+		sockets[ i ].head = 0;
+		sockets[ i ].waitSince = 0;
+		pfds[ i ].fd = sockets[ i ].fd;
+		pfds[ i ].events = POLLIN;
+	}
+
+	byte* reply = new byte[ BUFFSZ ];
+	byte* packet = new byte[ MAX_RECORD_SIZE ];
+	u64 sent = 0;
+	int nextSocket = 0;
+
+	while ( true ) {
+		u64 now = Sys_Microseconds();
+		int step = Replay_StepAt( now );
+		if ( step >= replayConfig.numSteps ) {
+			break;
+		}
+		stepStats_t& stats = ( *steps )[ step ];
+
+		for ( u64 due = Replay_Due( now ); sent < due; sent++ ) {
+			replaySocket_t& s = sockets[ nextSocket ];
+			nextSocket = ( nextSocket + 1 ) % numSockets;
+			const corpusRecord_t* record = &corpus[ replayRecords[ s.nextRecord ] ];
+			s.nextRecord = ( s.nextRecord + 1 ) % numRecords;
+
+			if ( !replayConfig.tcp ) {
+				Replay_Expire( s, now, stats );
+
+				// another reply without an echo couldn't be told apart from the outstanding one,
+				// the socket moves on to a record that doesn't need one
+				for ( int skipped = 0; skipped < numRecords && record->expectsReply && !record->echoesChallenge && s.waitSince != 0; skipped++ ) {
+					record = &corpus[ replayRecords[ s.nextRecord ] ];
+					s.nextRecord = ( s.nextRecord + 1 ) % numRecords;
+				}
+				if ( record->expectsReply && !record->echoesChallenge && s.waitSince != 0 ) {
+					stats.held++;
+					continue;
+				}
+			}
+
+			const byte* data = record->data.data();
+			const bool echoed = record->expectsReply && record->echoesChallenge && !replayConfig.tcp;
+			if ( echoed ) {
+				memcpy( packet, data, record->data.size() );
+				pkLong::Write( packet + OOB_HEADER_SIZE + getStatusPacket_t::NAME_SIZE, s.baseSequence + ( u32 )s.sendTimes.size() );
+				data = packet;
+			}
+
+			if ( send( s.fd, data, record->data.size(), MSG_NOSIGNAL ) < 0 ) {
+				stats.sendErrors++;
+				continue;
+			}
+			stats.sent++;
+			if ( echoed ) {
+				s.sendTimes.push_back( now );
+			} else if ( record->expectsReply && !replayConfig.tcp ) {
+				s.waitSince = now;
+			}
+		}
+
+		if ( poll( pfds.data(), pfds.size(), 1 ) <= 0 ) {
+			continue;
+		}
+
+		now = Sys_Microseconds();
+		for ( int i = 0; i < numSockets; i++ ) {
+			if ( ( pfds[ i ].revents & POLLIN ) == 0 ) {
+				continue;
+			}
+			replaySocket_t& s = sockets[ i ];
+			ssize_t num;
+			while ( ( num = recv( s.fd, reply, BUFFSZ, 0 ) ) > 0 ) {
+				if ( !replayConfig.tcp ) {
+					Replay_Receive( s, reply, ( int )num, now, stats );
+				}
+			}
+		}
+	}
+
+	// whatever is still outstanding a timeout after the end is lost
+	stepStats_t& last = ( *steps )[ replayConfig.numSteps - 1 ];
+	u64 deadline = Sys_Microseconds() + REPLY_TIMEOUT;
+	while ( !replayConfig.tcp && Sys_Microseconds() < deadline ) {
+		if ( poll( pfds.data(), pfds.size(), 10 ) <= 0 ) {
+			continue;
+		}
+		u64 now = Sys_Microseconds();
+		for ( int i = 0; i < numSockets; i++ ) {
+			ssize_t num;
+			while ( ( num = recv( sockets[ i ].fd, reply, BUFFSZ, 0 ) ) > 0 ) {
+				Replay_Receive( sockets[ i ], reply, ( int )num, now, last );
+			}
+		}
+	}
+	for ( int i = 0; i < numSockets; i++ ) {
+		replaySocket_t& s = sockets[ i ];
+		for ( size_t j = s.head; j < s.sendTimes.size(); j++ ) {
+			last.lost += s.sendTimes[ j ] != 0;
+		}
+		last.lost += s.waitSince != 0;
+		close( s.fd );
+	}
+	delete[] packet;
+	delete[] reply;
+}
+
+/*
+================
+Replay_Calibrate
+
+sends every UDP record once and only times the ones the target answers, the
+dump shows what the retail master replied to, not what this one does
+================
+*/
+static void Replay_Calibrate( void ) {
+	byte* reply = new byte[ BUFFSZ ];
+	for ( size_t i = 0; i < replayRecords.size(); i++ ) {
+		corpusRecord_t& record = corpus[ replayRecords[ i ] ];
+		int fd = Replay_OpenSocket( SOURCE_CALIBRATE + ( u32 )i );
+		bool answered = false;
+		if ( send( fd, record.data.data(), record.data.size(), 0 ) >= 0 ) {
+			pollfd pfd = { fd, POLLIN, 0 };
+			answered = poll( &pfd, 1, CALIBRATE_TIMEOUT ) > 0 && recv( fd, reply, BUFFSZ, 0 ) > 0;
+		}
+		close( fd );
+
+		if ( answered != record.expectsReply ) {
+			Msr_Printf( "- record %d is %sanswered by the target, %s\n", replayRecords[ i ], answered ? "" : "not ",
+				answered ? "timing it" : "not timing it" );
+		}
+		record.expectsReply = answered;
+	}
+	delete[] reply;
+}
+
+/*
+================
+Replay_Run
+================
+*/
+static void Replay_Run( void ) {
+	const int transport = replayConfig.tcp ? TRANSPORT_TCP : TRANSPORT_UDP;
+	for ( size_t i = 0; i < corpus.size(); i++ ) {
+		if ( corpus[ i ].transport == transport ) {
+			replayRecords.push_back( ( int )i );
+		}
+	}
+	if ( replayRecords.empty() ) {
+		Msr_Error( "the corpus has no %s records", replayConfig.tcp ? "TCP" : "UDP" );
+	}
+	for ( size_t i = 0; i < replayRecords.size(); i++ ) {
+		corpusRecord_t& record = corpus[ replayRecords[ i ] ];
+		record.echoesChallenge = Replay_EchoesChallenge( record );
+	}
+
+	if ( !replayConfig.tcp ) {
+		Replay_Calibrate();
+	} else {
+		struct rlimit limit;
+		if ( getrlimit( RLIMIT_NOFILE, &limit ) == 0 ) {
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit( RLIMIT_NOFILE, &limit );
+		}
+	}
+
+	Msr_Printf( "- %d %s records, %d threads x %d sockets, %d steps of %d sec from %d to %d packets/sec\n",
+		( int )replayRecords.size(), replayConfig.tcp ? "TCP" : "UDP", replayConfig.numThreads, replayConfig.numSockets,
+		replayConfig.numSteps, replayConfig.stepTime, replayConfig.startRate, replayConfig.endRate );
+
+	std::vector< std::vector< stepStats_t > > threadSteps( replayConfig.numThreads, std::vector< stepStats_t >( replayConfig.numSteps ) );
+	for ( size_t i = 0; i < threadSteps.size(); i++ ) {
+		for ( size_t j = 0; j < threadSteps[ i ].size(); j++ ) {
+			stepStats_t& s = threadSteps[ i ][ j ];
+			s.sent = s.replies = s.lost = s.sendErrors = s.held = 0;
+		}
+	}
+
+	replayStart = Sys_Microseconds();
+	std::vector< std::thread > threads;
+	for ( int i = 0; i < replayConfig.numThreads; i++ ) {
+		threads.push_back( std::thread( Replay_Thread, i, &threadSteps[ i ] ) );
+	}
+	for ( size_t i = 0; i < threads.size(); i++ ) {
+		threads[ i ].join();
+	}
+
+	Msr_Printf( "  target/s     sent/s  replies/s     lost   errors     held    p50 us    p99 us   p999 us\n" );
+	for ( int step = 0; step < replayConfig.numSteps; step++ ) {
+		stepStats_t total;
+		total.sent = total.replies = total.lost = total.sendErrors = total.held = 0;
+		for ( int i = 0; i < replayConfig.numThreads; i++ ) {
+			const stepStats_t& s = threadSteps[ i ][ step ];
+			total.sent += s.sent;
+			total.replies += s.replies;
+			total.lost += s.lost;
+			total.sendErrors += s.sendErrors;
+			total.held += s.held;
+			total.latency.Merge( s.latency );
+		}
+		Msr_Printf( "%10.0f %10.0f %10.0f %8llu %8llu %8llu %9llu %9llu %9llu\n",
+			Replay_TargetRate( step ), ( double )total.sent / replayConfig.stepTime, ( double )total.replies / replayConfig.stepTime,
+			( unsigned long long )total.lost, ( unsigned long long )total.sendErrors, ( unsigned long long )total.held,
+			( unsigned long long )total.latency.Percentile( 0.50 ), ( unsigned long long )total.latency.Percentile( 0.99 ),
+			( unsigned long long )total.latency.Percentile( 0.999 ) );
+	}
+}
+
+/*
+================
+main
+================
+*/
+int main( int argc, char* argv[] ) {
+	const char* corpusFile = NULL;
+	const char* convertFile = NULL;
+	std::vector< const char* > dumpFiles;
+
+	for ( int i = 1; i < argc; i++ ) {
+		const char* arg = argv[ i ];
+		const char* value = ( i + 1 < argc ) ? argv[ i + 1 ] : NULL;
+
+		if ( !strcmp( arg, "-tcp" ) ) {
+			replayConfig.tcp = true;
+			continue;
+		}
+		if ( arg[ 0 ] != '-' && convertFile != NULL ) {
+			dumpFiles.push_back( arg );
+			continue;
+		}
+		if ( value == NULL ) {
+			Msr_Error( "missing value for '%s'", arg );
+		}
+
+		if ( !strcmp( arg, "-convert" ) ) {
+			convertFile = value;
+		} else if ( !strcmp( arg, "-corpus" ) ) {
+			corpusFile = value;
+		} else if ( !strcmp( arg, "-host" ) ) {
+			replayConfig.host = value;
+		} else if ( !strcmp( arg, "-port" ) ) {
+			replayConfig.port = ( u16 )atoi( value );
+		} else if ( !strcmp( arg, "-threads" ) ) {
+			replayConfig.numThreads = atoi( value );
+		} else if ( !strcmp( arg, "-sockets" ) ) {
+			replayConfig.numSockets = atoi( value );
+		} else if ( !strcmp( arg, "-rate" ) ) {
+			replayConfig.startRate = atoi( value );
+			const char* colon = strchr( value, ':' );
+			replayConfig.endRate = colon != NULL ? atoi( colon + 1 ) : replayConfig.startRate;
+		} else if ( !strcmp( arg, "-steps" ) ) {
+			replayConfig.numSteps = atoi( value );
+		} else if ( !strcmp( arg, "-stepTime" ) ) {
+			replayConfig.stepTime = atoi( value );
+		} else {
+			Msr_Error( "unknown option '%s'\n"
+				"usage: %s -convert <corpus> <dump> [<dump> ...]\n"
+				"       %s -corpus <corpus> [-tcp] [-host <ip>] [-port <n>] [-threads <n>] [-sockets <n per thread>]\n"
+				"          [-rate <start>[:<end>]] [-steps <n>] [-stepTime <sec>]", arg, argv[ 0 ], argv[ 0 ] );
+		}
+		i++;
+	}
+
+	if ( convertFile != NULL ) {
+		if ( dumpFiles.empty() ) {
+			Msr_Error( "no dumps to convert" );
+		}
+		for ( size_t i = 0; i < dumpFiles.size(); i++ ) {
+			Replay_LoadDump( dumpFiles[ i ] );
+		}
+		Replay_WriteCorpus( convertFile );
+		Msr_Printf( "- wrote %d records to %s\n", ( int )corpus.size(), convertFile );
+		return 0;
+	}
+
+	if ( corpusFile == NULL ) {
+		Msr_Error( "nothing to do, use -convert or -corpus" );
+	}
+	if ( replayConfig.numThreads < 1 || replayConfig.numSockets < 1 || replayConfig.numSteps < 1 || replayConfig.stepTime < 1 ) {
+		Msr_Error( "-threads, -sockets, -steps and -stepTime must be positive" );
+	}
+	Replay_ReadCorpus( corpusFile );
+
+	if ( replayConfig.port == 0 ) {
+		replayConfig.port = replayConfig.tcp ? 3074 : MASTER_PORT;
+	}
+	memset( &targetAddr, 0, sizeof( targetAddr ) );
+	targetAddr.sin_family = AF_INET;
+	targetAddr.sin_port = htons( replayConfig.port );
+	if ( inet_pton( AF_INET, replayConfig.host, &targetAddr.sin_addr ) != 1 ) {
+		Msr_Error( "invalid host '%s'", replayConfig.host );
+	}
+
+	Replay_Run();
+	return 0;
+}
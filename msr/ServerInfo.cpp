@@ -0,0 +1,111 @@
+
+#include "ServerInfo.h"
+
+#include <strings.h>
+
+#include <algorithm>
+
+struct crcTable_t {
+	crcTable_t( void ) {
+		for ( u32 i = 0; i < 256; i++ ) {
+			u32 c = i;
+			for ( int j = 0; j < 8; j++ ) {
+				c = ( c & 1 ) ? ( c >> 1 ) ^ 0xedb88320 : c >> 1;
+			}
+			entries[ i ] = c;
+		}
+	}
+	u32 entries[ 256 ];
+};
+
+/*
+================
+Msr_CRC32
+
+reflected 0xedb88320, same as idLib's CRC32_UpdateChecksum
+================
+*/
+u32 Msr_CRC32( u32 crc, const void* data, int length ) {
+	static const crcTable_t crcTable;		// thread safe initialization
+	const u32* table = crcTable.entries;
+
+	const byte* p = ( const byte* )data;
+	for ( int i = 0; i < length; i++ ) {
+		crc = table[ ( crc ^ p[ i ] ) & 0xff ] ^ ( crc >> 8 );
+	}
+	return crc;
+}
+
+/*
+================
+sdServerInfo::FindKey
+================
+*/
+int sdServerInfo::FindKey( const char* key ) const {
+	for ( size_t i = 0; i < keys.size(); i++ ) {
+		if ( !strcasecmp( keys[ i ].c_str(), key ) ) {
+			return ( int )i;
+		}
+	}
+	return -1;
+}
+
+/*
+================
+sdServerInfo::Set
+================
+*/
+void sdServerInfo::Set( const char* key, const char* value ) {
+	int index = FindKey( key );
+	if ( index < 0 ) {
+		keys.push_back( key );
+		values.push_back( value );
+	} else {
+		values[ index ] = value;
+	}
+	UpdateChecksum();
+}
+
+/*
+================
+sdServerInfo::GetString
+================
+*/
+const char* sdServerInfo::GetString( const char* key, const char* defaultString ) const {
+	int index = FindKey( key );
+	return index >= 0 ? values[ index ].c_str() : defaultString;
+}
+
+/*
+================
+sdServerInfo::GetInt
+================
+*/
+int sdServerInfo::GetInt( const char* key, int defaultInt ) const {
+	int index = FindKey( key );
+	return index >= 0 ? atoi( values[ index ].c_str() ) : defaultInt;
+}
+
+/*
+================
+sdServerInfo::UpdateChecksum
+
+keys are hashed in sorted order like idDict::Checksum
+================
+*/
+void sdServerInfo::UpdateChecksum( void ) {
+	std::vector< int > order( keys.size() );
+	for ( size_t i = 0; i < order.size(); i++ ) {
+		order[ i ] = ( int )i;
+	}
+	std::sort( order.begin(), order.end(), [this]( int a, int b ) { return strcasecmp( keys[ a ].c_str(), keys[ b ].c_str() ) < 0; } );
+
+	u32 crc = 0xffffffff;
+	for ( size_t i = 0; i < order.size(); i++ ) {
+		const std::string& key = keys[ order[ i ] ];
+		const std::string& value = values[ order[ i ] ];
+		crc = Msr_CRC32( crc, key.c_str(), ( int )key.length() );
+		crc = Msr_CRC32( crc, value.c_str(), ( int )value.length() );
+	}
+	checksum = crc ^ 0xffffffff;
+}
@@ -0,0 +1,48 @@
+
+#ifndef __MSR_SERVERINFO_H__
+#define __MSR_SERVERINFO_H__
+
+#include "Common.h"
+
+#include <string>
+#include <vector>
+
+/*
+===============================================================================
+
+	sdServerInfo
+
+	The si_* dictionary reported by getStatus. Like idDict the checksum does
+	not depend on the order the keys were set in, so it can be compared the
+	same way sdNetManager::UpdateGameSession compares serverInfo.Checksum().
+	The checksum is kept up to date by Set, reading it is free.
+
+===============================================================================
+*/
+
+class sdServerInfo {
+public:
+							sdServerInfo( void ) : checksum( 0 ) {}
+
+	int						GetNumKeyVals( void ) const { return ( int )keys.size(); }
+	const char*				GetKey( int index ) const { return keys[ index ].c_str(); }
+	const char*				GetValue( int index ) const { return values[ index ].c_str(); }
+
+	void					Set( const char* key, const char* value );
+	const char*				GetString( const char* key, const char* defaultString = "" ) const;
+	int						GetInt( const char* key, int defaultInt = 0 ) const;
+
+	u32						Checksum( void ) const { return checksum; }
+
+private:
+	int						FindKey( const char* key ) const;
+	void					UpdateChecksum( void );
+
+	std::vector< std::string >	keys;
+	std::vector< std::string >	values;
+	u32						checksum;
+};
+
+u32		Msr_CRC32( u32 crc, const void* data, int length );
+
+#endif /* !__MSR_SERVERINFO_H__ */
@@ -0,0 +1,316 @@
+
+#include "SessionFilter.h"
+#include "SessionRegistry.h"
+#include "Msg.h"
+
+#include <ctype.h>
+#include <float.h>
+#include <math.h>
+
+/*
+================
+sdSessionFilter::Read
+================
+*/
+bool sdSessionFilter::Read( sdMsgReader& msg ) {
+	numNumeric = 0;
+	numString = 0;
+
+	if ( msg.GetRemaining() == 0 ) {
+		return true;
+	}
+
+	bool clientOnly = false;
+	int num = msg.ReadByte();
+	if ( num < 0 || num > MAX_NUMERIC_FILTERS ) {
+		return false;
+	}
+	for ( int i = 0; i < num; i++ ) {
+		numericFilter_t& filter = numericFilters[ i ];
+		filter.type = msg.ReadByte();
+		filter.state = msg.ReadByte();
+		filter.op = msg.ReadByte();
+		filter.resultBin = msg.ReadByte();
+		u32 bits = msg.ReadLong();
+		memcpy( &filter.value, &bits, sizeof( filter.value ) );
+
+		if ( msg.IsOverflowed() ) {
+			return false;
+		}
+		if ( filter.type < 0 || filter.type >= SFT_MAX || filter.state < 0 || filter.state >= SFS_MAX ||
+			filter.op < 0 || filter.op >= SFO_MAX || filter.resultBin < 0 || filter.resultBin >= SFR_MAX ) {
+			return false;
+		}
+		// these depend on the client, evaluating them here would hide sessions the client shows
+		if ( filter.type == SFT_PING || filter.type == SFT_FAVORITE || filter.type == SFT_FRIENDS ) {
+			clientOnly = true;
+		}
+	}
+	numNumeric = num;
+
+	num = msg.ReadByte();
+	if ( num < 0 || num > MAX_STRING_FILTERS ) {
+		numNumeric = 0;
+		return false;
+	}
+	for ( int i = 0; i < num; i++ ) {
+		stringFilter_t& filter = stringFilters[ i ];
+		filter.state = msg.ReadByte();
+		filter.op = msg.ReadByte();
+		filter.resultBin = msg.ReadByte();
+		filter.key = msg.ReadString();
+		filter.value = msg.ReadString();
+
+		if ( msg.IsOverflowed() || filter.state < 0 || filter.state >= SFS_MAX ||
+			filter.op < 0 || filter.op >= SFO_MAX || filter.resultBin < 0 || filter.resultBin >= SFR_MAX ) {
+			numNumeric = 0;
+			return false;
+		}
+	}
+	numString = num;
+
+	// a set the master can only evaluate in part is answered unfiltered, the client filters it all
+	if ( clientOnly ) {
+		numNumeric = 0;
+		numString = 0;
+	}
+
+	return true;
+}
+
+/*
+================
+sdSessionFilter::IsFiltered
+
+mirrors sdNetManager::SessionIsFiltered, keep the two in sync
+================
+*/
+bool sdSessionFilter::IsFiltered( const sessionSnapshot_t& snapshot, int index ) const {
+	if ( IsEmpty() ) {
+		return false;
+	}
+
+	const int flags = snapshot.flags[ index ];
+	const bool isRepeater = ( flags & SESSION_FLAG_REPEATER ) != 0;
+
+	bool visible = true;
+	bool orFilters = false;
+	bool orSet = false;
+
+	for ( int i = 0; i < numNumeric && visible; i++ ) {
+		const numericFilter_t& filter = numericFilters[ i ];
+		if ( filter.state == SFS_DONTCARE ) {
+			continue;
+		}
+
+		// superseded by SFT_MAXBOTS
+		if ( filter.type == SFT_BOTS ) {
+			continue;
+		}
+
+		// don't filter by most items for repeaters
+		if ( isRepeater ) {
+			if ( filter.type != SFT_FULL &&
+				filter.type != SFT_EMPTY &&
+				filter.type != SFT_PING &&
+				filter.type != SFT_FRIENDS &&
+				filter.type != SFT_MODS &&
+				filter.type != SFT_PLAYERCOUNT ) {
+				continue;
+			}
+		}
+
+		float value = 0.0f;
+		switch ( filter.type ) {
+			case SFT_PASSWORDED:
+				value = ( flags & SESSION_FLAG_NEEDPASS ) ? 1.0f : 0.0f;
+				break;
+			case SFT_PUNKBUSTER:
+				value = ( flags & SESSION_FLAG_PUNKBUSTER ) ? 1.0f : 0.0f;
+				break;
+			case SFT_FRIENDLYFIRE:
+				value = ( flags & SESSION_FLAG_TEAMDAMAGE ) ? 1.0f : 0.0f;
+				break;
+			case SFT_AUTOBALANCE:
+				value = ( flags & SESSION_FLAG_AUTOBALANCE ) ? 1.0f : 0.0f;
+				break;
+			case SFT_PURE:
+				value = ( flags & SESSION_FLAG_PURE ) ? 1.0f : 0.0f;
+				break;
+			case SFT_LATEJOIN:
+				value = ( flags & SESSION_FLAG_LATEJOIN ) ? 1.0f : 0.0f;
+				break;
+			case SFT_EMPTY: {
+					int num = isRepeater ? snapshot.numRepeaterClients[ index ] : snapshot.numClients[ index ];
+					value = ( num == 0 ) ? 1.0f : 0.0f;
+				}
+				break;
+			case SFT_FULL: {
+					int num = isRepeater ? snapshot.numRepeaterClients[ index ] : snapshot.numClients[ index ];
+					int max = isRepeater ? snapshot.maxRepeaterClients[ index ] : snapshot.maxPlayers[ index ];
+					value = ( num == max ) ? 1.0f : 0.0f;
+				}
+				break;
+			case SFT_MAXBOTS:
+				value = snapshot.numBots[ index ];
+				break;
+			case SFT_RANKED:
+				value = ( flags & SESSION_FLAG_RANKED ) ? 1.0f : 0.0f;
+				break;
+			case SFT_PLAYERCOUNT:
+				value = isRepeater ? snapshot.numRepeaterClients[ index ] : ( snapshot.numClients[ index ] - snapshot.numBots[ index ] );
+				break;
+			case SFT_MODS:
+				value = ( flags & SESSION_FLAG_MODS ) ? 1.0f : 0.0f;
+				break;
+		}
+
+		bool result = false;
+		switch ( filter.op ) {
+			case SFO_EQUAL:
+				result = fabsf( value - filter.value ) < FLT_EPSILON;
+				break;
+			case SFO_NOT_EQUAL:
+				result = fabsf( value - filter.value ) >= FLT_EPSILON;
+				break;
+			case SFO_LESS:
+				result = value < filter.value;
+				break;
+			case SFO_GREATER:
+				result = value > filter.value;
+				break;
+		}
+
+		if ( filter.state == SFS_SHOWONLY && !result ) {
+			visible = false;
+			break;
+		}
+
+		if ( filter.resultBin == SFR_OR ) {
+			orFilters |= result;
+			orSet = true;
+		} else if ( result && filter.state == SFS_HIDE ) {
+			visible = false;
+			break;
+		}
+	}
+
+	char stripped[ sdSessionRegistry::MAX_SERVERINFO_SIZE ];
+
+	for ( int i = 0; i < numString && visible; i++ ) {
+		const stringFilter_t& filter = stringFilters[ i ];
+		if ( filter.state == SFS_DONTCARE ) {
+			continue;
+		}
+
+		// the client compares against the value with the color codes removed
+		const char* value = snapshot.serverInfos[ index ]->GetString( filter.key );
+		int length = 0;
+		while ( *value != '\0' ) {
+			if ( IsColor( value ) ) {
+				value += 2;
+				continue;
+			}
+			stripped[ length++ ] = *value++;
+		}
+		stripped[ length ] = '\0';
+
+		bool result = false;
+		switch ( filter.op ) {
+			case SFO_EQUAL:
+				result = IcmpNoColor( stripped, filter.value ) == 0;
+				break;
+			case SFO_NOT_EQUAL:
+				result = IcmpNoColor( stripped, filter.value ) != 0;
+				break;
+			case SFO_CONTAINS:
+				result = ContainsNoCase( stripped, filter.value );
+				break;
+			case SFO_NOT_CONTAINS:
+				result = !ContainsNoCase( stripped, filter.value );
+				break;
+		}
+
+		if ( filter.state == SFS_SHOWONLY && !result ) {
+			visible = false;
+			break;
+		}
+		if ( result && filter.state != SFS_HIDE && filter.resultBin == SFR_OR ) {
+			orFilters |= result;
+			orSet = true;
+		} else if ( result && filter.state == SFS_HIDE ) {
+			visible = false;
+			break;
+		}
+	}
+
+	if ( orSet ) {
+		visible &= orFilters;
+	}
+
+	return !visible;
+}
+
+/*
+================
+sdSessionFilter::IcmpNoColor
+
+same as idStr::IcmpNoColor
+================
+*/
+int sdSessionFilter::IcmpNoColor( const char* s1, const char* s2 ) {
+	int c1, c2, d;
+
+	do {
+		while ( IsColor( s1 ) ) {
+			s1 += 2;
+		}
+		while ( IsColor( s2 ) ) {
+			s2 += 2;
+		}
+		c1 = *s1++;
+		c2 = *s2++;
+
+		d = c1 - c2;
+		while ( d ) {
+			if ( c1 <= 'Z' && c1 >= 'A' ) {
+				d += ( 'a' - 'A' );
+				if ( !d ) {
+					break;
+				}
+			}
+			if ( c2 <= 'Z' && c2 >= 'A' ) {
+				d -= ( 'a' - 'A' );
+				if ( !d ) {
+					break;
+				}
+			}
+			return d < 0 ? -1 : 1;
+		}
+	} while ( c1 );
+
+	return 0;
+}
+
+/*
+================
+sdSessionFilter::ContainsNoCase
+
+same as idStr::FindText( str, text, false ) != INVALID_POSITION
+================
+*/
+bool sdSessionFilter::ContainsNoCase( const char* str, const char* text ) {
+	int l = ( int )strlen( str ) - ( int )strlen( text );
+	for ( int i = 0; i <= l; i++ ) {
+		int j;
+		for ( j = 0; text[ j ]; j++ ) {
+			if ( toupper( ( byte )str[ i + j ] ) != toupper( ( byte )text[ j ] ) ) {
+				break;
+			}
+		}
+		if ( !text[ j ] ) {
+			return true;
+		}
+	}
+	return false;
+}
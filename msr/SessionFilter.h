@@ -0,0 +1,125 @@
+
+#ifndef __MSR_SESSIONFILTER_H__
+#define __MSR_SESSIONFILTER_H__
+
+#include "Common.h"
+
+class sdMsgReader;
+struct sessionSnapshot_t;
+
+/*
+===============================================================================
+
+	sdSessionFilter
+
+	The server browser filters pushed down into a findSessions request. The
+	evaluation mirrors sdNetManager::SessionIsFiltered (with ignoreEmptyFilter
+	false) line for line, including its float compares and the quirks of the
+	SFR_OR bin, so the master never drops a session the client would show.
+
+	A sender must leave out what the master can't evaluate: si_map string
+	filters compare against the localized pretty name, and if any SFR_OR
+	filter is left out, none of them may be sent. Favorites, friends and
+	ping depend on the client; a set with any of them is answered unfiltered.
+	The retail client doesn't send the block, sdnet's FindSessions has no
+	room for it.
+
+	Wire format, following the source byte of findSessions:
+
+		byte	numNumericFilters
+				numNumericFilters * ( byte type, byte state, byte op, byte resultBin, float value )
+		byte	numStringFilters
+				numStringFilters * ( byte state, byte op, byte resultBin, string key, string value )
+
+	An old request without the block has no filters.
+
+===============================================================================
+*/
+
+// the retail values of the sdNetManager enums, demo builds renumber after SF_FAVORITE
+enum sessionFilterType_e {
+	SFT_PASSWORDED,
+	SFT_PUNKBUSTER,
+	SFT_FRIENDLYFIRE,
+	SFT_AUTOBALANCE,
+	SFT_EMPTY,
+	SFT_FULL,
+	SFT_PING,
+	SFT_BOTS,
+	SFT_PURE,
+	SFT_LATEJOIN,
+	SFT_FAVORITE,
+	SFT_RANKED,
+	SFT_FRIENDS,
+	SFT_PLAYERCOUNT,
+	SFT_MODS,
+	SFT_MAXBOTS,
+	SFT_MAX
+};
+
+enum sessionFilterState_e {
+	SFS_DONTCARE,
+	SFS_SHOWONLY,
+	SFS_HIDE,
+	SFS_MAX
+};
+
+enum sessionFilterOp_e {
+	SFO_EQUAL,
+	SFO_NOT_EQUAL,
+	SFO_LESS,
+	SFO_GREATER,
+	SFO_NOOP,
+	SFO_CONTAINS,
+	SFO_NOT_CONTAINS,
+	SFO_MAX
+};
+
+enum sessionFilterResult_e {
+	SFR_OR,
+	SFR_AND,
+	SFR_MAX
+};
+
+class sdSessionFilter {
+public:
+	static const int		MAX_NUMERIC_FILTERS	= 16;		// same as sdNetManager::numericFilters
+	static const int		MAX_STRING_FILTERS	= 8;		// same as sdNetManager::stringFilters
+
+							sdSessionFilter( void ) : numNumeric( 0 ), numString( 0 ) {}
+
+							// the strings point into the packet and are only valid while it is; false if
+							// the block is malformed, a set with ping, favorite or friends filters reads as empty
+	bool					Read( sdMsgReader& msg );
+
+	bool					IsEmpty( void ) const { return numNumeric == 0 && numString == 0; }
+	bool					IsFiltered( const sessionSnapshot_t& snapshot, int index ) const;
+
+private:
+	struct numericFilter_t {
+		int					type;
+		int					state;
+		int					op;
+		int					resultBin;
+		float				value;
+	};
+
+	struct stringFilter_t {
+		int					state;
+		int					op;
+		int					resultBin;
+		const char*			key;
+		const char*			value;
+	};
+
+	static bool				IsColor( const char* s ) { return s[ 0 ] == '^' && s[ 1 ] != '\0' && s[ 1 ] != ' '; }
+	static int				IcmpNoColor( const char* s1, const char* s2 );
+	static bool				ContainsNoCase( const char* str, const char* text );
+
+	numericFilter_t			numericFilters[ MAX_NUMERIC_FILTERS ];
+	stringFilter_t			stringFilters[ MAX_STRING_FILTERS ];
+	int						numNumeric;
+	int						numString;
+};
+
+#endif /* !__MSR_SESSIONFILTER_H__ */
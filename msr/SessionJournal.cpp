@@ -0,0 +1,644 @@
+
+#include "SessionJournal.h"
+#include "Msg.h"
+#include "ServerInfo.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+================
+Journal_WriteAll
+================
+*/
+static bool Journal_WriteAll( int fd, const byte* data, size_t length ) {
+	while ( length > 0 ) {
+		ssize_t num = write( fd, data, length );
+		if ( num < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			return false;
+		}
+		data += num;
+		length -= ( size_t )num;
+	}
+	return true;
+}
+
+/*
+================
+Journal_SyncDirectory
+
+makes a rename durable
+================
+*/
+static void Journal_SyncDirectory( const char* directory ) {
+	int fd = open( directory, O_RDONLY | O_DIRECTORY );
+	if ( fd >= 0 ) {
+		fsync( fd );
+		close( fd );
+	}
+}
+
+/*
+================
+Journal_Map
+
+the whole file read only, NULL if it doesn't exist or is empty
+================
+*/
+static const byte* Journal_Map( const char* path, size_t& size ) {
+	size = 0;
+	int fd = open( path, O_RDONLY );
+	if ( fd < 0 ) {
+		return NULL;
+	}
+	struct stat st;
+	if ( fstat( fd, &st ) < 0 || st.st_size == 0 ) {
+		close( fd );
+		return NULL;
+	}
+	void* data = mmap( NULL, ( size_t )st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0 );
+	close( fd );
+	if ( data == MAP_FAILED ) {
+		return NULL;
+	}
+	size = ( size_t )st.st_size;
+	return ( const byte* )data;
+}
+
+/*
+================
+sdSessionJournal::sdSessionJournal
+================
+*/
+sdSessionJournal::sdSessionJournal( void ) :
+	shard( 0 ),
+	numShards( 0 ),
+	generation( 0 ),
+	logFd( -1 ),
+	logSize( 0 ),
+	snapshotSize( 0 ),
+	nextCompactTime( 0 ),
+	compactState( COMPACT_DONE ),
+	nextLogFd( -1 ),
+	nextLogSize( 0 ),
+	nextLogFailed( false ) {
+	directory[ 0 ] = '\0';
+	memset( bootId, 0, sizeof( bootId ) );
+}
+
+/*
+================
+sdSessionJournal::~sdSessionJournal
+================
+*/
+sdSessionJournal::~sdSessionJournal( void ) {
+	Close();
+}
+
+/*
+================
+sdSessionJournal::MakePath
+================
+*/
+void sdSessionJournal::MakePath( char* path, int size, const char* suffix ) const {
+	snprintf( path, size, "%s/shard%d.%s", directory, shard, suffix );
+}
+
+/*
+================
+sdSessionJournal::WriteHeader
+================
+*/
+int sdSessionJournal::WriteHeader( byte* dest, const char* magic ) const {
+	sdMsgWriter msg( dest, HEADER_SIZE );
+	msg.WriteData( magic, 4 );
+	msg.WriteLong( FILE_VERSION );
+	msg.WriteLong( ( u32 )numShards );
+	msg.WriteLong( generation );
+	msg.WriteData( bootId, BOOT_ID_SIZE );
+	msg.WriteLong( Msr_CRC32( 0xffffffff, dest, msg.GetLength() ) ^ 0xffffffff );
+	msg.WriteFill( 0, HEADER_SIZE - msg.GetLength() );
+	return msg.GetLength();
+}
+
+/*
+================
+sdSessionJournal::ReadHeader
+================
+*/
+bool sdSessionJournal::ReadHeader( const byte* data, size_t size, const char* magic, header_t& header ) const {
+	if ( size < ( size_t )HEADER_SIZE ) {
+		return false;
+	}
+	sdMsgReader msg( data, HEADER_SIZE );
+	memcpy( header.magic, msg.GetCursor(), 4 );
+	msg.Skip( 4 );
+	u32 version = msg.ReadLong();
+	header.numShards = msg.ReadLong();
+	header.generation = msg.ReadLong();
+	memcpy( header.bootId, msg.GetCursor(), BOOT_ID_SIZE );
+	msg.Skip( BOOT_ID_SIZE );
+	const int checked = HEADER_SIZE - msg.GetRemaining();
+	u32 crc = msg.ReadLong();
+
+	return memcmp( header.magic, magic, 4 ) == 0 && version == FILE_VERSION && crc == ( Msr_CRC32( 0xffffffff, data, checked ) ^ 0xffffffff );
+}
+
+/*
+================
+sdSessionJournal::CreateLog
+
+an empty log of the current generation, swapped in with a rename
+================
+*/
+bool sdSessionJournal::CreateLog( void ) {
+	char path[ 300 ];
+	char tempPath[ 300 ];
+	MakePath( path, sizeof( path ), "log" );
+	MakePath( tempPath, sizeof( tempPath ), "log.tmp" );
+
+	int fd = open( tempPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+	if ( fd < 0 ) {
+		Msr_Warning( "sdSessionJournal: couldn't create %s (%s)", tempPath, strerror( errno ) );
+		return false;
+	}
+	byte header[ HEADER_SIZE ];
+	WriteHeader( header, "MSRJ" );
+	if ( !Journal_WriteAll( fd, header, HEADER_SIZE ) || fdatasync( fd ) < 0 || rename( tempPath, path ) < 0 ) {
+		Msr_Warning( "sdSessionJournal: couldn't write %s (%s)", path, strerror( errno ) );
+		close( fd );
+		return false;
+	}
+	Journal_SyncDirectory( directory );
+
+	if ( logFd >= 0 ) {
+		close( logFd );
+	}
+	logFd = fd;
+	logSize = HEADER_SIZE;
+	return true;
+}
+
+/*
+================
+sdSessionJournal::EncodeUpdate
+
+	long	length
+	long	crc
+	byte	RECORD_UPDATE
+	long	address low, long address high
+	long	expire time, seconds since the epoch
+	byte	numClients, byte numBots, byte gameState, byte flags
+	long	sessionTime
+	short	numRepeaterClients, short maxRepeaterClients
+	key\0value\0 ... \0		serverInfo, the rest of the record
+================
+*/
+int sdSessionJournal::EncodeUpdate( byte* dest, u64 address, const sessionInfo_t& info, const byte* serverInfo, int serverInfoLength, u32 expireWall ) const {
+	sdMsgWriter msg( dest + RECORD_HEADER_SIZE, MAX_RECORD_SIZE - RECORD_HEADER_SIZE );
+	msg.WriteByte( RECORD_UPDATE );
+	msg.WriteLong( ( u32 )address );
+	msg.WriteLong( ( u32 )( address >> 32 ) );
+	msg.WriteLong( expireWall );
+	msg.WriteByte( info.numClients );
+	msg.WriteByte( info.numBots );
+	msg.WriteByte( info.gameState );
+	msg.WriteByte( info.flags );
+	msg.WriteLong( ( u32 )info.sessionTime );
+	msg.WriteShort( info.numRepeaterClients );
+	msg.WriteShort( info.maxRepeaterClients );
+	msg.WriteData( serverInfo, serverInfoLength );
+
+	sdMsgWriter header( dest, RECORD_HEADER_SIZE );
+	header.WriteLong( ( u32 )msg.GetLength() );
+	header.WriteLong( Msr_CRC32( 0xffffffff, dest + RECORD_HEADER_SIZE, msg.GetLength() ) ^ 0xffffffff );
+	return RECORD_HEADER_SIZE + msg.GetLength();
+}
+
+/*
+================
+sdSessionJournal::ApplyRecords
+
+returns the offset of the first record that is torn or fails its checksum,
+size if there is none
+================
+*/
+size_t sdSessionJournal::ApplyRecords( const byte* data, size_t size, sdSessionRegistry& sessions, int now, u32 wallNow ) const {
+	size_t offset = 0;
+	while ( size - offset >= ( size_t )RECORD_HEADER_SIZE ) {
+		sdMsgReader header( data + offset, RECORD_HEADER_SIZE );
+		u32 length = header.ReadLong();
+		u32 crc = header.ReadLong();
+		if ( length == 0 || length > ( u32 )( MAX_RECORD_SIZE - RECORD_HEADER_SIZE ) || size - offset - RECORD_HEADER_SIZE < length ) {
+			break;
+		}
+		const byte* payload = data + offset + RECORD_HEADER_SIZE;
+		if ( ( Msr_CRC32( 0xffffffff, payload, ( int )length ) ^ 0xffffffff ) != crc ) {
+			break;
+		}
+
+		sdMsgReader msg( payload, ( int )length );
+		int type = msg.ReadByte();
+		u64 address = msg.ReadLong();
+		address |= ( u64 )msg.ReadLong() << 32;
+
+		if ( type == RECORD_UPDATE ) {
+			u32 expireWall = msg.ReadLong();
+			sessionInfo_t info;
+			info.numClients = msg.ReadByte();
+			info.numBots = msg.ReadByte();
+			info.gameState = msg.ReadByte();
+			info.flags = msg.ReadByte();
+			info.sessionTime = ( int )msg.ReadLong();
+			info.numRepeaterClients = ( u16 )msg.ReadShort();
+			info.maxRepeaterClients = ( u16 )msg.ReadShort();
+			if ( msg.IsOverflowed() ) {
+				break;
+			}
+
+			// timed out while the master was down
+			int remaining = ( int )( expireWall - wallNow );
+			if ( remaining <= 0 ) {
+				sessions.Remove( address );
+			} else {
+				sessions.Update( address, info, msg.GetCursor(), msg.GetRemaining(), now + remaining * 1000 );
+			}
+		} else if ( type == RECORD_REMOVE ) {
+			sessions.Remove( address );
+		} else {
+			break;
+		}
+
+		offset += RECORD_HEADER_SIZE + length;
+	}
+	return offset;
+}
+
+/*
+================
+sdSessionJournal::Open
+================
+*/
+bool sdSessionJournal::Open( const char* directory, int shard, int numShards, sdSessionRegistry& sessions ) {
+	Close();
+
+	if ( mkdir( directory, 0755 ) < 0 && errno != EEXIST ) {
+		Msr_Warning( "sdSessionJournal: couldn't create %s (%s)", directory, strerror( errno ) );
+		return false;
+	}
+	snprintf( this->directory, sizeof( this->directory ), "%s", directory );
+	this->shard = shard;
+	this->numShards = numShards;
+	generation = 0;
+	snapshotSize = 0;
+
+	memset( bootId, 0, sizeof( bootId ) );
+	FILE* f = fopen( "/proc/sys/kernel/random/boot_id", "r" );
+	if ( f != NULL ) {
+		if ( fgets( bootId, sizeof( bootId ), f ) != NULL ) {
+			bootId[ strcspn( bootId, "\n" ) ] = '\0';
+		}
+		fclose( f );
+	}
+
+	const int now = Sys_Milliseconds();
+	const u32 wallNow = ( u32 )time( NULL );
+
+	char snapshotPath[ 300 ];
+	char logPath[ 300 ];
+	char nextLogPath[ 300 ];
+	MakePath( snapshotPath, sizeof( snapshotPath ), "snapshot" );
+	MakePath( logPath, sizeof( logPath ), "log" );
+	MakePath( nextLogPath, sizeof( nextLogPath ), "log.next" );
+
+	header_t header;
+	bool haveSnapshot = false;
+	size_t size;
+	const byte* data = Journal_Map( snapshotPath, size );
+	if ( data != NULL ) {
+		if ( !ReadHeader( data, size, "MSRS", header ) ) {
+			Msr_Warning( "sdSessionJournal: %s is damaged, ignored", snapshotPath );
+		} else if ( header.numShards != ( u32 )numShards || memcmp( header.bootId, bootId, BOOT_ID_SIZE ) != 0 ) {
+			Msr_Printf( "- %s was written by another boot or number of workers, starting empty\n", snapshotPath );
+			unlink( logPath );
+		} else {
+			haveSnapshot = true;
+			generation = header.generation;
+			snapshotSize = size;
+			if ( ApplyRecords( data + HEADER_SIZE, size - HEADER_SIZE, sessions, now, wallNow ) != size - HEADER_SIZE ) {
+				Msr_Warning( "sdSessionJournal: %s is damaged, restored what preceded the damage", snapshotPath );
+			}
+		}
+		munmap( ( void* )data, size );
+		if ( !haveSnapshot ) {
+			unlink( snapshotPath );
+		}
+	}
+
+	// a compaction that replaced the snapshot but not the log
+	data = Journal_Map( nextLogPath, size );
+	if ( data != NULL ) {
+		bool current = haveSnapshot && ReadHeader( data, size, "MSRJ", header ) && header.generation == generation;
+		munmap( ( void* )data, size );
+		if ( current ) {
+			rename( nextLogPath, logPath );
+		}
+	}
+	unlink( nextLogPath );
+
+	data = Journal_Map( logPath, size );
+	if ( data != NULL ) {
+		bool usable = ReadHeader( data, size, "MSRJ", header ) && header.numShards == ( u32 )numShards && memcmp( header.bootId, bootId, BOOT_ID_SIZE ) == 0;
+		// a log of an older generation is already part of the snapshot
+		if ( usable && ( !haveSnapshot || header.generation == generation ) ) {
+			generation = header.generation;
+			size_t valid = HEADER_SIZE + ApplyRecords( data + HEADER_SIZE, size - HEADER_SIZE, sessions, now, wallNow );
+			munmap( ( void* )data, size );
+
+			// appends continue after the last good record
+			logFd = open( logPath, O_WRONLY | O_APPEND | O_CLOEXEC );
+			if ( logFd >= 0 && valid != size && ftruncate( logFd, ( off_t )valid ) < 0 ) {
+				close( logFd );
+				logFd = -1;
+			}
+			if ( valid != size ) {
+				Msr_Printf( "- %s: dropped %d bytes after the last complete record\n", logPath, ( int )( size - valid ) );
+			}
+			logSize = valid;
+		} else {
+			munmap( ( void* )data, size );
+		}
+	}
+
+	if ( logFd < 0 && !CreateLog() ) {
+		return false;
+	}
+	nextCompactTime = now + COMPACT_INTERVAL;
+	return true;
+}
+
+/*
+================
+sdSessionJournal::Close
+================
+*/
+void sdSessionJournal::Close( void ) {
+	if ( compactThread.joinable() ) {
+		EndCompaction();
+	}
+	if ( logFd < 0 ) {
+		return;
+	}
+	Flush();
+	if ( logFd >= 0 ) {
+		close( logFd );
+		logFd = -1;
+	}
+	pending.clear();
+}
+
+/*
+================
+sdSessionJournal::LogUpdate
+================
+*/
+void sdSessionJournal::LogUpdate( u64 address, const sessionInfo_t& info, const byte* serverInfo, int serverInfoLength, int expireTime ) {
+	if ( logFd < 0 ) {
+		return;
+	}
+	const int remaining = ( expireTime - Sys_Milliseconds() + 999 ) / 1000;
+	const size_t start = pending.size();
+	pending.resize( start + MAX_RECORD_SIZE );
+	int length = EncodeUpdate( pending.data() + start, address, info, serverInfo, serverInfoLength, ( u32 )time( NULL ) + ( u32 )remaining );
+	pending.resize( start + length );
+}
+
+/*
+================
+sdSessionJournal::LogRemove
+================
+*/
+void sdSessionJournal::LogRemove( u64 address ) {
+	if ( logFd < 0 ) {
+		return;
+	}
+	const size_t start = pending.size();
+	pending.resize( start + RECORD_HEADER_SIZE + 9 );
+	byte* payload = pending.data() + start + RECORD_HEADER_SIZE;
+
+	sdMsgWriter msg( payload, 9 );
+	msg.WriteByte( RECORD_REMOVE );
+	msg.WriteLong( ( u32 )address );
+	msg.WriteLong( ( u32 )( address >> 32 ) );
+
+	sdMsgWriter header( pending.data() + start, RECORD_HEADER_SIZE );
+	header.WriteLong( 9 );
+	header.WriteLong( Msr_CRC32( 0xffffffff, payload, 9 ) ^ 0xffffffff );
+}
+
+/*
+================
+sdSessionJournal::Flush
+
+a log that can't be written is given up, the master keeps running without it
+================
+*/
+void sdSessionJournal::Flush( void ) {
+	if ( logFd < 0 || pending.empty() ) {
+		return;
+	}
+	if ( nextLogFd >= 0 && !nextLogFailed ) {
+		if ( !Journal_WriteAll( nextLogFd, pending.data(), pending.size() ) ) {
+			Msr_Warning( "sdSessionJournal: shard %d log write failed (%s)", shard, strerror( errno ) );
+			nextLogFailed = true;
+		} else {
+			nextLogSize += pending.size();
+		}
+	}
+	if ( !Journal_WriteAll( logFd, pending.data(), pending.size() ) ) {
+		Msr_Warning( "sdSessionJournal: shard %d log write failed (%s), journal disabled", shard, strerror( errno ) );
+		close( logFd );
+		logFd = -1;
+	} else {
+		logSize += pending.size();
+	}
+	pending.clear();
+}
+
+/*
+================
+sdSessionJournal::NeedsCompaction
+
+once the log holds more than the sessions themselves
+================
+*/
+bool sdSessionJournal::NeedsCompaction( int now ) const {
+	return logFd >= 0 && !compactThread.joinable() && logSize > ( size_t )COMPACT_MIN_SIZE && logSize > snapshotSize && now - nextCompactTime >= 0;
+}
+
+/*
+================
+sdSessionJournal::BeginCompaction
+
+the sessions are encoded here, everything that can block on the disk is left
+to the compaction thread
+================
+*/
+void sdSessionJournal::BeginCompaction( const sdSessionRegistry& sessions, int now ) {
+	if ( logFd < 0 || compactThread.joinable() ) {
+		return;
+	}
+	Flush();
+	nextCompactTime = now + COMPACT_INTERVAL;
+
+	char nextLogPath[ 300 ];
+	MakePath( nextLogPath, sizeof( nextLogPath ), "log.next" );
+	nextLogFd = open( nextLogPath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644 );
+	if ( nextLogFd < 0 ) {
+		Msr_Warning( "sdSessionJournal: couldn't create %s (%s)", nextLogPath, strerror( errno ) );
+		return;
+	}
+
+	generation++;
+	byte header[ HEADER_SIZE ];
+	WriteHeader( header, "MSRJ" );
+	if ( !Journal_WriteAll( nextLogFd, header, HEADER_SIZE ) ) {
+		Msr_Warning( "sdSessionJournal: couldn't write %s (%s)", nextLogPath, strerror( errno ) );
+		close( nextLogFd );
+		nextLogFd = -1;
+		unlink( nextLogPath );
+		generation--;
+		return;
+	}
+	nextLogSize = HEADER_SIZE;
+	nextLogFailed = false;
+
+	const u32 wallNow = ( u32 )time( NULL );
+	snapshotData.resize( HEADER_SIZE );
+	WriteHeader( snapshotData.data(), "MSRS" );
+	for ( int i = 0; i < sessions.Num(); i++ ) {
+		sessionInfo_t info;
+		sessions.GetSession( i, info );
+		const sessionServerInfo_t* serverInfo = sessions.GetServerInfo( i );
+		const int remaining = ( sessions.GetExpireTime( i ) - now + 999 ) / 1000;
+
+		size_t start = snapshotData.size();
+		snapshotData.resize( start + MAX_RECORD_SIZE );
+		int length = EncodeUpdate( snapshotData.data() + start, sessions.GetAddress( i ), info, ( const byte* )serverInfo->data, serverInfo->length, wallNow + ( u32 )remaining );
+		snapshotData.resize( start + length );
+	}
+
+	compactState.store( COMPACT_RUNNING );
+	compactThread = std::thread( &sdSessionJournal::WriteSnapshot, this );
+}
+
+/*
+================
+sdSessionJournal::WriteSnapshot
+
+compaction thread, log.next is synced before it can replace the log
+================
+*/
+void sdSessionJournal::WriteSnapshot( void ) {
+	char path[ 300 ];
+	char tempPath[ 300 ];
+	char logPath[ 300 ];
+	char nextLogPath[ 300 ];
+	MakePath( path, sizeof( path ), "snapshot" );
+	MakePath( tempPath, sizeof( tempPath ), "snapshot.tmp" );
+	MakePath( logPath, sizeof( logPath ), "log" );
+	MakePath( nextLogPath, sizeof( nextLogPath ), "log.next" );
+
+	int fd = open( tempPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+	if ( fd < 0 ) {
+		Msr_Warning( "sdSessionJournal: couldn't create %s (%s)", tempPath, strerror( errno ) );
+		compactState.store( COMPACT_FAILED );
+		return;
+	}
+	if ( !Journal_WriteAll( fd, snapshotData.data(), snapshotData.size() ) || fdatasync( fd ) < 0 || fdatasync( nextLogFd ) < 0 || rename( tempPath, path ) < 0 ) {
+		Msr_Warning( "sdSessionJournal: couldn't write %s (%s)", path, strerror( errno ) );
+		close( fd );
+		unlink( tempPath );
+		compactState.store( COMPACT_FAILED );
+		return;
+	}
+	close( fd );
+
+	// a crash before this leaves log.next, which Open puts in place of the log
+	if ( rename( nextLogPath, logPath ) < 0 ) {
+		Msr_Warning( "sdSessionJournal: couldn't replace %s (%s)", logPath, strerror( errno ) );
+		compactState.store( COMPACT_LOST );
+		return;
+	}
+	Journal_SyncDirectory( directory );
+	compactState.store( COMPACT_DONE );
+}
+
+/*
+================
+sdSessionJournal::PollCompaction
+================
+*/
+void sdSessionJournal::PollCompaction( void ) {
+	if ( compactThread.joinable() && compactState.load() != COMPACT_RUNNING ) {
+		EndCompaction();
+	}
+}
+
+/*
+================
+sdSessionJournal::EndCompaction
+
+waits for the compaction thread and switches to the new log if it got that far
+================
+*/
+void sdSessionJournal::EndCompaction( void ) {
+	compactThread.join();
+	int state = compactState.load();
+	if ( state == COMPACT_DONE && nextLogFailed ) {
+		state = COMPACT_LOST;
+	}
+
+	if ( state == COMPACT_DONE && logFd >= 0 ) {
+		snapshotSize = snapshotData.size();
+		close( logFd );
+		logFd = nextLogFd;
+		logSize = nextLogSize;
+	} else {
+		close( nextLogFd );
+		if ( state == COMPACT_FAILED ) {
+			char nextLogPath[ 300 ];
+			MakePath( nextLogPath, sizeof( nextLogPath ), "log.next" );
+			unlink( nextLogPath );
+			generation--;
+		} else if ( logFd >= 0 ) {
+			// appending to the old log would be lost behind the new snapshot
+			Msr_Warning( "sdSessionJournal: shard %d journal disabled", shard );
+			close( logFd );
+			logFd = -1;
+		}
+	}
+	nextLogFd = -1;
+	std::vector< byte >().swap( snapshotData );
+}
+
+/*
+================
+sdSessionJournal::Compact
+================
+*/
+void sdSessionJournal::Compact( const sdSessionRegistry& sessions, int now ) {
+	if ( compactThread.joinable() ) {
+		EndCompaction();
+	}
+	BeginCompaction( sessions, now );
+	if ( compactThread.joinable() ) {
+		EndCompaction();
+	}
+}
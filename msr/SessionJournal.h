@@ -0,0 +1,131 @@
+
+#ifndef __MSR_SESSIONJOURNAL_H__
+#define __MSR_SESSIONJOURNAL_H__
+
+#include "Common.h"
+#include "SessionRegistry.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/*
+===============================================================================
+
+	sdSessionJournal
+
+	Keeps one worker's sessions on disk so a restarted master serves the list
+	right away instead of waiting for every server to advertise again.
+
+	Every updateSession and deleteSession is appended to shard<n>.log, the
+	records are buffered and written once per tick. Every record carries its
+	length and a CRC32, so a record torn by a crash is detected on restart and
+	cut off together with whatever followed it. Once the log has grown past
+	the last snapshot it is compacted: the network thread encodes the live
+	sessions and starts shard<n>.log.next of the next generation, then a
+	compaction thread writes shard<n>.snapshot.tmp, syncs it and renames it
+	over the snapshot, and renames log.next over the log. Until the network
+	thread picks up the result every flush goes to both logs. A log whose
+	generation doesn't match the snapshot was already folded into it and is
+	skipped, and a log.next that matches it replaces the log on start up, so
+	a crash at any point loses nothing.
+
+	On start up the snapshot is mapped and applied, then the log tail. Expire
+	times are stored as wall clock time, sessions that timed out while the
+	master was down are not restored.
+
+	SO_REUSEPORT only sends a server back to the same worker while the boot
+	(the kernel's hash secret) and the number of workers stay the same, so
+	both are part of the header and a journal written under others is
+	discarded.
+
+	The journal survives crashes of the process; the log isn't synced after
+	every write, so a crash of the machine can lose the last few seconds.
+
+===============================================================================
+*/
+
+class sdSessionJournal {
+public:
+	static const int		COMPACT_MIN_SIZE	= 4 * 1024 * 1024;	// bytes of log before it is worth compacting
+	static const int		COMPACT_INTERVAL	= 60 * 1000;		// msec between compactions at most
+
+							sdSessionJournal( void );
+							~sdSessionJournal( void );
+
+							// restores the sessions of the shard into sessions and opens its log, false if the
+							// directory can't be used, the master then runs without a journal
+	bool					Open( const char* directory, int shard, int numShards, sdSessionRegistry& sessions );
+	void					Close( void );
+	bool					IsOpen( void ) const { return logFd >= 0; }
+
+							// buffered until the next Flush, expireTime is Sys_Milliseconds based
+	void					LogUpdate( u64 address, const sessionInfo_t& info, const byte* serverInfo, int serverInfoLength, int expireTime );
+	void					LogRemove( u64 address );
+	void					Flush( void );
+
+	bool					NeedsCompaction( int now ) const;
+							// the snapshot is written by the compaction thread, PollCompaction switches to the
+							// new log once it is done
+	void					BeginCompaction( const sdSessionRegistry& sessions, int now );
+	void					PollCompaction( void );
+							// waits for the snapshot, for the shut down
+	void					Compact( const sdSessionRegistry& sessions, int now );
+
+private:
+	static const u32		FILE_VERSION		= 1;
+	static const int		HEADER_SIZE			= 64;
+	static const int		BOOT_ID_SIZE		= 40;
+	static const int		RECORD_HEADER_SIZE	= 8;				// long length, long crc
+	static const int		MAX_RECORD_SIZE		= RECORD_HEADER_SIZE + 32 + sdSessionRegistry::MAX_SERVERINFO_SIZE;
+
+	enum recordType_e {
+		RECORD_UPDATE		= 1,
+		RECORD_REMOVE		= 2,
+	};
+
+	enum compactState_e {
+		COMPACT_RUNNING,
+		COMPACT_DONE,
+		COMPACT_FAILED,						// the old snapshot and log are still in use
+		COMPACT_LOST,						// the snapshot was replaced but not the log
+	};
+
+	struct header_t {
+		char				magic[ 4 ];
+		u32					numShards;
+		u32					generation;
+		char				bootId[ BOOT_ID_SIZE ];
+	};
+
+	void					MakePath( char* path, int size, const char* suffix ) const;
+	int						WriteHeader( byte* dest, const char* magic ) const;
+	bool					ReadHeader( const byte* data, size_t size, const char* magic, header_t& header ) const;
+	bool					CreateLog( void );
+	int						EncodeUpdate( byte* dest, u64 address, const sessionInfo_t& info, const byte* serverInfo, int serverInfoLength, u32 expireWall ) const;
+	size_t					ApplyRecords( const byte* data, size_t size, sdSessionRegistry& sessions, int now, u32 wallNow ) const;
+	void					WriteSnapshot( void );
+	void					EndCompaction( void );
+
+	char					directory[ 256 ];
+	int						shard;
+	int						numShards;
+	char					bootId[ BOOT_ID_SIZE ];
+	u32						generation;
+
+	int						logFd;
+	size_t					logSize;
+	size_t					snapshotSize;
+	int						nextCompactTime;
+	std::vector< byte >		pending;
+
+							// while a compaction runs
+	std::thread				compactThread;
+	std::atomic< int >		compactState;
+	std::vector< byte >		snapshotData;	// read by the compaction thread
+	int						nextLogFd;		// synced by the compaction thread, written by Flush
+	size_t					nextLogSize;
+	bool					nextLogFailed;
+};
+
+#endif /* !__MSR_SESSIONJOURNAL_H__ */
@@ -0,0 +1,95 @@
+
+#include "SessionPages.h"
+#include "Log.h"
+#include "Msg.h"
+
+#include <stdlib.h>
+
+/*
+================
+sessionPages_t::Build
+
+same packets HandleFindSessions encodes for an empty filter: short packetIndex,
+short numPackets, short count, count * ( long ip, short port )
+================
+*/
+sessionPages_t* sessionPages_t::Build( const sessionSnapshot_t* const* snapshots, int numSnapshots, sessionSource_e source, int sessionsPerPacket, u32 version ) {
+	int numSessions = 0;
+	for ( int i = 0; i < numSnapshots; i++ ) {
+		const sessionSnapshot_t& s = *snapshots[ i ];
+		for ( int j = 0; j < s.numEntries; j++ ) {
+			if ( sessionSnapshot_t::MatchesSource( s.flags[ j ], source ) ) {
+				numSessions++;
+			}
+		}
+	}
+
+	const int numPackets = numSessions > 0 ? ( numSessions + sessionsPerPacket - 1 ) / sessionsPerPacket : 1;
+	const int maxPacketSize = OOB_HEADER_SIZE + sizeof( "sessions" ) + 6 + sessionsPerPacket * 6;
+
+	size_t size = sizeof( sessionPages_t ) + sizeof( int ) * ( numPackets + 1 ) + ( size_t )maxPacketSize * numPackets;
+	byte* block = ( byte* )malloc( size );
+	if ( block == NULL ) {
+		Msr_Error( "sessionPages_t::Build: failed to allocate %zu bytes", size );
+	}
+
+	sessionPages_t* pages = ( sessionPages_t* )block;
+	int* offsets = ( int* )( block + sizeof( sessionPages_t ) );
+	byte* data = ( byte* )( offsets + numPackets + 1 );
+
+	pages->version = version;
+	pages->numSessions = numSessions;
+	pages->numPackets = numPackets;
+	pages->offsets = offsets;
+	pages->data = data;
+
+	int shard = 0;
+	int entry = 0;
+	int length = 0;
+	for ( int packetIndex = 0; packetIndex < numPackets; packetIndex++ ) {
+		int first = packetIndex * sessionsPerPacket;
+		int count = numSessions - first < sessionsPerPacket ? numSessions - first : sessionsPerPacket;
+
+		sdMsgWriter packet( data + length, maxPacketSize );
+		packet.WriteOOBHeader();
+		packet.WriteString( "sessions" );
+		packet.WriteShort( packetIndex );
+		packet.WriteShort( numPackets );
+		packet.WriteShort( count );
+		for ( int i = 0; i < count; i++ ) {
+			// next matching entry, the count above guarantees there is one
+			for ( ;; ) {
+				if ( entry == snapshots[ shard ]->numEntries ) {
+					shard++;
+					entry = 0;
+					continue;
+				}
+				if ( sessionSnapshot_t::MatchesSource( snapshots[ shard ]->flags[ entry ], source ) ) {
+					break;
+				}
+				entry++;
+			}
+
+			u64 address = snapshots[ shard ]->addresses[ entry++ ];
+			u32 ip = Msr_AddressIP( address );
+			u16 port = Msr_AddressPort( address );
+			packet.WriteData( &ip, 4 );
+			packet.WriteData( &port, 2 );
+		}
+
+		offsets[ packetIndex ] = length;
+		length += packet.GetLength();
+	}
+	offsets[ numPackets ] = length;
+
+	return pages;
+}
+
+/*
+================
+sessionPages_t::Free
+================
+*/
+void sessionPages_t::Free( void* pages ) {
+	free( pages );
+}
@@ -0,0 +1,43 @@
+
+#ifndef __MSR_SESSIONPAGES_H__
+#define __MSR_SESSIONPAGES_H__
+
+#include "Common.h"
+#include "SessionRegistry.h"
+
+/*
+===============================================================================
+
+	sessionPages_t
+
+	The complete "sessions" datagrams of an unfiltered findSessions for one
+	source, OOB header included. Almost every query the browser sends is
+	unfiltered, so worker 0 encodes the list once per tick when some shard
+	changed and every worker answers from the same block by pointing its
+	send batch at the pages; a query costs no encoding and no copies.
+
+	One allocation, immutable once published and retired through the epoch
+	manager like the snapshots it is built from.
+
+===============================================================================
+*/
+
+struct sessionPages_t {
+	static const int		FIRST_SOURCE		= SS_INTERNET_ALL;
+	static const int		NUM_SOURCES			= SS_INTERNET_REPEATER - SS_INTERNET_ALL + 1;
+
+	u32						version;			// every change before this version is in the pages
+	int						numSessions;
+	int						numPackets;
+	const int*				offsets;			// numPackets + 1, the last one is the end of the data
+	const byte*				data;
+
+	const byte*				GetPacket( int index ) const { return data + offsets[ index ]; }
+	int						GetPacketLength( int index ) const { return offsets[ index + 1 ] - offsets[ index ]; }
+
+							// snapshots of every shard, in worker order like the encoded path
+	static sessionPages_t*	Build( const sessionSnapshot_t* const* snapshots, int numSnapshots, sessionSource_e source, int sessionsPerPacket, u32 version );
+	static void				Free( void* pages );
+};
+
+#endif /* !__MSR_SESSIONPAGES_H__ */
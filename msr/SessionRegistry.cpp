@@ -0,0 +1,427 @@
+
+#include "SessionRegistry.h"
+
+#include <strings.h>
+
+/*
+================
+sessionSnapshot_t::Alloc
+
+header and columns in one block, every column starts on its own cache line,
+the address index (at most half full) goes last
+================
+*/
+sessionSnapshot_t* sessionSnapshot_t::Alloc( int numEntries, int numTombstones ) {
+	const size_t ALIGN = 64;
+
+	size_t size = ( sizeof( sessionSnapshot_t ) + ALIGN - 1 ) & ~( ALIGN - 1 );
+#define SESSION_COLUMN_SIZE( type, name )	size += ( sizeof( type ) * numEntries + ALIGN - 1 ) & ~( ALIGN - 1 );
+	SESSION_COLUMNS( SESSION_COLUMN_SIZE )
+#undef SESSION_COLUMN_SIZE
+	size += sizeof( sessionTombstone_t ) * numTombstones;
+	u32 indexSize = 16;
+	while ( indexSize < ( u32 )numEntries * 2 ) {
+		indexSize <<= 1;
+	}
+	size += sizeof( int ) * indexSize;
+
+	byte* block = NULL;
+	if ( posix_memalign( ( void** )&block, ALIGN, size ) != 0 ) {
+		Msr_Error( "sessionSnapshot_t::Alloc: failed to allocate %zu bytes", size );
+	}
+
+	sessionSnapshot_t* snapshot = ( sessionSnapshot_t* )block;
+	snapshot->numEntries = numEntries;
+	snapshot->oldestVersion = 0;
+	snapshot->numTombstones = numTombstones;
+
+	byte* column = block + ( ( sizeof( sessionSnapshot_t ) + ALIGN - 1 ) & ~( ALIGN - 1 ) );
+#define SESSION_COLUMN_ASSIGN( type, name )	snapshot->name = ( type* )column; column += ( sizeof( type ) * numEntries + ALIGN - 1 ) & ~( ALIGN - 1 );
+	SESSION_COLUMNS( SESSION_COLUMN_ASSIGN )
+#undef SESSION_COLUMN_ASSIGN
+	snapshot->tombstones = ( sessionTombstone_t* )column;
+	snapshot->indexMask = indexSize - 1;
+	snapshot->index = ( int* )( column + sizeof( sessionTombstone_t ) * numTombstones );
+	memset( snapshot->index, 0xff, sizeof( int ) * indexSize );
+
+	return snapshot;
+}
+
+/*
+================
+sessionSnapshot_t::Free
+================
+*/
+void sessionSnapshot_t::Free( void* snapshot ) {
+	free( snapshot );
+}
+
+/*
+================
+sessionServerInfo_t::Alloc
+================
+*/
+sessionServerInfo_t* sessionServerInfo_t::Alloc( const byte* serverInfo, int length ) {
+	sessionServerInfo_t* info = ( sessionServerInfo_t* )malloc( sizeof( sessionServerInfo_t ) + length );
+	info->length = length;
+	memcpy( info->data, serverInfo, length );
+	info->data[ length ] = '\0';		// an empty block still reads as an empty list
+	return info;
+}
+
+/*
+================
+sessionServerInfo_t::Free
+================
+*/
+void sessionServerInfo_t::Free( sessionServerInfo_t* serverInfo ) {
+	free( serverInfo );
+}
+
+/*
+================
+sessionServerInfo_t::GetString
+================
+*/
+const char* sessionServerInfo_t::GetString( const char* key ) const {
+	const char* p = data;
+	const char* end = data + length;
+	while ( p < end && *p != '\0' ) {
+		const char* k = p;
+		p += strlen( p ) + 1;
+		if ( p >= end ) {
+			break;
+		}
+		if ( !strcasecmp( k, key ) ) {
+			return p;
+		}
+		p += strlen( p ) + 1;
+	}
+	return "";
+}
+
+/*
+================
+sessionGarbage_t::Free
+================
+*/
+void sessionGarbage_t::Free( void* garbage ) {
+	sessionGarbage_t* g = ( sessionGarbage_t* )garbage;
+	for ( size_t i = 0; i < g->serverInfos.size(); i++ ) {
+		sessionServerInfo_t::Free( g->serverInfos[ i ] );
+	}
+	delete g;
+}
+
+/*
+================
+sessionSnapshot_t::MatchesSource
+
+LAN sessions are found by broadcast, the master only lists internet sessions
+================
+*/
+bool sessionSnapshot_t::MatchesSource( int flags, sessionSource_e source ) {
+	switch ( source ) {
+		case SS_INTERNET_ALL:
+			return ( flags & SESSION_FLAG_REPEATER ) == 0;
+		case SS_INTERNET_RANKED:
+			return ( flags & ( SESSION_FLAG_REPEATER | SESSION_FLAG_RANKED ) ) == SESSION_FLAG_RANKED;
+		case SS_INTERNET_REPEATER:
+			return ( flags & SESSION_FLAG_REPEATER ) != 0;
+		default:
+			return false;
+	}
+}
+
+/*
+================
+sdSessionRegistry::sdSessionRegistry
+================
+*/
+sdSessionRegistry::sdSessionRegistry( void ) :
+	garbage( NULL ),
+	oldestVersion( 0 ),
+	versionCounter( NULL ),
+	dirty( false ) {
+	expireWheel.Init( EXPIRE_RESOLUTION, Sys_Milliseconds() );
+}
+
+/*
+================
+sdSessionRegistry::~sdSessionRegistry
+================
+*/
+sdSessionRegistry::~sdSessionRegistry( void ) {
+	for ( int i = 0; i < Num(); i++ ) {
+		sessionServerInfo_t::Free( serverInfos[ i ] );
+	}
+	if ( garbage != NULL ) {
+		sessionGarbage_t::Free( garbage );
+	}
+}
+
+/*
+================
+sdSessionRegistry::ParseServerInfo
+================
+*/
+void sdSessionRegistry::ParseServerInfo( const byte* serverInfo, int serverInfoLength, int& flags, int& maxPlayers ) {
+	static const struct {
+		const char*		key;
+		int				flag;
+	} boolKeys[] = {
+		{ "si_needPass",					SESSION_FLAG_NEEDPASS },
+		{ "si_pure",						SESSION_FLAG_PURE },
+		{ "net_serverPunkbusterEnabled",	SESSION_FLAG_PUNKBUSTER },
+		{ "si_teamDamage",					SESSION_FLAG_TEAMDAMAGE },
+		{ "si_allowLateJoin",				SESSION_FLAG_LATEJOIN },
+		{ "si_teamForceBalance",			SESSION_FLAG_AUTOBALANCE },
+	};
+
+	flags = 0;
+	maxPlayers = 0;
+
+	const char* p = ( const char* )serverInfo;
+	const char* end = p + serverInfoLength;
+	while ( p < end && *p != '\0' ) {
+		const char* key = p;
+		p += strlen( p ) + 1;
+		if ( p >= end ) {
+			break;
+		}
+		const char* value = p;
+		p += strlen( p ) + 1;
+
+		if ( !strcasecmp( key, "si_maxPlayers" ) ) {
+			maxPlayers = atoi( value );
+			continue;
+		}
+		if ( !strcasecmp( key, "fs_game" ) ) {
+			if ( value[ 0 ] != '\0' ) {
+				flags |= SESSION_FLAG_MODS;
+			}
+			continue;
+		}
+		for ( size_t i = 0; i < sizeof( boolKeys ) / sizeof( boolKeys[ 0 ] ); i++ ) {
+			if ( !strcasecmp( key, boolKeys[ i ].key ) ) {
+				if ( atoi( value ) != 0 ) {
+					flags |= boolKeys[ i ].flag;
+				}
+				break;
+			}
+		}
+	}
+}
+
+/*
+================
+sdSessionRegistry::Update
+
+the serverInfo block has been checked to be NUL terminated by the caller
+================
+*/
+void sdSessionRegistry::Update( u64 address, const sessionInfo_t& info, const byte* serverInfo, int serverInfoLength, int expireTime ) {
+	int infoFlags;
+	int infoMaxPlayers;
+	ParseServerInfo( serverInfo, serverInfoLength, infoFlags, infoMaxPlayers );
+
+	const u16 newFlags = ( u16 )( ( info.flags & SESSION_FLAG_WIRE_MASK ) | infoFlags );
+	// the client counts are bytes, a value that can never equal them keeps the SF_FULL compare exact
+	const u16 newMaxPlayers = ( u16 )( infoMaxPlayers < 0 || infoMaxPlayers > 255 ? 0xffff : infoMaxPlayers );
+
+	bool changed = false;
+
+	int index = hash.Find( address );
+	if ( index == sdAddressHash::INVALID_INDEX ) {
+		index = Num();
+#define SESSION_COLUMN_GROW( type, name )	name.resize( index + 1 );
+		SESSION_COLUMNS( SESSION_COLUMN_GROW )
+#undef SESSION_COLUMN_GROW
+		expireTimers.push_back( expireWheel.Schedule( expireTime, address ) );
+
+		addresses[ index ] = address;
+		coords[ index ].Init();
+		hash.Set( address, index );
+		changed = true;
+	} else {
+		expireWheel.Reschedule( expireTimers[ index ], expireTime );
+	}
+
+	if ( flags[ index ] != newFlags ||
+		numClients[ index ] != ( u8 )info.numClients ||
+		numBots[ index ] != ( u8 )info.numBots ||
+		maxPlayers[ index ] != newMaxPlayers ||
+		gameStates[ index ] != ( u8 )info.gameState ||
+		sessionTimes[ index ] != info.sessionTime ||
+		numRepeaterClients[ index ] != ( u16 )info.numRepeaterClients ||
+		maxRepeaterClients[ index ] != ( u16 )info.maxRepeaterClients ) {
+		changed = true;
+	}
+
+	flags[ index ] = newFlags;
+	numClients[ index ] = ( u8 )info.numClients;
+	numBots[ index ] = ( u8 )info.numBots;
+	maxPlayers[ index ] = newMaxPlayers;
+	gameStates[ index ] = ( u8 )info.gameState;
+	sessionTimes[ index ] = info.sessionTime;
+	numRepeaterClients[ index ] = ( u16 )info.numRepeaterClients;
+	maxRepeaterClients[ index ] = ( u16 )info.maxRepeaterClients;
+
+	sessionServerInfo_t* oldInfo = serverInfos[ index ];
+	if ( oldInfo == NULL || oldInfo->length != serverInfoLength || memcmp( oldInfo->data, serverInfo, serverInfoLength ) != 0 ) {
+		if ( oldInfo != NULL ) {
+			if ( garbage == NULL ) {
+				garbage = new sessionGarbage_t;
+			}
+			garbage->serverInfos.push_back( oldInfo );
+		}
+		serverInfos[ index ] = sessionServerInfo_t::Alloc( serverInfo, serverInfoLength );
+		changed = true;
+	}
+
+	// refreshes that only keep the session alive don't show up in deltas
+	if ( changed ) {
+		versions[ index ] = NextVersion();
+	}
+}
+
+/*
+================
+sdSessionRegistry::GetSession
+================
+*/
+void sdSessionRegistry::GetSession( int index, sessionInfo_t& info ) const {
+	info.numClients = numClients[ index ];
+	info.numBots = numBots[ index ];
+	info.gameState = gameStates[ index ];
+	info.flags = flags[ index ] & SESSION_FLAG_WIRE_MASK;
+	info.sessionTime = sessionTimes[ index ];
+	info.numRepeaterClients = numRepeaterClients[ index ];
+	info.maxRepeaterClients = maxRepeaterClients[ index ];
+}
+
+/*
+================
+sdSessionRegistry::SetInterestedClients
+================
+*/
+void sdSessionRegistry::SetInterestedClients( int index, int num ) {
+	const u16 clamped = ( u16 )( num < 0xffff ? num : 0xffff );
+	if ( interestedClients[ index ] != clamped ) {
+		interestedClients[ index ] = clamped;
+		dirty = true;
+	}
+}
+
+/*
+================
+sdSessionRegistry::Remove
+================
+*/
+bool sdSessionRegistry::Remove( u64 address ) {
+	int index = hash.Find( address );
+	if ( index == sdAddressHash::INVALID_INDEX ) {
+		return false;
+	}
+	RemoveIndex( index );
+	return true;
+}
+
+/*
+================
+sdSessionRegistry::RemoveIndex
+
+swaps the last session into the hole so the columns stay dense
+================
+*/
+void sdSessionRegistry::RemoveIndex( int index ) {
+	hash.Remove( addresses[ index ] );
+	if ( expireTimers[ index ] != sdTimerWheel::INVALID_TIMER ) {
+		expireWheel.Cancel( expireTimers[ index ] );
+	}
+
+	if ( garbage == NULL ) {
+		garbage = new sessionGarbage_t;
+	}
+	garbage->serverInfos.push_back( serverInfos[ index ] );
+
+	// the oldest half of the tombstones is dropped at once, clients older than that get the full list
+	if ( ( int )tombstones.size() >= MAX_TOMBSTONES ) {
+		const int numDropped = MAX_TOMBSTONES / 2;
+		oldestVersion = tombstones[ numDropped - 1 ].version + 1;
+		tombstones.erase( tombstones.begin(), tombstones.begin() + numDropped );
+	}
+	sessionTombstone_t tombstone;
+	tombstone.address = addresses[ index ];
+	tombstone.version = NextVersion();
+	tombstones.push_back( tombstone );
+
+	int last = Num() - 1;
+	if ( index != last ) {
+#define SESSION_COLUMN_MOVE( type, name )	name[ index ] = name[ last ];
+		SESSION_COLUMNS( SESSION_COLUMN_MOVE )
+#undef SESSION_COLUMN_MOVE
+		expireTimers[ index ] = expireTimers[ last ];
+		hash.Set( addresses[ index ], index );
+	}
+
+#define SESSION_COLUMN_SHRINK( type, name )	name.pop_back();
+	SESSION_COLUMNS( SESSION_COLUMN_SHRINK )
+#undef SESSION_COLUMN_SHRINK
+	expireTimers.pop_back();
+}
+
+/*
+================
+sdSessionRegistry::Expire
+================
+*/
+int sdSessionRegistry::Expire( int now ) {
+	auto expired = [this]( u64 address ) {
+		int index = hash.Find( address );
+		expireTimers[ index ] = sdTimerWheel::INVALID_TIMER;		// already released by the wheel
+		RemoveIndex( index );
+	};
+	return expireWheel.Advance( now, expired );
+}
+
+/*
+================
+sdSessionRegistry::BuildSnapshot
+
+one memcpy per column, then the address index
+================
+*/
+sessionSnapshot_t* sdSessionRegistry::BuildSnapshot( void ) {
+	const int num = Num();
+	sessionSnapshot_t* snapshot = sessionSnapshot_t::Alloc( num, ( int )tombstones.size() );
+	if ( num > 0 ) {
+#define SESSION_COLUMN_COPY( type, name )	memcpy( snapshot->name, name.data(), sizeof( type ) * num );
+		SESSION_COLUMNS( SESSION_COLUMN_COPY )
+#undef SESSION_COLUMN_COPY
+	}
+	for ( int i = 0; i < num; i++ ) {
+		u32 slot = sdAddressHash::Hash( addresses[ i ] ) & snapshot->indexMask;
+		while ( snapshot->index[ slot ] >= 0 ) {
+			slot = ( slot + 1 ) & snapshot->indexMask;
+		}
+		snapshot->index[ slot ] = i;
+	}
+	if ( !tombstones.empty() ) {
+		memcpy( snapshot->tombstones, tombstones.data(), sizeof( sessionTombstone_t ) * tombstones.size() );
+	}
+	snapshot->oldestVersion = oldestVersion;
+	dirty = false;
+	return snapshot;
+}
+
+/*
+================
+sdSessionRegistry::TakeGarbage
+================
+*/
+sessionGarbage_t* sdSessionRegistry::TakeGarbage( void ) {
+	sessionGarbage_t* g = garbage;
+	garbage = NULL;
+	return g;
+}
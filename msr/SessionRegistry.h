@@ -0,0 +1,244 @@
+
+#ifndef __MSR_SESSIONREGISTRY_H__
+#define __MSR_SESSIONREGISTRY_H__
+
+#include "Common.h"
+#include "AddressHash.h"
+#include "NetCoords.h"
+#include "TimerWheel.h"
+
+#include <atomic>
+#include <vector>
+
+/*
+===============================================================================
+
+	sdSessionRegistry
+
+	The sessions advertised to one master worker. SO_REUSEPORT hashes on the
+	source address, so a game server always talks to the same worker and its
+	session lives in exactly one shard; nothing in here is shared or locked.
+
+	Sessions are stored as columns (structure of arrays) kept dense by
+	swapping the last session into removed slots. The serverInfo strings are
+	only parsed when a session is updated, queries read the columns.
+
+	Every change takes a new version from the counter shared by all shards,
+	removals leave a tombstone, so refreshSessions can send only what changed
+	since the version a client saw last. Versions are u32 and compared with
+	Msr_VersionBefore, they wrap after 2^31 changes.
+
+	Every session has a timer in a hierarchical wheel that is pushed back by
+	each update, Expire only visits the sessions that are due.
+
+	Other shards see the sessions through the immutable snapshot published
+	by BuildSnapshot.
+
+===============================================================================
+*/
+
+// same values as sdNetSessionManager::sessionSource_e
+enum sessionSource_e {
+	SS_LAN,
+	SS_LAN_REPEATER,
+	SS_INTERNET_ALL,
+	SS_INTERNET_RANKED,
+	SS_INTERNET_REPEATER,
+};
+
+// sent in the updateSession flags byte
+const int SESSION_FLAG_RANKED		= 1 << 0;
+const int SESSION_FLAG_REPEATER		= 1 << 1;
+const int SESSION_FLAG_WIRE_MASK	= SESSION_FLAG_RANKED | SESSION_FLAG_REPEATER;
+
+// taken from the serverInfo when the session is updated, the same keys sdNetManager::SessionIsFiltered reads
+const int SESSION_FLAG_NEEDPASS		= 1 << 2;		// si_needPass
+const int SESSION_FLAG_PURE			= 1 << 3;		// si_pure
+const int SESSION_FLAG_PUNKBUSTER	= 1 << 4;		// net_serverPunkbusterEnabled
+const int SESSION_FLAG_TEAMDAMAGE	= 1 << 5;		// si_teamDamage
+const int SESSION_FLAG_LATEJOIN		= 1 << 6;		// si_allowLateJoin
+const int SESSION_FLAG_AUTOBALANCE	= 1 << 7;		// si_teamForceBalance
+const int SESSION_FLAG_MODS			= 1 << 8;		// fs_game is set
+
+struct sessionInfo_t {
+	int						numClients;
+	int						numBots;
+	int						gameState;		// sdGameRules::PGS_* bits
+	int						flags;			// SESSION_FLAG_*
+	int						sessionTime;
+	int						numRepeaterClients;
+	int						maxRepeaterClients;
+};
+
+/*
+================
+sessionServerInfo_t
+
+immutable copy of the serverInfo block of one update, shared with the snapshots
+================
+*/
+struct sessionServerInfo_t {
+	int						length;
+	char					data[ 1 ];		// variable sized, key\0value\0 ... \0
+
+	static sessionServerInfo_t*	Alloc( const byte* serverInfo, int length );
+	static void				Free( sessionServerInfo_t* serverInfo );
+
+							// returns "" if the key is not set
+	const char*				GetString( const char* key ) const;
+};
+
+/*
+================
+sessionGarbage_t
+
+serverInfo blocks the registry no longer references; the last published
+snapshot may still, so they are retired together with it
+================
+*/
+struct sessionGarbage_t {
+	std::vector< sessionServerInfo_t* >	serverInfos;
+
+	static void				Free( void* garbage );
+};
+
+/*
+================
+SESSION_COLUMNS
+
+the fields every list query and filter reads, stored one array per field so a
+scan over a single field touches nothing else
+================
+*/
+#define SESSION_COLUMNS( COLUMN )											\
+	COLUMN( u64,	addresses )			/* Msr_PackAddress */				\
+	COLUMN( u32,	versions )			/* version of the last change */	\
+	COLUMN( u16,	flags )				/* SESSION_FLAG_* */				\
+	COLUMN( u8,		numClients )										\
+	COLUMN( u8,		numBots )											\
+	COLUMN( u16,	maxPlayers )		/* si_maxPlayers, see ParseServerInfo */	\
+	COLUMN( u8,		gameStates )		/* sdGameRules::PGS_* bits */		\
+	COLUMN( int,	sessionTimes )										\
+	COLUMN( u16,	numRepeaterClients )								\
+	COLUMN( u16,	maxRepeaterClients )								\
+	COLUMN( u16,	interestedClients )	/* sdInterestCounters window sum */	\
+	COLUMN( netCoord_t,	coords )		/* Vivaldi coordinate from pingReport */	\
+	COLUMN( sessionServerInfo_t*,	serverInfos )	/* only read by string filters */
+
+/*
+================
+Msr_VersionBefore
+================
+*/
+inline bool Msr_VersionBefore( u32 a, u32 b ) {
+	return ( int )( a - b ) < 0;
+}
+
+struct sessionTombstone_t {
+	u64						address;
+	u32						version;		// version of the removal
+};
+
+/*
+================
+sessionSnapshot_t
+
+immutable copy of one shard's columns, every column lives in the same allocation
+================
+*/
+struct sessionSnapshot_t {
+	int						numEntries;
+
+							// changes from oldestVersion on can be sent as a delta, older clients get the full list
+	u32						oldestVersion;
+	int						numTombstones;
+	sessionTombstone_t*		tombstones;		// ordered by version
+
+							// open addressing from address to entry, so other shards can look sessions up
+	u32						indexMask;
+	int*					index;
+
+#define SESSION_COLUMN_POINTER( type, name )	type* name;
+	SESSION_COLUMNS( SESSION_COLUMN_POINTER )
+#undef SESSION_COLUMN_POINTER
+
+	static sessionSnapshot_t*	Alloc( int numEntries, int numTombstones );
+	static void				Free( void* snapshot );
+
+	static bool				MatchesSource( int flags, sessionSource_e source );
+
+							// -1 if the session is not in the snapshot
+	int						Find( u64 address ) const {
+								for ( u32 i = sdAddressHash::Hash( address ) & indexMask; ; i = ( i + 1 ) & indexMask ) {
+									if ( index[ i ] < 0 || addresses[ index[ i ] ] == address ) {
+										return index[ i ];
+									}
+								}
+							}
+};
+
+class sdSessionRegistry {
+public:
+	static const int		MAX_SERVERINFO_SIZE	= 4096;
+	static const int		MAX_TOMBSTONES		= 4096;
+	static const int		EXPIRE_RESOLUTION	= 100;		// msec, sessions are removed at most this late
+
+							sdSessionRegistry( void );
+							~sdSessionRegistry( void );
+
+							// must be set before the first update, shared by every shard
+	void					SetVersionCounter( std::atomic< u32 >* counter ) { versionCounter = counter; }
+
+	int						Num( void ) const { return ( int )addresses.size(); }
+	bool					IsDirty( void ) const { return dirty; }
+	u64						GetAddress( int index ) const { return addresses[ index ]; }
+	int						Find( u64 address ) const { return hash.Find( address ); }
+							// what the last updateSession sent, for sdSessionJournal
+	void					GetSession( int index, sessionInfo_t& info ) const;
+	const sessionServerInfo_t*	GetServerInfo( int index ) const { return serverInfos[ index ]; }
+	int						GetExpireTime( int index ) const { return expireWheel.GetTime( expireTimers[ index ] ); }
+
+							// not versioned, the count is not part of the session list
+	void					SetInterestedClients( int index, int num );
+	const netCoord_t&		GetCoord( int index ) const { return coords[ index ]; }
+	void					SetCoord( int index, const netCoord_t& coord ) { coords[ index ] = coord; dirty = true; }
+
+							// serverInfo is the raw key\0value\0 ... \0 block of the updateSession packet,
+							// the session is removed at expireTime unless it is updated again
+	void					Update( u64 address, const sessionInfo_t& info, const byte* serverInfo, int serverInfoLength, int expireTime );
+	bool					Remove( u64 address );
+
+							// removes every session whose expire time has passed
+	int						Expire( int now );
+
+	sessionSnapshot_t*		BuildSnapshot( void );
+							// serverInfo blocks replaced or removed since the last call, NULL if there are none
+	sessionGarbage_t*		TakeGarbage( void );
+
+private:
+	void					RemoveIndex( int index );
+	u32						NextVersion( void ) { dirty = true; return versionCounter->fetch_add( 1 ); }
+
+	static void				ParseServerInfo( const byte* serverInfo, int serverInfoLength, int& flags, int& maxPlayers );
+
+	// hot columns, indexed by the value stored in hash
+#define SESSION_COLUMN_VECTOR( type, name )	std::vector< type > name;
+	SESSION_COLUMNS( SESSION_COLUMN_VECTOR )
+#undef SESSION_COLUMN_VECTOR
+
+	// cold columns
+	std::vector< int >		expireTimers;		// handles in expireWheel, keyed by address
+
+	sdTimerWheel			expireWheel;
+
+	sessionGarbage_t*		garbage;
+
+	std::vector< sessionTombstone_t >	tombstones;
+	u32						oldestVersion;
+	std::atomic< u32 >*		versionCounter;
+
+	sdAddressHash			hash;
+	bool					dirty;
+};
+
+#endif /* !__MSR_SESSIONREGISTRY_H__ */
@@ -0,0 +1,130 @@
+
+#ifndef __MSR_SOURCELIMITER_H__
+#define __MSR_SOURCELIMITER_H__
+
+#include "Common.h"
+#include "AddressHash.h"
+
+/*
+===============================================================================
+
+	sdSourceLimiter
+
+	Token bucket per source IP for the connectionless packets, so a single
+	scanner or misbehaving browser can't take the worker from everybody else.
+	Admit is called with the address from recvmmsg before anything else looks
+	at the packet.
+
+	The buckets live in a fixed open addressing table that is never resized
+	or swept. Entries are not removed either: a bucket that has been idle long
+	enough to be full again is indistinguishable from a new one, so the first
+	such entry on the probe path is simply taken over. When MAX_PROBES finds
+	no room (a flood of spoofed sources) the packet is let through untracked,
+	per source limiting can't help there anyway.
+
+	Every worker has its own limiter, a source spread over several workers by
+	SO_REUSEPORT gets the rate on each of them.
+
+===============================================================================
+*/
+
+class sdSourceLimiter {
+public:
+	static const int		TABLE_SIZE			= 1 << 18;		// 3 MB per worker, holds 100k+ active sources
+	static const int		MAX_PROBES			= 16;
+	static const int		TOKEN				= 1000;			// tokens are kept in 1/1000 packets
+	static const int		MAX_BURST			= 1000 * 1000;
+
+							sdSourceLimiter( void ) : buckets( NULL ), rate( 0 ), capacity( 0 ), refillTime( 0 ), numUntracked( 0 ) {}
+							~sdSourceLimiter( void ) { delete[] buckets; }
+
+							// packets per second and the burst allowed on top, a rate of 0 admits everything
+	void					Init( int rate, int burst ) {
+								delete[] buckets;
+								buckets = NULL;
+								this->rate = rate;
+								if ( rate <= 0 ) {
+									return;
+								}
+								if ( burst < 1 ) {
+									burst = 1;
+								} else if ( burst > MAX_BURST ) {
+									burst = MAX_BURST;
+								}
+								capacity = burst * TOKEN;
+								refillTime = ( capacity + rate - 1 ) / rate;
+								buckets = new bucket_t[ TABLE_SIZE ];
+								memset( buckets, 0, sizeof( bucket_t ) * TABLE_SIZE );
+							}
+
+	bool					IsEnabled( void ) const { return buckets != NULL; }
+	u64						GetNumUntracked( void ) const { return numUntracked; }
+
+							// ip in network byte order, now in milliseconds
+	bool					Admit( u32 ip, int now ) {
+								if ( buckets == NULL || ip == 0 ) {
+									return true;
+								}
+
+								bucket_t* reuse = NULL;
+								u32 i = sdAddressHash::Hash( ip );
+								for ( int probe = 0; probe < MAX_PROBES; probe++, i++ ) {
+									bucket_t& bucket = buckets[ i & ( TABLE_SIZE - 1 ) ];
+									if ( bucket.ip == ip ) {
+										return Take( bucket, now );
+									}
+									if ( bucket.ip == 0 ) {
+										if ( reuse == NULL ) {
+											reuse = &bucket;
+										}
+										break;
+									}
+									if ( reuse == NULL && now - bucket.lastTime >= refillTime ) {
+										reuse = &bucket;
+									}
+								}
+
+								if ( reuse == NULL ) {
+									numUntracked++;
+									return true;
+								}
+								reuse->ip = ip;
+								reuse->lastTime = now;
+								reuse->tokens = capacity - TOKEN;
+								return true;
+							}
+
+private:
+	struct bucket_t {
+		u32					ip;
+		int					lastTime;
+		int					tokens;
+	};
+
+	bool					Take( bucket_t& bucket, int now ) {
+								int elapsed = now - bucket.lastTime;
+								if ( elapsed >= refillTime ) {
+									bucket.tokens = capacity;
+								} else if ( elapsed > 0 ) {
+									bucket.tokens += elapsed * rate;
+									if ( bucket.tokens > capacity ) {
+										bucket.tokens = capacity;
+									}
+								}
+								bucket.lastTime = now;
+
+								if ( bucket.tokens < TOKEN ) {
+									return false;
+								}
+								bucket.tokens -= TOKEN;
+								return true;
+							}
+
+	bucket_t*				buckets;
+	int						rate;					// tokens per millisecond, the same number as packets per second
+	int						capacity;
+	int						refillTime;				// milliseconds for an empty bucket to fill up
+	u64						numUntracked;
+};
+
+#endif /* !__MSR_SOURCELIMITER_H__ */
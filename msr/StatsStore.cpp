@@ -0,0 +1,299 @@
+
+#include "StatsStore.h"
+#include "Msg.h"
+#include "ServerInfo.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+================
+sdStatsStore::sdStatsStore
+================
+*/
+sdStatsStore::sdStatsStore( void ) :
+	fd( -1 ),
+	running( false ),
+	numKeys( 0 ),
+	records( NULL ),
+	head( 0 ),
+	tail( 0 ),
+	numDropped( 0 ),
+	numPending( 0 ) {
+	memset( &stats, 0, sizeof( stats ) );
+	memset( keyHash, 0xff, sizeof( keyHash ) );
+	memset( leaderboards, 0, sizeof( leaderboards ) );
+}
+
+/*
+================
+sdStatsStore::~sdStatsStore
+================
+*/
+sdStatsStore::~sdStatsStore( void ) {
+	Close();
+	for ( int i = 0; i < MAX_KEYS; i++ ) {
+		delete leaderboards[ i ];
+	}
+}
+
+/*
+================
+sdStatsStore::Open
+================
+*/
+bool sdStatsStore::Open( const char* directory ) {
+	char path[ 512 ];
+	snprintf( path, sizeof( path ), "%s/stats.log", directory );
+
+	fd = open( path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644 );
+	if ( fd < 0 ) {
+		Msr_Warning( "sdStatsStore::Open: can't open '%s' (%s)", path, strerror( errno ) );
+		return false;
+	}
+
+	records = new record_t[ RING_SIZE ];
+	head.store( 0 );
+	tail.store( 0 );
+	running.store( true );
+	thread = std::thread( &sdStatsStore::Run, this );
+	return true;
+}
+
+/*
+================
+sdStatsStore::Close
+================
+*/
+void sdStatsStore::Close( void ) {
+	if ( !running.exchange( false ) ) {
+		return;
+	}
+	thread.join();
+
+	close( fd );
+	fd = -1;
+	delete[] records;
+	records = NULL;
+}
+
+/*
+================
+sdStatsStore::HashKey
+================
+*/
+u32 sdStatsStore::HashKey( const char* name, int type ) {
+	u32 hash = 2166136261u ^ ( u32 )type;
+	for ( const char* p = name; *p != '\0'; p++ ) {
+		hash = ( hash ^ ( byte )*p ) * 16777619u;
+	}
+	return hash;
+}
+
+/*
+================
+sdStatsStore::FindSlot
+
+the slot of the key in keyHash, or the empty slot it would go to
+================
+*/
+int sdStatsStore::FindSlot( const char* name, int type, u32 hash ) const {
+	const u32 mask = MAX_KEYS * 2 - 1;
+	u32 slot = hash & mask;
+	for ( ; keyHash[ slot ] >= 0; slot = ( slot + 1 ) & mask ) {
+		const key_t& key = keys[ keyHash[ slot ] ];
+		if ( key.hash == hash && key.type == type && !strcmp( key.name, name ) ) {
+			break;
+		}
+	}
+	return ( int )slot;
+}
+
+/*
+================
+sdStatsStore::FindKey
+================
+*/
+int sdStatsStore::FindKey( const char* name, int type ) const {
+	return keyHash[ FindSlot( name, type, HashKey( name, type ) ) ];
+}
+
+/*
+================
+sdStatsStore::InternKey
+
+the same name sent with another type is another key
+================
+*/
+int sdStatsStore::InternKey( const char* name, int type ) {
+	const u32 hash = HashKey( name, type );
+	const int slot = FindSlot( name, type, hash );
+	if ( keyHash[ slot ] >= 0 ) {
+		return keyHash[ slot ];
+	}
+
+	if ( numKeys == MAX_KEYS || strlen( name ) >= ( size_t )MAX_KEY_LENGTH ) {
+		return -1;
+	}
+
+	key_t& key = keys[ numKeys ];
+	strcpy( key.name, name );
+	key.type = type;
+	key.hash = hash;
+	keyHash[ slot ] = numKeys;
+	return numKeys++;
+}
+
+/*
+================
+sdStatsStore::Add
+================
+*/
+void sdStatsStore::Add( u64 client, int key, u32 value ) {
+	u32 h = head.load( std::memory_order_relaxed );
+	if ( key < 0 || h - tail.load( std::memory_order_acquire ) >= RING_SIZE ) {
+		numDropped.fetch_add( 1, std::memory_order_relaxed );
+		return;
+	}
+
+	record_t& record = records[ h & ( RING_SIZE - 1 ) ];
+	record.client = client;
+	record.key = ( u32 )key;
+	record.value = value;
+
+	head.store( h + 1, std::memory_order_release );
+}
+
+/*
+================
+sdStatsStore::QueryLeaderboard
+================
+*/
+bool sdStatsStore::QueryLeaderboard( int key, u64 client, int& rank, u32& value, int& numEntries,
+	int first, int count, sdLeaderboard::entry_t* entries, int& numReturned ) {
+	if ( key < 0 ) {
+		return false;
+	}
+
+	std::lock_guard< std::mutex > lock( leaderboardLock );
+	const sdLeaderboard* board = leaderboards[ key ];
+	if ( board == NULL ) {
+		return false;
+	}
+	rank = board->GetRank( client );
+	value = 0;
+	board->GetValue( client, value );
+	numEntries = board->Num();
+	numReturned = board->GetRange( first, count, entries );
+	return true;
+}
+
+/*
+================
+sdStatsStore::Run
+
+drains the ring into the columns and commits a group when it is full or old enough
+================
+*/
+void sdStatsStore::Run( void ) {
+	int groupStart = 0;
+	for ( ;; ) {
+		const bool stopping = !running.load( std::memory_order_acquire );
+
+		u32 t = tail.load( std::memory_order_relaxed );
+		u32 h = head.load( std::memory_order_acquire );
+		if ( t != h && numPending == 0 ) {
+			groupStart = Sys_Milliseconds();
+		}
+		for ( ; t != h; t++ ) {
+			const record_t& record = records[ t & ( RING_SIZE - 1 ) ];
+			column_t& column = columns[ record.key ];
+			if ( column.clients.empty() ) {
+				dirtyKeys.push_back( record.key );
+			}
+			column.clients.push_back( record.client );
+			column.values.push_back( record.value );
+			numPending++;
+
+			std::lock_guard< std::mutex > lock( leaderboardLock );
+			if ( leaderboards[ record.key ] == NULL ) {
+				leaderboards[ record.key ] = new sdLeaderboard( keys[ record.key ].type );
+			}
+			leaderboards[ record.key ]->Add( record.client, record.value );
+		}
+		tail.store( t, std::memory_order_release );
+
+		if ( numPending >= GROUP_RECORDS || ( numPending > 0 && ( stopping || Sys_Milliseconds() - groupStart >= GROUP_MSEC ) ) ) {
+			Commit();
+			continue;
+		}
+		if ( stopping ) {
+			break;
+		}
+		usleep( 1000 );
+	}
+}
+
+/*
+================
+sdStatsStore::Commit
+
+one segment, one write, one fdatasync for everything that is pending
+================
+*/
+void sdStatsStore::Commit( void ) {
+	const int SEGMENT_HEADER_SIZE = 12;
+
+	size_t size = SEGMENT_HEADER_SIZE + 6;
+	for ( size_t i = 0; i < dirtyKeys.size(); i++ ) {
+		const column_t& column = columns[ dirtyKeys[ i ] ];
+		size += 1 + strlen( keys[ dirtyKeys[ i ] ].name ) + 1 + 4 + column.clients.size() * ( sizeof( u64 ) + sizeof( u32 ) );
+	}
+	segment.resize( size );
+
+	sdMsgWriter msg( segment.data(), ( int )size );
+	msg.WriteData( "MSTS", 4 );
+	msg.WriteLong( ( u32 )( size - SEGMENT_HEADER_SIZE ) );
+	msg.WriteLong( 0 );		// crc, filled in below
+	msg.WriteLong( ( u32 )time( NULL ) );
+	msg.WriteShort( ( int )dirtyKeys.size() );
+	for ( size_t i = 0; i < dirtyKeys.size(); i++ ) {
+		const key_t& key = keys[ dirtyKeys[ i ] ];
+		column_t& column = columns[ dirtyKeys[ i ] ];
+		msg.WriteByte( key.type );
+		msg.WriteString( key.name );
+		msg.WriteLong( ( u32 )column.clients.size() );
+		msg.WriteData( column.clients.data(), ( int )( column.clients.size() * sizeof( u64 ) ) );
+		msg.WriteData( column.values.data(), ( int )( column.values.size() * sizeof( u32 ) ) );
+
+		stats.records += column.clients.size();
+		column.clients.clear();
+		column.values.clear();
+	}
+	dirtyKeys.clear();
+	numPending = 0;
+
+	const u32 crc = Msr_CRC32( 0xffffffff, segment.data() + SEGMENT_HEADER_SIZE, ( int )( size - SEGMENT_HEADER_SIZE ) ) ^ 0xffffffff;
+	sdMsgWriter crcField( segment.data() + 8, 4 );
+	crcField.WriteLong( crc );
+
+	u64 start = Sys_Microseconds();
+	size_t written = 0;
+	while ( written < size ) {
+		ssize_t num = write( fd, segment.data() + written, size - written );
+		if ( num < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			Msr_Warning( "sdStatsStore::Commit: write failed (%s)", strerror( errno ) );
+			break;
+		}
+		written += num;
+	}
+	fdatasync( fd );
+
+	stats.syncMicroseconds += Sys_Microseconds() - start;
+	stats.bytes += written;
+	stats.groups++;
+}
@@ -0,0 +1,143 @@
+
+#ifndef __MSR_STATSSTORE_H__
+#define __MSR_STATSSTORE_H__
+
+#include "Common.h"
+#include "Leaderboard.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+===============================================================================
+
+	sdStatsStore
+
+	Takes the sdNetStatsManager::WriteDictionary uploads servers send at the
+	end of every round. Rounds end together on many servers, so the records
+	arrive in bursts that must not stall the network thread.
+
+	The network thread interns the key and copies a 16 byte record into a
+	single producer / single consumer ring, nothing else. The writer thread
+	sorts what it drains into one column pair (clients, values) per key and
+	commits them as a group: once GROUP_RECORDS are waiting or GROUP_MSEC
+	after the first one arrived, every column is written as one segment of
+	stats.log with a single write and a single fdatasync. A full ring drops
+	the record and counts it instead of blocking.
+
+	Segment:	long magic "MSTS", long length, long crc32 of what follows, long wall clock seconds,
+				short numKeys, numKeys * ( byte type, string key, long count, count * u64 client, count * long value )
+
+	A torn last segment fails its crc and is skipped by readers.
+
+	The writer also folds every record into the key's sdLeaderboard as it
+	drains the ring, so ranks and pages are current before the group is
+	even committed. The boards are shared with the network thread through
+	one lock that is only held for a single update or query; they live in
+	memory and start empty with the process.
+
+===============================================================================
+*/
+
+class sdStatsStore {
+public:
+	static const int			MAX_KEYS			= 1024;
+	static const int			MAX_KEY_LENGTH		= 64;			// including the terminator
+	static const int			RING_SIZE			= 1 << 18;		// records, 4 MB, must be a power of two
+	static const int			GROUP_RECORDS		= 16384;
+	static const int			GROUP_MSEC			= 20;
+
+	// same values as sdNetStatKeyValue::statValueType
+	enum valueType_e {
+		SVT_INT,
+		SVT_FLOAT,
+		SVT_INT_MAX,
+		SVT_FLOAT_MAX,
+		SVT_NUM_TYPES
+	};
+
+	struct stats_t {
+		u64						records;			// committed
+		u64						dropped;			// ring full or out of keys
+		u64						groups;
+		u64						bytes;
+		u64						syncMicroseconds;
+	};
+
+								sdStatsStore( void );
+								~sdStatsStore( void );
+
+								// opens or appends to directory/stats.log and starts the writer
+	bool						Open( const char* directory );
+								// commits what is queued and stops the writer
+	void						Close( void );
+	bool						IsOpen( void ) const { return fd >= 0; }
+
+								// network thread only, -1 once MAX_KEYS keys are known or the key is too long
+	int							InternKey( const char* name, int type );
+								// network thread only, -1 if no upload used the key yet
+	int							FindKey( const char* name, int type ) const;
+								// network thread only, value holds the int or float bits
+	void						Add( u64 client, int key, u32 value );
+
+								// network thread, false if nothing was uploaded for the key yet; rank is
+								// sdLeaderboard::INVALID_RANK when the client has no value
+	bool						QueryLeaderboard( int key, u64 client, int& rank, u32& value, int& numEntries,
+									int first, int count, sdLeaderboard::entry_t* entries, int& numReturned );
+
+								// counters of the writer, read them after Close
+	const stats_t&				GetStats( void ) const { return stats; }
+	u64							GetNumDropped( void ) const { return numDropped.load( std::memory_order_relaxed ); }
+
+private:
+	struct record_t {
+		u64						client;
+		u32						key;
+		u32						value;
+	};
+
+	struct key_t {
+		char					name[ MAX_KEY_LENGTH ];
+		int						type;
+		u32						hash;
+	};
+
+	struct column_t {
+		std::vector< u64 >		clients;
+		std::vector< u32 >		values;
+	};
+
+	static u32					HashKey( const char* name, int type );
+	int							FindSlot( const char* name, int type, u32 hash ) const;
+
+	void						Run( void );
+	void						Commit( void );
+
+	int							fd;
+	std::atomic< bool >			running;
+	std::thread					thread;
+
+								// written by the network thread before the first record that uses them
+	key_t						keys[ MAX_KEYS ];
+	int							numKeys;
+	int							keyHash[ MAX_KEYS * 2 ];		// open addressing into keys, -1 is empty
+
+	record_t*					records;
+	std::atomic< u32 >			head;			// written by the producer
+	std::atomic< u32 >			tail;			// written by the consumer
+	std::atomic< u64 >			numDropped;
+
+	std::mutex					leaderboardLock;
+	sdLeaderboard*				leaderboards[ MAX_KEYS ];		// created by the writer
+
+								// writer thread only
+	column_t					columns[ MAX_KEYS ];
+	std::vector< int >			dirtyKeys;
+	int							numPending;
+	std::vector< byte >			segment;
+	stats_t						stats;
+};
+
+#endif /* !__MSR_STATSSTORE_H__ */
@@ -0,0 +1,77 @@
+
+#include "StatusCache.h"
+#include "ServerInfo.h"
+
+#include <strings.h>
+
+/*
+================
+sdStatusCache::sdStatusCache
+================
+*/
+sdStatusCache::sdStatusCache( void ) :
+	length( 0 ),
+	checksum( 0 ),
+	valid( false ),
+	numBuilds( 0 ) {
+}
+
+/*
+================
+sdStatusCache::Build
+
+name, map and max players have their own fields, the rest of the dictionary
+follows as key / value pairs; pairs that do not fit are left out
+================
+*/
+void sdStatusCache::Build( const sdServerInfo& serverInfo ) {
+	byte keyValues[ MAX_STATUS_SERVERINFO ];
+	sdMsgWriter msg( keyValues, sizeof( keyValues ) );
+	for ( int i = 0; i < serverInfo.GetNumKeyVals(); i++ ) {
+		const char* key = serverInfo.GetKey( i );
+		if ( !strcasecmp( key, "si_name" ) || !strcasecmp( key, "si_maxPlayers" ) || !strcasecmp( key, "si_map" ) ) {
+			continue;
+		}
+		const char* value = serverInfo.GetValue( i );
+		if ( ( int )( strlen( key ) + strlen( value ) + 2 ) > msg.GetRemaining() ) {
+			Msr_Warning( "sdStatusCache::Build: serverInfo is larger than %d bytes, '%s' and later keys are not reported", MAX_STATUS_SERVERINFO, key );
+			break;
+		}
+		msg.WriteString( key );
+		msg.WriteString( value );
+	}
+
+	pkData_t keyValueData;
+	keyValueData.data = keyValues;
+	keyValueData.length = msg.GetLength();
+
+	// the echoed longs are patched in by Write
+	length = statusResponsePacket_t::Encode( data,
+		0, 0,
+		PROTOCOL_MINOR, PROTOCOL_MAJOR, 153,
+		serverInfo.GetString( "si_name" ),
+		serverInfo.GetInt( "si_maxPlayers", 24 ),
+		serverInfo.GetString( "si_map" ),
+		0,
+		keyValueData,
+		0, 0xffffffff, 0, 256 );
+
+	checksum = serverInfo.Checksum();
+	valid = true;
+	numBuilds++;
+}
+
+/*
+================
+sdStatusCache::Write
+================
+*/
+void sdStatusCache::Write( sdMsgWriter& reply, u32 challenge, u32 queryId ) const {
+	byte* dest = reply.GetWriteBuffer( length );
+	if ( dest == NULL ) {
+		return;
+	}
+	memcpy( dest, data, length );
+	pkLong::Write( pkLong::Write( dest + ECHO_OFFSET, challenge ), queryId );
+	reply.CommitWrite( length );
+}
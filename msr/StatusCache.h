@@ -0,0 +1,45 @@
+
+#ifndef __MSR_STATUSCACHE_H__
+#define __MSR_STATUSCACHE_H__
+
+#include "OOBPackets.h"
+
+class sdServerInfo;
+
+/*
+===============================================================================
+
+	sdStatusCache
+
+	The encoded statusResponse, built once per serverInfo checksum. Only the
+	two longs echoed from the query differ between replies; they sit right
+	after the command string, so a reply is one copy and two stores.
+
+	Every worker keeps its own cache, nothing in here is shared.
+
+===============================================================================
+*/
+
+class sdStatusCache {
+public:
+							sdStatusCache( void );
+
+	bool					IsValid( u32 checksum ) const { return valid && this->checksum == checksum; }
+	void					Build( const sdServerInfo& serverInfo );
+
+	int						GetNumBuilds( void ) const { return numBuilds; }
+
+							// writes everything after the OOB header
+	void					Write( sdMsgWriter& reply, u32 challenge, u32 queryId ) const;
+
+private:
+	static const int		ECHO_OFFSET			= statusResponsePacket_t::NAME_SIZE;
+
+	byte					data[ statusResponsePacket_t::MAX_SIZE ];
+	int						length;
+	u32						checksum;
+	bool					valid;
+	int						numBuilds;
+};
+
+#endif /* !__MSR_STATUSCACHE_H__ */
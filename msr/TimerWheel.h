@@ -0,0 +1,183 @@
+
+#ifndef __MSR_TIMERWHEEL_H__
+#define __MSR_TIMERWHEEL_H__
+
+#include "Common.h"
+
+#include <vector>
+
+/*
+===============================================================================
+
+	sdTimerWheel
+
+	Hierarchical timing wheel (Varghese & Lauck) with four levels of 256
+	slots over a tick counter. A timer goes into the lowest level whose span
+	covers its delay, higher level slots are cascaded down when the level
+	below wraps. Schedule, Reschedule and Cancel are O(1), and Advance only
+	touches the slots of the ticks it passes plus the timers that are due, so
+	a tick costs the same with a thousand timers as with a million.
+
+	Every timer carries a u64 key that is handed back when it fires, callers
+	keep the handle next to whatever the key names. Timers that are
+	rescheduled before they get close, like session heartbeats, never cascade.
+
+	Times are Sys_Milliseconds, rounded up to whole ticks; a timer never
+	fires early, and at most one tick late. Only differences between times
+	are used, so the clock may wrap as long as no timer is more than 24 days
+	out and Advance runs at least that often.
+
+===============================================================================
+*/
+
+class sdTimerWheel {
+public:
+	static const int		INVALID_TIMER	= -1;
+	static const int		NUM_LEVELS		= 4;
+	static const int		SLOT_BITS		= 8;
+	static const int		NUM_SLOTS		= 1 << SLOT_BITS;
+
+							sdTimerWheel( void ) : tickMsec( 1 ), startTime( 0 ), nextTick( 0 ), freeList( INVALID_TIMER ), num( 0 ) {
+								for ( int i = 0; i < NUM_LEVELS * NUM_SLOTS; i++ ) {
+									slots[ i ] = INVALID_TIMER;
+								}
+							}
+
+							// must be called before anything is scheduled
+	void					Init( int tickMsec, int now ) { this->tickMsec = tickMsec; startTime = now; nextTick = 0; }
+
+	int						Num( void ) const { return num; }
+
+	int						Schedule( int time, u64 key ) {
+								int timer = freeList;
+								if ( timer == INVALID_TIMER ) {
+									timer = ( int )timers.size();
+									timers.resize( timer + 1 );
+								} else {
+									freeList = timers[ timer ].next;
+								}
+								timers[ timer ].key = key;
+								Link( timer, TimeToTick( time ) );
+								num++;
+								return timer;
+							}
+
+	void					Reschedule( int timer, int time ) {
+								Unlink( timer );
+								Link( timer, TimeToTick( time ) );
+							}
+
+	void					Cancel( int timer ) {
+								Unlink( timer );
+								Release( timer );
+							}
+
+							// the time the timer fires at, rounded up to its tick
+	int						GetTime( int timer ) const { return ( int )TickTime( timers[ timer ].tick ); }
+
+							// fires every timer due by now, expired( key ) may schedule and cancel other timers
+	template< typename FUNC >
+	int						Advance( int now, FUNC& expired ) {
+								int numExpired = 0;
+								for ( ; ( int )( ( u32 )now - TickTime( nextTick ) ) >= 0; nextTick++ ) {
+									if ( ( nextTick & ( NUM_SLOTS - 1 ) ) == 0 ) {
+										for ( int level = 1; level < NUM_LEVELS; level++ ) {
+											u32 index = ( nextTick >> ( level * SLOT_BITS ) ) & ( NUM_SLOTS - 1 );
+											Cascade( level, index );
+											if ( index != 0 ) {
+												break;
+											}
+										}
+									}
+
+									int* head = &slots[ nextTick & ( NUM_SLOTS - 1 ) ];
+									while ( *head != INVALID_TIMER ) {
+										int timer = *head;
+										u64 key = timers[ timer ].key;
+										Unlink( timer );
+										Release( timer );
+										numExpired++;
+										expired( key );
+									}
+								}
+								return numExpired;
+							}
+
+private:
+	struct timer_t {
+		u64					key;
+		u32					tick;
+		int					slot;
+		int					next;
+		int					prev;
+	};
+
+							// modulo 2^32 like the clock, only differences are meaningful
+	u32						TickTime( u32 tick ) const { return ( u32 )startTime + tick * ( u32 )tickMsec; }
+
+	u32						TimeToTick( int time ) const {
+								int delay = ( int )( ( u32 )time - TickTime( nextTick ) );
+								if ( delay <= 0 ) {
+									return nextTick;
+								}
+								return nextTick + ( ( u32 )delay + tickMsec - 1 ) / ( u32 )tickMsec;
+							}
+
+	void					Link( int timer, u32 tick ) {
+								u32 delta = tick - nextTick;
+								int level = 0;
+								while ( level < NUM_LEVELS - 1 && delta >= ( 1u << ( ( level + 1 ) * SLOT_BITS ) ) ) {
+									level++;
+								}
+								int slot = level * NUM_SLOTS + ( ( tick >> ( level * SLOT_BITS ) ) & ( NUM_SLOTS - 1 ) );
+
+								timer_t& t = timers[ timer ];
+								t.tick = tick;
+								t.slot = slot;
+								t.prev = INVALID_TIMER;
+								t.next = slots[ slot ];
+								if ( t.next != INVALID_TIMER ) {
+									timers[ t.next ].prev = timer;
+								}
+								slots[ slot ] = timer;
+							}
+
+	void					Unlink( int timer ) {
+								timer_t& t = timers[ timer ];
+								if ( t.prev != INVALID_TIMER ) {
+									timers[ t.prev ].next = t.next;
+								} else {
+									slots[ t.slot ] = t.next;
+								}
+								if ( t.next != INVALID_TIMER ) {
+									timers[ t.next ].prev = t.prev;
+								}
+							}
+
+	void					Release( int timer ) {
+								timers[ timer ].next = freeList;
+								freeList = timer;
+								num--;
+							}
+
+							// moves the timers of one slot down to the levels that now cover them
+	void					Cascade( int level, u32 index ) {
+								int timer = slots[ level * NUM_SLOTS + index ];
+								slots[ level * NUM_SLOTS + index ] = INVALID_TIMER;
+								while ( timer != INVALID_TIMER ) {
+									int next = timers[ timer ].next;
+									Link( timer, timers[ timer ].tick );
+									timer = next;
+								}
+							}
+
+	std::vector< timer_t >	timers;
+	int						slots[ NUM_LEVELS * NUM_SLOTS ];
+	int						tickMsec;
+	int						startTime;
+	u32						nextTick;		// first tick Advance has not processed
+	int						freeList;
+	int						num;
+};
+
+#endif /* !__MSR_TIMERWHEEL_H__ */